@@ -10,6 +10,8 @@
 # HAVE_INTEL_PCLMUL
 # HAVE_INTEL_SSE4_1
 # HAVE_INTEL_SSE4_2
+# HAVE_INTEL_AVX2
+# HAVE_INTEL_AVX512F
 #
 # SIMD_COMPILE_FLAGS
 #
@@ -105,6 +107,10 @@ elseif(CMAKE_SYSTEM_PROCESSOR MATCHES "i386|i686|amd64|x86_64|AMD64")
       if(HAVE_INTEL_SSE4_2)
         set(SIMD_COMPILE_FLAGS "${SIMD_COMPILE_FLAGS} -msse4.2")
       endif()
+      # not added to SIMD_COMPILE_FLAGS: only used for individual files
+      # whose code is picked at runtime
+      CHECK_C_COMPILER_FLAG(-mavx2 HAVE_INTEL_AVX2)
+      CHECK_C_COMPILER_FLAG(-mavx512f HAVE_INTEL_AVX512F)
     endif(CMAKE_SYSTEM_PROCESSOR MATCHES "amd64|x86_64|AMD64")
   endif(CMAKE_SYSTEM_PROCESSOR MATCHES "i686|amd64|x86_64|AMD64")
 elseif(CMAKE_SYSTEM_PROCESSOR MATCHES "(powerpc|ppc)64|(powerpc|ppc)64le")
@@ -354,6 +354,81 @@ function TEST_rados_get_with_subreadall_eio_shard_1() {
     delete_pool $poolname
 }
 
+function get_perf_counter() {
+    local osd_id=$1
+    local counter=$2
+
+    CEPH_ARGS='' ceph --admin-daemon $(get_asok_path osd.$osd_id) \
+        perf dump | jq ".osd.$counter"
+}
+
+#
+# A read within a single data chunk is served by the shard holding it.
+# If that shard fails the read, the stripe is read and decoded instead.
+#
+function TEST_rados_get_direct_read_eio() {
+    local dir=$1
+    setup_osds 4 || return 1
+
+    local poolname=pool-jerasure
+    create_erasure_coded_pool $poolname 2 1 || return 1
+    # 4096 bytes, all of them in the first chunk of shard 0
+    local objname=obj-direct-$$
+    rados_put $dir $poolname $objname || return 1
+    local primary=$(get_primary $poolname $objname)
+
+    local direct=$(get_perf_counter $primary ec_read_direct)
+    rados_get $dir $poolname $objname || return 1
+    test $(get_perf_counter $primary ec_read_direct) -gt $direct || return 1
+
+    direct=$(get_perf_counter $primary ec_read_direct)
+    inject_eio ec data $poolname $objname $dir 0 || return 1
+    rados_get $dir $poolname $objname || return 1
+    # decoded from shards 1 and 2, not served directly
+    test $(get_perf_counter $primary ec_read_direct) = $direct || return 1
+
+    rm $dir/ORIGINAL
+    delete_pool $poolname
+}
+
+#
+# A client read still waiting for a shard slower than it usually is
+# also reads the remaining shards and completes without it.
+#
+function TEST_rados_get_hedged() {
+    local dir=$1
+    setup_osds 4 || return 1
+
+    local poolname=pool-jerasure
+    create_erasure_coded_pool $poolname 2 1 || return 1
+    # a full stripe, read from shards 0 and 1
+    local objname=obj-hedged-$$
+    for marker in AAA BBB CCCC DDDD EEEE FFFF GGGG HHHH ; do
+        printf "%*s" 1024 $marker
+    done > $dir/ORIGINAL
+    rados --pool $poolname put $objname $dir/ORIGINAL || return 1
+    local -a osds=($(get_osds $poolname $objname))
+    local primary=${osds[0]}
+
+    # enough reads for both shards to know their usual latency
+    for i in $(seq 1 20) ; do
+        rados_get $dir $poolname $objname || return 1
+    done
+
+    local hedged=$(get_perf_counter $primary ec_read_hedged)
+    local win=$(get_perf_counter $primary ec_read_hedge_win)
+    set_config osd ${osds[1]} osd_debug_inject_dispatch_delay_duration 1 || return 1
+    set_config osd ${osds[1]} osd_debug_inject_dispatch_delay_probability 1 || return 1
+    rados_get $dir $poolname $objname || return 1
+    set_config osd ${osds[1]} osd_debug_inject_dispatch_delay_probability 0 || return 1
+    # shard 2 was read and decoded with shard 0 before shard 1 replied
+    test $(get_perf_counter $primary ec_read_hedged) -gt $hedged || return 1
+    test $(get_perf_counter $primary ec_read_hedge_win) -gt $win || return 1
+
+    rm $dir/ORIGINAL
+    delete_pool $poolname
+}
+
 # Test recovery the first k copies aren't all available
 function TEST_ec_recovery_errors() {
     local dir=$1
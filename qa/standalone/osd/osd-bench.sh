@@ -89,6 +89,30 @@ function TEST_bench() {
     ceph tell osd.0 bench 1 14456
 }
 
+function TEST_bench_run_to_completion() {
+    local dir=$1
+
+    run_mon $dir a --osd_pool_default_size=1 || return 1
+    run_mgr $dir x || return 1
+    run_osd_bluestore $dir 0 || return 1
+    create_rbd_pool || return 1
+    wait_for_clean || return 1
+
+    #
+    # same workload with the default thread pool and with one thread
+    # per shard completing its own pgs' transactions
+    #
+    for mode in false true ; do
+        kill_daemons $dir TERM osd || return 1
+        activate_osd $dir 0 --osd-op-run-to-completion=$mode || return 1
+        wait_for_clean || return 1
+        echo "osd_op_run_to_completion=$mode"
+        rados -p rbd bench 10 write -b 4096 -t 16 --no-cleanup || return 1
+        rados -p rbd bench 10 rand -t 16 || return 1
+        rados -p rbd cleanup || return 1
+    done
+}
+
 main osd-bench "$@"
 
 # Local Variables:
@@ -23,6 +23,8 @@ int ceph_arch_intel_ssse3 = 0;
 int ceph_arch_intel_sse3 = 0;
 int ceph_arch_intel_sse2 = 0;
 int ceph_arch_intel_aesni = 0;
+int ceph_arch_intel_avx2 = 0;
+int ceph_arch_intel_avx512f = 0;
 
 #ifdef __x86_64__
 #include <cpuid.h>
@@ -36,6 +38,23 @@ int ceph_arch_intel_aesni = 0;
 #define CPUID_SSE3	(1)
 #define CPUID_SSE2	(1 << 26)
 #define CPUID_AESNI (1 << 25)
+#define CPUID_OSXSAVE	(1 << 27)
+#define CPUID_AVX	(1 << 28)
+
+/* leaf 7, subleaf 0, ebx */
+#define CPUID7_AVX2	(1 << 5)
+#define CPUID7_AVX512F	(1 << 16)
+
+/* XCR0: state the OS saves/restores for us */
+#define XCR0_AVX	0x06	/* xmm, ymm */
+#define XCR0_AVX512	0xe6	/* xmm, ymm, opmask, zmm hi256, hi16 zmm */
+
+static unsigned long long xgetbv(unsigned int index)
+{
+	unsigned int eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+	return ((unsigned long long)edx << 32) | eax;
+}
 
 int ceph_arch_intel_probe(void)
 {
@@ -66,6 +85,22 @@ int ceph_arch_intel_probe(void)
           ceph_arch_intel_aesni = 1;
   }
 
+	/* the wide registers are only usable if the OS saves them, too */
+	if ((ecx & (CPUID_OSXSAVE | CPUID_AVX)) == (CPUID_OSXSAVE | CPUID_AVX)) {
+		unsigned long long xcr0 = xgetbv(0);
+		unsigned int max_leaf = __get_cpuid_max(0, NULL);
+		if (max_leaf >= 7 && (xcr0 & XCR0_AVX) == XCR0_AVX) {
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			if ((ebx & CPUID7_AVX2) != 0) {
+				ceph_arch_intel_avx2 = 1;
+			}
+			if ((ebx & CPUID7_AVX512F) != 0 &&
+			    (xcr0 & XCR0_AVX512) == XCR0_AVX512) {
+				ceph_arch_intel_avx512f = 1;
+			}
+		}
+	}
+
 	return 0;
 }
 
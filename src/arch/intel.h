@@ -12,6 +12,8 @@ extern int ceph_arch_intel_ssse3;  /* true if we have ssse 3 features */
 extern int ceph_arch_intel_sse3;   /* true if we have sse 3 features */
 extern int ceph_arch_intel_sse2;   /* true if we have sse 2 features */
 extern int ceph_arch_intel_aesni;  /* true if we have aesni features */
+extern int ceph_arch_intel_avx2;   /* true if we have (os enabled) avx2 */
+extern int ceph_arch_intel_avx512f; /* true if we have (os enabled) avx512f */
 
 extern int ceph_arch_intel_probe(void);
 
@@ -5,9 +5,14 @@
 #define CEPH_OS_BLUESTORE_CHECKSUMMER
 
 #include "xxHash/xxhash.h"
+#include "include/crc32c.h"
+#include "common/xxhash_multi.h"
 
 class Checksummer {
 public:
+  // most blocks handed to Alg::calc_multi in one go
+  enum { MULTI_BATCH = 64 };
+
   enum CSumType {
     CSUM_NONE = 1,	//intentionally set to 1 to be aligned with OSDMnitor's pool_opts_t handling - it treats 0 as unset while we need to distinguish none and unset cases
     CSUM_XXHASH32 = 2,
@@ -86,6 +91,22 @@ public:
       ) {
       return p.crc32c(len, init_value);
     }
+
+    // n consecutive blocks of len bytes at data; n <= MULTI_BATCH
+    static void calc_multi(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      const char *data,
+      value_t *out
+      ) {
+      uint32_t v[MULTI_BATCH];
+      ceph_crc32c_multi(init_value, (const unsigned char*)data, len, n, v);
+      for (size_t i = 0; i < n; ++i) {
+	out[i] = v[i];
+      }
+    }
   };
 
   struct crc32c_16 {
@@ -107,6 +128,22 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xffff;
     }
+
+    // n consecutive blocks of len bytes at data; n <= MULTI_BATCH
+    static void calc_multi(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      const char *data,
+      value_t *out
+      ) {
+      uint32_t v[MULTI_BATCH];
+      ceph_crc32c_multi(init_value, (const unsigned char*)data, len, n, v);
+      for (size_t i = 0; i < n; ++i) {
+	out[i] = v[i] & 0xffff;
+      }
+    }
   };
 
   struct crc32c_8 {
@@ -128,6 +165,22 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xff;
     }
+
+    // n consecutive blocks of len bytes at data; n <= MULTI_BATCH
+    static void calc_multi(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      const char *data,
+      value_t *out
+      ) {
+      uint32_t v[MULTI_BATCH];
+      ceph_crc32c_multi(init_value, (const unsigned char*)data, len, n, v);
+      for (size_t i = 0; i < n; ++i) {
+	out[i] = v[i] & 0xff;
+      }
+    }
   };
 
   struct xxhash32 {
@@ -157,6 +210,21 @@ public:
       }
       return XXH32_digest(state);
     }
+
+    static void calc_multi(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      const char *data,
+      value_t *out
+      ) {
+      uint32_t v[MULTI_BATCH];
+      ceph_xxhash32_multi(init_value, (const unsigned char*)data, len, n, v);
+      for (size_t i = 0; i < n; ++i) {
+	out[i] = v[i];
+      }
+    }
   };
 
   struct xxhash64 {
@@ -186,6 +254,21 @@ public:
       }
       return XXH64_digest(state);
     }
+
+    static void calc_multi(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      size_t n,
+      const char *data,
+      value_t *out
+      ) {
+      uint64_t v[MULTI_BATCH];
+      ceph_xxhash64_multi(init_value, (const unsigned char*)data, len, n, v);
+      for (size_t i = 0; i < n; ++i) {
+	out[i] = v[i];
+      }
+    }
   };
 
   template<class Alg>
@@ -221,9 +304,19 @@ public:
     typename Alg::value_t *pv =
       reinterpret_cast<typename Alg::value_t*>(csum_data->c_str());
     pv += offset / csum_block_size;
-    while (blocks--) {
-      *pv = Alg::calc(state, init_value, csum_block_size, p);
-      ++pv;
+    while (blocks) {
+      size_t n = _contiguous_blocks(p, csum_block_size, blocks);
+      if (n) {
+	Alg::calc_multi(state, init_value, csum_block_size, n,
+			p.get_current_ptr().c_str(), pv);
+	p.advance(n * csum_block_size);
+      } else {
+	// block straddles buffers
+	*pv = Alg::calc(state, init_value, csum_block_size, p);
+	n = 1;
+      }
+      pv += n;
+      blocks -= n;
     }
     Alg::fini(&state);
     return 0;
@@ -249,22 +342,51 @@ public:
       reinterpret_cast<const typename Alg::value_t*>(csum_data.c_str());
     pv += offset / csum_block_size;
     size_t pos = offset;
-    while (length > 0) {
-      typename Alg::value_t v = Alg::calc(state, -1, csum_block_size, p);
-      if (*pv != v) {
-	if (bad_csum) {
-	  *bad_csum = v;
+    size_t blocks = length / csum_block_size;
+    typename Alg::value_t v[MULTI_BATCH];
+    while (blocks) {
+      size_t n = _contiguous_blocks(p, csum_block_size, blocks);
+      if (n) {
+	Alg::calc_multi(state, -1, csum_block_size, n,
+			p.get_current_ptr().c_str(), v);
+	p.advance(n * csum_block_size);
+      } else {
+	v[0] = Alg::calc(state, -1, csum_block_size, p);
+	n = 1;
+      }
+      for (size_t i = 0; i < n; ++i) {
+	if (pv[i] != v[i]) {
+	  if (bad_csum) {
+	    *bad_csum = v[i];
+	  }
+	  Alg::fini(&state);
+	  return pos + i * csum_block_size;
 	}
-	Alg::fini(&state);
-	return pos;
       }
-      ++pv;
-      pos += csum_block_size;
-      length -= csum_block_size;
+      pv += n;
+      pos += n * csum_block_size;
+      blocks -= n;
     }
     Alg::fini(&state);
     return -1;  // no errors
   }
+
+private:
+  /// number of whole blocks (at most MULTI_BATCH) readable in place at p
+  static size_t _contiguous_blocks(
+    const bufferlist::const_iterator& p,
+    size_t csum_block_size,
+    size_t blocks) {
+    size_t n = p.get_remaining() ? p.get_current_ptr().length() /
+      csum_block_size : 0;
+    if (n > blocks) {
+      n = blocks;
+    }
+    if (n > MULTI_BATCH) {
+      n = MULTI_BATCH;
+    }
+    return n;
+  }
 };
 
 #endif
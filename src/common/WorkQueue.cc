@@ -355,6 +355,9 @@ void ShardedThreadPool::start_threads()
     WorkThreadSharded *wt = new WorkThreadSharded(this, thread_index);
     ldout(cct, 10) << "start_threads creating and starting " << wt << dendl;
     threads_shardedpool.push_back(wt);
+    if (first_cpu >= 0) {
+      wt->set_affinity(first_cpu + thread_index);
+    }
     wt->create(thread_name.c_str());
     thread_index++;
   }
@@ -625,6 +625,7 @@ class ShardedThreadPool {
   Cond shardedpool_cond;
   Cond wait_cond;
   uint32_t num_threads;
+  int first_cpu = -1;
 
   std::atomic<bool> stop_threads = { false };
   std::atomic<bool> pause_threads = { false };
@@ -706,6 +707,11 @@ public:
 
   ~ShardedThreadPool(){};
 
+  /// pin thread i to cpu first + i (call before start)
+  void set_cpu_affinity(int first) {
+    first_cpu = first;
+  }
+
   /// start thread pool thread
   void start();
   /// stop thread pool thread
@@ -8,6 +8,7 @@
 #include "arch/ppc.h"
 #include "common/sctp_crc32.h"
 #include "common/crc32c_intel_fast.h"
+#include "common/crc32c_intel_multi.h"
 #include "common/crc32c_aarch64.h"
 #include "common/crc32c_ppc.h"
 
@@ -50,6 +51,33 @@ ceph_crc32c_func_t ceph_choose_crc32(void)
  */
 ceph_crc32c_func_t ceph_crc32c_func = ceph_choose_crc32();
 
+void ceph_crc32c_multi_generic(uint32_t crc, unsigned char const *data,
+			       unsigned block_len, unsigned nblocks,
+			       uint32_t *out)
+{
+  for (unsigned i = 0; i < nblocks; ++i) {
+    out[i] = ceph_crc32c(crc, data ? data + (size_t)i * block_len : nullptr,
+			 block_len);
+  }
+}
+
+ceph_crc32c_multi_func_t ceph_choose_crc32c_multi(void)
+{
+  ceph_arch_probe();
+
+#if defined(__x86_64__)
+  if (ceph_arch_intel_sse42 && ceph_crc32c_intel_multi_exists()) {
+    return ceph_crc32c_intel_multi;
+  }
+#endif
+  return ceph_crc32c_multi_generic;
+}
+
+/*
+ * static global, same as ceph_crc32c_func above.
+ */
+ceph_crc32c_multi_func_t ceph_crc32c_multi_func = ceph_choose_crc32c_multi();
+
 
 /*
  * Look: http://crcutil.googlecode.com/files/crc-doc.1.0.pdf
@@ -0,0 +1,92 @@
+#include "include/crc32c.h"
+#include "common/crc32c_intel_multi.h"
+
+#if defined(__x86_64__) && defined(__SSE4_2__)
+
+#include <string.h>
+#include <nmmintrin.h>
+
+/*
+ * The crc32 instruction has a latency of 3 cycles but a throughput of
+ * one per cycle, so a single dependency chain only gets a third of
+ * what the unit can do.  The single buffer code works around that by
+ * splitting the buffer into three and recombining the partial crcs
+ * with pclmul, which costs a fixed amount per buffer and is not worth
+ * it for small checksum blocks.  When we have many independent blocks
+ * (one checksum per csum_block_size chunk of a blob) we can instead
+ * run three blocks side by side and skip the recombination entirely.
+ */
+
+static inline uint64_t load_u64(unsigned char const *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+void ceph_crc32c_intel_multi(uint32_t crc, unsigned char const *data,
+			     unsigned block_len, unsigned nblocks,
+			     uint32_t *out)
+{
+	unsigned words = block_len / 8;
+	unsigned tail = block_len & 7;
+	unsigned i = 0;
+
+	if (!data) {
+		/* every block is the same; do it once */
+		if (nblocks) {
+			uint32_t v = ceph_crc32c(crc, NULL, block_len);
+			for (i = 0; i < nblocks; ++i)
+				out[i] = v;
+		}
+		return;
+	}
+
+	for (; i + 3 <= nblocks; i += 3) {
+		unsigned char const *a = data + (size_t)i * block_len;
+		unsigned char const *b = a + block_len;
+		unsigned char const *c = b + block_len;
+		uint64_t ca = crc, cb = crc, cc = crc;
+		unsigned w, t;
+
+		for (w = 0; w < words; ++w) {
+			ca = _mm_crc32_u64(ca, load_u64(a));
+			cb = _mm_crc32_u64(cb, load_u64(b));
+			cc = _mm_crc32_u64(cc, load_u64(c));
+			a += 8;
+			b += 8;
+			c += 8;
+		}
+		for (t = 0; t < tail; ++t) {
+			ca = _mm_crc32_u8((uint32_t)ca, a[t]);
+			cb = _mm_crc32_u8((uint32_t)cb, b[t]);
+			cc = _mm_crc32_u8((uint32_t)cc, c[t]);
+		}
+		out[i] = (uint32_t)ca;
+		out[i + 1] = (uint32_t)cb;
+		out[i + 2] = (uint32_t)cc;
+	}
+	for (; i < nblocks; ++i)
+		out[i] = ceph_crc32c_func(crc, data + (size_t)i * block_len,
+					  block_len);
+}
+
+int ceph_crc32c_intel_multi_exists(void)
+{
+	return 1;
+}
+
+#else
+
+int ceph_crc32c_intel_multi_exists(void)
+{
+	return 0;
+}
+
+void ceph_crc32c_intel_multi(uint32_t crc, unsigned char const *data,
+			     unsigned block_len, unsigned nblocks,
+			     uint32_t *out)
+{
+}
+
+#endif
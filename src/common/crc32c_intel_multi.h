@@ -0,0 +1,25 @@
+#ifndef CEPH_COMMON_CRC32C_INTEL_MULTI_H
+#define CEPH_COMMON_CRC32C_INTEL_MULTI_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* is the multi-buffer version compiled in */
+extern int ceph_crc32c_intel_multi_exists(void);
+
+/*
+ * crc32c of nblocks consecutive, equally sized blocks starting at
+ * data, each seeded with crc.  results go to out[0..nblocks).
+ */
+extern void ceph_crc32c_intel_multi(uint32_t crc, unsigned char const *data,
+				    unsigned block_len, unsigned nblocks,
+				    uint32_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
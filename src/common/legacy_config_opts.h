@@ -550,6 +550,10 @@ OPTION(mds_client_writeable_range_max_inc_objs, OPT_U32)
 // verify backend can support configured max object name length
 OPTION(osd_check_max_object_name_len_on_startup, OPT_BOOL)
 
+// memory usage target for caches that autotune (bluestore)
+OPTION(osd_memory_target, OPT_U64)
+OPTION(osd_memory_cache_min, OPT_U64)
+
 // Maximum number of backfills to or from a single osd
 OPTION(osd_max_backfills, OPT_U64)
 
@@ -942,6 +946,9 @@ OPTION(bdev_aio, OPT_BOOL)
 OPTION(bdev_aio_poll_ms, OPT_INT)  // milliseconds
 OPTION(bdev_aio_max_queue_depth, OPT_INT)
 OPTION(bdev_aio_reap_max, OPT_INT)
+OPTION(bdev_ioring, OPT_BOOL)  // use io_uring instead of libaio, if supported
+OPTION(bdev_ioring_hipri, OPT_BOOL)
+OPTION(bdev_ioring_sqthread_poll, OPT_BOOL)
 OPTION(bdev_block_size, OPT_INT)
 OPTION(bdev_debug_aio, OPT_BOOL)
 OPTION(bdev_debug_aio_suicide_timeout, OPT_FLOAT)
@@ -964,7 +971,7 @@ OPTION(bluefs_min_flush_size, OPT_U64)  // ignore flush until its this big
 OPTION(bluefs_compact_log_sync, OPT_BOOL)  // sync or async log compaction?
 OPTION(bluefs_buffered_io, OPT_BOOL)
 OPTION(bluefs_sync_write, OPT_BOOL)
-OPTION(bluefs_allocator, OPT_STR)     // stupid | bitmap
+OPTION(bluefs_allocator, OPT_STR)     // stupid | bitmap | avl
 OPTION(bluefs_preextend_wal_files, OPT_BOOL)  // this *requires* that rocksdb has recycling enabled
 
 OPTION(bluestore_bluefs, OPT_BOOL)
@@ -1054,8 +1061,12 @@ OPTION(bluestore_cache_size_ssd, OPT_U64)
 OPTION(bluestore_cache_meta_ratio, OPT_DOUBLE)
 OPTION(bluestore_cache_kv_ratio, OPT_DOUBLE)
 OPTION(bluestore_cache_kv_max, OPT_U64) // limit the maximum amount of cache for the kv store
+OPTION(bluestore_cache_autotune, OPT_BOOL)
+OPTION(bluestore_cache_autotune_interval, OPT_DOUBLE)
+OPTION(bluestore_cache_autotune_chunk_size, OPT_U64)
 OPTION(bluestore_kvbackend, OPT_STR)
-OPTION(bluestore_allocator, OPT_STR)     // stupid | bitmap
+OPTION(bluestore_allocator, OPT_STR)     // stupid | bitmap | avl
+OPTION(bluestore_alloc_checkpoint, OPT_BOOL)
 OPTION(bluestore_freelist_blocks_per_key, OPT_INT)
 OPTION(bluestore_bitmapallocator_blocks_per_zone, OPT_INT) // must be power of 2 aligned, e.g., 512, 1024, 2048...
 OPTION(bluestore_bitmapallocator_span_size, OPT_INT) // must be power of 2 aligned, e.g., 512, 1024, 2048...
@@ -1067,7 +1078,10 @@ OPTION(bluestore_fsck_on_umount, OPT_BOOL)
 OPTION(bluestore_fsck_on_umount_deep, OPT_BOOL)
 OPTION(bluestore_fsck_on_mkfs, OPT_BOOL)
 OPTION(bluestore_fsck_on_mkfs_deep, OPT_BOOL)
+OPTION(bluestore_fsck_threads, OPT_INT)
+OPTION(bluestore_fsck_progress_interval, OPT_DOUBLE)
 OPTION(bluestore_sync_submit_transaction, OPT_BOOL) // submit kv txn in queueing thread (not kv_sync_thread)
+OPTION(bluestore_kv_submit_lanes, OPT_INT) // threads submitting kv txns for kv_sync_thread (0 = none)
 OPTION(bluestore_throttle_bytes, OPT_U64)
 OPTION(bluestore_throttle_deferred_bytes, OPT_U64)
 OPTION(bluestore_throttle_cost_per_io_hdd, OPT_U64)
@@ -1076,10 +1090,14 @@ OPTION(bluestore_throttle_cost_per_io, OPT_U64)
 OPTION(bluestore_deferred_batch_ops, OPT_U64)
 OPTION(bluestore_deferred_batch_ops_hdd, OPT_U64)
 OPTION(bluestore_deferred_batch_ops_ssd, OPT_U64)
+OPTION(bluestore_deferred_global_batch, OPT_BOOL)
 OPTION(bluestore_nid_prealloc, OPT_INT)
 OPTION(bluestore_blobid_prealloc, OPT_U64)
 OPTION(bluestore_clone_cow, OPT_BOOL)  // do copy-on-write for clones
 OPTION(bluestore_default_buffered_read, OPT_BOOL)
+OPTION(bluestore_readahead_trigger_requests, OPT_INT)
+OPTION(bluestore_readahead_min_bytes, OPT_U64)
+OPTION(bluestore_readahead_max_bytes, OPT_U64)
 OPTION(bluestore_default_buffered_write, OPT_BOOL)
 OPTION(bluestore_debug_misc, OPT_BOOL)
 OPTION(bluestore_debug_no_reuse_blocks, OPT_BOOL)
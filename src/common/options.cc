@@ -1596,6 +1596,17 @@ std::vector<Option> get_global_options() {
     .set_default(true)
     .set_description(""),
 
+    Option("osd_memory_target", Option::TYPE_UINT, Option::LEVEL_BASIC)
+    .set_default(4_G)
+    .set_description("Target amount of memory for an OSD to use")
+    .set_long_description("When cache autotuning is enabled, the object store grows or shrinks its caches so that resident memory usage stays near this target.")
+    .add_see_also("bluestore_cache_autotune"),
+
+    Option("osd_memory_cache_min", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(128_M)
+    .set_description("Minimum cache size when tuning toward osd_memory_target")
+    .add_see_also("osd_memory_target"),
+
     Option("osd_max_backfills", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description(""),
@@ -1970,6 +1981,18 @@ std::vector<Option> get_global_options() {
     .set_default(8)
     .set_description(""),
 
+    Option("osd_op_run_to_completion", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Run each op shard on a single thread that also completes its PGs' transactions")
+    .set_long_description("Use exactly one op thread per shard, so the PG lock is never contended between op threads, and have the object store hand commit and apply callbacks for the shard's PGs back to that thread instead of running them on its finisher threads.  Combine with osd_op_thread_first_cpu to pin each shard to a core.  Supported by BlueStore and MemStore.")
+    .add_see_also("osd_op_thread_first_cpu")
+    .add_see_also("osd_op_num_shards"),
+
+    Option("osd_op_thread_first_cpu", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(-1)
+    .set_description("Pin op thread N to cpu osd_op_thread_first_cpu + N (-1 to not pin)")
+    .add_see_also("osd_op_run_to_completion"),
+
     Option("osd_skip_data_digest", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description(""),
@@ -2296,6 +2319,36 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("osd_ec_parity_delta_writes", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Update coding chunks with the delta of the modified data chunks on partial stripe overwrites")
+    .set_long_description("When an overwrite modifies few data chunks of a stripe, read only those and the coding chunks, and update the coding chunks with the difference between the old and new data instead of reading and encoding the whole stripe. Only used by erasure code plugins that support it (jerasure reed_sol_van and reed_sol_r6_op, isa).")
+    .add_see_also("osd_pool_erasure_code_stripe_unit"),
+
+    Option("osd_ec_direct_reads", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Serve client reads contained in a single chunk from the shard holding it")
+    .set_long_description("A read that falls entirely within one data chunk of a stripe is sent only to the shard storing that chunk instead of to k shards. If that shard fails the read, the whole stripe is read and decoded as usual.")
+    .add_see_also("osd_pool_erasure_code_stripe_unit"),
+
+    Option("osd_ec_hedged_reads", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Read remaining shards when an erasure coded read is slower than usual")
+    .set_long_description("When a shard takes longer to reply to a client read than osd_ec_hedged_read_percentile of its recent reads, send the read to the shards that were not read yet and complete as soon as enough replies arrive to decode.")
+    .add_see_also("osd_ec_hedged_read_percentile")
+    .add_see_also("osd_ec_hedged_read_min_delay"),
+
+    Option("osd_ec_hedged_read_percentile", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.95)
+    .set_min_max(.5, 1.0)
+    .set_description("Recent read latency percentile of a shard after which a read is hedged")
+    .add_see_also("osd_ec_hedged_reads"),
+
+    Option("osd_ec_hedged_read_min_delay", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.005)
+    .set_description("Minimum time in seconds before an erasure coded read is hedged")
+    .add_see_also("osd_ec_hedged_reads"),
+
     Option("osd_recover_clone_overlap_limit", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_description(""),
@@ -2937,6 +2990,10 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("rocksdb_debug_cf_migration_stop_after", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(0)
+    .set_description("Stop a column family migration after moving this many keys, as if interrupted (for testing)"),
+
     Option("rocksdb_bloom_bits_per_key", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(20)
     .set_description("Number of bits per key to use for RocksDB's bloom filters.")
@@ -3138,6 +3195,25 @@ std::vector<Option> get_global_options() {
     .set_default(16)
     .set_description(""),
 
+    Option("bdev_ioring", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Use io_uring instead of libaio for kernel block devices")
+    .set_long_description("Falls back to libaio if io_uring is not supported by this build or the running kernel.")
+    .add_see_also("bdev_ioring_hipri")
+    .add_see_also("bdev_ioring_sqthread_poll"),
+
+    Option("bdev_ioring_hipri", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Use polled (IOPOLL) completions for io_uring")
+    .set_long_description("The device driver must support polling; the aio thread busy-polls for completions instead of sleeping.")
+    .add_see_also("bdev_ioring"),
+
+    Option("bdev_ioring_sqthread_poll", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Use a kernel thread to poll the io_uring submission queue")
+    .set_long_description("Submissions do not need a syscall, at the cost of a kernel thread spinning on the queue.")
+    .add_see_also("bdev_ioring"),
+
     Option("bdev_block_size", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(4_K)
     .set_description(""),
@@ -3188,7 +3264,8 @@ std::vector<Option> get_global_options() {
 
     Option("bluefs_compact_log_sync", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
-    .set_description(""),
+    .set_description("Compact the BlueFS metadata log synchronously")
+    .set_long_description("Synchronous compaction rewrites the whole log while holding the BlueFS lock, which blocks other log writers (e.g., the RocksDB WAL) for its duration.  Asynchronous compaction writes the new log from a snapshot of the metadata while appends continue to the old log, and only takes the lock to switch over."),
 
     Option("bluefs_buffered_io", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
@@ -3200,12 +3277,36 @@ std::vector<Option> get_global_options() {
 
     Option("bluefs_allocator", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("stupid")
+    .set_enum_allowed({"bitmap", "stupid", "avl"})
     .set_description(""),
 
     Option("bluefs_preextend_wal_files", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description(""),
 
+    Option("bluefs_placement_slow_level", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("RocksDB level from which table files are placed on the slow device")
+    .set_long_description("When BlueFS has both a dedicated DB device and a slow device, table files at this RocksDB level and deeper are moved to the slow device in the background, while shallower levels (and files that spilled over) are moved back to the DB device as space allows.  The WAL stays where it is.  0 disables level-based placement, leaving placement to directory names and spillover only.")
+    .add_see_also("bluefs_placement_interval")
+    .add_see_also("bluefs_placement_max_bytes")
+    .add_see_also("bluefs_placement_min_free_ratio"),
+
+    Option("bluefs_placement_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(5.0)
+    .set_description("Seconds between background level-based placement passes")
+    .add_see_also("bluefs_placement_slow_level"),
+
+    Option("bluefs_placement_max_bytes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(256_M)
+    .set_description("Maximum bytes moved between devices per placement pass")
+    .add_see_also("bluefs_placement_slow_level"),
+
+    Option("bluefs_placement_min_free_ratio", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.05)
+    .set_description("Fraction of a device that must remain free after moving a file onto it")
+    .add_see_also("bluefs_placement_slow_level"),
+
     Option("bluestore_bluefs", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(true)
     .add_tag("mkfs")
@@ -3257,6 +3358,11 @@ std::vector<Option> get_global_options() {
     .set_default(0)
     .set_description(""),
 
+    Option("bluestore_spdk_io_qpairs", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(0)
+    .set_description("Maximum number of NVMe io qpairs to allocate (0 for as many as the controller allows)")
+    .set_long_description("Each thread submitting io to the device gets its own qpair and polls it for its own completions.  Once this many qpairs are allocated, or the controller has no more, further threads share the existing qpairs."),
+
     Option("bluestore_block_path", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("")
     .add_tag("mkfs")
@@ -3430,6 +3536,60 @@ std::vector<Option> get_global_options() {
     .set_description("Compression ratio required to store compressed data")
     .set_long_description("If we compress data and get less than this we discard the result and store the original uncompressed data."),
 
+    Option("bluestore_txc_trace", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_safe()
+    .set_description("Record where each transaction spends its time, and keep the slow ones")
+    .set_long_description("Every transaction records when it leaves each stage of the commit pipeline (throttle, aio, kv queueing and commit, deferred io, ...).  Those slower than bluestore_txc_trace_slow_threshold are kept for the dump_objectstore_slow_transactions admin socket command.  The stages up to the kv commit are also marked on the op in the OSD op tracker as they happen."),
+
+    Option("bluestore_txc_trace_slow_threshold", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.1)
+    .set_safe()
+    .set_description("Transactions taking at least this long (seconds) are kept by bluestore_txc_trace"),
+
+    Option("bluestore_txc_trace_history", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(100)
+    .set_safe()
+    .set_description("Number of slow transactions kept by bluestore_txc_trace"),
+
+    Option("bluestore_onode_filter", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Keep a bloom filter of each collection's objects so creates can skip the existence lookup")
+    .set_long_description("Each collection's filter is built in the background the first time an object is created in it after mount, by listing the collection's objects; until then creates look the object up as usual.  Only takes effect on mount.")
+    .add_see_also("bluestore_onode_filter_max_onodes"),
+
+    Option("bluestore_onode_filter_max_onodes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1000000)
+    .set_description("Don't build an onode filter for collections with more objects than this"),
+
+    Option("bluestore_extent_map_lazy_decode", Option::TYPE_BOOL, Option::LEVEL_DEV)
+    .set_default(true)
+    .set_safe()
+    .set_description("Only decode the extents a read needs from a sharded extent map")
+    .set_long_description("A read that faults in an extent map shard decodes just the extents overlapping the range being read and keeps the encoded shard around for later reads.  The shard is fully decoded the first time it is written to."),
+
+    Option("bluestore_extent_map_lazy_decode_min_bytes", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(256)
+    .set_description("Always fully decode extent map shards smaller than this")
+    .add_see_also("bluestore_extent_map_lazy_decode"),
+
+    Option("bluestore_compression_entropy_threshold", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(7.9)
+    .set_safe()
+    .set_description("Skip compressing blobs whose sampled byte entropy (bits/byte) is at least this")
+    .set_long_description("Before compressing a blob, bluestore samples bluestore_compression_sample_size bytes of it and estimates their entropy.  Data that looks random (already compressed or encrypted) is written uncompressed without running the compressor.  Ignored in force mode.  0 disables the check."),
+
+    Option("bluestore_compression_sample_size", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(4_K)
+    .set_safe()
+    .set_description("Bytes of each blob sampled for bluestore_compression_entropy_threshold"),
+
+    Option("bluestore_compression_reject_backoff", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(16)
+    .set_safe()
+    .set_description("Max number of writes to an object to leave uncompressed after its data failed to compress")
+    .set_long_description("When an object's blobs keep failing bluestore_compression_required_ratio (or the entropy check), bluestore stops trying to compress writes to it for a while, doubling the pause each time up to this many writes.  Any successful compression resets it.  The history is kept with the cached onode only.  Ignored in force mode.  0 disables."),
+
     Option("bluestore_extent_map_shard_max_size", Option::TYPE_UINT, Option::LEVEL_DEV)
     .set_default(1200)
     .set_description("Max size (bytes) for a single extent map shard before splitting"),
@@ -3496,6 +3656,24 @@ std::vector<Option> get_global_options() {
     .set_default(512_M)
     .set_description("Max memory (bytes) to devote to kv database (rocksdb)"),
 
+    Option("bluestore_cache_autotune", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Automatically tune the cache size and the split between metadata, kv and data caches")
+    .set_long_description("Periodically sizes the total cache so that the process's resident memory stays near osd_memory_target, and moves memory toward whichever of the onode, rocksdb block and data caches currently has the highest miss ratio.  bluestore_cache_size, bluestore_cache_meta_ratio and bluestore_cache_kv_ratio only set the starting point, and bluestore_cache_kv_max is not enforced.")
+    .add_see_also("osd_memory_target")
+    .add_see_also("bluestore_cache_autotune_interval")
+    .add_see_also("bluestore_cache_autotune_chunk_size"),
+
+    Option("bluestore_cache_autotune_interval", Option::TYPE_FLOAT, Option::LEVEL_DEV)
+    .set_default(5)
+    .set_description("Seconds between cache autotune decisions")
+    .add_see_also("bluestore_cache_autotune"),
+
+    Option("bluestore_cache_autotune_chunk_size", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(32_M)
+    .set_description("Bytes moved between caches by a single autotune decision")
+    .add_see_also("bluestore_cache_autotune"),
+
     Option("bluestore_kvbackend", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("rocksdb")
     .add_tag("mkfs")
@@ -3503,8 +3681,15 @@ std::vector<Option> get_global_options() {
 
     Option("bluestore_allocator", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("stupid")
-    .set_enum_allowed({"bitmap", "stupid"})
-    .set_description("Allocator policy"),
+    .set_enum_allowed({"bitmap", "stupid", "avl"})
+    .set_description("Allocator policy")
+    .set_long_description("stupid keeps free extents in power-of-two size bins, bitmap scans a hierarchy of bitmaps, and avl indexes free extents by both offset and length for logarithmic best-fit allocation."),
+
+    Option("bluestore_alloc_checkpoint", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Save allocator free space on clean umount and reload it on mount")
+    .set_long_description("On a clean umount the allocator's free extents are written to the key/value store, and the next mount loads them instead of rebuilding the allocator from the freelist.  The checkpoint is removed as soon as it is read, so a crash always falls back to the freelist scan.  While a checkpoint exists, versions that do not understand it refuse to mount the store.")
+    .add_see_also("bluestore_allocator"),
 
     Option("bluestore_freelist_blocks_per_key", Option::TYPE_INT, Option::LEVEL_DEV)
     .set_default(128)
@@ -3528,11 +3713,15 @@ std::vector<Option> get_global_options() {
 
     Option("bluestore_rocksdb_cf", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
-    .set_description("Enable use of rocksdb column families for bluestore metadata"),
+    .set_description("Enable use of rocksdb column families for bluestore metadata")
+    .set_long_description("Column families are created when the OSD is created.  Existing OSDs can be converted either way, offline, with 'ceph-bluestore-tool migrate-cfs'.")
+    .add_see_also("bluestore_rocksdb_cfs"),
 
     Option("bluestore_rocksdb_cfs", Option::TYPE_STR, Option::LEVEL_DEV)
-    .set_default("M= P= L=")
-    .set_description("List of whitespace-separate key/value pairs where key is CF name and value is CF options"),
+    .set_default("O=compaction_pri=kMinOverlappingRatio M=compaction_pri=kOldestSmallestSeqFirst;block_based_table_factory={filter_policy=bloomfilter:10:false} P=compaction_pri=kOldestSmallestSeqFirst;block_based_table_factory={filter_policy=bloomfilter:10:false} L=compaction_pri=kOldestSmallestSeqFirst;level0_file_num_compaction_trigger=8 B=compaction_pri=kMinOverlappingRatio b=compaction_pri=kOldestSmallestSeqFirst;level0_file_num_compaction_trigger=8 X=compaction_pri=kMinOverlappingRatio;block_based_table_factory={filter_policy=bloomfilter:10:false}")
+    .set_description("List of whitespace-separate key/value pairs where key is CF name and value is CF options")
+    .set_long_description("Each name is a bluestore key prefix (O onodes, M and P omap, L deferred writes, B freelist metadata, b freelist bitmap, X shared blobs, ...) and the options are rocksdb column family options applied on top of bluestore_rocksdb_options.  The defaults keep the short-lived deferred, omap and freelist keys from forcing rewrites of onode and shared blob data during compaction, and give the point-looked-up omap and shared blob keys bloom filters.")
+    .add_see_also("bluestore_rocksdb_cf"),
 
     Option("bluestore_fsck_on_mount", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(false)
@@ -3558,10 +3747,27 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description("Run deep fsck after mkfs"),
 
+    Option("bluestore_fsck_threads", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_min(1)
+    .set_description("Number of threads walking objects during fsck")
+    .set_long_description("The object keyspace is split at collection boundaries and the pieces are checked in parallel.  Mostly useful for deep fsck, which reads and checksums all object data."),
+
+    Option("bluestore_fsck_progress_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(10.0)
+    .set_description("Seconds between fsck progress log messages (0 to disable)"),
+
     Option("bluestore_sync_submit_transaction", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(false)
     .set_description("Try to submit metadata transaction to rocksdb in queuing thread context"),
 
+    Option("bluestore_kv_submit_lanes", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_min_max(0, 32)
+    .set_description("Number of threads submitting metadata transactions on behalf of the kv sync thread")
+    .set_long_description("Transactions of each OpSequencer are submitted in order by a single lane, while different sequencers are submitted in parallel; the kv sync thread still does one flush and sync per batch. 0 means the kv sync thread submits everything itself.")
+    .add_see_also("bluestore_sync_submit_transaction"),
+
     Option("bluestore_throttle_bytes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(64_M)
     .set_safe()
@@ -3603,6 +3809,12 @@ std::vector<Option> get_global_options() {
     .set_safe()
     .set_description("Default bluestore_deferred_batch_ops for non-rotational (solid state) media"),
 
+    Option("bluestore_deferred_global_batch", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Submit deferred writes from all sequencers as one batch")
+    .set_long_description("Instead of flushing each PG's deferred writes separately, merge the pending writes of every sequencer, sort them by offset, coalesce adjacent ranges and issue them in elevator order.  Mostly useful on HDDs, where seeks between PGs' small overwrites dominate.")
+    .add_see_also("bluestore_deferred_batch_ops"),
+
     Option("bluestore_nid_prealloc", Option::TYPE_INT, Option::LEVEL_DEV)
     .set_default(1024)
     .set_description("Number of unique object ids to preallocate at a time"),
@@ -3621,6 +3833,22 @@ std::vector<Option> get_global_options() {
     .set_safe()
     .set_description("Cache read results by default (unless hinted NOCACHE or WONTNEED)"),
 
+    Option("bluestore_readahead_trigger_requests", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(2)
+    .set_min(1)
+    .set_description("Number of sequential reads of an object before readahead kicks in"),
+
+    Option("bluestore_readahead_min_bytes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_description("Size of the first readahead window for a sequential stream"),
+
+    Option("bluestore_readahead_max_bytes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Largest readahead window for a sequential stream (0 disables readahead)")
+    .set_long_description("When an object is read sequentially, bluestore prefetches the next window into the buffer cache with async reads.  The window starts at bluestore_readahead_min_bytes and doubles up to this size.")
+    .add_see_also("bluestore_readahead_min_bytes")
+    .add_see_also("bluestore_readahead_trigger_requests"),
+
     Option("bluestore_default_buffered_write", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_safe()
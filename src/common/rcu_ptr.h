@@ -0,0 +1,90 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_COMMON_RCU_PTR_H
+#define CEPH_COMMON_RCU_PTR_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * rcu_ptr - a shared_ptr published to lock-free readers
+ *
+ * get() takes no lock.  The value lives in one of two slots; a reader
+ * pins the current slot by bumping its reader count, copies the
+ * shared_ptr if the slot is still current and unpins it.  set() fills
+ * the other slot, makes it current and then waits for the readers
+ * still pinning the old slot before dropping the old value, so the
+ * previous value is released by the time set() returns.
+ *
+ * Readers never wait.  Writers are serialized and may spin briefly
+ * behind readers copying the old value, which suits values that are
+ * read constantly and replaced rarely.
+ */
+template <class T>
+class rcu_ptr {
+  struct slot_t {
+    std::atomic<unsigned> readers = {0};
+    std::shared_ptr<T> ptr;
+  };
+  mutable slot_t slots[2];
+  std::atomic<unsigned> cur = {0};
+  std::mutex write_lock;
+
+  static void drain(const slot_t &s) {
+    while (s.readers.load())
+      std::this_thread::yield();
+  }
+
+public:
+  rcu_ptr() = default;
+  explicit rcu_ptr(std::shared_ptr<T> p) {
+    slots[0].ptr = std::move(p);
+  }
+  rcu_ptr(const rcu_ptr &) = delete;
+  rcu_ptr &operator=(const rcu_ptr &) = delete;
+
+  std::shared_ptr<T> get() const {
+    while (true) {
+      unsigned i = cur.load();
+      slot_t &s = slots[i];
+      s.readers.fetch_add(1);
+      if (cur.load() == i) {
+	// set() only refills a slot after making the other one current
+	std::shared_ptr<T> ret = s.ptr;
+	s.readers.fetch_sub(1);
+	return ret;
+      }
+      // raced with set(), the slot may be being refilled
+      s.readers.fetch_sub(1);
+    }
+  }
+
+  void set(std::shared_ptr<T> p) {
+    std::lock_guard<std::mutex> l(write_lock);
+    unsigned old = cur.load();
+    slot_t &next = slots[!old];
+    drain(next);
+    next.ptr = std::move(p);
+    cur.store(!old);
+    drain(slots[old]);
+    slots[old].ptr.reset();
+  }
+
+  void reset() {
+    set(std::shared_ptr<T>());
+  }
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef CEPH_COMMON_XXHASH32_INTEL_H
+#define CEPH_COMMON_XXHASH32_INTEL_H
+
+/*
+ * Internal to the xxhash32 multi-buffer kernels: the vector code only
+ * runs the 16-byte stripe loop; the per-block merge, tail and avalanche
+ * are done here in scalar code, exactly as XXH32() does them.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CEPH_XXH_PRIME32_1 2654435761U
+#define CEPH_XXH_PRIME32_2 2246822519U
+#define CEPH_XXH_PRIME32_3 3266489917U
+#define CEPH_XXH_PRIME32_4  668265263U
+#define CEPH_XXH_PRIME32_5  374761393U
+
+static inline uint32_t ceph_xxh32_rotl(uint32_t x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t ceph_xxh32_read(unsigned char const *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;	/* the kernels are x86 only, hence little-endian */
+}
+
+/*
+ * finish one block given its four stripe accumulators.  p points at the
+ * bytes following the last full stripe; len is the full block length.
+ */
+static inline uint32_t ceph_xxh32_finalize(const uint32_t v[4],
+					   unsigned char const *p,
+					   unsigned len)
+{
+	unsigned char const *end = p + (len & 15);
+	uint32_t h32 = ceph_xxh32_rotl(v[0], 1) + ceph_xxh32_rotl(v[1], 7) +
+		ceph_xxh32_rotl(v[2], 12) + ceph_xxh32_rotl(v[3], 18);
+
+	h32 += len;
+	while (p + 4 <= end) {
+		h32 += ceph_xxh32_read(p) * CEPH_XXH_PRIME32_3;
+		h32 = ceph_xxh32_rotl(h32, 17) * CEPH_XXH_PRIME32_4;
+		p += 4;
+	}
+	while (p < end) {
+		h32 += (*p) * CEPH_XXH_PRIME32_5;
+		h32 = ceph_xxh32_rotl(h32, 11) * CEPH_XXH_PRIME32_1;
+		p++;
+	}
+	h32 ^= h32 >> 15;
+	h32 *= CEPH_XXH_PRIME32_2;
+	h32 ^= h32 >> 13;
+	h32 *= CEPH_XXH_PRIME32_3;
+	h32 ^= h32 >> 16;
+	return h32;
+}
+
+/* the whole of XXH32() for len >= 16, for blocks left over by a kernel */
+static inline uint32_t ceph_xxh32_scalar(uint32_t seed,
+					 unsigned char const *p,
+					 unsigned len)
+{
+	uint32_t v[4] = {
+		seed + CEPH_XXH_PRIME32_1 + CEPH_XXH_PRIME32_2,
+		seed + CEPH_XXH_PRIME32_2,
+		seed,
+		seed - CEPH_XXH_PRIME32_1,
+	};
+	unsigned stripes = len / 16;
+	unsigned s;
+	int j;
+
+	for (s = 0; s < stripes; ++s, p += 16) {
+		for (j = 0; j < 4; ++j) {
+			v[j] += ceph_xxh32_read(p + j * 4) * CEPH_XXH_PRIME32_2;
+			v[j] = ceph_xxh32_rotl(v[j], 13) * CEPH_XXH_PRIME32_1;
+		}
+	}
+	return ceph_xxh32_finalize(v, p, len);
+}
+
+/* is the kernel compiled in */
+extern int ceph_xxhash32_avx2_exists(void);
+extern int ceph_xxhash32_avx512_exists(void);
+
+/* block_len must be >= 16; see ceph_xxhash32_multi() */
+extern void ceph_xxhash32_avx2(uint32_t seed, unsigned char const *data,
+			       unsigned block_len, unsigned nblocks,
+			       uint32_t *out);
+extern void ceph_xxhash32_avx512(uint32_t seed, unsigned char const *data,
+				 unsigned block_len, unsigned nblocks,
+				 uint32_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,116 @@
+#include "common/xxhash32_intel.h"
+
+#if defined(__x86_64__) && defined(__AVX2__)
+
+#include <immintrin.h>
+
+/*
+ * Each ymm register carries the four stripe accumulators of two
+ * blocks: lanes 0-3 for the first, lanes 4-7 for the second.  A stripe
+ * round is two dependent multiplies, so we keep two registers (four
+ * blocks) in flight to give the multiplier something to overlap.
+ */
+
+static inline __m256i xxh32_load2(unsigned char const *a,
+				  unsigned char const *b)
+{
+	__m256i v = _mm256_castsi128_si256(
+		_mm_loadu_si128((__m128i const *)a));
+	return _mm256_inserti128_si256(v,
+		_mm_loadu_si128((__m128i const *)b), 1);
+}
+
+static inline __m256i xxh32_round(__m256i acc, __m256i in)
+{
+	const __m256i prime1 = _mm256_set1_epi32((int)CEPH_XXH_PRIME32_1);
+	const __m256i prime2 = _mm256_set1_epi32((int)CEPH_XXH_PRIME32_2);
+
+	acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(in, prime2));
+	acc = _mm256_or_si256(_mm256_slli_epi32(acc, 13),
+			      _mm256_srli_epi32(acc, 19));
+	return _mm256_mullo_epi32(acc, prime1);
+}
+
+static inline __m256i xxh32_init(uint32_t seed)
+{
+	return _mm256_setr_epi32(
+		(int)(seed + CEPH_XXH_PRIME32_1 + CEPH_XXH_PRIME32_2),
+		(int)(seed + CEPH_XXH_PRIME32_2),
+		(int)seed,
+		(int)(seed - CEPH_XXH_PRIME32_1),
+		(int)(seed + CEPH_XXH_PRIME32_1 + CEPH_XXH_PRIME32_2),
+		(int)(seed + CEPH_XXH_PRIME32_2),
+		(int)seed,
+		(int)(seed - CEPH_XXH_PRIME32_1));
+}
+
+void ceph_xxhash32_avx2(uint32_t seed, unsigned char const *data,
+			unsigned block_len, unsigned nblocks,
+			uint32_t *out)
+{
+	unsigned stripes = block_len / 16;
+	size_t tail_off = (size_t)stripes * 16;
+	uint32_t acc[16];
+	unsigned i = 0, s, k;
+
+	for (; i + 4 <= nblocks; i += 4) {
+		unsigned char const *b0 = data + (size_t)i * block_len;
+		unsigned char const *b1 = b0 + block_len;
+		unsigned char const *b2 = b1 + block_len;
+		unsigned char const *b3 = b2 + block_len;
+		__m256i v01 = xxh32_init(seed);
+		__m256i v23 = v01;
+
+		for (s = 0; s < stripes; ++s) {
+			size_t o = (size_t)s * 16;
+			v01 = xxh32_round(v01, xxh32_load2(b0 + o, b1 + o));
+			v23 = xxh32_round(v23, xxh32_load2(b2 + o, b3 + o));
+		}
+		_mm256_storeu_si256((__m256i *)acc, v01);
+		_mm256_storeu_si256((__m256i *)(acc + 8), v23);
+		for (k = 0; k < 4; ++k) {
+			out[i + k] = ceph_xxh32_finalize(
+				acc + k * 4,
+				data + (size_t)(i + k) * block_len + tail_off,
+				block_len);
+		}
+	}
+	if (i + 2 <= nblocks) {
+		unsigned char const *b0 = data + (size_t)i * block_len;
+		unsigned char const *b1 = b0 + block_len;
+		__m256i v01 = xxh32_init(seed);
+
+		for (s = 0; s < stripes; ++s) {
+			size_t o = (size_t)s * 16;
+			v01 = xxh32_round(v01, xxh32_load2(b0 + o, b1 + o));
+		}
+		_mm256_storeu_si256((__m256i *)acc, v01);
+		out[i] = ceph_xxh32_finalize(acc, b0 + tail_off, block_len);
+		out[i + 1] = ceph_xxh32_finalize(acc + 4, b1 + tail_off,
+						 block_len);
+		i += 2;
+	}
+	for (; i < nblocks; ++i)
+		out[i] = ceph_xxh32_scalar(seed, data + (size_t)i * block_len,
+					   block_len);
+}
+
+int ceph_xxhash32_avx2_exists(void)
+{
+	return 1;
+}
+
+#else
+
+int ceph_xxhash32_avx2_exists(void)
+{
+	return 0;
+}
+
+void ceph_xxhash32_avx2(uint32_t seed, unsigned char const *data,
+			unsigned block_len, unsigned nblocks,
+			uint32_t *out)
+{
+}
+
+#endif
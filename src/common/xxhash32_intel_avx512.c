@@ -0,0 +1,120 @@
+#include "common/xxhash32_intel.h"
+
+#if defined(__x86_64__) && defined(__AVX512F__)
+
+#include <immintrin.h>
+
+/*
+ * Same scheme as the avx2 kernel, but a zmm register holds the stripe
+ * accumulators of four blocks, and avx-512 has a real rotate.  Two
+ * registers (eight blocks) are kept in flight.
+ */
+
+static inline __m512i xxh32_load4(unsigned char const *a,
+				  unsigned char const *b,
+				  unsigned char const *c,
+				  unsigned char const *d)
+{
+	__m512i v = _mm512_castsi128_si512(
+		_mm_loadu_si128((__m128i const *)a));
+	v = _mm512_inserti32x4(v, _mm_loadu_si128((__m128i const *)b), 1);
+	v = _mm512_inserti32x4(v, _mm_loadu_si128((__m128i const *)c), 2);
+	return _mm512_inserti32x4(v, _mm_loadu_si128((__m128i const *)d), 3);
+}
+
+static inline __m512i xxh32_round(__m512i acc, __m512i in)
+{
+	const __m512i prime1 = _mm512_set1_epi32((int)CEPH_XXH_PRIME32_1);
+	const __m512i prime2 = _mm512_set1_epi32((int)CEPH_XXH_PRIME32_2);
+
+	acc = _mm512_add_epi32(acc, _mm512_mullo_epi32(in, prime2));
+	acc = _mm512_rol_epi32(acc, 13);
+	return _mm512_mullo_epi32(acc, prime1);
+}
+
+static inline __m512i xxh32_init(uint32_t seed)
+{
+	return _mm512_broadcast_i32x4(_mm_setr_epi32(
+		(int)(seed + CEPH_XXH_PRIME32_1 + CEPH_XXH_PRIME32_2),
+		(int)(seed + CEPH_XXH_PRIME32_2),
+		(int)seed,
+		(int)(seed - CEPH_XXH_PRIME32_1)));
+}
+
+static inline void xxh32_finish4(__m512i v, uint32_t *acc,
+				 unsigned char const *first,
+				 unsigned block_len, size_t tail_off,
+				 uint32_t *out)
+{
+	unsigned k;
+
+	_mm512_storeu_si512((void *)acc, v);
+	for (k = 0; k < 4; ++k)
+		out[k] = ceph_xxh32_finalize(
+			acc + k * 4, first + (size_t)k * block_len + tail_off,
+			block_len);
+}
+
+void ceph_xxhash32_avx512(uint32_t seed, unsigned char const *data,
+			  unsigned block_len, unsigned nblocks,
+			  uint32_t *out)
+{
+	unsigned stripes = block_len / 16;
+	size_t tail_off = (size_t)stripes * 16;
+	size_t bl = block_len;
+	uint32_t acc[16];
+	unsigned i = 0, s;
+
+	for (; i + 8 <= nblocks; i += 8) {
+		unsigned char const *b = data + (size_t)i * bl;
+		__m512i lo = xxh32_init(seed);
+		__m512i hi = lo;
+
+		for (s = 0; s < stripes; ++s) {
+			unsigned char const *p = b + (size_t)s * 16;
+			lo = xxh32_round(lo, xxh32_load4(p, p + bl, p + 2 * bl,
+							 p + 3 * bl));
+			p += 4 * bl;
+			hi = xxh32_round(hi, xxh32_load4(p, p + bl, p + 2 * bl,
+							 p + 3 * bl));
+		}
+		xxh32_finish4(lo, acc, b, block_len, tail_off, out + i);
+		xxh32_finish4(hi, acc, b + 4 * bl, block_len, tail_off,
+			      out + i + 4);
+	}
+	if (i + 4 <= nblocks) {
+		unsigned char const *b = data + (size_t)i * bl;
+		__m512i v = xxh32_init(seed);
+
+		for (s = 0; s < stripes; ++s) {
+			unsigned char const *p = b + (size_t)s * 16;
+			v = xxh32_round(v, xxh32_load4(p, p + bl, p + 2 * bl,
+						       p + 3 * bl));
+		}
+		xxh32_finish4(v, acc, b, block_len, tail_off, out + i);
+		i += 4;
+	}
+	for (; i < nblocks; ++i)
+		out[i] = ceph_xxh32_scalar(seed, data + (size_t)i * bl,
+					   block_len);
+}
+
+int ceph_xxhash32_avx512_exists(void)
+{
+	return 1;
+}
+
+#else
+
+int ceph_xxhash32_avx512_exists(void)
+{
+	return 0;
+}
+
+void ceph_xxhash32_avx512(uint32_t seed, unsigned char const *data,
+			  unsigned block_len, unsigned nblocks,
+			  uint32_t *out)
+{
+}
+
+#endif
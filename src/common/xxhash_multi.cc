@@ -0,0 +1,73 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "common/xxhash_multi.h"
+#include "arch/probe.h"
+#include "arch/intel.h"
+#include "common/xxhash32_intel.h"
+#include "xxHash/xxhash.h"
+
+void ceph_xxhash32_multi_generic(uint32_t seed, unsigned char const *data,
+				 unsigned block_len, unsigned nblocks,
+				 uint32_t *out)
+{
+  for (unsigned i = 0; i < nblocks; ++i) {
+    out[i] = XXH32(data + (size_t)i * block_len, block_len, seed);
+  }
+}
+
+#if defined(__x86_64__)
+// the kernels only vectorize the stripe loop; blocks too short to have
+// a full stripe are all tail and gain nothing from them.
+static void xxhash32_multi_avx2(uint32_t seed, unsigned char const *data,
+				unsigned block_len, unsigned nblocks,
+				uint32_t *out)
+{
+  if (block_len < 16) {
+    ceph_xxhash32_multi_generic(seed, data, block_len, nblocks, out);
+  } else {
+    ceph_xxhash32_avx2(seed, data, block_len, nblocks, out);
+  }
+}
+
+static void xxhash32_multi_avx512(uint32_t seed, unsigned char const *data,
+				  unsigned block_len, unsigned nblocks,
+				  uint32_t *out)
+{
+  if (block_len < 16) {
+    ceph_xxhash32_multi_generic(seed, data, block_len, nblocks, out);
+  } else {
+    ceph_xxhash32_avx512(seed, data, block_len, nblocks, out);
+  }
+}
+#endif
+
+ceph_xxhash32_multi_func_t ceph_choose_xxhash32_multi(void)
+{
+  ceph_arch_probe();
+
+#if defined(__x86_64__)
+  if (ceph_arch_intel_avx512f && ceph_xxhash32_avx512_exists()) {
+    return xxhash32_multi_avx512;
+  }
+  if (ceph_arch_intel_avx2 && ceph_xxhash32_avx2_exists()) {
+    return xxhash32_multi_avx2;
+  }
+#endif
+  return ceph_xxhash32_multi_generic;
+}
+
+/*
+ * static global; see ceph_crc32c_func.
+ */
+ceph_xxhash32_multi_func_t ceph_xxhash32_multi_func =
+  ceph_choose_xxhash32_multi();
+
+void ceph_xxhash64_multi(uint64_t seed, unsigned char const *data,
+			 unsigned block_len, unsigned nblocks,
+			 uint64_t *out)
+{
+  for (unsigned i = 0; i < nblocks; ++i) {
+    out[i] = XXH64(data + (size_t)i * block_len, block_len, seed);
+  }
+}
@@ -0,0 +1,66 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_COMMON_XXHASH_MULTI_H
+#define CEPH_COMMON_XXHASH_MULTI_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*ceph_xxhash32_multi_func_t)(uint32_t seed,
+					   unsigned char const *data,
+					   unsigned block_len,
+					   unsigned nblocks,
+					   uint32_t *out);
+
+/*
+ * static global with the chosen xxhash32 multi-block implementation
+ * for this cpu.
+ */
+extern ceph_xxhash32_multi_func_t ceph_xxhash32_multi_func;
+
+extern ceph_xxhash32_multi_func_t ceph_choose_xxhash32_multi(void);
+
+/* portable fallback: one XXH32() call per block */
+extern void ceph_xxhash32_multi_generic(uint32_t seed,
+					unsigned char const *data,
+					unsigned block_len, unsigned nblocks,
+					uint32_t *out);
+
+/**
+ * xxhash32 of several consecutive, equally sized blocks
+ *
+ * Equivalent to out[i] = XXH32(data + i * block_len, block_len, seed).
+ *
+ * @param seed seed for every block
+ * @param data pointer to nblocks * block_len bytes
+ * @param block_len length of each block
+ * @param nblocks number of blocks
+ * @param out array of nblocks results
+ */
+static inline void ceph_xxhash32_multi(uint32_t seed, unsigned char const *data,
+				       unsigned block_len, unsigned nblocks,
+				       uint32_t *out)
+{
+  ceph_xxhash32_multi_func(seed, data, block_len, nblocks, out);
+}
+
+/**
+ * xxhash64 of several consecutive, equally sized blocks
+ *
+ * There is no vector version: the 64x64 multiply xxhash64 is built on
+ * has no packed equivalent short of AVX-512DQ, so this is a plain loop
+ * over XXH64(); it exists so callers can treat both hashes alike.
+ */
+extern void ceph_xxhash64_multi(uint64_t seed, unsigned char const *data,
+				unsigned block_len, unsigned nblocks,
+				uint64_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -12,6 +12,7 @@
  *
  */
 
+#include <cmath>
 #include <random>
 #include <sstream>
 
@@ -107,3 +108,51 @@ CompressorRef Compressor::create(CephContext *cct, int alg)
   std::string type_name = get_comp_alg_name(alg);
   return create(cct, type_name);
 }
+
+double Compressor::estimate_entropy(const bufferlist& bl, size_t sample_len)
+{
+  // runs long enough to be cache friendly, short enough to cover the
+  // input in many places
+  const size_t run = 32;
+  uint32_t hist[256] = {0};
+  size_t total = 0;
+  size_t len = bl.length();
+
+  auto count = [&](bufferlist::const_iterator& p, size_t l) {
+    while (l > 0) {
+      const char *d;
+      size_t n = p.get_ptr_and_advance(l, &d);
+      for (size_t i = 0; i < n; ++i) {
+	++hist[(unsigned char)d[i]];
+      }
+      total += n;
+      l -= n;
+    }
+  };
+
+  if (sample_len == 0 || sample_len >= len) {
+    auto p = bl.begin();
+    count(p, len);
+  } else {
+    size_t runs = std::max<size_t>(sample_len / run, 1);
+    size_t stride = len / runs;
+    auto p = bl.begin();
+    for (size_t i = 0; i < runs; ++i) {
+      size_t off = i * stride;
+      p.seek(off);
+      count(p, std::min(run, len - off));
+    }
+  }
+  if (!total) {
+    return 0;
+  }
+
+  double h = 0;
+  for (auto c : hist) {
+    if (c) {
+      double q = (double)c / total;
+      h -= q * std::log2(q);
+    }
+  }
+  return h;
+}
@@ -71,6 +71,21 @@ public:
   static CompressorRef create(CephContext *cct, const std::string &type);
   static CompressorRef create(CephContext *cct, int alg);
 
+  /**
+   * estimate the order-0 (byte frequency) entropy of bl
+   *
+   * Looks at no more than sample_len bytes, taken in small runs spread
+   * evenly over bl.  Close to 8 means the data looks random and is
+   * unlikely to compress; this does not see repeated strings, though,
+   * so a low value is a better predictor than a high one.
+   *
+   * @param bl data to look at
+   * @param sample_len max bytes to sample; 0 means all of bl
+   * @return entropy estimate in bits per byte, [0, 8]
+   */
+  static double estimate_entropy(const ceph::bufferlist& bl,
+				 size_t sample_len);
+
 protected:
   CompressionAlgorithm alg;
   std::string type;
@@ -303,6 +303,27 @@ int ErasureCode::to_string(const std::string &name,
   return 0;
 }
 
+void ErasureCode::encode_delta(const bufferptr &old_data,
+			       const bufferptr &new_data,
+			       bufferptr *delta)
+{
+  // addition is xor in the galois fields used by all linear plugins
+  assert(old_data.length() == new_data.length());
+  assert(delta->length() == new_data.length());
+  const char *o = old_data.c_str();
+  const char *n = new_data.c_str();
+  char *d = delta->c_str();
+  for (unsigned i = 0; i < new_data.length(); ++i) {
+    d[i] = o[i] ^ n[i];
+  }
+}
+
+int ErasureCode::apply_delta(const map<int, bufferptr> &in,
+			     map<int, bufferptr> &out)
+{
+  return -ENOTSUP;
+}
+
 int ErasureCode::decode_concat(const map<int, bufferlist> &chunks,
 			       bufferlist *decoded)
 {
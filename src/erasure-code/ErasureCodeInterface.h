@@ -446,6 +446,45 @@ namespace ceph {
      */
     virtual int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) = 0;
+
+    /**
+     * Return true if the coding chunks are a linear function of the
+     * data chunks and **apply_delta** can update them in place. A
+     * partial overwrite then only needs to read the data chunks it
+     * modifies and the coding chunks, instead of all the data chunks.
+     *
+     * @return true if **apply_delta** is supported
+     */
+    virtual bool supports_parity_delta() const = 0;
+
+    /**
+     * Compute in **delta** the difference between the **old_data**
+     * and **new_data** content of a data chunk, in the form expected
+     * by **apply_delta**. All buffers have the same length and
+     * **delta** must be allocated by the caller.
+     *
+     * @param [in] old_data current content of the data chunk
+     * @param [in] new_data content about to be written
+     * @param [out] delta difference to give to **apply_delta**
+     */
+    virtual void encode_delta(const bufferptr &old_data,
+			      const bufferptr &new_data,
+			      bufferptr *delta) = 0;
+
+    /**
+     * Update the coding chunks found in **out** with the data chunk
+     * deltas found in **in**, as computed by **encode_delta**. The
+     * result is the same as if the coding chunks were encoded again
+     * from the modified data chunks. All buffers have the same size.
+     *
+     * Returns -ENOTSUP if **supports_parity_delta** is false.
+     *
+     * @param [in] in map data chunk indexes to deltas
+     * @param [in,out] out map coding chunk indexes to their content
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int apply_delta(const std::map<int, bufferptr> &in,
+			    std::map<int, bufferptr> &out) = 0;
   };
 
   typedef std::shared_ptr<ErasureCodeInterface> ErasureCodeInterfaceRef;
@@ -131,6 +131,50 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+int
+ErasureCodeIsaDefault::apply_delta(const map<int, bufferptr> &in,
+                                   map<int, bufferptr> &out)
+{
+  // ec_encode_data_update updates all coding chunks at once
+  if ((int) out.size() != m)
+    return -EINVAL;
+  unsigned char* coding[m];
+  int blocksize = -1;
+  for (auto &p : out) {
+    if (p.first < k || p.first >= k + m)
+      return -EINVAL;
+    if (blocksize < 0)
+      blocksize = p.second.length();
+    if ((int) p.second.length() != blocksize)
+      return -EINVAL;
+    coding[p.first - k] = (unsigned char*) p.second.c_str();
+  }
+
+  for (auto &d : in) {
+    if (d.first < 0 || d.first >= k)
+      return -EINVAL;
+    if ((int) d.second.length() != blocksize)
+      return -EINVAL;
+    unsigned char* delta = (unsigned char*) d.second.c_str();
+    if (m == 1) {
+      // single parity stripe, see isa_encode
+      if (is_aligned(delta, EC_ISA_VECTOR_OP_WORDSIZE) &&
+          is_aligned(coding[0], EC_ISA_VECTOR_OP_WORDSIZE) &&
+          (blocksize % EC_ISA_VECTOR_OP_WORDSIZE) == 0)
+        vector_xor((vector_op_t*) delta, (vector_op_t*) coding[0],
+                   (vector_op_t*) (delta + blocksize));
+      else
+        byte_xor(delta, coding[0], delta + blocksize);
+    } else {
+      ec_encode_data_update(blocksize, k, m, d.first, encode_tbls,
+                            delta, coding);
+    }
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
@@ -145,6 +145,14 @@ public:
 
   void prepare() override;
 
+  bool supports_parity_delta() const override
+  {
+    return true;
+  }
+
+  int apply_delta(const std::map<int, bufferptr> &in,
+                  std::map<int, bufferptr> &out) override;
+
  private:
   int parse(ErasureCodeProfile &profile,
                     std::ostream *ss) override;
@@ -146,6 +146,49 @@ bool ErasureCodeJerasure::is_prime(int value)
   return false;
 }
 
+int ErasureCodeJerasure::matrix_apply_delta(const int *matrix,
+					    const map<int, bufferptr> &in,
+					    map<int, bufferptr> &out)
+{
+  // coding chunk j is the sum over the data chunks i of
+  // matrix[j * k + i] * data[i], so a data chunk delta multiplied by
+  // the same coefficient is added to each coding chunk.
+  for (auto &d : in) {
+    if (d.first < 0 || d.first >= k)
+      return -EINVAL;
+    char *delta = const_cast<char*>(d.second.c_str());
+    int size = d.second.length();
+    for (auto &p : out) {
+      if (p.first < k || p.first >= k + m)
+	return -EINVAL;
+      if ((int)p.second.length() != size)
+	return -EINVAL;
+      int coef = matrix[(p.first - k) * k + d.first];
+      char *parity = p.second.c_str();
+      if (coef == 0) {
+	continue;
+      } else if (coef == 1) {
+	galois_region_xor(delta, parity, size);
+      } else {
+	switch (w) {
+	case 8:
+	  galois_w08_region_multiply(delta, coef, size, parity, 1);
+	  break;
+	case 16:
+	  galois_w16_region_multiply(delta, coef, size, parity, 1);
+	  break;
+	case 32:
+	  galois_w32_region_multiply(delta, coef, size, parity, 1);
+	  break;
+	default:
+	  return -EINVAL;
+	}
+      }
+    }
+  }
+  return 0;
+}
+
 // 
 // ErasureCodeJerasureReedSolomonVandermonde
 //
@@ -77,6 +77,9 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ErasureCodeProfile &profile, std::ostream *ss);
+  int matrix_apply_delta(const int *matrix,
+			 const std::map<int, bufferptr> &in,
+			 std::map<int, bufferptr> &out);
 };
 
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
@@ -96,6 +99,14 @@ public:
       free(matrix);
   }
 
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  int apply_delta(const std::map<int, bufferptr> &in,
+		  std::map<int, bufferptr> &out) override {
+    return matrix_apply_delta(matrix, in, out);
+  }
+
   void jerasure_encode(char **data,
                                char **coding,
                                int blocksize) override;
@@ -125,6 +136,14 @@ public:
       free(matrix);
   }
 
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  int apply_delta(const std::map<int, bufferptr> &in,
+		  std::map<int, bufferptr> &out) override {
+    return matrix_apply_delta(matrix, in, out);
+  }
+
   void jerasure_encode(char **data,
                                char **coding,
                                int blocksize) override;
@@ -50,6 +50,43 @@ static inline uint32_t ceph_crc32c(uint32_t crc, unsigned char const *data, unsi
   return ceph_crc32c_func(crc, data, length);
 }
 
+typedef void (*ceph_crc32c_multi_func_t)(uint32_t crc, unsigned char const *data,
+					 unsigned block_len, unsigned nblocks,
+					 uint32_t *out);
+
+/*
+ * the chosen implementation for checksumming many equally sized
+ * blocks at once (e.g., per-csum-block checksums of a blob).
+ */
+extern ceph_crc32c_multi_func_t ceph_crc32c_multi_func;
+
+extern ceph_crc32c_multi_func_t ceph_choose_crc32c_multi(void);
+
+/* portable fallback: one ceph_crc32c_func call per block */
+extern void ceph_crc32c_multi_generic(uint32_t crc, unsigned char const *data,
+				      unsigned block_len, unsigned nblocks,
+				      uint32_t *out);
+
+/**
+ * calculate crc32c of several consecutive blocks
+ *
+ * Equivalent to out[i] = ceph_crc32c(crc, data + i * block_len, block_len)
+ * for i in [0, nblocks), but lets the implementation interleave the
+ * independent blocks.
+ *
+ * @param crc initial value for every block
+ * @param data pointer to nblocks * block_len bytes (or NULL for zeros)
+ * @param block_len length of each block
+ * @param nblocks number of blocks
+ * @param out array of nblocks results
+ */
+static inline void ceph_crc32c_multi(uint32_t crc, unsigned char const *data,
+				     unsigned block_len, unsigned nblocks,
+				     uint32_t *out)
+{
+  ceph_crc32c_multi_func(crc, data, block_len, nblocks, out);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,7 @@
 #include <set>
 #include <map>
 #include <string>
+#include <functional>
 #include "include/memory.h"
 #include <boost/scoped_ptr.hpp>
 #include "include/encoding.h"
@@ -165,6 +166,15 @@ public:
   /// Try to repair K/V database. leveldb and rocksdb require that database must be not opened.
   virtual int repair(std::ostream &out) { return 0; }
 
+  /// Move keys between the default key space and per-prefix column
+  /// families so that exactly the column families in cfs exist afterwards.
+  /// Offline use only; nothing else may access the db meanwhile.  If it is
+  /// interrupted, the next open finishes it.
+  virtual int migrate_column_families(std::ostream &out,
+				      const vector<ColumnFamily>& cfs) {
+    return -EOPNOTSUPP;
+  }
+
   virtual Transaction get_transaction() = 0;
   virtual int submit_transaction(Transaction) = 0;
   virtual int submit_transaction_sync(Transaction t) {
@@ -268,7 +278,7 @@ public:
   };
   typedef ceph::shared_ptr< WholeSpaceIteratorImpl > WholeSpaceIterator;
 
-private:
+protected:
   // This class filters a WholeSpaceIterator by a prefix.
   class PrefixIteratorImpl : public IteratorImpl {
     const std::string prefix;
@@ -358,6 +368,36 @@ public:
     return -EOPNOTSUPP;
   }
 
+  /// collect cache hit/miss statistics (call before open)
+  virtual int enable_cache_stats() {
+    return -EOPNOTSUPP;
+  }
+
+  /// resize the cache of an open db
+  virtual int set_cache_capacity(uint64_t capacity) {
+    return -EOPNOTSUPP;
+  }
+
+  /// bytes currently held in the cache
+  virtual int64_t get_cache_usage() const {
+    return -EOPNOTSUPP;
+  }
+
+  /// cumulative cache hits and misses
+  virtual int get_cache_stats(uint64_t *hits, uint64_t *misses) const {
+    return -EOPNOTSUPP;
+  }
+
+  /// called with the path and LSM level of each table file as it is
+  /// written, and of every live table file on open
+  typedef std::function<void(const std::string& path, int level)>
+    FileLevelHandler;
+
+  /// register a FileLevelHandler (call before open)
+  virtual int set_file_level_handler(FileLevelHandler h) {
+    return -EOPNOTSUPP;
+  }
+
   virtual ~KeyValueDB() {}
 
   /// compact the underlying store
@@ -51,10 +51,11 @@ static string make_key(const string &prefix, const string &value)
   return out;
 }
 
-void MemDB::_encode(mdb_iter_t iter, bufferlist &bl)
+void MemDB::_encode(const string& key, const bufferptr& value,
+		    bufferlist &bl)
 {
-  ::encode(iter->first, bl);
-  ::encode(iter->second, bl);
+  ::encode(key, bl);
+  ::encode(value, bl);
 }
 
 std::string MemDB::_get_data_fn()
@@ -65,7 +66,7 @@ std::string MemDB::_get_data_fn()
 
 void MemDB::_save()
 {
-  std::lock_guard<std::mutex> l(m_lock);
+  RWLock::WLocker l(m_lock);
   dout(10) << __func__ << " Saving MemDB to file: "<< _get_data_fn().c_str() << dendl;
   int mode = 0644;
   int fd = TEMP_FAILURE_RETRY(::open(_get_data_fn().c_str(),
@@ -77,11 +78,13 @@ void MemDB::_save()
     return;
   }
   bufferlist bl;
-  mdb_iter_t iter = m_map.begin();
-  while (iter != m_map.end()) {
-    dout(10) << __func__ << " Key:"<< iter->first << dendl;
-    _encode(iter, bl);
-    ++iter;
+  for (auto& p : m_map) {
+    const mdb_version_t& v = p.second.back();
+    if (v.deleted) {
+      continue;
+    }
+    dout(10) << __func__ << " Key:"<< p.first << dendl;
+    _encode(p.first, v.value, bl);
   }
   bl.write_fd(fd);
 
@@ -90,7 +93,7 @@ void MemDB::_save()
 
 int MemDB::_load()
 {
-  std::lock_guard<std::mutex> l(m_lock);
+  RWLock::WLocker l(m_lock);
   dout(10) << __func__ << " Reading MemDB from file: "<< _get_data_fn().c_str() << dendl;
   /*
    * Open file and read it in single shot.
@@ -123,7 +126,7 @@ int MemDB::_load()
     bytes_done += ::decode_file(fd, datap);
 
     dout(10) << __func__ << " Key:"<< key << dendl;
-    m_map[key] = datap;
+    m_map[key].emplace_back(m_seq, datap, false);
     m_total_bytes += datap.length();
   }
   VOID_TEMP_FAILURE_RETRY(::close(fd));
@@ -200,19 +203,24 @@ int MemDB::submit_transaction(KeyValueDB::Transaction t)
   MDBTransactionImpl* mt =  static_cast<MDBTransactionImpl*>(t.get());
 
   dtrace << __func__ << " " << mt->get_ops().size() << dendl;
+  RWLock::WLocker l(m_lock);
+  // readers see all of the transaction or none of it
+  uint64_t seq = m_seq + 1;
   for(auto& op : mt->get_ops()) {
     if(op.first == MDBTransactionImpl::WRITE) {
       ms_op_t set_op = op.second;
-      _setkey(set_op);
+      _setkey(set_op, seq);
     } else if (op.first == MDBTransactionImpl::MERGE) {
       ms_op_t merge_op = op.second;
-      _merge(merge_op);
+      _merge(merge_op, seq);
     } else {
       ms_op_t rm_op = op.second;
       assert(op.first == MDBTransactionImpl::DELETE);
-      _rmkey(rm_op);
+      _rmkey(rm_op, seq);
     }
   }
+  m_seq = seq;
+  _gc();
 
   return 0;
 }
@@ -278,9 +286,115 @@ void MemDB::MDBTransactionImpl::merge(
   return;
 }
 
-int MemDB::_setkey(ms_op_t &op)
+uint64_t MemDB::_get_snapshot()
+{
+  // take m_lock so that m_seq can't move before we are registered
+  RWLock::RLocker l(m_lock);
+  std::lock_guard<std::mutex> sl(m_snap_lock);
+  m_snapshots.insert(m_seq);
+  return m_seq;
+}
+
+void MemDB::_put_snapshot(uint64_t seq)
+{
+  std::lock_guard<std::mutex> l(m_snap_lock);
+  auto p = m_snapshots.find(seq);
+  assert(p != m_snapshots.end());
+  m_snapshots.erase(p);
+}
+
+uint64_t MemDB::_min_snapshot()
+{
+  std::lock_guard<std::mutex> l(m_snap_lock);
+  if (m_snapshots.empty()) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return *m_snapshots.begin();
+}
+
+const MemDB::mdb_version_t *MemDB::_visible(const mdb_versions_t& v,
+					    uint64_t seq)
+{
+  for (auto p = v.rbegin(); p != v.rend(); ++p) {
+    if (p->seq <= seq) {
+      return p->deleted ? nullptr : &*p;
+    }
+  }
+  return nullptr;
+}
+
+/*
+ * Caller holds m_lock for write.
+ */
+bool MemDB::_prune(mdb_iter_t p, uint64_t min_snap)
+{
+  mdb_versions_t& v = p->second;
+  // the oldest snapshot sees the newest version at or before it; nobody
+  // sees anything older than that.
+  auto keep = v.end() - 1;
+  while (keep != v.begin() && keep->seq > min_snap) {
+    --keep;
+  }
+  v.erase(v.begin(), keep);
+  if (v.size() == 1 && v.back().deleted) {
+    m_map.erase(p);
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Caller holds m_lock for write.
+ */
+void MemDB::_add_version(const string& key, uint64_t seq,
+			 const bufferptr& value, bool deleted)
+{
+  mdb_iter_t p = m_map.lower_bound(key);
+  if (p == m_map.end() || p->first != key) {
+    if (deleted) {
+      return;
+    }
+    p = m_map.emplace_hint(p, key, mdb_versions_t());
+  }
+  mdb_versions_t& v = p->second;
+  if (!v.empty() && v.back().seq == seq) {
+    // written earlier in this transaction; nobody has seen it yet
+    v.back().value = value;
+    v.back().deleted = deleted;
+  } else {
+    v.emplace_back(seq, value, deleted);
+  }
+  if (!_prune(p, _min_snapshot()) && v.size() > 1) {
+    m_gc_keys.insert(key);
+  }
+}
+
+/*
+ * Caller holds m_lock for write.
+ */
+void MemDB::_gc()
+{
+  if (m_gc_keys.empty()) {
+    return;
+  }
+  uint64_t min_snap = _min_snapshot();
+  if (min_snap == m_gc_min_snap) {
+    return;  // nothing more can be dropped
+  }
+  m_gc_min_snap = min_snap;
+  dtrace << __func__ << " " << m_gc_keys.size() << " keys" << dendl;
+  for (auto k = m_gc_keys.begin(); k != m_gc_keys.end(); ) {
+    mdb_iter_t p = m_map.find(*k);
+    if (p == m_map.end() || _prune(p, min_snap) || p->second.size() == 1) {
+      k = m_gc_keys.erase(k);
+    } else {
+      ++k;
+    }
+  }
+}
+
+int MemDB::_setkey(ms_op_t &op, uint64_t seq)
 {
-  std::lock_guard<std::mutex> l(m_lock);
   std::string key = make_key(op.first.first, op.first.second);
   bufferlist bl = op.second;
 
@@ -288,34 +402,26 @@ int MemDB::_setkey(ms_op_t &op)
 
   bufferlist bl_old;
   if (_get(op.first.first, op.first.second, &bl_old)) {
-    /*
-     * delete and free existing key.
-     */
     assert(m_total_bytes >= bl_old.length());
     m_total_bytes -= bl_old.length();
-    m_map.erase(key);
   }
 
-  m_map[key] = bufferptr((char *) bl.c_str(), bl.length());
-  iterator_seq_no++;
+  _add_version(key, seq, bufferptr((char *) bl.c_str(), bl.length()), false);
   return 0;
 }
 
-int MemDB::_rmkey(ms_op_t &op)
+int MemDB::_rmkey(ms_op_t &op, uint64_t seq)
 {
-  std::lock_guard<std::mutex> l(m_lock);
   std::string key = make_key(op.first.first, op.first.second);
 
   bufferlist bl_old;
-  if (_get(op.first.first, op.first.second, &bl_old)) {
-    assert(m_total_bytes >= bl_old.length());
-    m_total_bytes -= bl_old.length();
+  if (!_get(op.first.first, op.first.second, &bl_old)) {
+    return 0;
   }
-  iterator_seq_no++;
-  /*
-   * Erase will call the destructor for bufferptr.
-   */
-  return m_map.erase(key);
+  assert(m_total_bytes >= bl_old.length());
+  m_total_bytes -= bl_old.length();
+  _add_version(key, seq, bufferptr(), true);
+  return 1;
 }
 
 std::shared_ptr<KeyValueDB::MergeOperator> MemDB::_find_merge_op(std::string prefix)
@@ -331,9 +437,8 @@ std::shared_ptr<KeyValueDB::MergeOperator> MemDB::_find_merge_op(std::string pre
 }
 
 
-int MemDB::_merge(ms_op_t &op)
+int MemDB::_merge(ms_op_t &op, uint64_t seq)
 {
-  std::lock_guard<std::mutex> l(m_lock);
   std::string prefix = op.first.first;
   std::string key = make_key(op.first.first, op.first.second);
   bufferlist bl = op.second;
@@ -349,32 +454,29 @@ int MemDB::_merge(ms_op_t &op)
    * call the merge operator with value and non value
    */
   bufferlist bl_old;
+  std::string new_val;
   if (_get(op.first.first, op.first.second, &bl_old) == false) {
-    std::string new_val;
     /*
      * Merge non existent.
      */
     mop->merge_nonexistent(bl.c_str(), bl.length(), &new_val);
-    m_map[key] = bufferptr(new_val.c_str(), new_val.length());
   } else {
     /*
      * Merge existing.
      */
-    std::string new_val;
     mop->merge(bl_old.c_str(), bl_old.length(), bl.c_str(), bl.length(), &new_val);
-    m_map[key] = bufferptr(new_val.c_str(), new_val.length());
     bytes_adjusted -= bl_old.length();
     bl_old.clear();
   }
+  _add_version(key, seq, bufferptr(new_val.c_str(), new_val.length()), false);
 
   assert((int64_t)m_total_bytes + bytes_adjusted >= 0);
   m_total_bytes += bytes_adjusted;
-  iterator_seq_no++;
   return 0;
 }
 
 /*
- * Caller take btree lock.
+ * Caller holds m_lock.
  */
 bool MemDB::_get(const string &prefix, const string &k, bufferlist *out)
 {
@@ -384,14 +486,19 @@ bool MemDB::_get(const string &prefix, const string &k, bufferlist *out)
   if (iter == m_map.end()) {
     return false;
   }
+  const mdb_version_t& v = iter->second.back();
+  if (v.deleted) {
+    return false;
+  }
 
-  out->push_back((m_map[key].clone()));
+  // versions are never modified once visible, so share the buffer
+  out->push_back(v.value);
   return true;
 }
 
 bool MemDB::_get_locked(const string &prefix, const string &k, bufferlist *out)
 {
-  std::lock_guard<std::mutex> l(m_lock);
+  RWLock::RLocker l(m_lock);
   return _get(prefix, k, out);
 }
 
@@ -419,51 +526,45 @@ int MemDB::get(const string &prefix, const std::set<string> &keys,
 
 void MemDB::MDBWholeSpaceIteratorImpl::fill_current()
 {
+  const mdb_version_t *v = _visible(m_iter->second, m_snap);
+  assert(v);
   bufferlist bl;
-  bl.append(m_iter->second.clone());
+  bl.append(v->value);
   m_key_value = std::make_pair(m_iter->first, bl);
 }
 
-bool MemDB::MDBWholeSpaceIteratorImpl::valid()
+bool MemDB::MDBWholeSpaceIteratorImpl::_skip_forward()
 {
-  if (m_key_value.first.empty()) {
-    return false;
+  while (m_iter != m_db->m_map.end()) {
+    if (_visible(m_iter->second, m_snap)) {
+      fill_current();
+      return true;
+    }
+    ++m_iter;
   }
-  return true;
+  return false;
 }
 
-bool MemDB::MDBWholeSpaceIteratorImpl::iterator_validate() {
-
-  if (this_seq_no != *global_seq_no) {
-    auto key = m_key_value.first;
-    assert(!key.empty());
-
-    bool restart_iter = false;
-    if (!m_using_btree) {
-      /*
-       * Map is modified and marker key does not exists, 
-       * restart the iterator from next key.
-       */
-      if (m_map_p->find(key) == m_map_p->end()) {
-        restart_iter = true;
-      }
-    } else {
-      restart_iter = true;
+bool MemDB::MDBWholeSpaceIteratorImpl::_skip_backward()
+{
+  while (true) {
+    if (m_iter != m_db->m_map.end() && _visible(m_iter->second, m_snap)) {
+      fill_current();
+      return true;
     }
-
-    if (restart_iter) {
-      m_iter = m_map_p->lower_bound(key);
-      if (m_iter == m_map_p->end()) {
-        return false;
-      }
+    if (m_iter == m_db->m_map.begin()) {
+      m_iter = m_db->m_map.end();
+      return false;
     }
-
-    /*
-     * This iter is valid now.
-     */
-    this_seq_no = *global_seq_no;
+    --m_iter;
   }
+}
 
+bool MemDB::MDBWholeSpaceIteratorImpl::valid()
+{
+  if (m_key_value.first.empty()) {
+    return false;
+  }
   return true;
 }
 
@@ -505,36 +606,28 @@ bufferlist MemDB::MDBWholeSpaceIteratorImpl::value()
 
 int MemDB::MDBWholeSpaceIteratorImpl::next()
 {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
-  if (!iterator_validate()) {
-    free_last();
+  RWLock::RLocker l(m_db->m_lock);
+  if (!valid()) {
     return -1;
   }
   free_last();
   ++m_iter;
-  if (m_iter != m_map_p->end()) {
-    fill_current();
-    return 0;
-  } else {
-    return -1;
-  }
+  return _skip_forward() ? 0 : -1;
 }
 
 int MemDB::MDBWholeSpaceIteratorImpl:: prev()
 {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
-  if (!iterator_validate()) {
-    free_last();
+  RWLock::RLocker l(m_db->m_lock);
+  if (!valid()) {
     return -1;
   }
   free_last();
-  if (m_iter != m_map_p->begin()) {
-    --m_iter;
-    fill_current();
-    return 0;
-  } else {
+  if (m_iter == m_db->m_map.begin()) {
+    m_iter = m_db->m_map.end();
     return -1;
   }
+  --m_iter;
+  return _skip_backward() ? 0 : -1;
 }
 
 /*
@@ -542,68 +635,52 @@ int MemDB::MDBWholeSpaceIteratorImpl:: prev()
  */
 int MemDB::MDBWholeSpaceIteratorImpl::seek_to_first(const std::string &k)
 {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
+  RWLock::RLocker l(m_db->m_lock);
   free_last();
   if (k.empty()) {
-    m_iter = m_map_p->begin();
+    m_iter = m_db->m_map.begin();
   } else {
-    m_iter = m_map_p->lower_bound(k);
+    m_iter = m_db->m_map.lower_bound(k);
   }
-  
-  if (m_iter == m_map_p->end()) {
-    return -1;
-  }
-  fill_current();
-  return 0;
+  return _skip_forward() ? 0 : -1;
 }
 
 int MemDB::MDBWholeSpaceIteratorImpl::seek_to_last(const std::string &k)
 {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
+  RWLock::RLocker l(m_db->m_lock);
   free_last();
   if (k.empty()) {
-    m_iter = m_map_p->end();
-    --m_iter;
-  } else {
-    m_iter = m_map_p->lower_bound(k);
-  }
-
-  if (m_iter == m_map_p->end()) {
-    return -1;
+    m_iter = m_db->m_map.end();
+    return _skip_backward() ? 0 : -1;
   }
-  fill_current();
-  return 0;
+  m_iter = m_db->m_map.lower_bound(k);
+  return _skip_forward() ? 0 : -1;
 }
 
 MemDB::MDBWholeSpaceIteratorImpl::~MDBWholeSpaceIteratorImpl()
 {
   free_last();
+  m_db->_put_snapshot(m_snap);
 }
 
 int MemDB::MDBWholeSpaceIteratorImpl::upper_bound(const std::string &prefix,
     const std::string &after) {
 
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
+  RWLock::RLocker l(m_db->m_lock);
 
   dtrace << "upper_bound " << prefix.c_str() << after.c_str() << dendl;
+  free_last();
   string k = make_key(prefix, after);
-  m_iter = m_map_p->upper_bound(k);
-  if (m_iter != m_map_p->end()) {
-    fill_current();
-    return 0;
-  }
-  return -1;
+  m_iter = m_db->m_map.upper_bound(k);
+  return _skip_forward() ? 0 : -1;
 }
 
 int MemDB::MDBWholeSpaceIteratorImpl::lower_bound(const std::string &prefix,
     const std::string &to) {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
+  RWLock::RLocker l(m_db->m_lock);
   dtrace << "lower_bound " << prefix.c_str() << to.c_str() << dendl;
+  free_last();
   string k = make_key(prefix, to);
-  m_iter = m_map_p->lower_bound(k);
-  if (m_iter != m_map_p->end()) {
-    fill_current();
-    return 0;
-  }
-  return -1;
+  m_iter = m_db->m_map.lower_bound(k);
+  return _skip_forward() ? 0 : -1;
 }
@@ -19,25 +19,60 @@
 #include "include/encoding.h"
 #include "include/cpp-btree/btree.h"
 #include "include/cpp-btree/btree_map.h"
+#include <boost/container/small_vector.hpp>
 #include "include/encoding_btree.h"
 #include "KeyValueDB.h"
 #include "osd/osd_types.h"
+#include "common/RWLock.h"
 
 using std::string;
 #define KEY_DELIM '\0' 
 
+/*
+ * Keys are kept in a map of version lists, so that iterators can read a
+ * consistent snapshot (like rocksdb's) while transactions are applied.
+ * Readers share m_lock; a transaction holds it exclusively while its ops
+ * are applied, so it becomes visible atomically.  Versions that no live
+ * snapshot can see are pruned as keys are written, or by _gc().
+ */
 class MemDB : public KeyValueDB
 {
   typedef std::pair<std::pair<std::string, std::string>, bufferlist> ms_op_t;
-  std::mutex m_lock;
+  RWLock m_lock;
   uint64_t m_total_bytes;
   uint64_t m_allocated_bytes;
 
-  typedef std::map<std::string, bufferptr> mdb_map_t;
+  struct mdb_version_t {
+    uint64_t seq;      ///< transaction that wrote this version
+    bufferptr value;   ///< immutable once written
+    bool deleted;
+
+    mdb_version_t(uint64_t s, const bufferptr& v, bool d)
+      : seq(s), value(v), deleted(d) {}
+  };
+  /// versions of a key, oldest first
+  typedef boost::container::small_vector<mdb_version_t, 1> mdb_versions_t;
+  typedef std::map<std::string, mdb_versions_t> mdb_map_t;
   typedef mdb_map_t::iterator mdb_iter_t;
-  bool m_using_btree;
 
   mdb_map_t m_map;
+  uint64_t m_seq = 0;          ///< last applied transaction; under m_lock
+
+  std::mutex m_snap_lock;      ///< protects m_snapshots
+  std::multiset<uint64_t> m_snapshots;  ///< seqs of live iterators
+  std::set<std::string> m_gc_keys;      ///< keys holding old versions
+  uint64_t m_gc_min_snap = 0;  ///< oldest snapshot at the last _gc()
+
+  uint64_t _get_snapshot();
+  void _put_snapshot(uint64_t seq);
+  uint64_t _min_snapshot();
+  /// drop versions older than any snapshot needs; true if key is gone
+  bool _prune(mdb_iter_t p, uint64_t min_snap);
+  void _add_version(const std::string& key, uint64_t seq,
+		    const bufferptr& value, bool deleted);
+  void _gc();
+  static const mdb_version_t *_visible(const mdb_versions_t& v,
+				       uint64_t seq);
 
   CephContext *m_cct;
   void* m_priv;
@@ -50,14 +85,15 @@ class MemDB : public KeyValueDB
   bool _get(const string &prefix, const string &k, bufferlist *out);
   bool _get_locked(const string &prefix, const string &k, bufferlist *out);
   std::string _get_data_fn();
-  void _encode(mdb_iter_t iter, bufferlist &bl);
+  void _encode(const std::string& key, const bufferptr& value,
+	       bufferlist &bl);
   void _save();
   int _load();
-  uint64_t iterator_seq_no;
 
 public:
   MemDB(CephContext *c, const string &path, void *p) :
-    m_using_btree(false), m_cct(c), m_priv(p), m_db_path(path), iterator_seq_no(1)
+    m_lock("MemDB::m_lock", false, false, true),
+    m_cct(c), m_priv(p), m_db_path(path)
   {
     //Nothing as of now
   }
@@ -111,10 +147,9 @@ private:
   /*
    * Transaction states.
    */
-  int _merge(const std::string &k, bufferptr &bl);
-  int _merge(ms_op_t &op);
-  int _setkey(ms_op_t &op);
-  int _rmkey(ms_op_t &op);
+  int _merge(ms_op_t &op, uint64_t seq);
+  int _setkey(ms_op_t &op, uint64_t seq);
+  int _rmkey(ms_op_t &op, uint64_t seq);
 
 public:
 
@@ -143,23 +178,25 @@ public:
 
   class MDBWholeSpaceIteratorImpl : public KeyValueDB::WholeSpaceIteratorImpl {
 
+      MemDB *m_db;
       mdb_iter_t m_iter;
       std::pair<string, bufferlist> m_key_value;
-      mdb_map_t *m_map_p;
-      std::mutex *m_map_lock_p;
-      uint64_t *global_seq_no;
-      uint64_t this_seq_no;
-      bool m_using_btree;
+      uint64_t m_snap;       ///< we see versions up to this seq
+
+      // m_iter stays valid: a key we can see keeps the version we see,
+      // so its map node isn't erased while we are registered.
+
+      /// move m_iter to the first key at or after it we can see
+      bool _skip_forward();
+      /// move m_iter to the first key at or before it we can see
+      bool _skip_backward();
 
   public:
-    MDBWholeSpaceIteratorImpl(mdb_map_t *btree_p, std::mutex *btree_lock_p,
-                              uint64_t *iterator_seq_no, bool using_btree) {
-      m_map_p = btree_p;
-      m_map_lock_p = btree_lock_p;
-      std::lock_guard<std::mutex> l(*m_map_lock_p);
-      global_seq_no = iterator_seq_no;
-      this_seq_no = *iterator_seq_no;
-      m_using_btree = using_btree;
+    explicit MDBWholeSpaceIteratorImpl(MemDB *db)
+      : m_db(db) {
+      m_snap = m_db->_get_snapshot();
+      RWLock::RLocker l(m_db->m_lock);
+      m_iter = m_db->m_map.end();
     }
 
     void fill_current();
@@ -175,7 +212,6 @@ public:
     int upper_bound(const std::string &prefix, const std::string &after) override;
     int lower_bound(const std::string &prefix, const std::string &to) override;
     bool valid() override;
-    bool iterator_validate();
 
     int next() override;
     int prev() override;
@@ -189,12 +225,12 @@ public:
   };
 
   uint64_t get_estimated_size(std::map<std::string,uint64_t> &extra) override {
-      std::lock_guard<std::mutex> l(m_lock);
+      RWLock::RLocker l(m_lock);
       return m_allocated_bytes;
   };
 
   int get_statfs(struct store_statfs_t *buf) override {
-    std::lock_guard<std::mutex> l(m_lock);
+    RWLock::RLocker l(m_lock);
     buf->reset();
     buf->total = m_total_bytes;
     buf->allocated = m_allocated_bytes;
@@ -204,7 +240,7 @@ public:
 
   WholeSpaceIterator get_wholespace_iterator() override {
     return std::shared_ptr<KeyValueDB::WholeSpaceIteratorImpl>(
-      new MDBWholeSpaceIteratorImpl(&m_map, &m_lock, &iterator_seq_no, m_using_btree));
+      new MDBWholeSpaceIteratorImpl(this));
   }
 };
 
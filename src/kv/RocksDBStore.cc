@@ -18,6 +18,7 @@
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/utilities/convenience.h"
 #include "rocksdb/merge_operator.h"
+#include "rocksdb/listener.h"
 using std::string;
 #include "common/perf_counters.h"
 #include "common/debug.h"
@@ -190,6 +191,29 @@ rocksdb::Logger *create_rocksdb_ceph_logger()
   return new CephRocksdbLogger(g_ceph_context);
 }
 
+// report the level of each table file rocksdb writes (flushes go to L0)
+class CephRocksdbFileLevelListener : public rocksdb::EventListener {
+  KeyValueDB::FileLevelHandler handler;
+public:
+  explicit CephRocksdbFileLevelListener(KeyValueDB::FileLevelHandler h)
+    : handler(h) {}
+
+  void OnFlushCompleted(rocksdb::DB *db,
+			const rocksdb::FlushJobInfo& info) override {
+    handler(info.file_path, 0);
+  }
+
+  void OnCompactionCompleted(rocksdb::DB *db,
+			     const rocksdb::CompactionJobInfo& info) override {
+    if (!info.status.ok()) {
+      return;
+    }
+    for (auto& f : info.output_files) {
+      handler(f, info.output_level);
+    }
+  }
+};
+
 static int string2bool(const string &val, bool &b_val)
 {
   if (strcasecmp(val.c_str(), "false") == 0) {
@@ -309,6 +333,32 @@ int RocksDBStore::install_cf_mergeop(
   return 0;
 }
 
+int RocksDBStore::create_cf(
+  const rocksdb::ColumnFamilyOptions& base,
+  const ColumnFamily& p)
+{
+  rocksdb::ColumnFamilyOptions cf_opt(base);
+  // user input options will override the base options
+  rocksdb::Status status = rocksdb::GetColumnFamilyOptionsFromString(
+    cf_opt, p.option, &cf_opt);
+  if (!status.ok()) {
+    derr << __func__ << " invalid db column family option string for CF: "
+	 << p.name << dendl;
+    return -EINVAL;
+  }
+  install_cf_mergeop(p.name, &cf_opt);
+  rocksdb::ColumnFamilyHandle *cf;
+  status = db->CreateColumnFamily(cf_opt, p.name, &cf);
+  if (!status.ok()) {
+    derr << __func__ << " Failed to create rocksdb column family: "
+	 << p.name << dendl;
+    return -EINVAL;
+  }
+  // store the new CF handle
+  add_column_family(p.name, static_cast<void*>(cf));
+  return 0;
+}
+
 int RocksDBStore::create_and_open(ostream &out,
 				  const vector<ColumnFamily>& cfs)
 {
@@ -333,7 +383,7 @@ int RocksDBStore::load_rocksdb_options(bool create_if_missing, rocksdb::Options&
     }
   }
 
-  if (g_conf->rocksdb_perf)  {
+  if (g_conf->rocksdb_perf || cache_stats)  {
     dbstats = rocksdb::CreateDBStatistics();
     opt.statistics = dbstats;
   }
@@ -439,6 +489,11 @@ int RocksDBStore::load_rocksdb_options(bool create_if_missing, rocksdb::Options&
 
   opt.merge_operator.reset(new MergeOperatorRouter(*this));
 
+  if (file_level_handler) {
+    opt.listeners.push_back(
+      std::make_shared<CephRocksdbFileLevelListener>(file_level_handler));
+  }
+
   return 0;
 }
 
@@ -460,28 +515,14 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing,
     }
     // create and open column families
     if (cfs) {
+      // copy default CF settings, block cache, merge operators as
+      // the base for new CF
+      rocksdb::ColumnFamilyOptions base(opt);
       for (auto& p : *cfs) {
-	// copy default CF settings, block cache, merge operators as
-	// the base for new CF
-	rocksdb::ColumnFamilyOptions cf_opt(opt);
-	// user input options will override the base options
-	status = rocksdb::GetColumnFamilyOptionsFromString(
-	  cf_opt, p.option, &cf_opt);
-	if (!status.ok()) {
-	  derr << __func__ << " invalid db column family option string for CF: "
-	       << p.name << dendl;
-	  return -EINVAL;
+	r = create_cf(base, p);
+	if (r < 0) {
+	  return r;
 	}
-	install_cf_mergeop(p.name, &cf_opt);
-	rocksdb::ColumnFamilyHandle *cf;
-	status = db->CreateColumnFamily(cf_opt, p.name, &cf);
-	if (!status.ok()) {
-	  derr << __func__ << " Failed to create rocksdb column family: "
-	       << p.name << dendl;
-	  return -EINVAL;
-	}
-	// store the new CF handle
-	add_column_family(p.name, static_cast<void*>(cf));
       }
     }
     default_cf = db->DefaultColumnFamily();
@@ -550,6 +591,21 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing,
     }
   }
   assert(default_cf != nullptr);
+
+  if (!create_if_missing) {
+    r = resume_cf_migration(out);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  if (file_level_handler) {
+    std::vector<rocksdb::LiveFileMetaData> files;
+    db->GetLiveFilesMetaData(&files);
+    for (auto& f : files) {
+      file_level_handler(f.db_path + f.name, f.level);
+    }
+  }
   
   PerfCountersBuilder plb(g_ceph_context, "rocksdb", l_rocksdb_first, l_rocksdb_last);
   plb.add_u64_counter(l_rocksdb_gets, "get", "Gets");
@@ -709,6 +765,39 @@ void RocksDBStore::get_statistics(Formatter *f)
   }
 }
 
+int RocksDBStore::set_cache_capacity(uint64_t capacity)
+{
+  if (!bbt_opts.block_cache) {
+    return -EOPNOTSUPP;
+  }
+  // the row cache keeps its share; only the block cache is resized
+  uint64_t row_cache_size = capacity * g_conf->rocksdb_cache_row_ratio;
+  uint64_t block_cache_size = capacity - row_cache_size;
+  dout(10) << __func__ << " block_cache size " << prettybyte_t(block_cache_size)
+	   << dendl;
+  bbt_opts.block_cache->SetCapacity(block_cache_size);
+  cache_size = capacity;
+  return 0;
+}
+
+int64_t RocksDBStore::get_cache_usage() const
+{
+  if (!bbt_opts.block_cache) {
+    return -EOPNOTSUPP;
+  }
+  return bbt_opts.block_cache->GetUsage();
+}
+
+int RocksDBStore::get_cache_stats(uint64_t *hits, uint64_t *misses) const
+{
+  if (!dbstats) {
+    return -EOPNOTSUPP;
+  }
+  *hits = dbstats->getTickerCount(rocksdb::BLOCK_CACHE_HIT);
+  *misses = dbstats->getTickerCount(rocksdb::BLOCK_CACHE_MISS);
+  return 0;
+}
+
 int RocksDBStore::submit_common(rocksdb::WriteOptions& woptions, KeyValueDB::Transaction t) 
 {
   // enable rocksdb breakdown
@@ -1211,11 +1300,227 @@ bool RocksDBStore::check_omap_dir(string &omap_dir)
 void RocksDBStore::compact_range(const string& start, const string& end)
 {
   rocksdb::CompactRangeOptions options;
+  // ranges are expressed as combined prefix\0key strings; if the prefix
+  // lives in its own column family, compact the matching part of that.
+  string prefix, k;
+  if (!cf_handles.empty() &&
+      split_key(rocksdb::Slice(start), &prefix, &k) == 0) {
+    auto cf = get_cf_handle(prefix);
+    if (cf) {
+      string eprefix, ek;
+      rocksdb::Slice cstart(k);
+      if (split_key(rocksdb::Slice(end), &eprefix, &ek) == 0 &&
+	  eprefix == prefix) {
+	rocksdb::Slice cend(ek);
+	db->CompactRange(options, cf, &cstart, &cend);
+      } else {
+	// end is past the prefix
+	db->CompactRange(options, cf, &cstart, nullptr);
+      }
+      return;
+    }
+  }
   rocksdb::Slice cstart(start);
   rocksdb::Slice cend(end);
   db->CompactRange(options, &cstart, &cend);
 }
 
+/*
+ * Column family migration
+ *
+ * Moving a prefix from the default key space into its column family is
+ * not atomic: the column family exists (and takes every read of the
+ * prefix) before all keys are in it.  So the target set of column
+ * families is recorded in the default column family first, and removed
+ * only once the migration is complete; an open that finds it finishes
+ * the migration before anything can read.
+ */
+static const string CF_MIGRATION_PREFIX = "_CF_MIGRATION";
+static const string CF_MIGRATION_KEY = "target";
+
+int RocksDBStore::resume_cf_migration(ostream &out)
+{
+  string key = combine_strings(CF_MIGRATION_PREFIX, CF_MIGRATION_KEY);
+  string value;
+  rocksdb::Status s = db->Get(rocksdb::ReadOptions(), default_cf,
+			      rocksdb::Slice(key), &value);
+  if (s.IsNotFound()) {
+    return 0;
+  }
+  if (!s.ok()) {
+    derr << __func__ << " " << s.ToString() << dendl;
+    return -EIO;
+  }
+  map<string,string> target;
+  try {
+    bufferlist bl;
+    bl.append(value);
+    auto p = bl.begin();
+    ::decode(target, p);
+  } catch (buffer::error& e) {
+    derr << __func__ << " unable to decode column family migration target"
+	 << dendl;
+    return -EIO;
+  }
+  vector<ColumnFamily> cfs;
+  for (auto& i : target) {
+    cfs.push_back(ColumnFamily(i.first, i.second));
+  }
+  derr << __func__ << " resuming interrupted column family migration to "
+       << target << dendl;
+  int r = migrate_column_families(out, cfs);
+  if (r < 0) {
+    derr << __func__ << " failed: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  return 0;
+}
+
+int RocksDBStore::move_prefix_keys(
+  ostream &out,
+  const string& prefix,
+  rocksdb::ColumnFamilyHandle *from,
+  rocksdb::ColumnFamilyHandle *to)
+{
+  // keys in the default column family carry the prefix, keys in a
+  // per-prefix column family do not.
+  const uint64_t max_batch_keys = 65536;
+  const uint64_t max_batch_bytes = 64 << 20;
+  rocksdb::WriteOptions woptions;
+  woptions.sync = true;
+  std::unique_ptr<rocksdb::Iterator> it(
+    db->NewIterator(rocksdb::ReadOptions(), from));
+  string start = from == default_cf ? combine_strings(prefix, string()) : "";
+  rocksdb::WriteBatch bat;
+  uint64_t batch_keys = 0, batch_bytes = 0, moved = 0;
+  const uint64_t stop_after =
+    g_conf->get_val<uint64_t>("rocksdb_debug_cf_migration_stop_after");
+  for (it->Seek(start); it->Valid(); it->Next()) {
+    rocksdb::Slice key = it->key();
+    if (from == default_cf) {
+      if (!key.starts_with(start)) {
+	break;
+      }
+      rocksdb::Slice raw(key.data() + start.size(), key.size() - start.size());
+      bat.Put(to, raw, it->value());
+      bat.Delete(from, key);
+    } else {
+      string k;
+      combine_strings(prefix, key.data(), key.size(), &k);
+      bat.Put(to, rocksdb::Slice(k), it->value());
+    }
+    ++moved;
+    ++batch_keys;
+    batch_bytes += key.size() + it->value().size();
+    if (stop_after && ++migration_moved >= stop_after) {
+      // as if we crashed right after this batch
+      rocksdb::Status s = db->Write(woptions, &bat);
+      assert(s.ok());
+      out << "stopping column family migration after " << migration_moved
+	  << " keys (rocksdb_debug_cf_migration_stop_after)" << std::endl;
+      return -EINTR;
+    }
+    if (batch_keys >= max_batch_keys || batch_bytes >= max_batch_bytes) {
+      rocksdb::Status s = db->Write(woptions, &bat);
+      if (!s.ok()) {
+	out << "failed to move keys of prefix " << prefix << ": "
+	    << s.ToString() << std::endl;
+	return -EIO;
+      }
+      bat.Clear();
+      batch_keys = batch_bytes = 0;
+    }
+  }
+  if (!it->status().ok()) {
+    out << "failed to iterate prefix " << prefix << ": "
+	<< it->status().ToString() << std::endl;
+    return -EIO;
+  }
+  if (batch_keys) {
+    rocksdb::Status s = db->Write(woptions, &bat);
+    if (!s.ok()) {
+      out << "failed to move keys of prefix " << prefix << ": "
+	  << s.ToString() << std::endl;
+      return -EIO;
+    }
+  }
+  dout(1) << __func__ << " moved " << moved << " keys of prefix " << prefix
+	  << (from == default_cf ? " into its column family" :
+	      " into the default column family") << dendl;
+  return 0;
+}
+
+int RocksDBStore::migrate_column_families(
+  ostream &out,
+  const vector<ColumnFamily>& cfs)
+{
+  // record where we are going before changing anything; see
+  // resume_cf_migration()
+  string marker = combine_strings(CF_MIGRATION_PREFIX, CF_MIGRATION_KEY);
+  rocksdb::WriteOptions woptions;
+  woptions.sync = true;
+  {
+    map<string,string> target;
+    for (auto& p : cfs) {
+      target[p.name] = p.option;
+    }
+    bufferlist bl;
+    ::encode(target, bl);
+    rocksdb::Status s = db->Put(woptions, default_cf, rocksdb::Slice(marker),
+				rocksdb::Slice(bl.c_str(), bl.length()));
+    if (!s.ok()) {
+      out << "failed to record column family migration: " << s.ToString()
+	  << std::endl;
+      return -EIO;
+    }
+  }
+  migration_moved = 0;
+
+  rocksdb::ColumnFamilyOptions base(db->GetOptions(default_cf));
+  std::set<string> wanted;
+  for (auto& p : cfs) {
+    wanted.insert(p.name);
+    if (!get_cf_handle(p.name)) {
+      int r = create_cf(base, p);
+      if (r < 0) {
+	out << "failed to create column family " << p.name << std::endl;
+	return r;
+      }
+    }
+    int r = move_prefix_keys(out, p.name, default_cf, get_cf_handle(p.name));
+    if (r < 0) {
+      return r;
+    }
+  }
+  for (auto i = cf_handles.begin(); i != cf_handles.end(); ) {
+    if (wanted.count(i->first)) {
+      ++i;
+      continue;
+    }
+    auto cf = static_cast<rocksdb::ColumnFamilyHandle*>(i->second);
+    int r = move_prefix_keys(out, i->first, cf, default_cf);
+    if (r < 0) {
+      return r;
+    }
+    rocksdb::Status s = db->DropColumnFamily(cf);
+    if (!s.ok()) {
+      out << "failed to drop column family " << i->first << ": "
+	  << s.ToString() << std::endl;
+      return -EIO;
+    }
+    db->DestroyColumnFamilyHandle(cf);
+    i = cf_handles.erase(i);
+  }
+
+  rocksdb::Status s = db->Delete(woptions, default_cf, rocksdb::Slice(marker));
+  if (!s.ok()) {
+    out << "failed to complete column family migration: " << s.ToString()
+	<< std::endl;
+    return -EIO;
+  }
+  return 0;
+}
+
 RocksDBStore::RocksDBWholeSpaceIteratorImpl::~RocksDBWholeSpaceIteratorImpl()
 {
   delete dbiter;
@@ -1345,8 +1650,253 @@ string RocksDBStore::past_prefix(const string &prefix)
   return limit;
 }
 
+// Whole space iteration when some prefixes live in their own column
+// families: merge the default column family with one iterator per column
+// family, presenting every key as if it were stored as prefix\0key in
+// the default one.  Both orders agree, so a plain merge by combined key
+// works.
+class MergedWholeSpaceIteratorImpl : public KeyValueDB::WholeSpaceIteratorImpl {
+  struct source_t {
+    string prefix;   ///< column family name, or empty for the default one
+    rocksdb::Iterator *dbiter;
+  };
+  vector<source_t> sources;
+  int cur = -1;           ///< source holding the current key
+  bool forward = true;    ///< direction of the last positioning
+
+  string combined_key(const source_t& src) {
+    if (src.prefix.empty()) {
+      return src.dbiter->key().ToString();
+    }
+    string k;
+    rocksdb::Slice key = src.dbiter->key();
+    RocksDBStore::combine_strings(src.prefix, key.data(), key.size(), &k);
+    return k;
+  }
+
+  /// position src on the first key >= target
+  void seek(source_t& src, const string& target) {
+    if (src.prefix.empty()) {
+      src.dbiter->Seek(rocksdb::Slice(target));
+      return;
+    }
+    string start = RocksDBStore::combine_strings(src.prefix, string());
+    if (target.compare(0, start.size(), start) == 0) {
+      src.dbiter->Seek(rocksdb::Slice(target.data() + start.size(),
+				      target.size() - start.size()));
+    } else if (target < start) {
+      src.dbiter->SeekToFirst();
+    } else {
+      // past all of this column family
+      src.dbiter->SeekToLast();
+      if (src.dbiter->Valid()) {
+	src.dbiter->Next();
+      }
+    }
+  }
+
+  /// position src on the last key < target
+  void seek_before(source_t& src, const string& target) {
+    seek(src, target);
+    if (src.dbiter->Valid()) {
+      src.dbiter->Prev();
+    } else {
+      src.dbiter->SeekToLast();
+      if (src.dbiter->Valid() && combined_key(src) >= target) {
+	// everything in this source is >= target
+	src.dbiter->Prev();
+      }
+    }
+  }
+
+  void pick() {
+    cur = -1;
+    string best;
+    for (unsigned i = 0; i < sources.size(); ++i) {
+      if (!sources[i].dbiter->Valid()) {
+	continue;
+      }
+      string k = combined_key(sources[i]);
+      if (cur < 0 || (forward ? k < best : k > best)) {
+	cur = i;
+	best.swap(k);
+      }
+    }
+  }
+
+  int check_status() {
+    for (auto& src : sources) {
+      assert(!src.dbiter->status().IsIOError());
+      if (!src.dbiter->status().ok()) {
+	return -1;
+      }
+    }
+    return 0;
+  }
+
+public:
+  MergedWholeSpaceIteratorImpl(
+    rocksdb::DB *db,
+    rocksdb::ColumnFamilyHandle *default_cf,
+    const std::unordered_map<string, void*>& cf_handles) {
+    sources.push_back(source_t{
+	string(), db->NewIterator(rocksdb::ReadOptions(), default_cf)});
+    for (auto& p : cf_handles) {
+      sources.push_back(source_t{
+	  p.first,
+	  db->NewIterator(rocksdb::ReadOptions(),
+			  static_cast<rocksdb::ColumnFamilyHandle*>(p.second))});
+    }
+  }
+  ~MergedWholeSpaceIteratorImpl() override {
+    for (auto& src : sources) {
+      delete src.dbiter;
+    }
+  }
+
+  int seek_to_first() override {
+    for (auto& src : sources) {
+      src.dbiter->SeekToFirst();
+    }
+    forward = true;
+    pick();
+    return check_status();
+  }
+  int seek_to_first(const string &prefix) override {
+    for (auto& src : sources) {
+      seek(src, prefix);
+    }
+    forward = true;
+    pick();
+    return check_status();
+  }
+  int seek_to_last() override {
+    for (auto& src : sources) {
+      src.dbiter->SeekToLast();
+    }
+    forward = false;
+    pick();
+    return check_status();
+  }
+  int seek_to_last(const string &prefix) override {
+    string limit = RocksDBStore::past_prefix(prefix);
+    for (auto& src : sources) {
+      seek_before(src, limit);
+    }
+    forward = false;
+    pick();
+    return check_status();
+  }
+  int upper_bound(const string &prefix, const string &after) override {
+    lower_bound(prefix, after);
+    if (valid()) {
+      pair<string,string> key = raw_key();
+      if (key.first == prefix && key.second == after)
+	next();
+    }
+    return check_status();
+  }
+  int lower_bound(const string &prefix, const string &to) override {
+    string bound = RocksDBStore::combine_strings(prefix, to);
+    for (auto& src : sources) {
+      seek(src, bound);
+    }
+    forward = true;
+    pick();
+    return check_status();
+  }
+  bool valid() override {
+    return cur >= 0;
+  }
+  int next() override {
+    if (!valid()) {
+      return check_status();
+    }
+    if (!forward) {
+      // bring the other sources to the first key after the current one
+      string k = combined_key(sources[cur]);
+      for (unsigned i = 0; i < sources.size(); ++i) {
+	if ((int)i == cur) {
+	  continue;
+	}
+	seek(sources[i], k);
+	if (sources[i].dbiter->Valid() && combined_key(sources[i]) == k) {
+	  sources[i].dbiter->Next();
+	}
+      }
+      forward = true;
+    }
+    sources[cur].dbiter->Next();
+    pick();
+    return check_status();
+  }
+  int prev() override {
+    if (!valid()) {
+      return check_status();
+    }
+    if (forward) {
+      // bring the other sources to the last key before the current one
+      string k = combined_key(sources[cur]);
+      for (unsigned i = 0; i < sources.size(); ++i) {
+	if ((int)i != cur) {
+	  seek_before(sources[i], k);
+	}
+      }
+      forward = false;
+    }
+    sources[cur].dbiter->Prev();
+    pick();
+    return check_status();
+  }
+  string key() override {
+    return raw_key().second;
+  }
+  pair<string,string> raw_key() override {
+    auto& src = sources[cur];
+    if (src.prefix.empty()) {
+      string prefix, key;
+      RocksDBStore::split_key(src.dbiter->key(), &prefix, &key);
+      return make_pair(prefix, key);
+    }
+    return make_pair(src.prefix, src.dbiter->key().ToString());
+  }
+  bool raw_key_is_prefixed(const string &prefix) override {
+    auto& src = sources[cur];
+    if (!src.prefix.empty()) {
+      return src.prefix == prefix;
+    }
+    rocksdb::Slice key = src.dbiter->key();
+    if ((key.size() > prefix.length()) && (key[prefix.length()] == '\0')) {
+      return memcmp(key.data(), prefix.c_str(), prefix.length()) == 0;
+    }
+    return false;
+  }
+  bufferlist value() override {
+    return to_bufferlist(sources[cur].dbiter->value());
+  }
+  bufferptr value_as_ptr() override {
+    rocksdb::Slice val = sources[cur].dbiter->value();
+    return bufferptr(val.data(), val.size());
+  }
+  int status() override {
+    return check_status();
+  }
+  size_t key_size() override {
+    auto& src = sources[cur];
+    size_t extra = src.prefix.empty() ? 0 : src.prefix.size() + 1;
+    return src.dbiter->key().size() + extra;
+  }
+  size_t value_size() override {
+    return sources[cur].dbiter->value().size();
+  }
+};
+
 RocksDBStore::WholeSpaceIterator RocksDBStore::get_wholespace_iterator()
 {
+  if (!cf_handles.empty()) {
+    return std::make_shared<MergedWholeSpaceIteratorImpl>(
+      db, default_cf, cf_handles);
+  }
   return std::make_shared<RocksDBWholeSpaceIteratorImpl>(
     db->NewIterator(rocksdb::ReadOptions(), default_cf));
 }
@@ -1425,6 +1975,11 @@ KeyValueDB::Iterator RocksDBStore::get_iterator(const std::string& prefix)
       prefix,
       db->NewIterator(rocksdb::ReadOptions(), cf_handle));
   } else {
-    return KeyValueDB::get_iterator(prefix);
+    // the prefix is in the default column family; no need to merge in
+    // the others
+    return std::make_shared<PrefixIteratorImpl>(
+      prefix,
+      std::make_shared<RocksDBWholeSpaceIteratorImpl>(
+	db->NewIterator(rocksdb::ReadOptions(), default_cf)));
   }
 }
@@ -80,12 +80,21 @@ class RocksDBStore : public KeyValueDB {
 
   uint64_t cache_size = 0;
   bool set_cache_flag = false;
+  bool cache_stats = false;
+  FileLevelHandler file_level_handler;
 
   bool must_close_default_cf = false;
   rocksdb::ColumnFamilyHandle *default_cf = nullptr;
 
   int submit_common(rocksdb::WriteOptions& woptions, KeyValueDB::Transaction t);
   int install_cf_mergeop(const string &cf_name, rocksdb::ColumnFamilyOptions *cf_opt);
+  int create_cf(const rocksdb::ColumnFamilyOptions& base,
+		const ColumnFamily& p);
+  int move_prefix_keys(ostream &out, const string& prefix,
+		       rocksdb::ColumnFamilyHandle *from,
+		       rocksdb::ColumnFamilyHandle *to);
+  int resume_cf_migration(ostream &out);
+  uint64_t migration_moved = 0;  ///< keys moved by the current migration
   int create_db_dir();
   int do_open(ostream &out, bool create_if_missing,
 	      const vector<ColumnFamily>* cfs = nullptr);
@@ -125,10 +134,11 @@ public:
   int init(string options_str) override;
   /// compact rocksdb for all keys with a given prefix
   void compact_prefix(const string& prefix) override {
-    compact_range(prefix, past_prefix(prefix));
+    compact_range(combine_strings(prefix, string()), past_prefix(prefix));
   }
   void compact_prefix_async(const string& prefix) override {
-    compact_range_async(prefix, past_prefix(prefix));
+    compact_range_async(combine_strings(prefix, string()),
+			past_prefix(prefix));
   }
 
   void compact_range(const string& prefix, const string& start, const string& end) override {
@@ -175,6 +185,8 @@ public:
       return static_cast<rocksdb::ColumnFamilyHandle*>(iter->second);
   }
   int repair(std::ostream &out) override;
+  int migrate_column_families(ostream &out,
+			      const vector<ColumnFamily>& cfs) override;
   void split_stats(const std::string &s, char delim, std::vector<std::string> &elems);
   void get_statistics(Formatter *f) override;
 
@@ -473,6 +485,20 @@ err:
     return 0;
   }
 
+  int enable_cache_stats() override {
+    cache_stats = true;
+    return 0;
+  }
+
+  int set_file_level_handler(FileLevelHandler h) override {
+    file_level_handler = h;
+    return 0;
+  }
+
+  int set_cache_capacity(uint64_t capacity) override;
+  int64_t get_cache_usage() const override;
+  int get_cache_stats(uint64_t *hits, uint64_t *misses) const override;
+
   WholeSpaceIterator get_wholespace_iterator() override;
 };
 
@@ -176,7 +176,13 @@ unsigned ObjectStore::apply_transactions(Sequencer *osr,
   bool done;
   C_SafeCond *onreadable = new C_SafeCond(&my_lock, &my_cond, &done, &r);
 
-  queue_transactions(osr, tls, onreadable, ondisk);
+  if (osr && osr->commit_queue) {
+    // the commit queue may be serviced by this very thread; wake up from
+    // the store's context instead
+    queue_transactions(osr, tls, nullptr, ondisk, onreadable);
+  } else {
+    queue_transactions(osr, tls, onreadable, ondisk);
+  }
 
   my_lock.Lock();
   while (!done)
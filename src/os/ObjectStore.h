@@ -163,6 +163,20 @@ public:
   };
   typedef boost::intrusive_ptr<Sequencer_impl> Sequencer_implRef;
 
+  /**
+   * Optional destination for a Sequencer's onreadable/oncommit callbacks.
+   *
+   * If set, stores that support it hand the onreadable, oncommit and
+   * flush_commit callbacks of the Sequencer to this queue, in order,
+   * instead of completing them on their own finisher threads, so that the
+   * owner (e.g. the OSD op shard that submitted the transaction) can run
+   * them itself.  The owner must not block waiting for them.
+   */
+  struct CommitQueue {
+    virtual void queue(Context *c) = 0;
+    virtual ~CommitQueue() {}
+  };
+
   /**
    * External (opaque) sequencer implementation
    */
@@ -170,6 +184,7 @@ public:
     string name;
     spg_t shard_hint;
     Sequencer_implRef p;
+    CommitQueue *commit_queue = nullptr;
 
     explicit Sequencer(string n)
       : name(n), shard_hint(spg_t()), p(NULL) {
@@ -1528,6 +1543,7 @@ public:
   }
 
   virtual void get_db_statistics(Formatter *f) { }
+  virtual void dump_slow_transactions(Formatter *f) { }
   virtual void generate_db_histogram(Formatter *f) { }
   virtual void flush_cache() { }
   virtual void dump_perf_counters(Formatter *f) {}
@@ -13,6 +13,7 @@
 #define CEPH_OS_BLUESTORE_ALLOCATOR_H
 
 #include <ostream>
+#include <functional>
 #include "include/assert.h"
 #include "os/bluestore/bluestore_types.h"
 
@@ -47,6 +48,10 @@ public:
 
   virtual void dump() = 0;
 
+  /* Enumerate every free extent, in bytes.  Adjacent extents may be
+   * reported separately and the order is implementation defined. */
+  virtual void dump(std::function<void(uint64_t offset, uint64_t length)> notify) = 0;
+
   virtual void init_add_free(uint64_t offset, uint64_t length) = 0;
   virtual void init_rm_free(uint64_t offset, uint64_t length) = 0;
 
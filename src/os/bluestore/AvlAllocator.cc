@@ -0,0 +1,361 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "AvlAllocator.h"
+#include "bluestore_types.h"
+#include "common/debug.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef dout_prefix
+#define dout_prefix *_dout << "avlalloc "
+
+MEMPOOL_DEFINE_OBJECT_FACTORY(range_seg_t, range_seg_t, bluestore_alloc);
+
+AvlAllocator::AvlAllocator(CephContext* cct)
+  : cct(cct), num_free(0),
+    num_reserved(0),
+    last_alloc(0)
+{
+}
+
+AvlAllocator::~AvlAllocator()
+{
+  _shutdown();
+}
+
+void AvlAllocator::_add_to_tree(uint64_t start, uint64_t size)
+{
+  assert(size != 0);
+  uint64_t end = start + size;
+
+  auto rs_after = range_tree.upper_bound(start, range_seg_t::by_offset_t());
+  auto rs_before = range_tree.end();
+  if (rs_after != range_tree.begin()) {
+    rs_before = std::prev(rs_after);
+  }
+  // make sure we don't overlap with either of our neighbors
+  assert(rs_before == range_tree.end() || rs_before->end <= start);
+  assert(rs_after == range_tree.end() || rs_after->start >= end);
+
+  bool merge_before = (rs_before != range_tree.end() && rs_before->end == start);
+  bool merge_after = (rs_after != range_tree.end() && rs_after->start == end);
+
+  if (merge_before && merge_after) {
+    range_size_tree.erase(*rs_before);
+    range_size_tree.erase(*rs_after);
+    rs_before->end = rs_after->end;
+    range_tree.erase_and_dispose(rs_after, [](range_seg_t *p) { delete p; });
+    range_size_tree.insert(*rs_before);
+  } else if (merge_before) {
+    range_size_tree.erase(*rs_before);
+    rs_before->end = end;
+    range_size_tree.insert(*rs_before);
+  } else if (merge_after) {
+    // moving start within the gap keeps the offset order intact
+    range_size_tree.erase(*rs_after);
+    rs_after->start = start;
+    range_size_tree.insert(*rs_after);
+  } else {
+    auto rs = new range_seg_t(start, end);
+    range_tree.insert_before(rs_after, *rs);
+    range_size_tree.insert(*rs);
+  }
+}
+
+void AvlAllocator::_remove_from_tree(uint64_t start, uint64_t size)
+{
+  uint64_t end = start + size;
+
+  auto rs = range_tree.upper_bound(start, range_seg_t::by_offset_t());
+  assert(rs != range_tree.begin());
+  --rs;
+  // the extent must be fully contained in a single free segment
+  assert(rs->start <= start);
+  assert(rs->end >= end);
+
+  bool left_over = (rs->start != start);
+  bool right_over = (rs->end != end);
+
+  range_size_tree.erase(*rs);
+
+  if (left_over && right_over) {
+    auto new_seg = new range_seg_t(end, rs->end);
+    rs->end = start;
+    range_tree.insert_before(std::next(rs), *new_seg);
+    range_size_tree.insert(*new_seg);
+    range_size_tree.insert(*rs);
+  } else if (left_over) {
+    rs->end = start;
+    range_size_tree.insert(*rs);
+  } else if (right_over) {
+    rs->start = end;
+    range_size_tree.insert(*rs);
+  } else {
+    range_tree.erase_and_dispose(rs, [](range_seg_t *p) { delete p; });
+  }
+}
+
+/// first offset >= from within rs that is a multiple of alloc_unit
+uint64_t AvlAllocator::_aligned_start(const range_seg_t& rs, uint64_t from,
+				      uint64_t alloc_unit) const
+{
+  uint64_t off = MAX(rs.start, from);
+  return P2ROUNDUP(off, alloc_unit);
+}
+
+/*
+ * Try to continue where the caller (or the last allocation) left off:
+ * the segment containing the hint, then the one after it.
+ */
+const range_seg_t *AvlAllocator::_pick_hint(uint64_t size, uint64_t alloc_unit,
+					    uint64_t hint, uint64_t *offset)
+{
+  auto rs = range_tree.upper_bound(hint, range_seg_t::by_offset_t());
+  if (rs != range_tree.begin()) {
+    auto prev = std::prev(rs);
+    if (prev->end > hint) {
+      rs = prev;
+    }
+  }
+  for (unsigned n = 0; n < 2 && rs != range_tree.end(); ++n, ++rs) {
+    uint64_t off = _aligned_start(*rs, hint, alloc_unit);
+    if (off + size <= rs->end) {
+      *offset = off;
+      return &*rs;
+    }
+  }
+  return nullptr;
+}
+
+/*
+ * Smallest segment that can hold size bytes at an alloc_unit aligned
+ * offset.  Only misaligned segments can fail the fit check, so after a
+ * few candidates jump straight to lengths that always fit.
+ */
+const range_seg_t *AvlAllocator::_pick_best_fit(uint64_t size,
+						uint64_t alloc_unit,
+						uint64_t *offset)
+{
+  auto rs = range_size_tree.lower_bound(size, range_seg_t::by_length_t());
+  for (unsigned n = 0; n < max_fit_search && rs != range_size_tree.end();
+       ++n, ++rs) {
+    uint64_t off = _aligned_start(*rs, 0, alloc_unit);
+    if (off + size <= rs->end) {
+      *offset = off;
+      return &*rs;
+    }
+  }
+  if (rs == range_size_tree.end()) {
+    return nullptr;
+  }
+  rs = range_size_tree.lower_bound(size + alloc_unit - 1,
+				   range_seg_t::by_length_t());
+  if (rs == range_size_tree.end()) {
+    return nullptr;
+  }
+  *offset = _aligned_start(*rs, 0, alloc_unit);
+  assert(*offset + size <= rs->end);
+  return &*rs;
+}
+
+int AvlAllocator::_allocate(
+  uint64_t want_size, uint64_t alloc_unit, uint64_t hint,
+  uint64_t *offset, uint64_t *length)
+{
+  ldout(cct, 10) << __func__ << " want_size 0x" << std::hex << want_size
+		 << " alloc_unit 0x" << alloc_unit
+		 << " hint 0x" << hint << std::dec
+		 << dendl;
+  uint64_t want = MAX(alloc_unit, want_size);
+
+  if (!hint)
+    hint = last_alloc;
+
+  const range_seg_t *rs = nullptr;
+  if (hint) {
+    rs = _pick_hint(want, alloc_unit, hint, offset);
+  }
+  if (!rs) {
+    rs = _pick_best_fit(want, alloc_unit, offset);
+  }
+  if (rs) {
+    *length = want;
+  } else {
+    // nothing big enough; take what we can from the largest segment
+    if (range_size_tree.empty()) {
+      return -ENOSPC;
+    }
+    auto& largest = *range_size_tree.rbegin();
+    *offset = _aligned_start(largest, 0, alloc_unit);
+    if (*offset >= largest.end ||
+	largest.end - *offset < alloc_unit) {
+      return -ENOSPC;
+    }
+    *length = MIN(want, P2ALIGN(largest.end - *offset, alloc_unit));
+  }
+
+  if (cct->_conf->bluestore_debug_small_allocations) {
+    uint64_t max =
+      alloc_unit * (rand() % cct->_conf->bluestore_debug_small_allocations);
+    if (max && *length > max) {
+      ldout(cct, 10) << __func__ << " shortening allocation of 0x" << std::hex
+		     << *length << " -> 0x"
+		     << max << " due to debug_small_allocations" << std::dec
+		     << dendl;
+      *length = max;
+    }
+  }
+  ldout(cct, 30) << __func__ << " got 0x" << std::hex << *offset << "~"
+		 << *length << std::dec << dendl;
+
+  _remove_from_tree(*offset, *length);
+  num_free -= *length;
+  num_reserved -= *length;
+  assert(num_free >= 0);
+  assert(num_reserved >= 0);
+  last_alloc = *offset + *length;
+  return 0;
+}
+
+int AvlAllocator::reserve(uint64_t need)
+{
+  std::lock_guard<std::mutex> l(lock);
+  ldout(cct, 10) << __func__ << " need 0x" << std::hex << need
+		 << " num_free 0x" << num_free
+		 << " num_reserved 0x" << num_reserved << std::dec << dendl;
+  if ((int64_t)need > num_free - num_reserved)
+    return -ENOSPC;
+  num_reserved += need;
+  return 0;
+}
+
+void AvlAllocator::unreserve(uint64_t unused)
+{
+  std::lock_guard<std::mutex> l(lock);
+  ldout(cct, 10) << __func__ << " unused 0x" << std::hex << unused
+		 << " num_free 0x" << num_free
+		 << " num_reserved 0x" << num_reserved << std::dec << dendl;
+  assert(num_reserved >= (int64_t)unused);
+  num_reserved -= unused;
+}
+
+int64_t AvlAllocator::allocate(
+  uint64_t want_size,
+  uint64_t alloc_unit,
+  uint64_t max_alloc_size,
+  int64_t hint,
+  mempool::bluestore_alloc::vector<AllocExtent> *extents)
+{
+  uint64_t allocated_size = 0;
+  uint64_t offset = 0;
+  uint64_t length = 0;
+
+  if (max_alloc_size == 0) {
+    max_alloc_size = want_size;
+  }
+  // AllocExtent lengths are 32 bits
+  max_alloc_size = MIN(max_alloc_size,
+		       P2ALIGN((uint64_t)std::numeric_limits<uint32_t>::max(),
+			       alloc_unit));
+
+  ExtentList block_list = ExtentList(extents, 1, max_alloc_size);
+
+  std::lock_guard<std::mutex> l(lock);
+  while (allocated_size < want_size) {
+    int res = _allocate(MIN(max_alloc_size, (want_size - allocated_size)),
+			alloc_unit, hint, &offset, &length);
+    if (res != 0) {
+      break;
+    }
+    block_list.add_extents(offset, length);
+    allocated_size += length;
+    hint = offset + length;
+  }
+
+  if (allocated_size == 0) {
+    return -ENOSPC;
+  }
+  return allocated_size;
+}
+
+void AvlAllocator::release(
+  const interval_set<uint64_t>& release_set)
+{
+  std::lock_guard<std::mutex> l(lock);
+  for (interval_set<uint64_t>::const_iterator p = release_set.begin();
+       p != release_set.end();
+       ++p) {
+    const auto offset = p.get_start();
+    const auto length = p.get_len();
+    ldout(cct, 10) << __func__ << " 0x" << std::hex << offset << "~" << length
+		   << std::dec << dendl;
+    _add_to_tree(offset, length);
+    num_free += length;
+  }
+}
+
+uint64_t AvlAllocator::get_free()
+{
+  std::lock_guard<std::mutex> l(lock);
+  return num_free;
+}
+
+void AvlAllocator::dump()
+{
+  std::lock_guard<std::mutex> l(lock);
+  ldout(cct, 0) << __func__ << " range_tree: " << range_tree.size()
+		<< " extents" << dendl;
+  for (auto& rs : range_tree) {
+    ldout(cct, 0) << __func__ << "  0x" << std::hex << rs.start << "~"
+		  << rs.length() << std::dec << dendl;
+  }
+  ldout(cct, 0) << __func__ << " range_size_tree: " << dendl;
+  for (auto& rs : range_size_tree) {
+    ldout(cct, 0) << __func__ << "  0x" << std::hex << rs.start << "~"
+		  << rs.length() << std::dec << dendl;
+  }
+}
+
+void AvlAllocator::dump(std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  std::lock_guard<std::mutex> l(lock);
+  for (auto& rs : range_tree) {
+    notify(rs.start, rs.length());
+  }
+}
+
+void AvlAllocator::init_add_free(uint64_t offset, uint64_t length)
+{
+  std::lock_guard<std::mutex> l(lock);
+  ldout(cct, 10) << __func__ << " 0x" << std::hex << offset << "~" << length
+		 << std::dec << dendl;
+  if (!length)
+    return;
+  _add_to_tree(offset, length);
+  num_free += length;
+}
+
+void AvlAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  std::lock_guard<std::mutex> l(lock);
+  ldout(cct, 10) << __func__ << " 0x" << std::hex << offset << "~" << length
+		 << std::dec << dendl;
+  if (!length)
+    return;
+  _remove_from_tree(offset, length);
+  num_free -= length;
+  assert(num_free >= 0);
+}
+
+void AvlAllocator::_shutdown()
+{
+  range_size_tree.clear();
+  range_tree.clear_and_dispose([](range_seg_t *p) { delete p; });
+}
+
+void AvlAllocator::shutdown()
+{
+  std::lock_guard<std::mutex> l(lock);
+  _shutdown();
+}
@@ -0,0 +1,135 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_OS_BLUESTORE_AVLALLOCATOR_H
+#define CEPH_OS_BLUESTORE_AVLALLOCATOR_H
+
+#include <mutex>
+#include <boost/intrusive/avl_set.hpp>
+
+#include "Allocator.h"
+#include "os/bluestore/bluestore_types.h"
+#include "include/mempool.h"
+
+/*
+ * A free extent, linked into two trees at once: one ordered by offset
+ * (for neighbour lookup/merging and hinted allocation) and one ordered
+ * by length (for best-fit allocation).
+ */
+struct range_seg_t {
+  MEMPOOL_CLASS_HELPERS();  ///< memory monitoring
+  uint64_t start;   ///< first byte of the extent
+  uint64_t end;     ///< one past the last byte
+
+  range_seg_t(uint64_t start, uint64_t end)
+    : start{start},
+      end{end}
+  {}
+  uint64_t length() const {
+    return end - start;
+  }
+
+  /// order by offset
+  struct by_offset_t {
+    bool operator()(const range_seg_t& lhs, const range_seg_t& rhs) const {
+      return lhs.start < rhs.start;
+    }
+    bool operator()(const range_seg_t& lhs, uint64_t rhs) const {
+      return lhs.start < rhs;
+    }
+    bool operator()(uint64_t lhs, const range_seg_t& rhs) const {
+      return lhs < rhs.start;
+    }
+  };
+  boost::intrusive::avl_set_member_hook<> offset_hook;
+
+  /// order by length, then offset
+  struct by_length_t {
+    bool operator()(const range_seg_t& lhs, const range_seg_t& rhs) const {
+      if (lhs.length() != rhs.length()) {
+	return lhs.length() < rhs.length();
+      }
+      return lhs.start < rhs.start;
+    }
+    bool operator()(const range_seg_t& lhs, uint64_t rhs) const {
+      return lhs.length() < rhs;
+    }
+    bool operator()(uint64_t lhs, const range_seg_t& rhs) const {
+      return lhs < rhs.length();
+    }
+  };
+  boost::intrusive::avl_set_member_hook<> size_hook;
+};
+
+class AvlAllocator : public Allocator {
+  typedef boost::intrusive::member_hook<
+    range_seg_t,
+    boost::intrusive::avl_set_member_hook<>,
+    &range_seg_t::offset_hook> offset_hook_t;
+  typedef boost::intrusive::avl_set<
+    range_seg_t,
+    boost::intrusive::compare<range_seg_t::by_offset_t>,
+    offset_hook_t> range_tree_t;
+
+  typedef boost::intrusive::member_hook<
+    range_seg_t,
+    boost::intrusive::avl_set_member_hook<>,
+    &range_seg_t::size_hook> size_hook_t;
+  typedef boost::intrusive::avl_set<
+    range_seg_t,
+    boost::intrusive::compare<range_seg_t::by_length_t>,
+    size_hook_t> range_size_tree_t;
+
+  /// best-fit candidates to try before falling back to a length that
+  /// is guaranteed to fit regardless of alignment
+  static const unsigned max_fit_search = 16;
+
+  CephContext* cct;
+  std::mutex lock;
+
+  range_tree_t range_tree;            ///< free extents by offset
+  range_size_tree_t range_size_tree;  ///< free extents by length
+
+  int64_t num_free;      ///< total bytes in freelist
+  int64_t num_reserved;  ///< reserved bytes
+
+  uint64_t last_alloc;
+
+  void _add_to_tree(uint64_t start, uint64_t size);
+  void _remove_from_tree(uint64_t start, uint64_t size);
+  uint64_t _aligned_start(const range_seg_t& rs, uint64_t from,
+			  uint64_t alloc_unit) const;
+  const range_seg_t *_pick_hint(uint64_t size, uint64_t alloc_unit,
+				uint64_t hint, uint64_t *offset);
+  const range_seg_t *_pick_best_fit(uint64_t size, uint64_t alloc_unit,
+				    uint64_t *offset);
+  int _allocate(uint64_t want_size, uint64_t alloc_unit, uint64_t hint,
+		uint64_t *offset, uint64_t *length);
+  void _shutdown();
+
+public:
+  AvlAllocator(CephContext* cct);
+  ~AvlAllocator() override;
+
+  int reserve(uint64_t need) override;
+  void unreserve(uint64_t unused) override;
+
+  int64_t allocate(
+    uint64_t want_size, uint64_t alloc_unit, uint64_t max_alloc_size,
+    int64_t hint, mempool::bluestore_alloc::vector<AllocExtent> *extents) override;
+
+  void release(
+    const interval_set<uint64_t>& release_set) override;
+
+  uint64_t get_free() override;
+
+  void dump() override;
+  void dump(std::function<void(uint64_t offset, uint64_t length)> notify) override;
+
+  void init_add_free(uint64_t offset, uint64_t length) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+
+  void shutdown() override;
+};
+
+#endif
@@ -536,6 +536,39 @@ void BitMapZone::dump_state(CephContext* const cct, int& count)
   count++;
 }
 
+/*
+ * Report free runs in block units; *pos is the zone's first block and
+ * is advanced past the zone on return.
+ */
+void BitMapZone::foreach_free(int64_t *pos,
+  const std::function<void(int64_t, int64_t)>& notify)
+{
+  int64_t bit_base = *pos;
+  for (auto& bmap : m_bmap_vec) {
+    bmap_t bits = bmap.atomic_fetch();
+    if (bits == BmapEntry::full_bmask()) {
+      // fully allocated
+    } else if (bits == BmapEntry::empty_bmask()) {
+      notify(bit_base, BmapEntry::size());
+    } else {
+      int bit = 0;
+      while (bit < BmapEntry::size()) {
+        if (bits & BmapEntry::bit_mask(bit)) {
+          bit++;
+          continue;
+        }
+        int start = bit;
+        while (bit < BmapEntry::size() && !(bits & BmapEntry::bit_mask(bit))) {
+          bit++;
+        }
+        notify(bit_base + start, bit - start);
+      }
+    }
+    bit_base += BmapEntry::size();
+  }
+  *pos += size();
+}
+
 
 /*
  * BitMapArea Leaf and non-Leaf functions.
@@ -925,6 +958,19 @@ void BitMapAreaIN::dump_state(CephContext* const cct, int& count)
   }
 }
 
+void BitMapAreaIN::foreach_free(int64_t *pos,
+  const std::function<void(int64_t, int64_t)>& notify)
+{
+  BitMapArea *child = NULL;
+
+  BmapEntityListIter iter = BmapEntityListIter(
+        &m_child_list, 0, false);
+
+  while ((child = static_cast<BitMapArea *>(iter.next()))) {
+    child->foreach_free(pos, notify);
+  }
+}
+
 /*
  * BitMapArea Leaf
  */
@@ -1418,3 +1464,20 @@ void BitAllocator::dump()
   dump_state(cct, count);
   serial_unlock(); 
 }
+
+void BitAllocator::foreach_free(
+  const std::function<void(int64_t, int64_t)>& notify)
+{
+  int64_t pos = 0;
+  int64_t limit = total_blocks();
+  serial_lock();
+  BitMapAreaIN::foreach_free(&pos,
+    [&](int64_t start, int64_t len) {
+      // padded tail blocks are marked used, but clip defensively
+      if (start >= limit) {
+        return;
+      }
+      notify(start, std::min(len, limit - start));
+    });
+  serial_unlock();
+}
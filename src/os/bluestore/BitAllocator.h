@@ -14,6 +14,7 @@
 #include <pthread.h>
 #include <mutex>
 #include <atomic>
+#include <functional>
 #include <vector>
 #include "include/intarith.h"
 #include "os/bluestore/bluestore_types.h"
@@ -246,6 +247,8 @@ public:
   int64_t get_index();
   int64_t get_level();
   virtual void dump_state(CephContext* cct, int& count) = 0;
+  virtual void foreach_free(int64_t *pos,
+    const std::function<void(int64_t, int64_t)>& notify) = 0;
   BitMapArea(CephContext*) { }
   virtual ~BitMapArea() { }
 };
@@ -380,6 +383,8 @@ public:
 
   void free_blocks(int64_t start_block, int64_t num_blocks) override;
   void dump_state(CephContext* cct, int& count) override;
+  void foreach_free(int64_t *pos,
+    const std::function<void(int64_t, int64_t)>& notify) override;
 };
 
 class BitMapAreaIN: public BitMapArea{
@@ -457,6 +462,8 @@ public:
   virtual void free_blocks_int(int64_t start_block, int64_t num_blocks);
   void free_blocks(int64_t start_block, int64_t num_blocks) override;
   void dump_state(CephContext* cct, int& count) override;
+  void foreach_free(int64_t *pos,
+    const std::function<void(int64_t, int64_t)>& notify) override;
 };
 
 class BitMapAreaLeaf: public BitMapAreaIN{
@@ -564,6 +571,7 @@ public:
       return m_stats;
   }
   void dump();
+  void foreach_free(const std::function<void(int64_t, int64_t)>& notify);
 };
 
 #endif //End of file
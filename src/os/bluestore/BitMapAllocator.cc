@@ -174,6 +174,28 @@ void BitMapAllocator::dump()
   m_bit_alloc->dump();
 }
 
+void BitMapAllocator::dump(std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  // coalesce runs that span bitmap words/zones before reporting them
+  int64_t run_start = -1;
+  int64_t run_len = 0;
+  m_bit_alloc->foreach_free(
+    [&](int64_t start_block, int64_t num_blocks) {
+      if (run_start >= 0 && run_start + run_len == start_block) {
+	run_len += num_blocks;
+	return;
+      }
+      if (run_start >= 0) {
+	notify(run_start * m_block_size, run_len * m_block_size);
+      }
+      run_start = start_block;
+      run_len = num_blocks;
+    });
+  if (run_start >= 0) {
+    notify(run_start * m_block_size, run_len * m_block_size);
+  }
+}
+
 void BitMapAllocator::init_add_free(uint64_t offset, uint64_t length)
 {
   dout(10) << __func__ << " instance " << (uint64_t) this
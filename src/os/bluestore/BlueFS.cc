@@ -1,6 +1,8 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include <thread>
+
 #include "boost/algorithm/string.hpp" 
 #include "BlueFS.h"
 
@@ -27,6 +29,7 @@ MEMPOOL_DEFINE_OBJECT_FACTORY(BlueFS::FileLock, bluefs_file_lock, bluefs);
 
 BlueFS::BlueFS(CephContext* cct)
   : cct(cct),
+    migrate_thread(this),
     bdev(MAX_BDEV),
     ioc(MAX_BDEV),
     block_all(MAX_BDEV)
@@ -95,6 +98,33 @@ void BlueFS::_init_logger()
   b.add_u64_counter(l_bluefs_bytes_written_sst, "bytes_written_sst",
 		    "Bytes written to SSTs", "sst",
 		    PerfCountersBuilder::PRIO_CRITICAL);
+  b.add_time_avg(l_bluefs_log_flush_lat, "log_flush_lat",
+		 "Average latency of metadata log flushes");
+
+  // log flush latency axis, in nanoseconds
+  PerfHistogramCommon::axis_config_d lat_x_axis_config{
+    "Latency (usec)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    10000,     ///< quantization unit is 10usec
+    24,        ///< up to ~80s
+  };
+  // log flush size axis, in bytes
+  PerfHistogramCommon::axis_config_d size_y_axis_config{
+    "Request size (bytes)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    4096,      ///< quantization unit is one block
+    16,
+  };
+  b.add_u64_counter_histogram(
+    l_bluefs_log_flush_lat_hist, "log_flush_lat_histogram",
+    lat_x_axis_config, size_y_axis_config,
+    "Histogram of metadata log flush latency + bytes logged");
+  b.add_time_avg(l_bluefs_log_compaction_lat, "log_compaction_lat",
+		 "Average duration of metadata log compactions");
+  b.add_u64_counter(l_bluefs_migrated_bytes, "migrated_bytes",
+		    "Bytes moved between devices by level-based placement");
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -427,6 +457,11 @@ int BlueFS::mount()
            << dendl;
 
   _init_logger();
+
+  if (_get_level_bdev(0) >= 0) {
+    migrate_stop = false;
+    migrate_thread.create("bluefs_migrate");
+  }
   return 0;
 
  out:
@@ -438,6 +473,15 @@ void BlueFS::umount()
 {
   dout(1) << __func__ << dendl;
 
+  if (migrate_thread.is_started()) {
+    {
+      std::lock_guard<std::mutex> l(lock);
+      migrate_stop = true;
+      migrate_cond.notify_all();
+    }
+    migrate_thread.join();
+  }
+
   sync_metadata();
 
   _close_writer(log_writer);
@@ -881,12 +925,12 @@ int BlueFS::_read_random(
   size_t len,            ///< [in] this many bytes
   char *out)             ///< [out] optional: or copy it here
 {
+  _start_reading(h->file.get());
+
   dout(10) << __func__ << " h " << h
            << " 0x" << std::hex << off << "~" << len << std::dec
 	   << " from " << h->file->fnode << dendl;
 
-  ++h->file->num_reading;
-
   if (!h->ignore_eof &&
       off + len > h->file->fnode.size) {
     if (off > h->file->fnode.size)
@@ -915,7 +959,7 @@ int BlueFS::_read_random(
   }
 
   dout(20) << __func__ << " got " << ret << dendl;
-  --h->file->num_reading;
+  _finish_reading(h->file.get());
   return ret;
 }
 
@@ -927,12 +971,12 @@ int BlueFS::_read(
   bufferlist *outbl,     ///< [out] optional: reference the result here
   char *out)             ///< [out] optional: or copy it here
 {
+  _start_reading(h->file.get());
+
   dout(10) << __func__ << " h " << h
            << " 0x" << std::hex << off << "~" << len << std::dec
 	   << " from " << h->file->fnode << dendl;
 
-  ++h->file->num_reading;
-
   if (!h->ignore_eof &&
       off + len > h->file->fnode.size) {
     if (off > h->file->fnode.size)
@@ -1000,7 +1044,7 @@ int BlueFS::_read(
 
   dout(20) << __func__ << " got " << ret << dendl;
   assert(!outbl || (int)outbl->length() == ret);
-  --h->file->num_reading;
+  _finish_reading(h->file.get());
   return ret;
 }
 
@@ -1041,6 +1085,10 @@ uint64_t BlueFS::_estimate_log_size()
 void BlueFS::compact_log()
 {
   std::unique_lock<std::mutex> l(lock);
+  while (new_log) {
+    dout(10) << __func__ << " async compaction in progress, waiting" << dendl;
+    log_cond.wait(l);
+  }
   if (cct->_conf->bluefs_compact_log_sync) {
      _compact_log_sync();
   } else {
@@ -1103,6 +1151,7 @@ void BlueFS::_compact_log_dump_metadata(bluefs_transaction_t *t)
 void BlueFS::_compact_log_sync()
 {
   dout(10) << __func__ << dendl;
+  utime_t start = ceph_clock_now();
   File *log_file = log_writer->file.get();
 
   // clear out log (be careful who calls us!!!)
@@ -1159,6 +1208,7 @@ void BlueFS::_compact_log_sync()
   }
 
   logger->inc(l_bluefs_log_compactions);
+  logger->tinc(l_bluefs_log_compaction_lat, ceph_clock_now() - start);
 }
 
 /*
@@ -1168,24 +1218,28 @@ void BlueFS::_compact_log_sync()
  * New events will be written to the new region that we'll keep.
  *
  * 2. While still holding the lock, encode a bufferlist that dumps all of the
- * in-memory fnodes and names.  This will become the new beginning of the
- * log.  The last event will jump to the log continuation extent from #1.
+ * in-memory fnodes and names.  This snapshot will become the new beginning
+ * of the log.  The last event will jump to the log continuation extent
+ * from #1.
  *
- * 3. Queue a write to a new extent for the new beginnging of the log.
+ * 3. Drop the lock, write the new beginning of the log to a new extent and
+ * wait for it to be stable.  Other writers keep appending to the old log
+ * (i.e., to the continuation extent) in the meantime.
  *
- * 4. Drop lock and wait
+ * 4. Retake the lock and update the log_fnode to splice in the new
+ * beginning.
  *
- * 5. Retake the lock.
+ * 5. Write the new superblock (again without the lock).
  *
- * 6. Update the log_fnode to splice in the new beginning.
+ * 6. Release the old log space.  Clean up.
  *
- * 7. Write the new superblock.
- *
- * 8. Release the old log space.  Clean up.
+ * The only O(number of files) work done under the lock is building the
+ * snapshot in #2; all of the IO happens with the lock dropped.
  */
 void BlueFS::_compact_log_async(std::unique_lock<std::mutex>& l)
 {
   dout(10) << __func__ << dendl;
+  utime_t start = ceph_clock_now();
   File *log_file = log_writer->file.get();
   assert(!new_log);
   assert(!new_log_writer);
@@ -1195,6 +1249,12 @@ void BlueFS::_compact_log_async(std::unique_lock<std::mutex>& l)
   new_log = new File;
   new_log->fnode.ino = 0;   // so that _flush_range won't try to log the fnode
 
+  // make sure previously written file data is stable before we log the
+  // jump; do not hold the lock across the device flush.
+  lock.unlock();
+  flush_bdev();
+  lock.lock();
+
   // 0. wait for any racing flushes to complete.  (We do not want to block
   // in _flush_sync_log with jump_to set or else a racing thread might flush
   // our entries and our jump_to update won't be correct.)
@@ -1222,11 +1282,9 @@ void BlueFS::_compact_log_async(std::unique_lock<std::mutex>& l)
   log_t.op_file_update(log_file->fnode);
   log_t.op_jump(log_seq, old_log_jump_to);
 
-  flush_bdev();  // FIXME?
-
   _flush_and_sync_log(l, 0, old_log_jump_to);
 
-  // 2. prepare compacted log
+  // 2. prepare compacted log from a snapshot of the current metadata
   bluefs_transaction_t t;
   //avoid record two times in log_t and _compact_log_dump_metadata.
   log_t.clear();
@@ -1252,14 +1310,22 @@ void BlueFS::_compact_log_async(std::unique_lock<std::mutex>& l)
   new_log_writer = _create_writer(new_log);
   new_log_writer->append(bl);
 
-  // 3. flush
+  // 3. write and wait, without the lock.  new_log is private to us (ino 0
+  // never dirties and its space is already allocated), so _flush does not
+  // touch any shared state here.
+  lock.unlock();
   r = _flush(new_log_writer, true);
   assert(r == 0);
+  if (!cct->_conf->bluefs_sync_write) {
+    list<aio_t> completed_ios;
+    _claim_completed_aios(new_log_writer, &completed_ios);
+    wait_for_aio(new_log_writer);
+    completed_ios.clear();
+  }
+  flush_bdev();
+  lock.lock();
 
-  // 4. wait
-  _flush_bdev_safely(new_log_writer);
-
-  // 5. update our log fnode
+  // 4. update our log fnode
   // discard first old_log_jump_to extents
   dout(10) << __func__ << " remove 0x" << std::hex << old_log_jump_to << std::dec
 	   << " of " << log_file->fnode.extents << dendl;
@@ -1298,17 +1364,19 @@ void BlueFS::_compact_log_async(std::unique_lock<std::mutex>& l)
   log_writer->pos = log_writer->file->fnode.size =
     log_writer->pos - old_log_jump_to + new_log_jump_to;
 
-  // 6. write the super block to reflect the changes
+  // 5. write the super block to reflect the changes.  nobody else modifies
+  // super while new_log is set, and appends landing before the new super
+  // is stable go to the continuation extents both versions of the log share.
   dout(10) << __func__ << " writing super" << dendl;
   super.log_fnode = log_file->fnode;
   ++super.version;
-  _write_super();
 
   lock.unlock();
+  _write_super();
   flush_bdev();
   lock.lock();
 
-  // 7. release old space
+  // 6. release old space
   dout(10) << __func__ << " release old log extents " << old_extents << dendl;
   for (auto& r : old_extents) {
     pending_release[r.bdev].insert(r.offset, r.length);
@@ -1327,6 +1395,7 @@ void BlueFS::_compact_log_async(std::unique_lock<std::mutex>& l)
 
   dout(10) << __func__ << " log extents " << log_file->fnode.extents << dendl;
   logger->inc(l_bluefs_log_compactions);
+  logger->tinc(l_bluefs_log_compaction_lat, ceph_clock_now() - start);
 }
 
 void BlueFS::_pad_bl(bufferlist& bl)
@@ -1350,6 +1419,7 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<std::mutex>& l,
 				uint64_t want_seq,
 				uint64_t jump_to)
 {
+  utime_t start = ceph_clock_now();
   while (log_flushing) {
     dout(10) << __func__ << " want_seq " << want_seq
 	     << " log is currently flushing, waiting" << dendl;
@@ -1412,7 +1482,8 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<std::mutex>& l,
 
   // pad to block boundary
   _pad_bl(bl);
-  logger->inc(l_bluefs_logged_bytes, bl.length());
+  uint64_t logged = bl.length();
+  logger->inc(l_bluefs_logged_bytes, logged);
 
   log_writer->append(bl);
 
@@ -1475,6 +1546,10 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<std::mutex>& l,
 
   _update_logger_stats();
 
+  utime_t lat = ceph_clock_now() - start;
+  logger->tinc(l_bluefs_log_flush_lat, lat);
+  logger->hinc(l_bluefs_log_flush_lat_hist, lat.to_nsec(), logged);
+
   return 0;
 }
 
@@ -1897,6 +1972,306 @@ int BlueFS::_preallocate(FileRef f, uint64_t off, uint64_t len)
   return 0;
 }
 
+void BlueFS::_start_reading(File *f)
+{
+  ++f->num_reading;
+  if (!f->migrating) {
+    return;
+  }
+  // _migrate_file is about to swap the extents out from under us; get
+  // out of its way until it is done.
+  std::unique_lock<std::mutex> l(reading_lock);
+  while (f->migrating) {
+    if (--f->num_reading == 0) {
+      reading_cond.notify_all();
+    }
+    reading_cond.wait(l, [f] { return !f->migrating; });
+    ++f->num_reading;
+  }
+}
+
+void BlueFS::_finish_reading(File *f)
+{
+  if (--f->num_reading == 0 && f->migrating) {
+    std::lock_guard<std::mutex> l(reading_lock);
+    reading_cond.notify_all();
+  }
+}
+
+int BlueFS::_get_level_bdev(int level)
+{
+  int64_t slow_level = cct->_conf->get_val<int64_t>(
+    "bluefs_placement_slow_level");
+  if (slow_level <= 0 || level < 0 ||
+      !bdev[BDEV_DB] || !bdev[BDEV_SLOW]) {
+    return -1;
+  }
+  return level >= slow_level ? BDEV_SLOW : BDEV_DB;
+}
+
+void BlueFS::set_file_level(const string& dirname, const string& filename,
+			    int level)
+{
+  std::lock_guard<std::mutex> l(lock);
+  auto p = dir_map.find(dirname);
+  if (p == dir_map.end()) {
+    dout(20) << __func__ << " dir " << dirname << " not found" << dendl;
+    return;
+  }
+  auto q = p->second->file_map.find(filename);
+  if (q == p->second->file_map.end()) {
+    dout(20) << __func__ << " " << dirname << "/" << filename
+	     << " not found" << dendl;
+    return;
+  }
+  dout(20) << __func__ << " " << dirname << "/" << filename
+	   << " level " << level << dendl;
+  q->second->level = level;
+}
+
+uint64_t BlueFS::migrate_files(uint64_t max_bytes)
+{
+  std::unique_lock<std::mutex> l(lock);
+  return _migrate_files(l, max_bytes);
+}
+
+uint64_t BlueFS::_migrate_files(std::unique_lock<std::mutex>& l,
+				uint64_t max_bytes)
+{
+  if (_get_level_bdev(0) < 0) {
+    return 0;
+  }
+
+  // demote first: it makes room on the faster device for any promotion
+  // that follows.
+  vector<pair<FileRef,unsigned>> demote, promote;
+  for (auto& p : file_map) {
+    FileRef f = p.second;
+    int target = _get_level_bdev(f->level);
+    if (target < 0 || f->deleted || f->num_writers.load() ||
+	f->migrating || f->fnode.ino <= 1) {
+      continue;
+    }
+    bool misplaced = false;
+    for (auto& e : f->fnode.extents) {
+      // the wal device counts as fast, too
+      if ((target == BDEV_SLOW) != (e.bdev == BDEV_SLOW)) {
+	misplaced = true;
+	break;
+      }
+    }
+    if (!misplaced) {
+      continue;
+    }
+    if (target == BDEV_SLOW) {
+      demote.push_back(make_pair(f, target));
+    } else {
+      promote.push_back(make_pair(f, target));
+    }
+  }
+  std::sort(promote.begin(), promote.end(),
+	    [](const pair<FileRef,unsigned>& a,
+	       const pair<FileRef,unsigned>& b) {
+	      return a.first->level < b.first->level;
+	    });
+  demote.insert(demote.end(), promote.begin(), promote.end());
+
+  double min_free_ratio = cct->_conf->get_val<double>(
+    "bluefs_placement_min_free_ratio");
+  uint64_t moved = 0;
+  for (auto& p : demote) {
+    if (moved >= max_bytes || migrate_stop) {
+      break;
+    }
+    FileRef f = p.first;
+    unsigned target = p.second;
+    uint64_t need = ROUND_UP_TO(f->fnode.size, cct->_conf->bluefs_alloc_size);
+    uint64_t reserve = block_all[target].size() * min_free_ratio;
+    if (alloc[target]->get_free() < need + reserve) {
+      dout(20) << __func__ << " not enough room on bdev " << target
+	       << " for " << f->fnode << dendl;
+      continue;
+    }
+    int r = _migrate_file(l, f, target);
+    if (r == 0) {
+      moved += need;
+    }
+  }
+  if (moved) {
+    _flush_and_sync_log(l);
+  }
+  return moved;
+}
+
+int BlueFS::_migrate_file(std::unique_lock<std::mutex>& l, FileRef f,
+			  unsigned target)
+{
+  dout(10) << __func__ << " " << f->fnode << " level " << f->level
+	   << " to bdev " << target << dendl;
+  bluefs_fnode_t src = f->fnode;
+  bluefs_fnode_t dst;
+  uint64_t len = ROUND_UP_TO(src.size, super.block_size);
+  if (len == 0) {
+    return -ENOENT;
+  }
+  int r = _allocate(target, len, &dst.extents);
+  if (r < 0) {
+    return r;
+  }
+  dst.recalc_allocated();
+  bool fallback = false;
+  for (auto& e : dst.extents) {
+    if (e.bdev != target) {
+      fallback = true;
+    }
+  }
+
+  // copy the data without the lock; tables are immutable once written
+  // and we check below that nobody reopened or replaced this one.
+  if (!fallback) {
+    IOContext ioc(cct, NULL);
+    lock.unlock();
+    uint64_t pos = 0;
+    while (pos < len) {
+      uint64_t s_off = 0, d_off = 0;
+      auto s = src.seek(pos, &s_off);
+      auto d = dst.seek(pos, &d_off);
+      uint64_t chunk = MIN(len - pos, cct->_conf->bluefs_max_prefetch);
+      chunk = MIN(chunk, s->length - s_off);
+      chunk = MIN(chunk, d->length - d_off);
+      bufferlist bl;
+      r = bdev[s->bdev]->read(s->offset + s_off, chunk, &bl, &ioc, false);
+      if (r < 0) {
+	derr << __func__ << " read " << *s << " failed: " << cpp_strerror(r)
+	     << dendl;
+	break;
+      }
+      r = bdev[d->bdev]->write(d->offset + d_off, bl, false);
+      if (r < 0) {
+	derr << __func__ << " write " << *d << " failed: " << cpp_strerror(r)
+	     << dendl;
+	break;
+      }
+      pos += chunk;
+    }
+    flush_bdev();
+    lock.lock();
+  }
+
+  auto file_changed = [&]() {
+    bool changed = f->deleted || f->num_writers.load() ||
+      f->fnode.size != src.size ||
+      f->fnode.extents.size() != src.extents.size();
+    for (size_t i = 0; !changed && i < src.extents.size(); ++i) {
+      const bluefs_extent_t& a = f->fnode.extents[i];
+      const bluefs_extent_t& b = src.extents[i];
+      changed = a.bdev != b.bdev || a.offset != b.offset ||
+	a.length != b.length;
+    }
+    return changed;
+  };
+  bool changed = file_changed();
+  if (!fallback && r >= 0 && !changed) {
+    // swap in the new extents.  in-flight reads still use the old ones,
+    // so wait for them (without the lock; they don't need it); new
+    // readers back off while migrating is set (see _start_reading).
+    f->migrating = true;
+    if (f->num_reading.load()) {
+      lock.unlock();
+      {
+	std::unique_lock<std::mutex> rl(reading_lock);
+	reading_cond.wait(rl, [f] { return f->num_reading.load() == 0; });
+      }
+      lock.lock();
+      changed = file_changed();
+    }
+    if (!changed) {
+      for (auto& e : f->fnode.extents) {
+	pending_release[e.bdev].insert(e.offset, e.length);
+      }
+      f->fnode.extents.swap(dst.extents);
+      f->fnode.recalc_allocated();
+      f->fnode.prefer_bdev = target;
+    }
+    {
+      std::lock_guard<std::mutex> rl(reading_lock);
+      f->migrating = false;
+      reading_cond.notify_all();
+    }
+  }
+  if (fallback || r < 0 || changed) {
+    dout(10) << __func__ << " abort " << f->fnode
+	     << (fallback ? " (no room on target)" : "")
+	     << (changed ? " (file changed)" : "")
+	     << " r " << r << dendl;
+    vector<interval_set<uint64_t>> to_release(MAX_BDEV);
+    for (auto& e : dst.extents) {
+      to_release[e.bdev].insert(e.offset, e.length);
+    }
+    for (unsigned i = 0; i < MAX_BDEV; ++i) {
+      if (!to_release[i].empty()) {
+	alloc[i]->release(to_release[i]);
+      }
+    }
+    return r < 0 ? r : -EAGAIN;
+  }
+
+  log_t.op_file_update(f->fnode);
+  logger->inc(l_bluefs_migrated_bytes, len);
+  dout(10) << __func__ << " now " << f->fnode << dendl;
+  return 0;
+}
+
+void BlueFS::_migrate_thread_entry()
+{
+  std::unique_lock<std::mutex> l(lock);
+  while (!migrate_stop) {
+    double interval = cct->_conf->get_val<double>(
+      "bluefs_placement_interval");
+    migrate_cond.wait_for(
+      l, std::chrono::milliseconds((uint64_t)(interval * 1000)));
+    if (migrate_stop) {
+      break;
+    }
+    _migrate_files(
+      l, cct->_conf->get_val<uint64_t>("bluefs_placement_max_bytes"));
+  }
+}
+
+void BlueFS::get_level_usage(map<int,vector<uint64_t>> *usage)
+{
+  std::lock_guard<std::mutex> l(lock);
+  usage->clear();
+  for (auto& p : file_map) {
+    auto& v = (*usage)[p.second->level];
+    v.resize(MAX_BDEV);
+    for (auto& e : p.second->fnode.extents) {
+      v[e.bdev] += e.length;
+    }
+  }
+}
+
+void BlueFS::dump_placement(Formatter *f)
+{
+  static const char *names[MAX_BDEV] = { "wal", "db", "slow" };
+  map<int,vector<uint64_t>> usage;
+  get_level_usage(&usage);
+  f->open_array_section("bluefs_placement");
+  for (auto& p : usage) {
+    f->open_object_section("level");
+    if (p.first < 0) {
+      f->dump_string("level", "none");
+    } else {
+      f->dump_int("level", p.first);
+    }
+    for (unsigned i = 0; i < MAX_BDEV; ++i) {
+      f->dump_unsigned(names[i], p.second[i]);
+    }
+    f->close_section();
+  }
+  f->close_section();
+}
+
 void BlueFS::sync_metadata()
 {
   std::unique_lock<std::mutex> l(lock);
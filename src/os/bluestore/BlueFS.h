@@ -8,6 +8,7 @@
 
 #include "bluefs_types.h"
 #include "common/RefCountedObj.h"
+#include "common/Thread.h"
 #include "BlockDevice.h"
 
 #include "boost/intrusive/list.hpp"
@@ -35,6 +36,10 @@ enum {
   l_bluefs_files_written_sst,
   l_bluefs_bytes_written_wal,
   l_bluefs_bytes_written_sst,
+  l_bluefs_log_flush_lat,
+  l_bluefs_log_flush_lat_hist,
+  l_bluefs_log_compaction_lat,
+  l_bluefs_migrated_bytes,
   l_bluefs_last,
 };
 
@@ -60,10 +65,12 @@ public:
     uint64_t dirty_seq;
     bool locked;
     bool deleted;
+    int level;  ///< rocksdb level hint (in memory only), -1 if unknown
     boost::intrusive::list_member_hook<> dirty_item;
 
     std::atomic_int num_readers, num_writers;
     std::atomic_int num_reading;
+    std::atomic_bool migrating;  ///< extents are being swapped; see _start_reading
 
     File()
       : RefCountedObject(NULL, 0),
@@ -71,9 +78,11 @@ public:
 	dirty_seq(0),
 	locked(false),
 	deleted(false),
+	level(-1),
 	num_readers(0),
 	num_writers(0),
-	num_reading(0)
+	num_reading(0),
+	migrating(false)
       {}
     ~File() override {
       assert(num_readers.load() == 0);
@@ -241,6 +250,22 @@ private:
   FileRef new_log = nullptr;
   FileWriter *new_log_writer = nullptr;
 
+  // level-based placement
+  bool migrate_stop = false;
+  std::condition_variable migrate_cond;
+  /// readers and _migrate_file wait here for each other; see _start_reading
+  std::mutex reading_lock;
+  std::condition_variable reading_cond;
+  class MigrateThread : public Thread {
+    BlueFS *fs;
+  public:
+    explicit MigrateThread(BlueFS *f) : fs(f) {}
+    void *entry() override {
+      fs->_migrate_thread_entry();
+      return NULL;
+    }
+  } migrate_thread;
+
   /*
    * There are up to 3 block devices:
    *
@@ -292,6 +317,16 @@ private:
   int _preallocate(FileRef f, uint64_t off, uint64_t len);
   int _truncate(FileWriter *h, uint64_t off);
 
+  /// bdev a file at the given rocksdb level should live on, or -1 if
+  /// level-based placement does not apply
+  int _get_level_bdev(int level);
+  uint64_t _migrate_files(std::unique_lock<std::mutex>& l, uint64_t max_bytes);
+  int _migrate_file(std::unique_lock<std::mutex>& l, FileRef f,
+		    unsigned target);
+  void _migrate_thread_entry();
+  void _start_reading(File *f);
+  void _finish_reading(File *f);
+
   int _read(
     FileReader *h,   ///< [in] read from here
     FileReaderBuffer *buf, ///< [in] reader state
@@ -383,6 +418,16 @@ public:
   void flush_log();
   void compact_log();
 
+  /// note the rocksdb level of a table file, for level-based placement
+  void set_file_level(const string& dirname, const string& filename,
+		      int level);
+  /// move up to max_bytes of misplaced files to the bdev their level
+  /// belongs on; returns bytes moved
+  uint64_t migrate_files(uint64_t max_bytes);
+  /// bytes on each bdev, by rocksdb level (-1 for files w/o a level)
+  void get_level_usage(map<int,vector<uint64_t>> *usage);
+  void dump_placement(Formatter *f);
+
   /// sync any uncommitted state to disk
   void sync_metadata();
 
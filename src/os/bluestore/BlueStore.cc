@@ -16,6 +16,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <thread>
 
 #include "include/cpp-btree/btree_set.h"
 
@@ -25,6 +26,7 @@
 #include "include/intarith.h"
 #include "include/stringify.h"
 #include "include/str_map.h"
+#include "include/ceph_hash.h"
 #include "common/errno.h"
 #include "common/safe_io.h"
 #include "Allocator.h"
@@ -33,6 +35,7 @@
 #include "BlueRocksEnv.h"
 #include "auth/Crypto.h"
 #include "common/EventTrace.h"
+#include "common/MemoryModel.h"
 
 #define dout_context cct
 #define dout_subsys ceph_subsys_bluestore
@@ -69,6 +72,7 @@ const string PREFIX_DEFERRED = "L";  // id -> deferred_transaction_t
 const string PREFIX_ALLOC = "B";   // u64 offset -> u64 length (freelist)
 const string PREFIX_ALLOC_BITMAP = "b"; // (see BitmapFreelistManager)
 const string PREFIX_SHARED_BLOB = "X"; // u64 offset -> shared_blob_t
+const string PREFIX_ALLOC_CHECKPOINT = "A"; // "meta" + u64 chunk -> extents
 
 // write a label in the first block.  always use this size.  note that
 // bluefs makes a matching assumption about the location of its
@@ -571,8 +575,10 @@ ostream& operator<<(ostream& out, const BlueStore::Buffer& b)
   out << "buffer(" << &b << " space " << b.space << " 0x" << std::hex
       << b.offset << "~" << b.length << std::dec
       << " " << BlueStore::Buffer::get_state_name(b.state);
-  if (b.flags)
-    out << " " << BlueStore::Buffer::get_flag_name(b.flags);
+  for (unsigned f = 1; f <= b.flags; f <<= 1) {
+    if (b.flags & f)
+      out << " " << BlueStore::Buffer::get_flag_name(f);
+  }
   return out << ")";
 }
 
@@ -895,11 +901,36 @@ void BlueStore::LRUCache::_trim(uint64_t onode_max, uint64_t buffer_max)
   --p;
   int skipped = 0;
   int max_skipped = g_conf->bluestore_cache_trim_max_skip_pinned;
+  // lookups don't touch the lru; give referenced onodes a second chance,
+  // bounded so a steady stream of hits can't keep us spinning
+  int max_rotate = onode_lru.size();
   while (num > 0) {
     Onode *o = &*p;
-    int refs = o->nref.load();
-    if (refs > 1) {
-      dout(20) << __func__ << "  " << o->oid << " has " << refs
+    if (max_rotate > 0 &&
+	o->lru_referenced.exchange(false, std::memory_order_relaxed)) {
+      dout(30) << __func__ << "  " << o->oid << " referenced, rotating"
+	       << dendl;
+      --max_rotate;
+      if (p == onode_lru.begin()) {
+	break;
+      }
+      auto q = p--;
+      onode_lru.erase(q);
+      onode_lru.push_front(*o);
+      continue;
+    }
+    bool pinned = o->nref.load() > 1;
+    if (!pinned) {
+      o->get();  // paranoia
+      // a lookup may have taken a ref since we looked; evict() rechecks
+      // under the onode_map lock
+      pinned = !o->c->onode_map.evict(o);
+      if (pinned) {
+	o->put();
+      }
+    }
+    if (pinned) {
+      dout(20) << __func__ << "  " << o->oid << " has " << o->nref.load()
 	       << " refs, skipping" << dendl;
       if (++skipped >= max_skipped) {
         dout(20) << __func__ << " maximum skip pinned reached; stopping with "
@@ -922,8 +953,6 @@ void BlueStore::LRUCache::_trim(uint64_t onode_max, uint64_t buffer_max)
       onode_lru.erase(p);
       assert(num == 1);
     }
-    o->get();  // paranoia
-    o->c->onode_map.remove(o->oid);
     o->put();
     --num;
   }
@@ -1191,12 +1220,37 @@ void BlueStore::TwoQCache::_trim(uint64_t onode_max, uint64_t buffer_max)
   --p;
   int skipped = 0;
   int max_skipped = g_conf->bluestore_cache_trim_max_skip_pinned;
+  // lookups don't touch the lru; give referenced onodes a second chance,
+  // bounded so a steady stream of hits can't keep us spinning
+  int max_rotate = onode_lru.size();
   while (num > 0) {
     Onode *o = &*p;
     dout(20) << __func__ << " considering " << o << dendl;
-    int refs = o->nref.load();
-    if (refs > 1) {
-      dout(20) << __func__ << "  " << o->oid << " has " << refs
+    if (max_rotate > 0 &&
+	o->lru_referenced.exchange(false, std::memory_order_relaxed)) {
+      dout(30) << __func__ << "  " << o->oid << " referenced, rotating"
+	       << dendl;
+      --max_rotate;
+      if (p == onode_lru.begin()) {
+	break;
+      }
+      auto q = p--;
+      onode_lru.erase(q);
+      onode_lru.push_front(*o);
+      continue;
+    }
+    bool pinned = o->nref.load() > 1;
+    if (!pinned) {
+      o->get();  // paranoia
+      // a lookup may have taken a ref since we looked; evict() rechecks
+      // under the onode_map lock
+      pinned = !o->c->onode_map.evict(o);
+      if (pinned) {
+	o->put();
+      }
+    }
+    if (pinned) {
+      dout(20) << __func__ << "  " << o->oid << " has " << o->nref.load()
 	       << " refs; skipping" << dendl;
       if (++skipped >= max_skipped) {
         dout(20) << __func__ << " maximum skip pinned reached; stopping with "
@@ -1219,8 +1273,6 @@ void BlueStore::TwoQCache::_trim(uint64_t onode_max, uint64_t buffer_max)
       onode_lru.erase(p);
       assert(num == 1);
     }
-    o->get();  // paranoia
-    o->c->onode_map.remove(o->oid);
     o->put();
     --num;
   }
@@ -1367,6 +1419,7 @@ void BlueStore::BufferSpace::read(
   res_intervals.clear();
   uint32_t want_bytes = length;
   uint32_t end = offset + length;
+  uint64_t readahead_bytes = 0;
 
   {
     std::lock_guard<std::recursive_mutex> l(cache->lock);
@@ -1381,6 +1434,11 @@ void BlueStore::BufferSpace::read(
 	  uint32_t l = MIN(length, b->length - skip);
 	  res[offset].substr_of(b->data, skip, l);
 	  res_intervals.insert(offset, l);
+	  if (b->flags & Buffer::FLAG_READAHEAD) {
+	    // only the first read of prefetched data is a readahead hit
+	    readahead_bytes += l;
+	    b->flags &= ~Buffer::FLAG_READAHEAD;
+	  }
 	  offset += l;
 	  length -= l;
 	  if (!b->is_writing()) {
@@ -1399,6 +1457,10 @@ void BlueStore::BufferSpace::read(
         if (!b->is_writing()) {
 	  cache->_touch_buffer(b);
         }
+        if (b->flags & Buffer::FLAG_READAHEAD) {
+	  readahead_bytes += MIN(length, b->length);
+	  b->flags &= ~Buffer::FLAG_READAHEAD;
+        }
         if (b->length > length) {
 	  res[offset].substr_of(b->data, 0, length);
 	  res_intervals.insert(offset, length);
@@ -1420,6 +1482,28 @@ void BlueStore::BufferSpace::read(
   uint64_t miss_bytes = want_bytes - hit_bytes;
   cache->logger->inc(l_bluestore_buffer_hit_bytes, hit_bytes);
   cache->logger->inc(l_bluestore_buffer_miss_bytes, miss_bytes);
+  if (readahead_bytes) {
+    cache->logger->inc(l_bluestore_readahead_hit_bytes, readahead_bytes);
+  }
+}
+
+void BlueStore::BufferSpace::get_cached(
+  Cache* cache,
+  uint32_t offset,
+  uint32_t length,
+  interval_set<uint32_t>& res_intervals)
+{
+  uint32_t end = offset + length;
+  std::lock_guard<std::recursive_mutex> l(cache->lock);
+  for (auto i = _data_lower_bound(offset);
+       i != buffer_map.end() && i->first < end;
+       ++i) {
+    Buffer *b = i->second.get();
+    if (b->is_writing() || b->is_clean()) {
+      uint32_t start = MAX(offset, b->offset);
+      res_intervals.insert(start, MIN(end, b->end()) - start);
+    }
+  }
 }
 
 void BlueStore::BufferSpace::finish_write(Cache* cache, uint64_t seq)
@@ -1514,6 +1598,7 @@ void BlueStore::BufferSpace::split(Cache* cache, size_t pos, BlueStore::BufferSp
 BlueStore::OnodeRef BlueStore::OnodeSpace::add(const ghobject_t& oid, OnodeRef o)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::WLocker ml(lock);
   auto p = onode_map.find(oid);
   if (p != onode_map.end()) {
     ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
@@ -1534,14 +1619,18 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
   bool hit = false;
 
   {
-    std::lock_guard<std::recursive_mutex> l(cache->lock);
+    // no cache->lock here: instead of moving the onode in the lru we
+    // mark it referenced and let trim rotate it (see Cache::_trim)
+    RWLock::RLocker l(lock);
     ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(oid);
     if (p == onode_map.end()) {
       ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
     } else {
       ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << p->second
 			    << dendl;
-      cache->_touch_onode(p->second);
+      if (!p->second->lru_referenced.load(std::memory_order_relaxed)) {
+	p->second->lru_referenced.store(true, std::memory_order_relaxed);
+      }
       hit = true;
       o = p->second;
     }
@@ -1555,9 +1644,22 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
   return o;
 }
 
+bool BlueStore::OnodeSpace::evict(Onode *o)
+{
+  RWLock::WLocker l(lock);
+  // one ref for the map, one for the caller; lookups can't take a new
+  // one while we hold the write lock
+  if (o->nref.load() > 2) {
+    return false;
+  }
+  onode_map.erase(o->oid);
+  return true;
+}
+
 void BlueStore::OnodeSpace::clear()
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::WLocker ml(lock);
   ldout(cache->cct, 10) << __func__ << dendl;
   for (auto &p : onode_map) {
     cache->_rm_onode(p.second);
@@ -1567,7 +1669,7 @@ void BlueStore::OnodeSpace::clear()
 
 bool BlueStore::OnodeSpace::empty()
 {
-  std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::RLocker l(lock);
   return onode_map.empty();
 }
 
@@ -1578,6 +1680,7 @@ void BlueStore::OnodeSpace::rename(
   const mempool::bluestore_cache_other::string& new_okey)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::WLocker ml(lock);
   ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
 			<< dendl;
   ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
@@ -1609,6 +1712,7 @@ void BlueStore::OnodeSpace::rename(
 bool BlueStore::OnodeSpace::map_any(std::function<bool(OnodeRef)> f)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  RWLock::RLocker ml(lock);
   ldout(cache->cct, 20) << __func__ << dendl;
   for (auto& i : onode_map) {
     if (f(i.second)) {
@@ -1620,6 +1724,7 @@ bool BlueStore::OnodeSpace::map_any(std::function<bool(OnodeRef)> f)
 
 void BlueStore::OnodeSpace::dump(CephContext *cct, int lvl)
 {
+  RWLock::RLocker l(lock);
   for (auto& i : onode_map) {
     ldout(cct, lvl) << i.first << " : " << i.second << dendl;
   }
@@ -2134,6 +2239,8 @@ void BlueStore::ExtentMap::reshard(
     dout(20) << __func__ << "   spanning blob " << p.first << " " << *p.second
 	     << dendl;
   }
+  // the spanning blob scan below may look past the resharded range
+  fault_partial(db);
   // determine shard index range
   unsigned si_begin = 0, si_end = 0;
   if (!shards.empty()) {
@@ -2497,6 +2604,14 @@ bool BlueStore::ExtentMap::encode_some(
 }
 
 unsigned BlueStore::ExtentMap::decode_some(bufferlist& bl)
+{
+  return decode_some(bl, 0, std::numeric_limits<uint64_t>::max(), nullptr);
+}
+
+unsigned BlueStore::ExtentMap::decode_some(
+  bufferlist& bl,
+  uint64_t begin, uint64_t end,
+  unsigned *skipped)
 {
   auto cct = onode->c->store->cct; //used by dout
   /*
@@ -2517,12 +2632,15 @@ unsigned BlueStore::ExtentMap::decode_some(bufferlist& bl)
   uint32_t num;
   denc_varint(num, p);
   vector<BlobRef> blobs(num);
+  // for a partial decode, remember where each skipped blob is encoded
+  // so that a later extent that does need it can decode it then.
+  bool partial = skipped != nullptr;
+  vector<uint32_t> blob_pos(partial ? num : 0);
   uint64_t pos = 0;
   uint64_t prev_len = 0;
   unsigned n = 0;
 
   while (!p.end()) {
-    Extent *le = new Extent();
     uint64_t blobid;
     denc_varint(blobid, p);
     if ((blobid & BLOBID_FLAG_CONTIGUOUS) == 0) {
@@ -2530,15 +2648,37 @@ unsigned BlueStore::ExtentMap::decode_some(bufferlist& bl)
       denc_varint_lowz(gap, p);
       pos += gap;
     }
-    le->logical_offset = pos;
+    uint32_t blob_offset = 0;
     if ((blobid & BLOBID_FLAG_ZEROOFFSET) == 0) {
-      denc_varint_lowz(le->blob_offset, p);
-    } else {
-      le->blob_offset = 0;
+      denc_varint_lowz(blob_offset, p);
     }
     if ((blobid & BLOBID_FLAG_SAMELENGTH) == 0) {
       denc_varint_lowz(prev_len, p);
     }
+
+    bool want = pos < end && pos + prev_len > begin &&
+      (!partial || find(pos) == extent_map.end());
+    if (!want) {
+      // only step over the blob, if it is encoded here
+      if ((blobid & BLOBID_FLAG_SPANNING) == 0 &&
+	  (blobid >> BLOBID_SHIFT_BITS) == 0) {
+	blob_pos[n] = p.get_offset();
+	bluestore_blob_t blob;
+	denc(blob, p, struct_v);
+	if (blob.is_shared()) {
+	  uint64_t sbid;
+	  denc(sbid, p);
+	}
+      }
+      ++*skipped;
+      pos += prev_len;
+      ++n;
+      continue;
+    }
+
+    Extent *le = new Extent();
+    le->logical_offset = pos;
+    le->blob_offset = blob_offset;
     le->length = prev_len;
 
     if (blobid & BLOBID_FLAG_SPANNING) {
@@ -2548,6 +2688,19 @@ unsigned BlueStore::ExtentMap::decode_some(bufferlist& bl)
     } else {
       blobid >>= BLOBID_SHIFT_BITS;
       if (blobid) {
+	if (partial && !blobs[blobid - 1]) {
+	  // blob was encoded with an extent we skipped.  if that extent
+	  // was materialized by an earlier partial decode this makes a
+	  // second in-memory copy of the blob; that is harmless since a
+	  // partially decoded shard is only ever read: writers call
+	  // fault_partial() first, which replaces both copies.
+	  auto q = bl.front().begin_deep(blob_pos[blobid - 1]);
+	  Blob *b = new Blob();
+	  uint64_t sbid = 0;
+	  b->decode(onode->c, q, struct_v, &sbid, false);
+	  blobs[blobid - 1] = b;
+	  onode->c->open_shared_blob(sbid, b);
+	}
 	le->assign_blob(blobs[blobid - 1]);
 	assert(le->blob);
       } else {
@@ -2631,6 +2784,7 @@ void BlueStore::ExtentMap::decode_spanning_blobs(
 void BlueStore::ExtentMap::init_shards(bool loaded, bool dirty)
 {
   shards.resize(onode->onode.extent_map_shards.size());
+  has_partial = false;
   unsigned i = 0;
   for (auto &s : onode->onode.extent_map_shards) {
     shards[i].shard_info = &s;
@@ -2640,6 +2794,34 @@ void BlueStore::ExtentMap::init_shards(bool loaded, bool dirty)
   }
 }
 
+void BlueStore::ExtentMap::_read_shard(KeyValueDB *db, Shard *p,
+					bufferlist *v)
+{
+  auto cct = onode->c->store->cct; //used by dout
+  string key;
+  generate_extent_shard_key_and_apply(
+    onode->key, p->shard_info->offset, &key,
+    [&](const string& final_key) {
+      int r = db->get(PREFIX_OBJ, final_key, v);
+      if (r < 0) {
+	derr << __func__ << " missing shard 0x" << std::hex
+	     << p->shard_info->offset << std::dec << " for " << onode->oid
+	     << dendl;
+	assert(r >= 0);
+      }
+    }
+  );
+  assert(v->length() == p->shard_info->bytes);
+}
+
+uint64_t BlueStore::ExtentMap::_shard_end(int i) const
+{
+  if ((size_t)i + 1 < shards.size()) {
+    return shards[i + 1].shard_info->offset;
+  }
+  return std::numeric_limits<uint64_t>::max();
+}
+
 void BlueStore::ExtentMap::fault_range(
   KeyValueDB *db,
   uint32_t offset,
@@ -2655,37 +2837,126 @@ void BlueStore::ExtentMap::fault_range(
     return;
 
   assert(last >= start);
-  string key;
+  while (start <= last) {
+    assert((size_t)start < shards.size());
+    if (!shards[start].loaded) {
+      _load_shard(db, start);
+      onode->c->store->logger->inc(l_bluestore_onode_shard_misses);
+    } else {
+      onode->c->store->logger->inc(l_bluestore_onode_shard_hits);
+    }
+    ++start;
+  }
+}
+
+void BlueStore::ExtentMap::_load_shard(KeyValueDB *db, int i)
+{
+  auto cct = onode->c->store->cct; //used by dout
+  auto p = &shards[i];
+  dout(30) << __func__ << " opening shard 0x" << std::hex
+	   << p->shard_info->offset << std::dec << dendl;
+  bufferlist v;
+  if (p->is_partial()) {
+    // the extents (and blob ref_maps) decoded so far are incomplete;
+    // throw them away and decode the whole shard from the cached copy.
+    auto e = seek_lextent(p->shard_info->offset);
+    uint64_t end = _shard_end(i);
+    while (e != extent_map.end() && e->logical_offset < end) {
+      rm(e++);
+    }
+    v.claim(p->encoded);
+    p->decoded_begin = p->decoded_end = 0;
+  } else {
+    _read_shard(db, p, &v);
+  }
+  p->extents = decode_some(v);
+  p->loaded = true;
+  dout(20) << __func__ << " open shard 0x" << std::hex
+	   << p->shard_info->offset << std::dec
+	   << " (" << v.length() << " bytes)" << dendl;
+  assert(p->dirty == false);
+}
+
+void BlueStore::ExtentMap::_fault_partial(KeyValueDB *db)
+{
+  for (unsigned i = 0; i < shards.size(); ++i) {
+    if (shards[i].is_partial()) {
+      _load_shard(db, i);
+    }
+  }
+  has_partial = false;
+}
+
+void BlueStore::ExtentMap::fault_range_for_read(
+  KeyValueDB *db,
+  uint32_t offset,
+  uint32_t length)
+{
+  auto cct = onode->c->store->cct; //used by dout
+  if (!onode->c->store->extent_map_lazy_decode) {
+    fault_range(db, offset, length);
+    return;
+  }
+  dout(30) << __func__ << " 0x" << std::hex << offset << "~" << length
+	   << std::dec << dendl;
+  auto start = seek_shard(offset);
+  auto last = seek_shard(offset + length);
+
+  if (start < 0)
+    return;
+
+  assert(last >= start);
   while (start <= last) {
     assert((size_t)start < shards.size());
     auto p = &shards[start];
-    if (!p->loaded) {
+    if (p->loaded) {
+      onode->c->store->logger->inc(l_bluestore_onode_shard_hits);
+      ++start;
+      continue;
+    }
+    uint64_t shard_end = _shard_end(start);
+    uint64_t b = std::max<uint64_t>(offset, p->shard_info->offset);
+    uint64_t e = std::min<uint64_t>((uint64_t)offset + length, shard_end);
+    if (!p->is_partial()) {
+      if (p->shard_info->bytes <
+	  onode->c->store->extent_map_lazy_decode_min_bytes) {
+	// small shard; not worth being clever
+	_load_shard(db, start);
+	onode->c->store->logger->inc(l_bluestore_onode_shard_misses);
+	++start;
+	continue;
+      }
       dout(30) << __func__ << " opening shard 0x" << std::hex
-	       << p->shard_info->offset << std::dec << dendl;
-      bufferlist v;
-      generate_extent_shard_key_and_apply(
-	onode->key, p->shard_info->offset, &key,
-        [&](const string& final_key) {
-          int r = db->get(PREFIX_OBJ, final_key, &v);
-          if (r < 0) {
-	    derr << __func__ << " missing shard 0x" << std::hex
-		 << p->shard_info->offset << std::dec << " for " << onode->oid
-		 << dendl;
-	    assert(r >= 0);
-          }
-        }
-      );
-      p->extents = decode_some(v);
-      p->loaded = true;
-      dout(20) << __func__ << " open shard 0x" << std::hex
-	       << p->shard_info->offset << std::dec
-	       << " (" << v.length() << " bytes)" << dendl;
-      assert(p->dirty == false);
-      assert(v.length() == p->shard_info->bytes);
+	       << p->shard_info->offset << std::dec << " (partial)" << dendl;
+      _read_shard(db, p, &p->encoded);
+      p->encoded.reassign_to_mempool(mempool::mempool_bluestore_cache_other);
+      has_partial = true;
       onode->c->store->logger->inc(l_bluestore_onode_shard_misses);
-    } else {
+    } else if (b >= p->decoded_begin && e <= p->decoded_end) {
       onode->c->store->logger->inc(l_bluestore_onode_shard_hits);
+      ++start;
+      continue;
     }
+    unsigned skipped = 0;
+    p->extents = decode_some(p->encoded, b, e, &skipped);
+    // track one contiguous decoded window; sequential readers extend it,
+    // random ones start a new one (the old extents simply stay around).
+    if (p->decoded_end > p->decoded_begin &&
+	b <= p->decoded_end && e >= p->decoded_begin) {
+      p->decoded_begin = std::min<uint64_t>(b, p->decoded_begin);
+      p->decoded_end = std::max<uint64_t>(e, p->decoded_end);
+    } else {
+      p->decoded_begin = b;
+      p->decoded_end = e;
+    }
+    dout(20) << __func__ << " partial shard 0x" << std::hex
+	     << p->shard_info->offset << " decoded 0x" << p->decoded_begin
+	     << "~" << (p->decoded_end - p->decoded_begin) << std::dec
+	     << ", skipped " << skipped << "/" << p->extents
+	     << " extents" << dendl;
+    onode->c->store->logger->inc(l_bluestore_onode_shard_partial);
+    onode->c->store->logger->inc(l_bluestore_onode_shard_skipped_extents,
+				 skipped);
     ++start;
   }
 }
@@ -3210,6 +3481,14 @@ uint64_t BlueStore::Collection::make_blob_unshared(SharedBlob *sb)
   return sbid;
 }
 
+struct C_OnodeFilterLoad : public Context {
+  BlueStore::CollectionRef c;
+  explicit C_OnodeFilterLoad(BlueStore::Collection *c) : c(c) {}
+  void finish(int r) override {
+    c->onode_filter_load();
+  }
+};
+
 BlueStore::OnodeRef BlueStore::Collection::get_onode(
   const ghobject_t& oid,
   bool create)
@@ -3235,8 +3514,28 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
   ldout(store->cct, 20) << __func__ << " oid " << oid << " key "
 			<< pretty_binary_string(key) << dendl;
 
+  bool use_filter = store->onode_filter &&
+    !store->cct->_conf->bluestore_debug_misc;
+  if (use_filter && create && !onode_filter_complete &&
+      !onode_filter_failed && !onode_filter_loading) {
+    // list the collection in the background; until that is done every
+    // lookup goes to the kv store
+    onode_filter_loading = true;
+    store->onode_filter_finisher.queue(new C_OnodeFilterLoad(this));
+  }
+
   bufferlist v;
-  int r = store->db->get(PREFIX_OBJ, key.c_str(), key.size(), &v);
+  int r;
+  if (use_filter && onode_filter_complete &&
+      !onode_filter_contains(key.c_str(), key.size())) {
+    r = -ENOENT;
+    store->logger->inc(l_bluestore_onode_filter_skipped);
+  } else {
+    r = store->db->get(PREFIX_OBJ, key.c_str(), key.size(), &v);
+    if (r == -ENOENT && use_filter && onode_filter_complete) {
+      store->logger->inc(l_bluestore_onode_filter_false_positive);
+    }
+  }
   ldout(store->cct, 20) << " r " << r << " v.len " << v.length() << dendl;
   Onode *on;
   if (v.length() == 0) {
@@ -3247,6 +3546,9 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
 
     // new object, new onode
     on = new Onode(this, oid, key);
+    if (store->onode_filter && create) {
+      onode_filter_insert(key.c_str(), key.size());
+    }
   } else {
     // loaded
     assert(r >= 0);
@@ -3273,6 +3575,99 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
   return onode_map.add(oid, o);
 }
 
+void BlueStore::Collection::onode_filter_add(
+  std::list<bloom_filter>& filter,
+  const char *key, size_t len)
+{
+  if (filter.empty() || filter.back().is_full()) {
+    // start small (most pgs of an empty pool hold few objects) and
+    // double, so a collection of n onodes costs ~2n filter entries
+    size_t count = filter.empty() ?
+      1024 : filter.back().element_count() * 2;
+    filter.emplace_back(count, 0.01, 0);
+  }
+  filter.back().insert(ceph_str_hash_rjenkins(key, len));
+}
+
+void BlueStore::Collection::onode_filter_insert(const char *key, size_t len)
+{
+  assert(lock.is_wlocked());
+  if (onode_filter_failed) {
+    return;
+  }
+  onode_filter_add(onode_filter, key, len);
+}
+
+bool BlueStore::Collection::onode_filter_contains(
+  const char *key, size_t len) const
+{
+  uint32_t hash = ceph_str_hash_rjenkins(key, len);
+  for (auto& f : onode_filter) {
+    if (f.contains(hash)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void BlueStore::Collection::onode_filter_load()
+{
+  auto cct = store->cct;
+  utime_t start = ceph_clock_now();
+  uint64_t max = cct->_conf->get_val<uint64_t>(
+    "bluestore_onode_filter_max_onodes");
+  string temp_start, temp_end, start_key, end_key;
+  {
+    RWLock::RLocker l(lock);
+    get_coll_key_range(cid, cnode.bits, &temp_start, &temp_end,
+		       &start_key, &end_key);
+  }
+  // runs without the collection lock, into a filter of its own.  onodes
+  // created since mount have been inserted into onode_filter as they
+  // were created, so whatever this listing misses is covered there.
+  std::list<bloom_filter> loaded;
+  uint64_t n = 0;
+  bool failed = false;
+  KeyValueDB::Iterator it = store->db->get_iterator(PREFIX_OBJ);
+  for (auto& range : { make_pair(temp_start, temp_end),
+			 make_pair(start_key, end_key) }) {
+    for (it->lower_bound(range.first);
+	 !failed && it->valid() && it->key() < range.second;
+	 it->next()) {
+      if (store->onode_filter_stop) {
+	ldout(cct, 10) << __func__ << " " << cid << " stopping" << dendl;
+	RWLock::WLocker l(lock);
+	onode_filter_loading = false;
+	return;
+      }
+      string k = it->key();
+      if (is_extent_shard_key(k)) {
+	continue;
+      }
+      if (++n > max) {
+	ldout(cct, 10) << __func__ << " " << cid << " has more than " << max
+		       << " onodes, not filtering" << dendl;
+	failed = true;
+	break;
+      }
+      onode_filter_add(loaded, k.c_str(), k.size());
+    }
+  }
+
+  RWLock::WLocker l(lock);
+  onode_filter_loading = false;
+  if (failed || onode_filter_failed) {
+    onode_filter.clear();
+    onode_filter_failed = true;
+    return;
+  }
+  // keep the filter we have been inserting into at the back of the chain
+  onode_filter.splice(onode_filter.begin(), loaded);
+  onode_filter_complete = true;
+  ldout(cct, 10) << __func__ << " " << cid << " loaded " << n << " onodes in "
+		 << (ceph_clock_now() - start) << dendl;
+}
+
 void BlueStore::Collection::split_cache(
   Collection *dest)
 {
@@ -3282,6 +3677,8 @@ void BlueStore::Collection::split_cache(
   std::lock(cache->lock, dest->cache->lock);
   std::lock_guard<std::recursive_mutex> l(cache->lock, std::adopt_lock);
   std::lock_guard<std::recursive_mutex> l2(dest->cache->lock, std::adopt_lock);
+  RWLock::WLocker ml(onode_map.lock);
+  RWLock::WLocker ml2(dest->onode_map.lock);
 
   int destbits = dest->cnode.bits;
   spg_t destpg;
@@ -3361,6 +3758,14 @@ void *BlueStore::MempoolThread::entry()
     }
 
     float bytes_per_onode = (float)meta_bytes / (float)onode_num;
+    if (store->cct->_conf->bluestore_cache_autotune) {
+      utime_t now = ceph_clock_now();
+      if (now - store->cache_autotune_stamp >=
+	  store->cct->_conf->bluestore_cache_autotune_interval) {
+	store->cache_autotune_stamp = now;
+	store->_autotune_cache();
+      }
+    }
     size_t num_shards = store->cache_shards.size();
     float target_ratio = store->cache_meta_ratio + store->cache_data_ratio;
     // A little sloppy but should be close enough
@@ -3506,6 +3911,7 @@ BlueStore::BlueStore(CephContext *cct, const string& path)
 		       cct->_conf->bluestore_throttle_bytes +
 		       cct->_conf->bluestore_throttle_deferred_bytes),
     deferred_finisher(cct, "defered_finisher", "dfin"),
+    onode_filter_finisher(cct, "onode_filter_finisher", "ofin"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
     mempool_thread(this)
@@ -3525,6 +3931,7 @@ BlueStore::BlueStore(CephContext *cct,
 		       cct->_conf->bluestore_throttle_bytes +
 		       cct->_conf->bluestore_throttle_deferred_bytes),
     deferred_finisher(cct, "defered_finisher", "dfin"),
+    onode_filter_finisher(cct, "onode_filter_finisher", "ofin"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
     min_alloc_size(_min_alloc_size),
@@ -3584,6 +3991,10 @@ const char **BlueStore::get_tracked_conf_keys() const
     "bluestore_max_blob_size",
     "bluestore_max_blob_size_ssd",
     "bluestore_max_blob_size_hdd",
+    "bluestore_txc_trace",
+    "bluestore_txc_trace_slow_threshold",
+    "bluestore_extent_map_lazy_decode",
+    "bluestore_extent_map_lazy_decode_min_bytes",
     NULL
   };
   return KEYS;
@@ -3603,6 +4014,14 @@ void BlueStore::handle_conf_change(const struct md_config_t *conf,
       _set_compression();
     }
   }
+  if (changed.count("bluestore_txc_trace") ||
+      changed.count("bluestore_txc_trace_slow_threshold")) {
+    _set_txc_trace();
+  }
+  if (changed.count("bluestore_extent_map_lazy_decode") ||
+      changed.count("bluestore_extent_map_lazy_decode_min_bytes")) {
+    _set_extent_map_lazy_decode();
+  }
   if (changed.count("bluestore_max_blob_size") ||
       changed.count("bluestore_max_blob_size_ssd") ||
       changed.count("bluestore_max_blob_size_hdd")) {
@@ -3641,6 +4060,25 @@ void BlueStore::handle_conf_change(const struct md_config_t *conf,
   }
 }
 
+void BlueStore::_set_txc_trace()
+{
+  txc_trace_slow_usec = cct->_conf->get_val<double>(
+    "bluestore_txc_trace_slow_threshold") * 1000000.0;
+  txc_trace = cct->_conf->get_val<bool>("bluestore_txc_trace");
+  dout(10) << __func__ << " " << txc_trace
+	   << " slow " << txc_trace_slow_usec << "us" << dendl;
+}
+
+void BlueStore::_set_extent_map_lazy_decode()
+{
+  extent_map_lazy_decode_min_bytes = cct->_conf->get_val<uint64_t>(
+    "bluestore_extent_map_lazy_decode_min_bytes");
+  extent_map_lazy_decode = cct->_conf->get_val<bool>(
+    "bluestore_extent_map_lazy_decode");
+  dout(10) << __func__ << " " << extent_map_lazy_decode
+	   << " min_bytes " << extent_map_lazy_decode_min_bytes << dendl;
+}
+
 void BlueStore::_set_compression()
 {
   auto m = Compressor::get_comp_mode_type(cct->_conf->bluestore_compression_mode);
@@ -3847,6 +4285,14 @@ void BlueStore::_init_logger()
   b.add_time_avg(l_bluestore_kv_lat, "kv_lat",
 		 "Average kv_thread sync latency",
 		 "k_l", PerfCountersBuilder::PRIO_INTERESTING);
+  b.add_time_avg(l_bluestore_kv_submit_lat, "kv_submit_lat",
+		 "Average kv_thread submit latency");
+  b.add_u64_avg(l_bluestore_kv_sync_batch, "kv_sync_batch",
+		"Transactions committed per kv sync");
+  b.add_u64_avg(l_bluestore_kv_submit_batch, "kv_submit_batch",
+		"Transactions submitted by kv_thread per kv sync");
+  b.add_u64_avg(l_bluestore_kv_submit_lanes, "kv_submit_lanes",
+		"Submit lanes busy per kv sync");
   b.add_time_avg(l_bluestore_state_prepare_lat, "state_prepare_lat",
     "Average prepare state latency");
   b.add_time_avg(l_bluestore_state_aio_wait_lat, "state_aio_wait_lat",
@@ -3896,12 +4342,21 @@ void BlueStore::_init_logger()
     "Sum for beneficial compress ops");
   b.add_u64_counter(l_bluestore_compress_rejected_count, "compress_rejected_count",
     "Sum for compress ops rejected due to low net gain of space");
+  b.add_u64_counter(l_bluestore_compress_skipped_count, "compress_skipped_count",
+    "Sum for blobs not compressed because they were predicted incompressible");
+  b.add_u64_counter(l_bluestore_compress_skipped_bytes, "compress_skipped_bytes",
+    "Sum for bytes not compressed because they were predicted incompressible");
+  b.add_time(l_bluestore_compress_saved_time, "compress_saved_time",
+    "Estimated compressor time saved by skipping incompressible data");
   b.add_u64_counter(l_bluestore_write_pad_bytes, "write_pad_bytes",
     "Sum for write-op padded bytes");
   b.add_u64_counter(l_bluestore_deferred_write_ops, "deferred_write_ops",
 		    "Sum for deferred write op");
   b.add_u64_counter(l_bluestore_deferred_write_bytes, "deferred_write_bytes",
 		    "Sum for deferred write bytes", "def");
+  b.add_u64_counter(l_bluestore_deferred_write_coalesced,
+		    "deferred_write_coalesced",
+		    "Deferred writes merged into an adjacent one by global batching");
   b.add_u64_counter(l_bluestore_write_penalty_read_ops, "write_penalty_read_ops",
 		    "Sum for write penalty read ops");
   b.add_u64(l_bluestore_allocated, "bluestore_allocated",
@@ -3926,6 +4381,18 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_onode_shard_misses,
 		    "bluestore_onode_shard_misses",
 		    "Sum for onode-shard lookups missed in the cache");
+  b.add_u64_counter(l_bluestore_onode_shard_partial,
+		    "bluestore_onode_shard_partial",
+		    "Sum for onode-shards decoded only partially for a read");
+  b.add_u64_counter(l_bluestore_onode_shard_skipped_extents,
+		    "bluestore_onode_shard_skipped_extents",
+		    "Sum for extents skipped by partial shard decodes");
+  b.add_u64_counter(l_bluestore_onode_filter_skipped,
+		    "bluestore_onode_filter_skipped",
+		    "Sum for onode lookups skipped because the filter missed");
+  b.add_u64_counter(l_bluestore_onode_filter_false_positive,
+		    "bluestore_onode_filter_false_positive",
+		    "Sum for onode lookups the filter let through for nothing");
   b.add_u64(l_bluestore_extents, "bluestore_extents",
 	    "Number of extents in cache");
   b.add_u64(l_bluestore_blobs, "bluestore_blobs",
@@ -3938,6 +4405,31 @@ void BlueStore::_init_logger()
     "Sum for bytes of read hit in the cache");
   b.add_u64(l_bluestore_buffer_miss_bytes, "bluestore_buffer_miss_bytes",
     "Sum for bytes of read missed in the cache");
+  b.add_u64_counter(l_bluestore_readahead, "bluestore_readahead",
+		    "Readahead requests issued");
+  b.add_u64_counter(l_bluestore_readahead_bytes, "bluestore_readahead_bytes",
+		    "Bytes prefetched into the buffer cache by readahead");
+  b.add_u64_counter(l_bluestore_readahead_hit_bytes,
+		    "bluestore_readahead_hit_bytes",
+		    "Bytes of reads served from prefetched buffers");
+  b.add_u64_counter(l_bluestore_readahead_dropped,
+		    "bluestore_readahead_dropped",
+		    "Readahead requests whose data was stale or unverified when "
+		    "they completed");
+  b.add_u64(l_bluestore_cache_target_bytes, "bluestore_cache_target_bytes",
+	    "Total cache size target");
+  b.add_u64(l_bluestore_cache_meta_target_bytes,
+	    "bluestore_cache_meta_target_bytes",
+	    "Cache target for onodes and other metadata");
+  b.add_u64(l_bluestore_cache_kv_target_bytes,
+	    "bluestore_cache_kv_target_bytes",
+	    "Cache target for the kv store (rocksdb block cache)");
+  b.add_u64(l_bluestore_cache_data_target_bytes,
+	    "bluestore_cache_data_target_bytes",
+	    "Cache target for object data buffers");
+  b.add_u64_counter(l_bluestore_cache_autotune_shifts,
+		    "bluestore_cache_autotune_shifts",
+		    "Times autotuning moved memory between caches");
 
   b.add_u64_counter(l_bluestore_write_big, "bluestore_write_big",
 		    "Large aligned writes into fresh blobs");
@@ -3963,6 +4455,8 @@ void BlueStore::_init_logger()
 		    "Small write into new (sparse) blob");
 
   b.add_u64_counter(l_bluestore_txc, "bluestore_txc", "Transactions committed");
+  b.add_u64_counter(l_bluestore_txc_slow_traced, "bluestore_txc_slow_traced",
+		    "Slow transactions recorded by bluestore_txc_trace");
   b.add_u64_counter(l_bluestore_onode_reshard, "bluestore_onode_reshard",
 		    "Onode extent map reshard events");
   b.add_u64_counter(l_bluestore_blob_split, "bluestore_blob_split",
@@ -3974,6 +4468,12 @@ void BlueStore::_init_logger()
 		    "collection");
   b.add_u64_counter(l_bluestore_read_eio, "bluestore_read_eio",
                     "Read EIO errors propagated to high level callers");
+  b.add_u64_counter(l_bluestore_read_bytes, "bluestore_read_bytes",
+		    "Bytes returned by object reads");
+  b.add_u64_counter(l_bluestore_read_zerocopy_bytes,
+		    "bluestore_read_zerocopy_bytes",
+		    "Bytes returned by object reads that reference device or "
+		    "cache buffers without a copy");
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -4320,7 +4820,7 @@ void BlueStore::_close_fm()
   fm = NULL;
 }
 
-int BlueStore::_open_alloc()
+int BlueStore::_open_alloc(bool use_checkpoint)
 {
   assert(alloc == NULL);
   assert(bdev->get_size());
@@ -4334,7 +4834,23 @@ int BlueStore::_open_alloc()
     return -EINVAL;
   }
 
+  if (use_checkpoint) {
+    int r = _load_alloc_checkpoint();
+    if (r == 0) {
+      return 0;
+    }
+    if (r != -ENOENT && r != -ECANCELED) {
+      // we may have added some of the extents; start over from the freelist
+      _close_alloc();
+      alloc = Allocator::create(cct, cct->_conf->bluestore_allocator,
+				bdev->get_size(),
+				min_alloc_size);
+      assert(alloc);
+    }
+  }
+
   uint64_t num = 0, bytes = 0;
+  utime_t start = ceph_clock_now();
 
   dout(1) << __func__ << " opening allocation metadata" << dendl;
   // initialize from freelist
@@ -4348,6 +4864,7 @@ int BlueStore::_open_alloc()
   fm->enumerate_reset();
   dout(1) << __func__ << " loaded " << pretty_si_t(bytes)
 	  << " in " << num << " extents"
+	  << " in " << (ceph_clock_now() - start) << " seconds"
 	  << dendl;
 
   // also mark bluefs space as allocated
@@ -4368,6 +4885,277 @@ void BlueStore::_close_alloc()
   alloc = NULL;
 }
 
+/*
+ * Allocator checkpoint
+ *
+ * On a clean umount we dump the allocator's free extents under
+ * PREFIX_ALLOC_CHECKPOINT so that the next mount can skip the freelist
+ * scan.  The checkpoint is removed (synchronously) by the first mount
+ * that sees it, before anything can modify the freelist, so a checkpoint
+ * is never trusted after a crash or for more than one mount.
+ *
+ * While a checkpoint exists min_compat_ondisk_format is raised to
+ * alloc_checkpoint_compat_ondisk_format, in the same transaction, so
+ * that older code (which knows nothing about the checkpoint and would
+ * happily modify the freelist underneath it) refuses to mount.  A
+ * checkpoint found without the raised compat value is not trusted.
+ */
+
+static const uint64_t ALLOC_CHECKPOINT_CHUNK_EXTENTS = 16384;
+
+static void get_alloc_checkpoint_chunk_key(uint64_t n, string *key)
+{
+  key->clear();
+  _key_encode_u64(n, key);
+}
+
+int BlueStore::_read_alloc_checkpoint_meta(bluestore_alloc_checkpoint_t *ckpt)
+{
+  bufferlist bl;
+  int r = db->get(PREFIX_ALLOC_CHECKPOINT, "meta", &bl);
+  if (r < 0) {
+    return -ENOENT;
+  }
+  try {
+    bufferlist::iterator p = bl.begin();
+    ::decode(*ckpt, p);
+  } catch (buffer::error& e) {
+    derr << __func__ << " failed to decode checkpoint meta" << dendl;
+    return -EIO;
+  }
+  return 0;
+}
+
+int BlueStore::_read_alloc_checkpoint_extents(
+  const bluestore_alloc_checkpoint_t& ckpt,
+  interval_set<uint64_t> *free)
+{
+  uint32_t crc = -1;
+  uint64_t num = 0, bytes = 0;
+  for (uint64_t n = 0; n < ckpt.num_chunks; ++n) {
+    string key;
+    get_alloc_checkpoint_chunk_key(n, &key);
+    bufferlist bl;
+    int r = db->get(PREFIX_ALLOC_CHECKPOINT, key, &bl);
+    if (r < 0) {
+      derr << __func__ << " missing chunk " << n << dendl;
+      return -EIO;
+    }
+    crc = bl.crc32c(crc);
+    interval_set<uint64_t> chunk;
+    try {
+      bufferlist::iterator p = bl.begin();
+      ::decode(chunk, p);
+    } catch (buffer::error& e) {
+      derr << __func__ << " failed to decode chunk " << n << dendl;
+      return -EIO;
+    }
+    for (auto e = chunk.begin(); e != chunk.end(); ++e) {
+      if (e.get_start() + e.get_len() > ckpt.size ||
+	  free->intersects(e.get_start(), e.get_len())) {
+	derr << __func__ << " bad extent 0x" << std::hex << e.get_start()
+	     << "~" << e.get_len() << std::dec << " in chunk " << n << dendl;
+	return -EIO;
+      }
+      free->insert(e.get_start(), e.get_len());
+    }
+    num += chunk.num_intervals();
+    bytes += chunk.size();
+  }
+  if (crc != ckpt.crc || num != ckpt.num_extents || bytes != ckpt.free_bytes) {
+    derr << __func__ << " checkpoint mismatch: crc 0x" << std::hex << crc
+	 << " free 0x" << bytes << std::dec << " extents " << num
+	 << " vs " << ckpt << dendl;
+    return -EIO;
+  }
+  return 0;
+}
+
+int BlueStore::_load_alloc_checkpoint()
+{
+  utime_t start = ceph_clock_now();
+  bluestore_alloc_checkpoint_t ckpt;
+  int r = _read_alloc_checkpoint_meta(&ckpt);
+  if (r == -ENOENT) {
+    dout(10) << __func__ << " no checkpoint" << dendl;
+    return r;
+  }
+
+  if (r == 0) {
+    int32_t compat = 0;
+    bufferlist bl;
+    if (db->get(PREFIX_SUPER, "min_compat_ondisk_format", &bl) >= 0) {
+      try {
+	auto p = bl.begin();
+	::decode(compat, p);
+      } catch (buffer::error& e) {
+	compat = 0;
+      }
+    }
+    if (compat != alloc_checkpoint_compat_ondisk_format) {
+      derr << __func__ << " checkpoint present but min_compat_ondisk_format is "
+	   << compat << ", not " << alloc_checkpoint_compat_ondisk_format
+	   << "; freelist may have changed since it was written" << dendl;
+      r = -ESTALE;
+    }
+  }
+
+  interval_set<uint64_t> free;
+  if (r == 0 && cct->_conf->bluestore_alloc_checkpoint) {
+    r = _read_alloc_checkpoint_extents(ckpt, &free);
+  }
+
+  // drop it before anything else can touch the freelist
+  int rr = _drop_alloc_checkpoint();
+  if (rr < 0) {
+    return rr;
+  }
+
+  if (r < 0) {
+    derr << __func__ << " ignoring bad checkpoint: " << cpp_strerror(r)
+	 << dendl;
+    return r;
+  }
+  if (!cct->_conf->bluestore_alloc_checkpoint) {
+    dout(1) << __func__ << " bluestore_alloc_checkpoint is off, discarded "
+	    << ckpt << dendl;
+    return -ECANCELED;
+  }
+  if (ckpt.size != bdev->get_size() ||
+      ckpt.min_alloc_size != min_alloc_size ||
+      !(ckpt.bluefs_extents == bluefs_extents)) {
+    derr << __func__ << " stale checkpoint " << ckpt
+	 << " (size 0x" << std::hex << bdev->get_size()
+	 << " min_alloc_size 0x" << min_alloc_size
+	 << " bluefs_extents " << bluefs_extents << std::dec << ")" << dendl;
+    return -ESTALE;
+  }
+
+  for (auto e = free.begin(); e != free.end(); ++e) {
+    alloc->init_add_free(e.get_start(), e.get_len());
+  }
+  dout(1) << __func__ << " loaded " << pretty_si_t(ckpt.free_bytes)
+	  << " in " << ckpt.num_extents << " extents"
+	  << " in " << (ceph_clock_now() - start) << " seconds"
+	  << dendl;
+  return 0;
+}
+
+int BlueStore::_drop_alloc_checkpoint()
+{
+  KeyValueDB::Transaction t = db->get_transaction();
+  t->rmkeys_by_prefix(PREFIX_ALLOC_CHECKPOINT);
+  bufferlist bl;
+  ::encode(min_compat_ondisk_format, bl);
+  t->set(PREFIX_SUPER, "min_compat_ondisk_format", bl);
+  int r = db->submit_transaction_sync(t);
+  if (r < 0) {
+    derr << __func__ << " failed to remove checkpoint: "
+	 << cpp_strerror(r) << dendl;
+    return r;
+  }
+  dout(10) << __func__ << " min_compat_ondisk_format now "
+	   << min_compat_ondisk_format << dendl;
+  return 0;
+}
+
+int BlueStore::_write_alloc_checkpoint()
+{
+  utime_t start = ceph_clock_now();
+  bluestore_alloc_checkpoint_t ckpt;
+  ckpt.size = bdev->get_size();
+  ckpt.min_alloc_size = min_alloc_size;
+  ckpt.bluefs_extents = bluefs_extents;
+
+  KeyValueDB::Transaction t = db->get_transaction();
+  t->rmkeys_by_prefix(PREFIX_ALLOC_CHECKPOINT);
+
+  uint32_t crc = -1;
+  interval_set<uint64_t> chunk;
+  auto flush_chunk = [&]() {
+    bufferlist bl;
+    ::encode(chunk, bl);
+    crc = bl.crc32c(crc);
+    string key;
+    get_alloc_checkpoint_chunk_key(ckpt.num_chunks++, &key);
+    t->set(PREFIX_ALLOC_CHECKPOINT, key, bl);
+    ckpt.num_extents += chunk.num_intervals();
+    ckpt.free_bytes += chunk.size();
+    chunk.clear();
+  };
+  alloc->dump([&](uint64_t offset, uint64_t length) {
+      chunk.insert(offset, length);
+      if ((uint64_t)chunk.num_intervals() >= ALLOC_CHECKPOINT_CHUNK_EXTENTS) {
+	flush_chunk();
+      }
+    });
+  if (!chunk.empty()) {
+    flush_chunk();
+  }
+  ckpt.crc = crc;
+
+  assert(ondisk_format >= alloc_checkpoint_compat_ondisk_format);
+  bufferlist bl;
+  ::encode(ckpt, bl);
+  t->set(PREFIX_ALLOC_CHECKPOINT, "meta", bl);
+  {
+    bufferlist cbl;
+    ::encode(alloc_checkpoint_compat_ondisk_format, cbl);
+    t->set(PREFIX_SUPER, "min_compat_ondisk_format", cbl);
+  }
+  int r = db->submit_transaction_sync(t);
+  if (r < 0) {
+    derr << __func__ << " failed: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  dout(1) << __func__ << " wrote " << ckpt
+	  << " in " << (ceph_clock_now() - start) << " seconds" << dendl;
+  return 0;
+}
+
+int BlueStore::_fsck_alloc_checkpoint()
+{
+  bluestore_alloc_checkpoint_t ckpt;
+  int r = _read_alloc_checkpoint_meta(&ckpt);
+  if (r == -ENOENT) {
+    return 0;
+  }
+  interval_set<uint64_t> free;
+  if (r == 0) {
+    r = _read_alloc_checkpoint_extents(ckpt, &free);
+  }
+  if (r < 0) {
+    derr << "fsck error: unable to read allocator checkpoint: "
+	 << cpp_strerror(r) << dendl;
+    return 1;
+  }
+  if (ckpt.size != bdev->get_size() ||
+      ckpt.min_alloc_size != min_alloc_size ||
+      !(ckpt.bluefs_extents == bluefs_extents)) {
+    // mount will discard it; nothing to compare against
+    dout(1) << __func__ << " stale checkpoint " << ckpt << dendl;
+    return 0;
+  }
+  int errors = 0;
+  interval_set<uint64_t> expected;
+  alloc->dump([&](uint64_t offset, uint64_t length) {
+      expected.insert(offset, length);
+    });
+  if (!(free == expected)) {
+    interval_set<uint64_t> common, extra, missing;
+    common.intersection_of(free, expected);
+    extra = free;
+    extra.subtract(common);
+    missing = expected;
+    missing.subtract(common);
+    derr << "fsck error: allocator checkpoint differs from freelist:"
+	 << " extra free 0x" << std::hex << extra
+	 << " missing free 0x" << missing << std::dec << dendl;
+    ++errors;
+  }
+  return errors;
+}
+
 int BlueStore::_open_fsid(bool create)
 {
   assert(fsid_fd < 0);
@@ -4513,6 +5301,17 @@ bool BlueStore::test_mount_in_use()
   return ret;
 }
 
+void BlueStore::_get_rocksdb_cfs(std::vector<KeyValueDB::ColumnFamily> *cfs)
+{
+  map<string,string> cf_map;
+  get_str_map(cct->_conf->get_val<string>("bluestore_rocksdb_cfs"), &cf_map,
+	      " \t");
+  for (auto& i : cf_map) {
+    dout(10) << "column family " << i.first << ": " << i.second << dendl;
+    cfs->push_back(KeyValueDB::ColumnFamily(i.first, i.second));
+  }
+}
+
 int BlueStore::_open_db(bool create, bool to_repair_db)
 {
   int r;
@@ -4776,18 +5575,29 @@ int BlueStore::_open_db(bool create, bool to_repair_db)
   FreelistManager::setup_merge_operators(db);
   db->set_merge_operator(PREFIX_STAT, merge_op);
 
+  if (bluefs) {
+    // let bluefs place table files by level
+    db->set_file_level_handler(
+      [this](const string& path, int level) {
+	size_t slash = path.rfind('/');
+	if (slash == string::npos) {
+	  return;
+	}
+	string file = path.substr(slash + 1);
+	while (slash && path[slash - 1] == '/')
+	  --slash;
+	bluefs->set_file_level(path.substr(0, slash), file, level);
+      });
+  }
+
   db->set_cache_size(cache_size * cache_kv_ratio);
+  if (cct->_conf->bluestore_cache_autotune) {
+    db->enable_cache_stats();
+  }
 
   if (kv_backend == "rocksdb") {
     options = cct->_conf->bluestore_rocksdb_options;
-
-    map<string,string> cf_map;
-    get_str_map(cct->_conf->get_val<string>("bluestore_rocksdb_cfs"), &cf_map,
-		" \t");
-    for (auto& i : cf_map) {
-      dout(10) << "column family " << i.first << ": " << i.second << dendl;
-      cfs.push_back(KeyValueDB::ColumnFamily(i.first, i.second));
-    }
+    _get_rocksdb_cfs(&cfs);
   }
 
   db->init(options);
@@ -5449,8 +6259,16 @@ int BlueStore::_mount(bool kv_only, bool open_db)
   if (r < 0)
     goto out_bdev;
 
-  if (kv_only)
+  if (kv_only) {
+    // the caller may modify anything, including the freelist
+    bluestore_alloc_checkpoint_t ckpt;
+    if (open_db && _read_alloc_checkpoint_meta(&ckpt) != -ENOENT) {
+      r = _drop_alloc_checkpoint();
+      if (r < 0)
+	goto out_db;
+    }
     return 0;
+  }
 
   r = _open_super_meta();
   if (r < 0)
@@ -5460,10 +6278,11 @@ int BlueStore::_mount(bool kv_only, bool open_db)
   if (r < 0)
     goto out_db;
 
-  r = _open_alloc();
+  r = _open_alloc(true);
   if (r < 0)
     goto out_fm;
 
+  onode_filter = cct->_conf->get_val<bool>("bluestore_onode_filter");
   r = _open_collections();
   if (r < 0)
     goto out_alloc;
@@ -5516,6 +6335,7 @@ int BlueStore::umount()
 
   _osr_drain_all();
   _osr_unregister_all();
+  _readahead_drain();
 
   mounted = false;
   if (!_kv_only) {
@@ -5524,6 +6344,9 @@ int BlueStore::umount()
     _kv_stop();
     _reap_collections();
     _flush_cache();
+    if (cct->_conf->bluestore_alloc_checkpoint) {
+      _write_alloc_checkpoint();
+    }
     dout(20) << __func__ << " closing" << dendl;
 
     _close_alloc();
@@ -5619,20 +6442,23 @@ int BlueStore::_fsck(bool deep, bool repair)
   KeyValueDB::Iterator it;
   store_statfs_t expected_statfs, actual_statfs;
   struct sb_info_t {
-    list<ghobject_t> oids;
+    ghobject_t oid;  ///< first referencing object, for error reports
     SharedBlobRef sb;
     bluestore_extent_ref_map_t ref_map;
     bool compressed;
   };
   mempool::bluestore_fsck::map<uint64_t,sb_info_t> sb_info;
 
-  uint64_t num_objects = 0;
-  uint64_t num_extents = 0;
-  uint64_t num_blobs = 0;
-  uint64_t num_spanning_blobs = 0;
+  // object walk workers share the used_* sets, sb_info and used_blocks
+  std::mutex fsck_lock;
+
+  std::atomic<uint64_t> num_objects = {0};
+  std::atomic<uint64_t> num_extents = {0};
+  std::atomic<uint64_t> num_blobs = {0};
+  std::atomic<uint64_t> num_spanning_blobs = {0};
   uint64_t num_shared_blobs = 0;
-  uint64_t num_sharded_objects = 0;
-  uint64_t num_object_shards = 0;
+  std::atomic<uint64_t> num_sharded_objects = {0};
+  std::atomic<uint64_t> num_object_shards = {0};
 
   utime_t start = ceph_clock_now();
 
@@ -5715,299 +6541,391 @@ int BlueStore::_fsck(bool deep, bool repair)
   expected_statfs.total = actual_statfs.total;
   expected_statfs.available = actual_statfs.available;
 
-  // walk PREFIX_OBJ
+  // walk PREFIX_OBJ.  the keyspace is split at collection boundaries
+  // and the pieces are handed out to bluestore_fsck_threads workers.
+  // an object's shard keys sort right after its onode key, so no
+  // object straddles a boundary.
   dout(1) << __func__ << " walking object keyspace" << dendl;
-  it = db->get_iterator(PREFIX_OBJ);
-  if (it) {
-    CollectionRef c;
-    spg_t pgid;
-    mempool::bluestore_fsck::list<string> expecting_shards;
-    for (it->lower_bound(string()); it->valid(); it->next()) {
-      if (g_conf->bluestore_debug_fsck_abort) {
-	goto out_scan;
-      }
-      dout(30) << __func__ << " key "
-               << pretty_binary_string(it->key()) << dendl;
-      if (is_extent_shard_key(it->key())) {
-	while (!expecting_shards.empty() &&
-	       expecting_shards.front() < it->key()) {
-	  derr << "fsck error: missing shard key "
-	       << pretty_binary_string(expecting_shards.front())
-	       << dendl;
-	  ++errors;
-	  expecting_shards.pop_front();
-	}
-	if (!expecting_shards.empty() &&
-	    expecting_shards.front() == it->key()) {
-	  // all good
-	  expecting_shards.pop_front();
-	  continue;
+  {
+    std::set<string> bounds;
+    for (auto& p : coll_map) {
+      string temp_start, temp_end, start, end;
+      get_coll_key_range(p.first, p.second->cnode.bits,
+			 &temp_start, &temp_end, &start, &end);
+      bounds.insert(temp_start);
+      bounds.insert(temp_end);
+      bounds.insert(start);
+      bounds.insert(end);
+    }
+    vector<pair<string,string>> ranges;  // [first, second); "" is open
+    string last;
+    for (auto& b : bounds) {
+      if (!b.empty()) {
+	ranges.emplace_back(last, b);
+	last = b;
+      }
+    }
+    ranges.emplace_back(last, string());
+
+    auto walk_objects = [&](const string& from, const string& to) {
+      // per-range tallies, folded into the totals at the end
+      int range_errors = 0;
+      store_statfs_t range_statfs;
+      CollectionRef c;
+      spg_t pgid;
+      mempool::bluestore_fsck::list<string> expecting_shards;
+      KeyValueDB::Iterator it = db->get_iterator(PREFIX_OBJ);
+      for (it->lower_bound(from);
+	   it->valid() && (to.empty() || it->key() < to);
+	   it->next()) {
+	if (g_conf->bluestore_debug_fsck_abort) {
+	  break;
 	}
+	dout(30) << "_fsck key "
+		 << pretty_binary_string(it->key()) << dendl;
+	if (is_extent_shard_key(it->key())) {
+	  while (!expecting_shards.empty() &&
+		 expecting_shards.front() < it->key()) {
+	    derr << "fsck error: missing shard key "
+		 << pretty_binary_string(expecting_shards.front())
+		 << dendl;
+	    ++range_errors;
+	    expecting_shards.pop_front();
+	  }
+	  if (!expecting_shards.empty() &&
+	      expecting_shards.front() == it->key()) {
+	    // all good
+	    expecting_shards.pop_front();
+	    continue;
+	  }
 
-        uint32_t offset;
-        string okey;
-        get_key_extent_shard(it->key(), &okey, &offset);
-        derr << "fsck error: stray shard 0x" << std::hex << offset
-	     << std::dec << dendl;
-        if (expecting_shards.empty()) {
-          derr << "fsck error: " << pretty_binary_string(it->key())
-               << " is unexpected" << dendl;
-          ++errors;
-          continue;
-        }
-	while (expecting_shards.front() > it->key()) {
-	  derr << "fsck error:   saw " << pretty_binary_string(it->key())
-	       << dendl;
-	  derr << "fsck error:   exp "
-	       << pretty_binary_string(expecting_shards.front()) << dendl;
-	  ++errors;
-	  expecting_shards.pop_front();
+	  uint32_t offset;
+	  string okey;
+	  get_key_extent_shard(it->key(), &okey, &offset);
+	  derr << "fsck error: stray shard 0x" << std::hex << offset
+	       << std::dec << dendl;
 	  if (expecting_shards.empty()) {
-	    break;
+	    derr << "fsck error: " << pretty_binary_string(it->key())
+		 << " is unexpected" << dendl;
+	    ++range_errors;
+	    continue;
 	  }
-	}
-	continue;
-      }
-
-      ghobject_t oid;
-      int r = get_key_object(it->key(), &oid);
-      if (r < 0) {
-        derr << "fsck error: bad object key "
-             << pretty_binary_string(it->key()) << dendl;
-	++errors;
-	continue;
-      }
-      if (!c ||
-	  oid.shard_id != pgid.shard ||
-	  oid.hobj.pool != (int64_t)pgid.pool() ||
-	  !c->contains(oid)) {
-	c = nullptr;
-	for (ceph::unordered_map<coll_t, CollectionRef>::iterator p =
-	       coll_map.begin();
-	     p != coll_map.end();
-	     ++p) {
-	  if (p->second->contains(oid)) {
-	    c = p->second;
-	    break;
+	  while (expecting_shards.front() > it->key()) {
+	    derr << "fsck error:   saw " << pretty_binary_string(it->key())
+		 << dendl;
+	    derr << "fsck error:   exp "
+		 << pretty_binary_string(expecting_shards.front()) << dendl;
+	    ++range_errors;
+	    expecting_shards.pop_front();
+	    if (expecting_shards.empty()) {
+	      break;
+	    }
 	  }
-	}
-	if (!c) {
-          derr << "fsck error: stray object " << oid
-               << " not owned by any collection" << dendl;
-	  ++errors;
 	  continue;
 	}
-	c->cid.is_pg(&pgid);
-	dout(20) << __func__ << "  collection " << c->cid << dendl;
-      }
 
-      if (!expecting_shards.empty()) {
-	for (auto &k : expecting_shards) {
-	  derr << "fsck error: missing shard key "
-	       << pretty_binary_string(k) << dendl;
+	ghobject_t oid;
+	int r = get_key_object(it->key(), &oid);
+	if (r < 0) {
+	  derr << "fsck error: bad object key "
+	       << pretty_binary_string(it->key()) << dendl;
+	  ++range_errors;
+	  continue;
 	}
-	++errors;
-	expecting_shards.clear();
-      }
-
-      dout(10) << __func__ << "  " << oid << dendl;
-      RWLock::RLocker l(c->lock);
-      OnodeRef o = c->get_onode(oid, false);
-      if (o->onode.nid) {
-	if (o->onode.nid > nid_max) {
-	  derr << "fsck error: " << oid << " nid " << o->onode.nid
-	       << " > nid_max " << nid_max << dendl;
-	  ++errors;
+	if (!c ||
+	    oid.shard_id != pgid.shard ||
+	    oid.hobj.pool != (int64_t)pgid.pool() ||
+	    !c->contains(oid)) {
+	  c = nullptr;
+	  for (ceph::unordered_map<coll_t, CollectionRef>::iterator p =
+		 coll_map.begin();
+	       p != coll_map.end();
+	       ++p) {
+	    if (p->second->contains(oid)) {
+	      c = p->second;
+	      break;
+	    }
+	  }
+	  if (!c) {
+	    derr << "fsck error: stray object " << oid
+		 << " not owned by any collection" << dendl;
+	    ++range_errors;
+	    continue;
+	  }
+	  c->cid.is_pg(&pgid);
+	  dout(20) << "_fsck  collection " << c->cid << dendl;
 	}
-	if (used_nids.count(o->onode.nid)) {
-	  derr << "fsck error: " << oid << " nid " << o->onode.nid
-	       << " already in use" << dendl;
-	  ++errors;
-	  continue; // go for next object
+
+	if (!expecting_shards.empty()) {
+	  for (auto &k : expecting_shards) {
+	    derr << "fsck error: missing shard key "
+		 << pretty_binary_string(k) << dendl;
+	  }
+	  ++range_errors;
+	  expecting_shards.clear();
 	}
-	used_nids.insert(o->onode.nid);
-      }
-      ++num_objects;
-      num_spanning_blobs += o->extent_map.spanning_blob_map.size();
-      o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
-      _dump_onode(o, 30);
-      // shards
-      if (!o->extent_map.shards.empty()) {
-	++num_sharded_objects;
-	num_object_shards += o->extent_map.shards.size();
-      }
-      for (auto& s : o->extent_map.shards) {
-	dout(20) << __func__ << "    shard " << *s.shard_info << dendl;
-	expecting_shards.push_back(string());
-	get_extent_shard_key(o->key, s.shard_info->offset,
-			     &expecting_shards.back());
-	if (s.shard_info->offset >= o->onode.size) {
-	  derr << "fsck error: " << oid << " shard 0x" << std::hex
-	       << s.shard_info->offset << " past EOF at 0x" << o->onode.size
-	       << std::dec << dendl;
-	  ++errors;
+
+	dout(10) << "_fsck  " << oid << dendl;
+	RWLock::RLocker l(c->lock);
+	OnodeRef o = c->get_onode(oid, false);
+	if (o->onode.nid) {
+	  if (o->onode.nid > nid_max) {
+	    derr << "fsck error: " << oid << " nid " << o->onode.nid
+		 << " > nid_max " << nid_max << dendl;
+	    ++range_errors;
+	  }
+	  std::lock_guard<std::mutex> fl(fsck_lock);
+	  if (used_nids.count(o->onode.nid)) {
+	    derr << "fsck error: " << oid << " nid " << o->onode.nid
+		 << " already in use" << dendl;
+	    ++range_errors;
+	    continue; // go for next object
+	  }
+	  used_nids.insert(o->onode.nid);
 	}
-      }
-      // lextents
-      map<BlobRef,bluestore_blob_t::unused_t> referenced;
-      uint64_t pos = 0;
-      mempool::bluestore_fsck::map<BlobRef,
-				   bluestore_blob_use_tracker_t> ref_map;
-      for (auto& l : o->extent_map.extent_map) {
-	dout(20) << __func__ << "    " << l << dendl;
-	if (l.logical_offset < pos) {
-	  derr << "fsck error: " << oid << " lextent at 0x"
-	       << std::hex << l.logical_offset
-	       << " overlaps with the previous, which ends at 0x" << pos
-	       << std::dec << dendl;
-	  ++errors;
+	++num_objects;
+	num_spanning_blobs += o->extent_map.spanning_blob_map.size();
+	o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
+	_dump_onode(o, 30);
+	// shards
+	if (!o->extent_map.shards.empty()) {
+	  ++num_sharded_objects;
+	  num_object_shards += o->extent_map.shards.size();
 	}
-	if (o->extent_map.spans_shard(l.logical_offset, l.length)) {
-	  derr << "fsck error: " << oid << " lextent at 0x"
-	       << std::hex << l.logical_offset << "~" << l.length
-	       << " spans a shard boundary"
-	       << std::dec << dendl;
-	  ++errors;
+	for (auto& s : o->extent_map.shards) {
+	  dout(20) << "_fsck    shard " << *s.shard_info << dendl;
+	  expecting_shards.push_back(string());
+	  get_extent_shard_key(o->key, s.shard_info->offset,
+			       &expecting_shards.back());
+	  if (s.shard_info->offset >= o->onode.size) {
+	    derr << "fsck error: " << oid << " shard 0x" << std::hex
+		 << s.shard_info->offset << " past EOF at 0x" << o->onode.size
+		 << std::dec << dendl;
+	    ++range_errors;
+	  }
 	}
-	pos = l.logical_offset + l.length;
-	expected_statfs.stored += l.length;
-	assert(l.blob);
-	const bluestore_blob_t& blob = l.blob->get_blob();
-
-        auto& ref = ref_map[l.blob];
-        if (ref.is_empty()) {
-          uint32_t min_release_size = blob.get_release_size(min_alloc_size);
-          uint32_t l = blob.get_logical_length();
-          ref.init(l, min_release_size);
-        }
-	ref.get(
-	  l.blob_offset, 
-	  l.length);
-	++num_extents;
-	if (blob.has_unused()) {
-	  auto p = referenced.find(l.blob);
-	  bluestore_blob_t::unused_t *pu;
-	  if (p == referenced.end()) {
-	    pu = &referenced[l.blob];
-	  } else {
-	    pu = &p->second;
+	// lextents
+	mempool::bluestore_fsck::map<BlobRef,
+				     bluestore_blob_t::unused_t> referenced;
+	uint64_t pos = 0;
+	mempool::bluestore_fsck::map<BlobRef,
+				     bluestore_blob_use_tracker_t> ref_map;
+	for (auto& l : o->extent_map.extent_map) {
+	  dout(20) << "_fsck    " << l << dendl;
+	  if (l.logical_offset < pos) {
+	    derr << "fsck error: " << oid << " lextent at 0x"
+		 << std::hex << l.logical_offset
+		 << " overlaps with the previous, which ends at 0x" << pos
+		 << std::dec << dendl;
+	    ++range_errors;
+	  }
+	  if (o->extent_map.spans_shard(l.logical_offset, l.length)) {
+	    derr << "fsck error: " << oid << " lextent at 0x"
+		 << std::hex << l.logical_offset << "~" << l.length
+		 << " spans a shard boundary"
+		 << std::dec << dendl;
+	    ++range_errors;
+	  }
+	  pos = l.logical_offset + l.length;
+	  range_statfs.stored += l.length;
+	  assert(l.blob);
+	  const bluestore_blob_t& blob = l.blob->get_blob();
+
+	  auto& ref = ref_map[l.blob];
+	  if (ref.is_empty()) {
+	    uint32_t min_release_size = blob.get_release_size(min_alloc_size);
+	    uint32_t l = blob.get_logical_length();
+	    ref.init(l, min_release_size);
 	  }
-	  uint64_t blob_len = blob.get_logical_length();
-	  assert((blob_len % (sizeof(*pu)*8)) == 0);
-	  assert(l.blob_offset + l.length <= blob_len);
-	  uint64_t chunk_size = blob_len / (sizeof(*pu)*8);
-	  uint64_t start = l.blob_offset / chunk_size;
-	  uint64_t end =
-	    ROUND_UP_TO(l.blob_offset + l.length, chunk_size) / chunk_size;
-	  for (auto i = start; i < end; ++i) {
-	    (*pu) |= (1u << i);
+	  ref.get(
+	    l.blob_offset, 
+	    l.length);
+	  ++num_extents;
+	  if (blob.has_unused()) {
+	    auto p = referenced.find(l.blob);
+	    bluestore_blob_t::unused_t *pu;
+	    if (p == referenced.end()) {
+	      pu = &referenced[l.blob];
+	    } else {
+	      pu = &p->second;
+	    }
+	    uint64_t blob_len = blob.get_logical_length();
+	    assert((blob_len % (sizeof(*pu)*8)) == 0);
+	    assert(l.blob_offset + l.length <= blob_len);
+	    uint64_t chunk_size = blob_len / (sizeof(*pu)*8);
+	    uint64_t start = l.blob_offset / chunk_size;
+	    uint64_t end =
+	      ROUND_UP_TO(l.blob_offset + l.length, chunk_size) / chunk_size;
+	    for (auto i = start; i < end; ++i) {
+	      (*pu) |= (1u << i);
+	    }
 	  }
 	}
-      }
-      for (auto &i : referenced) {
-	dout(20) << __func__ << "  referenced 0x" << std::hex << i.second
-		 << std::dec << " for " << *i.first << dendl;
-	const bluestore_blob_t& blob = i.first->get_blob();
-	if (i.second & blob.unused) {
-	  derr << "fsck error: " << oid << " blob claims unused 0x"
-	       << std::hex << blob.unused
-	       << " but extents reference 0x" << i.second
-	       << " on blob " << *i.first << dendl;
-	  ++errors;
+	for (auto &i : referenced) {
+	  dout(20) << "_fsck  referenced 0x" << std::hex << i.second
+		   << std::dec << " for " << *i.first << dendl;
+	  const bluestore_blob_t& blob = i.first->get_blob();
+	  if (i.second & blob.unused) {
+	    derr << "fsck error: " << oid << " blob claims unused 0x"
+		 << std::hex << blob.unused
+		 << " but extents reference 0x" << i.second
+		 << " on blob " << *i.first << dendl;
+	    ++range_errors;
+	  }
+	  if (blob.has_csum()) {
+	    uint64_t blob_len = blob.get_logical_length();
+	    uint64_t unused_chunk_size = blob_len / (sizeof(blob.unused)*8);
+	    unsigned csum_count = blob.get_csum_count();
+	    unsigned csum_chunk_size = blob.get_csum_chunk_size();
+	    for (unsigned p = 0; p < csum_count; ++p) {
+	      unsigned pos = p * csum_chunk_size;
+	      unsigned firstbit = pos / unused_chunk_size;    // [firstbit,lastbit]
+	      unsigned lastbit = (pos + csum_chunk_size - 1) / unused_chunk_size;
+	      unsigned mask = 1u << firstbit;
+	      for (unsigned b = firstbit + 1; b <= lastbit; ++b) {
+		mask |= 1u << b;
+	      }
+	      if ((blob.unused & mask) == mask) {
+		// this csum chunk region is marked unused
+		if (blob.get_csum_item(p) != 0) {
+		  derr << "fsck error: " << oid
+		       << " blob claims csum chunk 0x" << std::hex << pos
+		       << "~" << csum_chunk_size
+		       << " is unused (mask 0x" << mask << " of unused 0x"
+		       << blob.unused << ") but csum is non-zero 0x"
+		       << blob.get_csum_item(p) << std::dec << " on blob "
+		       << *i.first << dendl;
+		  ++range_errors;
+		}
+	      }
+	    }
+	  }
 	}
-	if (blob.has_csum()) {
-	  uint64_t blob_len = blob.get_logical_length();
-	  uint64_t unused_chunk_size = blob_len / (sizeof(blob.unused)*8);
-	  unsigned csum_count = blob.get_csum_count();
-	  unsigned csum_chunk_size = blob.get_csum_chunk_size();
-	  for (unsigned p = 0; p < csum_count; ++p) {
-	    unsigned pos = p * csum_chunk_size;
-	    unsigned firstbit = pos / unused_chunk_size;    // [firstbit,lastbit]
-	    unsigned lastbit = (pos + csum_chunk_size - 1) / unused_chunk_size;
-	    unsigned mask = 1u << firstbit;
-	    for (unsigned b = firstbit + 1; b <= lastbit; ++b) {
-	      mask |= 1u << b;
+	for (auto &i : ref_map) {
+	  std::lock_guard<std::mutex> fl(fsck_lock);
+	  ++num_blobs;
+	  const bluestore_blob_t& blob = i.first->get_blob();
+	  bool equal = i.first->get_blob_use_tracker().equal(i.second);
+	  if (!equal) {
+	    derr << "fsck error: " << oid << " blob " << *i.first
+		 << " doesn't match expected ref_map " << i.second << dendl;
+	    ++range_errors;
+	  }
+	  if (blob.is_compressed()) {
+	    range_statfs.compressed += blob.get_compressed_payload_length();
+	    range_statfs.compressed_original += 
+	      i.first->get_referenced_bytes();
+	  }
+	  if (blob.is_shared()) {
+	    if (i.first->shared_blob->get_sbid() > blobid_max) {
+	      derr << "fsck error: " << oid << " blob " << blob
+		   << " sbid " << i.first->shared_blob->get_sbid() << " > blobid_max "
+		   << blobid_max << dendl;
+	      ++range_errors;
+	    } else if (i.first->shared_blob->get_sbid() == 0) {
+	      derr << "fsck error: " << oid << " blob " << blob
+		   << " marked as shared but has uninitialized sbid"
+		   << dendl;
+	      ++range_errors;
 	    }
-	    if ((blob.unused & mask) == mask) {
-	      // this csum chunk region is marked unused
-	      if (blob.get_csum_item(p) != 0) {
-		derr << "fsck error: " << oid
-		     << " blob claims csum chunk 0x" << std::hex << pos
-		     << "~" << csum_chunk_size
-		     << " is unused (mask 0x" << mask << " of unused 0x"
-		     << blob.unused << ") but csum is non-zero 0x"
-		     << blob.get_csum_item(p) << std::dec << " on blob "
-		     << *i.first << dendl;
-		++errors;
+	    sb_info_t& sbi = sb_info[i.first->shared_blob->get_sbid()];
+	    if (!sbi.sb) {
+	      sbi.oid = oid;
+	    }
+	    sbi.sb = i.first->shared_blob;
+	    sbi.compressed = blob.is_compressed();
+	    for (auto e : blob.get_extents()) {
+	      if (e.is_valid()) {
+		sbi.ref_map.get(e.offset, e.length);
 	      }
 	    }
+	  } else {
+	    range_errors += _fsck_check_extents(oid, blob.get_extents(),
+					  blob.is_compressed(),
+					  used_blocks,
+					  range_statfs);
 	  }
 	}
-      }
-      for (auto &i : ref_map) {
-	++num_blobs;
-	const bluestore_blob_t& blob = i.first->get_blob();
-	bool equal = i.first->get_blob_use_tracker().equal(i.second);
-	if (!equal) {
-	  derr << "fsck error: " << oid << " blob " << *i.first
-	       << " doesn't match expected ref_map " << i.second << dendl;
-	  ++errors;
-	}
-	if (blob.is_compressed()) {
-	  expected_statfs.compressed += blob.get_compressed_payload_length();
-	  expected_statfs.compressed_original += 
-	    i.first->get_referenced_bytes();
+	if (deep) {
+	  bufferlist bl;
+	  int r = _do_read(c.get(), o, 0, o->onode.size, bl, 0);
+	  if (r < 0) {
+	    ++range_errors;
+	    derr << "fsck error: " << oid << " error during read: "
+		 << cpp_strerror(r) << dendl;
+	  }
 	}
-	if (blob.is_shared()) {
-	  if (i.first->shared_blob->get_sbid() > blobid_max) {
-	    derr << "fsck error: " << oid << " blob " << blob
-		 << " sbid " << i.first->shared_blob->get_sbid() << " > blobid_max "
-		 << blobid_max << dendl;
-	    ++errors;
-	  } else if (i.first->shared_blob->get_sbid() == 0) {
-            derr << "fsck error: " << oid << " blob " << blob
-                 << " marked as shared but has uninitialized sbid"
-                 << dendl;
-            ++errors;
-          }
-	  sb_info_t& sbi = sb_info[i.first->shared_blob->get_sbid()];
-	  sbi.sb = i.first->shared_blob;
-	  sbi.oids.push_back(oid);
-	  sbi.compressed = blob.is_compressed();
-	  for (auto e : blob.get_extents()) {
-	    if (e.is_valid()) {
-	      sbi.ref_map.get(e.offset, e.length);
-	    }
+	// omap
+	if (o->onode.has_omap()) {
+	  std::lock_guard<std::mutex> fl(fsck_lock);
+	  auto& m =
+	    o->onode.is_pgmeta_omap() ? used_pgmeta_omap_head : used_omap_head;
+	  if (m.count(o->onode.nid)) {
+	    derr << "fsck error: " << oid << " omap_head " << o->onode.nid
+		 << " already in use" << dendl;
+	    ++range_errors;
+	  } else {
+	    m.insert(o->onode.nid);
 	  }
-	} else {
-	  errors += _fsck_check_extents(oid, blob.get_extents(),
-					blob.is_compressed(),
-					used_blocks,
-					expected_statfs);
-        }
-      }
-      if (deep) {
-	bufferlist bl;
-	int r = _do_read(c.get(), o, 0, o->onode.size, bl, 0);
-	if (r < 0) {
-	  ++errors;
-	  derr << "fsck error: " << oid << " error during read: "
-	       << cpp_strerror(r) << dendl;
 	}
       }
-      // omap
-      if (o->onode.has_omap()) {
-	auto& m =
-	  o->onode.is_pgmeta_omap() ? used_pgmeta_omap_head : used_omap_head;
-	if (m.count(o->onode.nid)) {
-	  derr << "fsck error: " << oid << " omap_head " << o->onode.nid
-	       << " already in use" << dendl;
-	  ++errors;
-	} else {
-	  m.insert(o->onode.nid);
+      std::lock_guard<std::mutex> fl(fsck_lock);
+      errors += range_errors;
+      expected_statfs.allocated += range_statfs.allocated;
+      expected_statfs.stored += range_statfs.stored;
+      expected_statfs.compressed += range_statfs.compressed;
+      expected_statfs.compressed_original += range_statfs.compressed_original;
+      expected_statfs.compressed_allocated +=
+	range_statfs.compressed_allocated;
+    };
+
+    unsigned num_threads = MAX(1, cct->_conf->bluestore_fsck_threads);
+    dout(10) << __func__ << " " << ranges.size() << " key ranges, "
+	     << num_threads << " threads" << dendl;
+    std::mutex qlock;
+    std::condition_variable qcond;
+    size_t next_range = 0;
+    unsigned running = num_threads;
+    vector<std::thread> workers;
+    for (unsigned i = 0; i < num_threads; ++i) {
+      workers.emplace_back([&] {
+	  std::unique_lock<std::mutex> l(qlock);
+	  while (next_range < ranges.size() &&
+		 !g_conf->bluestore_debug_fsck_abort) {
+	    auto& range = ranges[next_range++];
+	    l.unlock();
+	    walk_objects(range.first, range.second);
+	    l.lock();
+	  }
+	  --running;
+	  qcond.notify_all();
+	});
+    }
+    {
+      double interval = cct->_conf->bluestore_fsck_progress_interval;
+      utime_t walk_start = ceph_clock_now();
+      std::unique_lock<std::mutex> l(qlock);
+      while (running) {
+	if (interval <= 0) {
+	  qcond.wait(l);
+	  continue;
+	}
+	qcond.wait_for(l, ceph::make_timespan(interval));
+	if (!running) {
+	  break;
 	}
+	double elapsed = ceph_clock_now() - walk_start;
+	dout(1) << __func__ << " walked " << num_objects << " objects, "
+		<< next_range << "/" << ranges.size() << " key ranges started, "
+		<< (uint64_t)(num_objects / elapsed) << " objects/sec" << dendl;
       }
     }
+    for (auto& t : workers) {
+      t.join();
+    }
+    if (g_conf->bluestore_debug_fsck_abort) {
+      goto out_scan;
+    }
   }
   dout(1) << __func__ << " checking shared_blobs" << dendl;
   it = db->get_iterator(PREFIX_SHARED_BLOB);
@@ -6044,7 +6962,7 @@ int BlueStore::_fsck(bool deep, bool repair)
 	for (auto &r : shared_blob.ref_map.ref_map) {
 	  extents.emplace_back(bluestore_pextent_t(r.first, r.second.length));
 	}
-	errors += _fsck_check_extents(p->second.oids.front(),
+	errors += _fsck_check_extents(p->second.oid,
 				      extents,
 				      p->second.compressed,
 				      used_blocks, expected_statfs);
@@ -6189,6 +7107,9 @@ int BlueStore::_fsck(bool deep, bool repair)
     }
   }
 
+  dout(1) << __func__ << " checking allocator checkpoint" << dendl;
+  errors += _fsck_alloc_checkpoint();
+
  out_scan:
   mempool_thread.shutdown();
   _flush_cache();
@@ -6220,12 +7141,60 @@ int BlueStore::_fsck(bool deep, bool repair)
 	  << dendl;
 
   utime_t duration = ceph_clock_now() - start;
+  last_fsck_stats.num_objects = num_objects;
+  last_fsck_stats.bytes = expected_statfs.stored;
+  last_fsck_stats.duration = duration;
   dout(1) << __func__ << " finish with " << errors << " errors, " << repaired
 	  << " repaired, " << (errors - repaired) << " remaining in "
 	  << duration << " seconds" << dendl;
   return errors - repaired;
 }
 
+int BlueStore::migrate_column_families(ostream& out)
+{
+  std::vector<KeyValueDB::ColumnFamily> cfs;
+  if (cct->_conf->get_val<bool>("bluestore_rocksdb_cf")) {
+    _get_rocksdb_cfs(&cfs);
+  }
+  dout(1) << __func__ << " to " << cfs.size() << " column families" << dendl;
+
+  int r = _open_path();
+  if (r < 0)
+    return r;
+  r = _open_fsid(false);
+  if (r < 0)
+    goto out_path;
+  r = _read_fsid(&fsid);
+  if (r < 0)
+    goto out_fsid;
+  r = _lock_fsid();
+  if (r < 0)
+    goto out_fsid;
+  r = _open_bdev(false);
+  if (r < 0)
+    goto out_fsid;
+  r = _open_db(false);
+  if (r < 0)
+    goto out_bdev;
+
+  r = db->migrate_column_families(out, cfs);
+  if (r < 0) {
+    derr << __func__ << " failed: " << cpp_strerror(r) << dendl;
+  } else {
+    // drop the tombstones left behind in the default column family
+    db->compact();
+  }
+
+  _close_db();
+ out_bdev:
+  _close_bdev();
+ out_fsid:
+  _close_fsid();
+ out_path:
+  _close_path();
+  return r;
+}
+
 void BlueStore::collect_metadata(map<string,string> *pm)
 {
   dout(10) << __func__ << dendl;
@@ -6324,24 +7293,150 @@ void BlueStore::_reap_collections()
   if (all_reaped) {
     dout(10) << __func__ << " all reaped" << dendl;
   }
-}
+}
+
+void BlueStore::_update_cache_logger()
+{
+  uint64_t num_onodes = 0;
+  uint64_t num_extents = 0;
+  uint64_t num_blobs = 0;
+  uint64_t num_buffers = 0;
+  uint64_t num_buffer_bytes = 0;
+  for (auto c : cache_shards) {
+    c->add_stats(&num_onodes, &num_extents, &num_blobs,
+		 &num_buffers, &num_buffer_bytes);
+  }
+  logger->set(l_bluestore_onodes, num_onodes);
+  logger->set(l_bluestore_extents, num_extents);
+  logger->set(l_bluestore_blobs, num_blobs);
+  logger->set(l_bluestore_buffers, num_buffers);
+  logger->set(l_bluestore_buffer_bytes, num_buffer_bytes);
+  logger->set(l_bluestore_cache_target_bytes, cache_size);
+  logger->set(l_bluestore_cache_meta_target_bytes, cache_size * cache_meta_ratio);
+  logger->set(l_bluestore_cache_kv_target_bytes, cache_size * cache_kv_ratio);
+  logger->set(l_bluestore_cache_data_target_bytes, cache_size * cache_data_ratio);
+}
+
+/*
+ * Resize the cache toward osd_memory_target and move one chunk from
+ * the cache that benefits least to the one that misses most.
+ *
+ * The total is osd_memory_target minus whatever the process uses that is
+ * not cache: the larger of the mempool-tracked non-cache memory and the
+ * resident set less the caches, so that untracked heap (rocksdb block
+ * cache overhead, allocator fragmentation, ...) is charged too.  Within it, each cache is compared by its miss ratio
+ * over the last interval.  Only caches that have filled their current
+ * target can receive memory (anything else would not use it), and a
+ * cache that is not filling its target is always the first donor.
+ */
+void BlueStore::_autotune_cache()
+{
+  uint64_t hits[CACHE_POOL_MAX], misses[CACHE_POOL_MAX];
+  hits[CACHE_POOL_META] = logger->get(l_bluestore_onode_hits);
+  misses[CACHE_POOL_META] = logger->get(l_bluestore_onode_misses);
+  hits[CACHE_POOL_DATA] = logger->get(l_bluestore_buffer_hit_bytes);
+  misses[CACHE_POOL_DATA] = logger->get(l_bluestore_buffer_miss_bytes);
+  if (db->get_cache_stats(&hits[CACHE_POOL_KV], &misses[CACHE_POOL_KV]) < 0) {
+    hits[CACHE_POOL_KV] = misses[CACHE_POOL_KV] = 0;
+  }
+
+  uint64_t usage[CACHE_POOL_MAX];
+  usage[CACHE_POOL_META] =
+    mempool::bluestore_cache_onode::allocated_bytes() +
+    mempool::bluestore_cache_other::allocated_bytes();
+  usage[CACHE_POOL_DATA] = mempool::bluestore_cache_data::allocated_bytes();
+  int64_t kv_usage = db->get_cache_usage();
+  usage[CACHE_POOL_KV] = kv_usage > 0 ? kv_usage : 0;
+
+  // everything the mempools track that is not one of our caches
+  uint64_t tracked = 0;
+  for (size_t i = 0; i < mempool::num_pools; ++i) {
+    tracked += mempool::get_pool((mempool::pool_index_t)i).allocated_bytes();
+  }
+  uint64_t cached = usage[CACHE_POOL_META] + usage[CACHE_POOL_DATA];
+  uint64_t other = tracked > cached ? tracked - cached : 0;
+
+  // and what the process actually has resident
+  MemoryModel mm(cct);
+  MemoryModel::snap snap;
+  mm.sample(&snap);
+  uint64_t rss = (uint64_t)snap.get_rss() << 10;
+  uint64_t in_caches = cached + usage[CACHE_POOL_KV];
+  uint64_t untracked = rss > in_caches ? rss - in_caches : 0;
+  other = MAX(other, untracked);
+  uint64_t target = cct->_conf->osd_memory_target;
+  uint64_t new_size = target > other ? target - other : 0;
+  new_size = MAX(new_size, cct->_conf->osd_memory_cache_min);
+
+  double ratio[CACHE_POOL_MAX] = {
+    cache_meta_ratio, cache_kv_ratio, cache_data_ratio
+  };
+  const char *names[CACHE_POOL_MAX] = { "meta", "kv", "data" };
+  uint64_t chunk = cct->_conf->bluestore_cache_autotune_chunk_size;
+  int64_t allot[CACHE_POOL_MAX];
+  double miss_ratio[CACHE_POOL_MAX];
+  int recipient = -1, donor = -1;
+  for (int i = 0; i < CACHE_POOL_MAX; ++i) {
+    allot[i] = ratio[i] * cache_size;
+    uint64_t dh = hits[i] - cache_autotune_hits[i];
+    uint64_t dm = misses[i] - cache_autotune_misses[i];
+    miss_ratio[i] = (dh + dm) ? (double)dm / (double)(dh + dm) : 0;
+    cache_autotune_hits[i] = hits[i];
+    cache_autotune_misses[i] = misses[i];
+    bool full = usage[i] + chunk >= (uint64_t)allot[i];
+    dout(20) << __func__ << " " << names[i] << " target " << allot[i]
+	     << " usage " << usage[i] << " hits " << dh << " misses " << dm
+	     << " miss_ratio " << miss_ratio[i] << (full ? " full" : "")
+	     << dendl;
+    if (full && dm &&
+	(recipient < 0 || miss_ratio[i] > miss_ratio[recipient])) {
+      recipient = i;
+    }
+  }
+  if (recipient >= 0) {
+    double donor_score = 0;
+    for (int i = 0; i < CACHE_POOL_MAX; ++i) {
+      if (i == recipient || allot[i] < (int64_t)(2 * chunk)) {
+	continue;
+      }
+      // unused target is free to take
+      double score = usage[i] + chunk < (uint64_t)allot[i] ? -1 : miss_ratio[i];
+      if (donor < 0 || score < donor_score) {
+	donor = i;
+	donor_score = score;
+      }
+    }
+    // leave some hysteresis so we don't flap between two busy caches
+    if (donor >= 0 && donor_score >= miss_ratio[recipient] * 0.9) {
+      donor = -1;
+    }
+  }
+  if (donor >= 0) {
+    allot[donor] -= chunk;
+    allot[recipient] += chunk;
+    logger->inc(l_bluestore_cache_autotune_shifts);
+  }
 
-void BlueStore::_update_cache_logger()
-{
-  uint64_t num_onodes = 0;
-  uint64_t num_extents = 0;
-  uint64_t num_blobs = 0;
-  uint64_t num_buffers = 0;
-  uint64_t num_buffer_bytes = 0;
-  for (auto c : cache_shards) {
-    c->add_stats(&num_onodes, &num_extents, &num_blobs,
-		 &num_buffers, &num_buffer_bytes);
+  int64_t total = allot[0] + allot[1] + allot[2];
+  if (total <= 0) {
+    return;
   }
-  logger->set(l_bluestore_onodes, num_onodes);
-  logger->set(l_bluestore_extents, num_extents);
-  logger->set(l_bluestore_blobs, num_blobs);
-  logger->set(l_bluestore_buffers, num_buffers);
-  logger->set(l_bluestore_buffer_bytes, num_buffer_bytes);
+  cache_size = new_size;
+  cache_meta_ratio = (double)allot[CACHE_POOL_META] / total;
+  cache_kv_ratio = (double)allot[CACHE_POOL_KV] / total;
+  cache_data_ratio = MAX(0.0, 1.0 - cache_meta_ratio - cache_kv_ratio);
+  db->set_cache_capacity(cache_size * cache_kv_ratio);
+
+  dout(10) << __func__ << " cache_size " << cache_size
+	   << " (other " << other << ", rss " << rss << ")"
+	   << " meta " << cache_meta_ratio
+	   << " kv " << cache_kv_ratio
+	   << " data " << cache_data_ratio;
+  if (donor >= 0) {
+    *_dout << " moved " << chunk << " from " << names[donor]
+	   << " to " << names[recipient];
+  }
+  *_dout << dendl;
 }
 
 // ---------------
@@ -6482,9 +7577,20 @@ int BlueStore::read(
     if (offset == length && offset == 0)
       length = o->onode.size;
 
-    r = _do_read(c, o, offset, length, bl, op_flags);
+    uint64_t zerocopy = 0;
+    r = _do_read(c, o, offset, length, bl, op_flags, &zerocopy);
+    if (r >= 0) {
+      logger->inc(l_bluestore_read_bytes, r);
+      logger->inc(l_bluestore_read_zerocopy_bytes, zerocopy);
+    }
     if (r == -EIO) {
       logger->inc(l_bluestore_read_eio);
+    } else if (r > 0 &&
+	       cct->_conf->bluestore_readahead_max_bytes &&
+	       (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_RANDOM |
+			    CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+			    CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0) {
+      _readahead(c, o, offset, r);
     }
   }
 
@@ -6540,7 +7646,8 @@ int BlueStore::_do_read(
   uint64_t offset,
   size_t length,
   bufferlist& bl,
-  uint32_t op_flags)
+  uint32_t op_flags,
+  uint64_t *zerocopy_bytes)
 {
   FUNCTRACE();
   int r = 0;
@@ -6572,11 +7679,15 @@ int BlueStore::_do_read(
   }
 
   utime_t start = ceph_clock_now();
-  o->extent_map.fault_range(db, offset, length);
+  o->extent_map.fault_range_for_read(db, offset, length);
   logger->tinc(l_bluestore_read_onode_meta_lat, ceph_clock_now() - start);
   _dump_onode(o);
 
   ready_regions_t ready_regions;
+  // bytes of the result that are slices of the cached or freshly read
+  // device buffers, as opposed to decompressed data or zero fill.  those
+  // buffers are page aligned and go all the way to the messenger as is.
+  uint64_t zerocopy = 0;
 
   // build blob-wise list to of stuff read (that isn't cached)
   blobs2read_t blobs2read;
@@ -6616,6 +7727,7 @@ int BlueStore::_do_read(
 	  pc->first == b_off) {
 	l = pc->second.length();
 	ready_regions[pos].claim(pc->second);
+	zerocopy += l;
 	dout(30) << __func__ << "    use cache 0x" << std::hex << pos << ": 0x"
 		 << b_off << "~" << l << std::dec << dendl;
 	++pc;
@@ -6780,6 +7892,7 @@ int BlueStore::_do_read(
 	// prune and keep result
 	ready_regions[reg.logical_offset].substr_of(
 	  reg.bl, reg.front, reg.length);
+	zerocopy += reg.length;
       }
     }
     ++b2r_it;
@@ -6813,10 +7926,209 @@ int BlueStore::_do_read(
   assert(bl.length() == length);
   assert(pos == length);
   assert(pr == pr_end);
+  if (zerocopy_bytes) {
+    *zerocopy_bytes = zerocopy;
+  }
   r = bl.length();
   return r;
 }
 
+// readahead
+//
+// reads that pick up where the previous read of the same onode left off
+// get a Readahead tracker.  once it decides the stream is sequential we
+// fetch the next window with aio and park it in the blobs' BufferSpace,
+// so the following reads are cache hits.  nothing waits for the
+// prefetch; if the object changed before it completes the data is
+// dropped.
+
+struct BlueStore::ReadaheadContext : public BlueStore::AioContext {
+  CollectionRef c;
+  OnodeRef o;
+  uint64_t write_seq;   ///< o->write_seq when the reads were issued
+  IOContext ioc;
+  blobs2read_t blobs2read;
+
+  ReadaheadContext(CephContext *cct, Collection *c, OnodeRef& o)
+    : c(c), o(o), write_seq(o->write_seq),
+      ioc(cct, static_cast<AioContext*>(this), true) {}
+
+  void aio_finish(BlueStore *store) override {
+    store->_readahead_finish(this, false);
+  }
+};
+
+void BlueStore::_readahead(
+  Collection *c,
+  OnodeRef& o,
+  uint64_t offset,
+  uint64_t length)
+{
+  uint64_t prev_end = o->last_read_end.exchange(offset + length);
+  Readahead *ra = o->readahead.load();
+  if (!ra) {
+    if (prev_end == 0 || offset != prev_end) {
+      return;
+    }
+    ra = new Readahead;
+    ra->set_trigger_requests(cct->_conf->bluestore_readahead_trigger_requests);
+    ra->set_min_readahead_size(cct->_conf->bluestore_readahead_min_bytes);
+    ra->set_max_readahead_size(cct->_conf->bluestore_readahead_max_bytes);
+    ra->set_alignments({min_alloc_size});
+    Readahead *expected = nullptr;
+    if (!o->readahead.compare_exchange_strong(expected, ra)) {
+      delete ra;
+      ra = expected;
+    }
+  }
+  Readahead::extent_t e = ra->update(offset, length, o->onode.size);
+  if (e.second == 0) {
+    return;
+  }
+  _readahead_issue(c, o, e.first, e.second);
+}
+
+void BlueStore::_readahead_issue(
+  Collection *c,
+  OnodeRef& o,
+  uint64_t offset,
+  uint64_t length)
+{
+  dout(20) << __func__ << " " << o->oid << " 0x" << std::hex << offset
+	   << "~" << length << std::dec << dendl;
+  o->extent_map.fault_range_for_read(db, offset, length);
+
+  // same walk as _do_read, minus what is already cached.  compressed
+  // blobs would need decompressing on completion; leave them alone.
+  ReadaheadContext *rc = new ReadaheadContext(cct, c, o);
+  uint64_t end = offset + length;
+  for (auto lp = o->extent_map.seek_lextent(offset);
+       lp != o->extent_map.extent_map.end() && lp->logical_offset < end;
+       ++lp) {
+    BlobRef bptr = lp->blob;
+    if (bptr->get_blob().is_compressed()) {
+      continue;
+    }
+    uint64_t pos = MAX(offset, lp->logical_offset);
+    unsigned b_off = pos - lp->logical_offset + lp->blob_offset;
+    unsigned b_len = MIN(end, lp->logical_end()) - pos;
+
+    // not a client read: leave the hit/miss counters the cache
+    // autotuner goes by, and the LRU, alone
+    interval_set<uint32_t> cache_interval;
+    bptr->shared_blob->bc.get_cached(
+      bptr->shared_blob->get_cache(), b_off, b_len, cache_interval);
+    interval_set<uint32_t> want;
+    want.insert(b_off, b_len);
+    want.subtract(cache_interval);
+    for (auto p = want.begin(); p != want.end(); ++p) {
+      rc->blobs2read[bptr].emplace_back(
+	region_t(pos + p.get_start() - b_off, p.get_start(), p.get_len()));
+    }
+  }
+
+  for (auto& p : rc->blobs2read) {
+    BlobRef bptr = p.first;
+    uint64_t chunk_size = bptr->get_blob().get_chunk_size(block_size);
+    for (auto& reg : p.second) {
+      reg.r_off = reg.blob_xoffset;
+      uint64_t r_len = reg.length;
+      reg.front = reg.r_off % chunk_size;
+      if (reg.front) {
+	reg.r_off -= reg.front;
+	r_len += reg.front;
+      }
+      unsigned tail = r_len % chunk_size;
+      if (tail) {
+	r_len += chunk_size - tail;
+      }
+      int r = bptr->get_blob().map(
+	reg.r_off, r_len,
+	[&](uint64_t offset, uint64_t length) {
+	  return bdev->aio_read(offset, length, &reg.bl, &rc->ioc);
+	});
+      if (r < 0) {
+	dout(10) << __func__ << " aio_read failed: " << cpp_strerror(r)
+		 << dendl;
+	rc->ioc.set_return_value(r);
+      }
+    }
+  }
+
+  if (rc->blobs2read.empty()) {
+    delete rc;
+    return;
+  }
+  logger->inc(l_bluestore_readahead);
+  if (!rc->ioc.has_pending_aios()) {
+    // the device did the reads synchronously
+    _readahead_finish(rc, true);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> l(readahead_lock);
+    ++readahead_inflight;
+  }
+  bdev->aio_submit(&rc->ioc);
+}
+
+void BlueStore::_readahead_finish(ReadaheadContext *rc, bool locked)
+{
+  OnodeRef o = rc->o;
+  uint64_t bytes = 0;
+  bool ok = false;
+  // readers hold c->lock for read, so the onode can't be changing under
+  // us while we hold it too.  don't block the aio thread on a writer,
+  // though; the prefetch is only a hint.
+  if (rc->ioc.get_return_value() >= 0 &&
+      (locked || rc->c->lock.try_get_read())) {
+    if (o->exists && o->c == rc->c.get() && o->write_seq == rc->write_seq) {
+      ok = true;
+      for (auto& p : rc->blobs2read) {
+	BlobRef bptr = p.first;
+	for (auto& reg : p.second) {
+	  if (reg.bl.length() == 0 ||
+	      _verify_csum(o, &bptr->get_blob(), reg.r_off, reg.bl,
+			   reg.logical_offset) < 0) {
+	    ok = false;
+	    continue;
+	  }
+	  bufferlist bl;
+	  bl.substr_of(reg.bl, reg.front, reg.length);
+	  bptr->shared_blob->bc.did_read(bptr->shared_blob->get_cache(),
+					 reg.blob_xoffset, bl,
+					 Buffer::FLAG_READAHEAD);
+	  bytes += reg.length;
+	}
+      }
+    }
+    if (!locked) {
+      rc->c->lock.put_read();
+    }
+  }
+  dout(20) << __func__ << " " << o->oid << " cached 0x" << std::hex << bytes
+	   << std::dec << (ok ? "" : ", dropped") << dendl;
+  logger->inc(l_bluestore_readahead_bytes, bytes);
+  if (!ok) {
+    logger->inc(l_bluestore_readahead_dropped);
+  }
+  delete rc;
+  if (!locked) {
+    std::lock_guard<std::mutex> l(readahead_lock);
+    if (--readahead_inflight == 0) {
+      readahead_cond.notify_all();
+    }
+  }
+}
+
+void BlueStore::_readahead_drain()
+{
+  std::unique_lock<std::mutex> l(readahead_lock);
+  while (readahead_inflight) {
+    readahead_cond.wait(l);
+  }
+}
+
 int BlueStore::_verify_csum(OnodeRef& o,
 			    const bluestore_blob_t* blob, uint64_t blob_xoffset,
 			    const bufferlist& bl,
@@ -6917,7 +8229,7 @@ int BlueStore::_fiemap(
       length = o->onode.size - offset;
     }
 
-    o->extent_map.fault_range(db, offset, length);
+    o->extent_map.fault_range_for_read(db, offset, length);
     eend = o->extent_map.extent_map.end();
     ep = o->extent_map.seek_lextent(offset);
     while (length > 0) {
@@ -7785,6 +9097,8 @@ int BlueStore::_open_super_meta()
   _set_csum();
   _set_compression();
   _set_blob_size();
+  _set_txc_trace();
+  _set_extent_map_lazy_decode();
 
   return 0;
 }
@@ -7796,6 +9110,7 @@ int BlueStore::_upgrade_super()
   assert(ondisk_format > 0);
   assert(ondisk_format < latest_ondisk_format);
 
+  KeyValueDB::Transaction t = db->get_transaction();
   if (ondisk_format == 1) {
     // changes:
     // - super: added ondisk_format
@@ -7803,7 +9118,6 @@ int BlueStore::_upgrade_super()
     // - super: added min_compat_ondisk_format
     // - super: added min_alloc_size
     // - super: removed min_min_alloc_size
-    KeyValueDB::Transaction t = db->get_transaction();
     {
       bufferlist bl;
       db->get(PREFIX_SUPER, "min_min_alloc_size", &bl);
@@ -7820,10 +9134,16 @@ int BlueStore::_upgrade_super()
       t->rmkey(PREFIX_SUPER, "min_min_alloc_size");
     }
     ondisk_format = 2;
-    _prepare_ondisk_format_super(t);
-    int r = db->submit_transaction_sync(t);
-    assert(r == 0);
   }
+  if (ondisk_format == 2) {
+    // changes:
+    // - alloc: PREFIX_ALLOC_CHECKPOINT, present only with
+    //   min_compat_ondisk_format raised to 3
+    ondisk_format = 3;
+  }
+  _prepare_ondisk_format_super(t);
+  int r = db->submit_transaction_sync(t);
+  assert(r == 0);
 
   // done
   dout(1) << __func__ << " done" << dendl;
@@ -7854,12 +9174,16 @@ uint64_t BlueStore::_assign_blobid(TransContext *txc)
 void BlueStore::get_db_statistics(Formatter *f)
 {
   db->get_statistics(f);
+  if (bluefs) {
+    bluefs->dump_placement(f);
+  }
 }
 
 BlueStore::TransContext *BlueStore::_txc_create(OpSequencer *osr)
 {
   TransContext *txc = new TransContext(cct, osr);
   txc->t = db->get_transaction();
+  txc->trace.enabled = txc_trace;
   osr->queue_new(txc);
   dout(20) << __func__ << " osr " << osr << " = " << txc
 	   << " seq " << txc->seq << dendl;
@@ -8226,18 +9550,35 @@ void BlueStore::_txc_committed_kv(TransContext *txc)
     txc->onreadable_sync = NULL;
   }
   unsigned n = txc->osr->parent->shard_hint.hash_to_shard(m_finisher_num);
+  // the sequencer's owner may want to run its completions itself
+  ObjectStore::CommitQueue *cq = txc->osr->parent->commit_queue;
   if (txc->oncommit) {
     logger->tinc(l_bluestore_commit_lat, ceph_clock_now() - txc->start);
-    finishers[n]->queue(txc->oncommit);
+    if (cq) {
+      cq->queue(txc->oncommit);
+    } else {
+      finishers[n]->queue(txc->oncommit);
+    }
     txc->oncommit = NULL;
   }
   if (txc->onreadable) {
-    finishers[n]->queue(txc->onreadable);
+    if (cq) {
+      cq->queue(txc->onreadable);
+    } else {
+      finishers[n]->queue(txc->onreadable);
+    }
     txc->onreadable = NULL;
   }
 
   if (!txc->oncommits.empty()) {
-    finishers[n]->queue(txc->oncommits);
+    if (cq) {
+      for (auto c : txc->oncommits) {
+	cq->queue(c);
+      }
+      txc->oncommits.clear();
+    } else {
+      finishers[n]->queue(txc->oncommits);
+    }
   }
 }
 
@@ -8301,6 +9642,9 @@ void BlueStore::_txc_finish(TransContext *txc)
     _txc_release_alloc(txc);
     releasing_txc.pop_front();
     txc->log_state_latency(logger, l_bluestore_state_done_lat);
+    if (txc->trace.enabled) {
+      _txc_trace_finish(txc);
+    }
     delete txc;
   }
 
@@ -8316,6 +9660,73 @@ void BlueStore::_txc_finish(TransContext *txc)
   }
 }
 
+void BlueStore::SlowTxc::dump(Formatter *f) const
+{
+  f->dump_stream("start") << start;
+  f->dump_float("lat", (double)lat);
+  f->dump_unsigned("seq", seq);
+  f->dump_string("osr", osr);
+  f->dump_unsigned("bytes", bytes);
+  f->dump_bool("deferred", deferred);
+  // each event marks the end of the named phase; break the total down
+  f->open_array_section("events");
+  uint32_t last = 0;
+  for (auto& e : events) {
+    f->open_object_section("event");
+    f->dump_string("name", e.name);
+    f->dump_unsigned("at_us", e.usec);
+    f->dump_unsigned("took_us", e.usec - last);
+    f->close_section();
+    last = e.usec;
+  }
+  f->close_section();
+}
+
+void BlueStore::_txc_trace_finish(TransContext *txc)
+{
+  const TxcTrace& trace = txc->trace;
+  utime_t lat = ceph_clock_now() - txc->start;
+  if (lat.to_nsec() / 1000 < txc_trace_slow_usec) {
+    return;
+  }
+  dout(10) << __func__ << " txc " << txc << " seq " << txc->seq
+	   << " took " << lat << dendl;
+
+  SlowTxc st;
+  st.start = txc->start;
+  st.lat = lat;
+  st.seq = txc->seq;
+  st.bytes = txc->bytes;
+  st.deferred = txc->deferred_txn != nullptr;
+  st.osr = txc->osr->name;
+  st.events.assign(trace.events, trace.events + trace.num_events);
+
+  uint64_t history =
+    cct->_conf->get_val<uint64_t>("bluestore_txc_trace_history");
+  std::lock_guard<std::mutex> l(txc_trace_lock);
+  slow_txcs.push_back(std::move(st));
+  while (slow_txcs.size() > history) {
+    slow_txcs.pop_front();
+  }
+  logger->inc(l_bluestore_txc_slow_traced);
+}
+
+void BlueStore::dump_slow_transactions(Formatter *f)
+{
+  std::lock_guard<std::mutex> l(txc_trace_lock);
+  f->open_object_section("slow_transactions");
+  f->dump_bool("tracing", txc_trace);
+  f->dump_float("threshold", (double)txc_trace_slow_usec / 1000000.0);
+  f->open_array_section("transactions");
+  for (auto& st : slow_txcs) {
+    f->open_object_section("transaction");
+    st.dump(f);
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+}
+
 void BlueStore::_txc_release_alloc(TransContext *txc)
 {
   interval_set<uint64_t> bulk_release_extents;
@@ -8340,11 +9751,13 @@ void BlueStore::_osr_drain_preceding(TransContext *txc)
   ++deferred_aggressive; // FIXME: maybe osr-local aggressive flag?
   {
     // submit anything pending
-    deferred_lock.lock();
+    std::unique_lock<std::mutex> l(deferred_lock);
     if (osr->deferred_pending) {
-      _deferred_submit_unlock(osr);
-    } else {
-      deferred_lock.unlock();
+      if (cct->_conf->bluestore_deferred_global_batch) {
+	_deferred_submit_global_unlock(l);
+      } else {
+	_deferred_submit_unlock(l, osr);
+      }
     }
   }
   {
@@ -8444,9 +9857,16 @@ void BlueStore::_kv_start()
   }
 
   deferred_finisher.start();
+  onode_filter_stop = false;
+  onode_filter_finisher.start();
   for (auto f : finishers) {
     f->start();
   }
+  for (int i = 0; i < cct->_conf->bluestore_kv_submit_lanes; ++i) {
+    KVSubmitLane *lane = new KVSubmitLane(this, i);
+    kv_submit_lanes.push_back(lane);
+    lane->create("bstore_kv_lane");
+  }
   kv_sync_thread.create("bstore_kv_sync");
   kv_finalize_thread.create("bstore_kv_final");
 }
@@ -8472,6 +9892,19 @@ void BlueStore::_kv_stop()
   }
   kv_sync_thread.join();
   kv_finalize_thread.join();
+  if (!kv_submit_lanes.empty()) {
+    {
+      std::lock_guard<std::mutex> l(kv_submit_lock);
+      kv_submit_stop = true;
+      kv_submit_cond.notify_all();
+    }
+    for (auto lane : kv_submit_lanes) {
+      lane->join();
+      delete lane;
+    }
+    kv_submit_lanes.clear();
+    kv_submit_stop = false;
+  }
   {
     std::lock_guard<std::mutex> l(kv_lock);
     kv_stop = false;
@@ -8483,6 +9916,9 @@ void BlueStore::_kv_stop()
   dout(10) << __func__ << " stopping finishers" << dendl;
   deferred_finisher.wait_for_empty();
   deferred_finisher.stop();
+  onode_filter_stop = true;
+  onode_filter_finisher.wait_for_empty();
+  onode_filter_finisher.stop();
   for (auto f : finishers) {
     f->wait_for_empty();
     f->stop();
@@ -8571,49 +10007,53 @@ void BlueStore::_kv_sync_thread()
       // case where we are approaching the max and the case we passed
       // it.  in either case, we increase the max in the earlier txn
       // we submit.
+      //
+      // with submit lanes the front txc is not necessarily submitted
+      // first, so use a separate txn that we submit ahead of the lanes.
       uint64_t new_nid_max = 0, new_blobid_max = 0;
       if (nid_last + cct->_conf->bluestore_nid_prealloc/2 > nid_max) {
-	KeyValueDB::Transaction t =
-	  kv_submitting.empty() ? synct : kv_submitting.front()->t;
 	new_nid_max = nid_last + cct->_conf->bluestore_nid_prealloc;
-	bufferlist bl;
-	::encode(new_nid_max, bl);
-	t->set(PREFIX_SUPER, "nid_max", bl);
 	dout(10) << __func__ << " new_nid_max " << new_nid_max << dendl;
       }
       if (blobid_last + cct->_conf->bluestore_blobid_prealloc/2 > blobid_max) {
-	KeyValueDB::Transaction t =
-	  kv_submitting.empty() ? synct : kv_submitting.front()->t;
 	new_blobid_max = blobid_last + cct->_conf->bluestore_blobid_prealloc;
-	bufferlist bl;
-	::encode(new_blobid_max, bl);
-	t->set(PREFIX_SUPER, "blobid_max", bl);
 	dout(10) << __func__ << " new_blobid_max " << new_blobid_max << dendl;
       }
-
-      for (auto txc : kv_committing) {
-	if (txc->state == TransContext::STATE_KV_QUEUED) {
-	  txc->log_state_latency(logger, l_bluestore_state_kv_queued_lat);
-	  int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction(txc->t);
+      if (new_nid_max || new_blobid_max) {
+	KeyValueDB::Transaction maxt = synct;
+	if (!kv_submitting.empty()) {
+	  maxt = kv_submit_lanes.empty() ? kv_submitting.front()->t :
+	    db->get_transaction();
+	}
+	if (new_nid_max) {
+	  bufferlist bl;
+	  ::encode(new_nid_max, bl);
+	  maxt->set(PREFIX_SUPER, "nid_max", bl);
+	}
+	if (new_blobid_max) {
+	  bufferlist bl;
+	  ::encode(new_blobid_max, bl);
+	  maxt->set(PREFIX_SUPER, "blobid_max", bl);
+	}
+	if (maxt != synct && !kv_submit_lanes.empty()) {
+	  int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 :
+	    db->submit_transaction(maxt);
 	  assert(r == 0);
-	  _txc_applied_kv(txc);
-	  --txc->osr->kv_committing_serially;
-	  txc->state = TransContext::STATE_KV_SUBMITTED;
-	  if (txc->osr->kv_submitted_waiters) {
-	    std::lock_guard<std::mutex> l(txc->osr->qlock);
-	    if (txc->osr->_is_all_kv_submitted()) {
-	      txc->osr->qcond.notify_all();
-	    }
-	  }
-
-	} else {
-	  assert(txc->state == TransContext::STATE_KV_SUBMITTED);
-	  txc->log_state_latency(logger, l_bluestore_state_kv_queued_lat);
 	}
-	if (txc->had_ios) {
-	  --txc->osr->txc_with_unstable_io;
+      }
+
+      if (kv_submit_lanes.empty()) {
+	for (auto txc : kv_committing) {
+	  _kv_submit_txc(txc);
 	}
+      } else {
+	logger->inc(l_bluestore_kv_submit_lanes,
+		    _kv_submit_lanes_queue(kv_committing));
       }
+      logger->inc(l_bluestore_kv_sync_batch, kv_committing.size());
+      logger->inc(l_bluestore_kv_submit_batch, kv_submitting.size());
+      utime_t after_submit = ceph_clock_now();
+      logger->tinc(l_bluestore_kv_submit_lat, after_submit - after_flush);
 
       // release throttle *before* we commit.  this allows new ops
       // to be prepared and enter pipeline while we are waiting on
@@ -8724,6 +10164,90 @@ void BlueStore::_kv_sync_thread()
   kv_sync_started = false;
 }
 
+void BlueStore::_kv_submit_txc(TransContext *txc)
+{
+  if (txc->state == TransContext::STATE_KV_QUEUED) {
+    txc->log_state_latency(logger, l_bluestore_state_kv_queued_lat);
+    int r = cct->_conf->bluestore_debug_omit_kv_commit ? 0 : db->submit_transaction(txc->t);
+    assert(r == 0);
+    _txc_applied_kv(txc);
+    --txc->osr->kv_committing_serially;
+    txc->state = TransContext::STATE_KV_SUBMITTED;
+    if (txc->osr->kv_submitted_waiters) {
+      std::lock_guard<std::mutex> l(txc->osr->qlock);
+      if (txc->osr->_is_all_kv_submitted()) {
+	txc->osr->qcond.notify_all();
+      }
+    }
+
+  } else {
+    assert(txc->state == TransContext::STATE_KV_SUBMITTED);
+    txc->log_state_latency(logger, l_bluestore_state_kv_queued_lat);
+  }
+  if (txc->had_ios) {
+    --txc->osr->txc_with_unstable_io;
+  }
+}
+
+unsigned BlueStore::_kv_submit_lanes_queue(const deque<TransContext*>& txcs)
+{
+  // all txcs of a sequencer go to the same lane, in order, so per-osr
+  // submission order is preserved; different sequencers are submitted
+  // concurrently.  we wait for every lane before syncing, so nothing
+  // from this batch can overtake the sync.
+  std::unordered_map<OpSequencer*, unsigned> osr_lane;
+  unsigned next = 0, used = 0;
+  std::unique_lock<std::mutex> l(kv_submit_lock);
+  assert(kv_submit_pending == 0);
+  for (auto txc : txcs) {
+    auto p = osr_lane.find(txc->osr.get());
+    if (p == osr_lane.end()) {
+      p = osr_lane.emplace(txc->osr.get(),
+			   next++ % kv_submit_lanes.size()).first;
+    }
+    KVSubmitLane *lane = kv_submit_lanes[p->second];
+    if (lane->q.empty()) {
+      ++used;
+    }
+    lane->q.push_back(txc);
+  }
+  kv_submit_pending = used;
+  kv_submit_cond.notify_all();
+  while (kv_submit_pending) {
+    kv_submit_cond.wait(l);
+  }
+  dout(20) << __func__ << " submitted " << txcs.size() << " txcs on "
+	   << used << " lanes" << dendl;
+  return used;
+}
+
+void BlueStore::_kv_submit_lane_thread(KVSubmitLane *lane)
+{
+  deque<TransContext*> submitting;
+  dout(10) << __func__ << " " << lane->id << " start" << dendl;
+  std::unique_lock<std::mutex> l(kv_submit_lock);
+  while (true) {
+    if (lane->q.empty()) {
+      if (kv_submit_stop)
+	break;
+      kv_submit_cond.wait(l);
+    } else {
+      submitting.swap(lane->q);
+      l.unlock();
+      for (auto txc : submitting) {
+	_kv_submit_txc(txc);
+      }
+      submitting.clear();
+      l.lock();
+      assert(kv_submit_pending > 0);
+      if (--kv_submit_pending == 0) {
+	kv_submit_cond.notify_all();
+      }
+    }
+  }
+  dout(10) << __func__ << " " << lane->id << " finish" << dendl;
+}
+
 void BlueStore::_kv_finalize_thread()
 {
   deque<TransContext*> kv_committed;
@@ -8798,7 +10322,7 @@ bluestore_deferred_op_t *BlueStore::_get_deferred_op(
 void BlueStore::_deferred_queue(TransContext *txc)
 {
   dout(20) << __func__ << " txc " << txc << " osr " << txc->osr << dendl;
-  deferred_lock.lock();
+  std::unique_lock<std::mutex> l(deferred_lock);
   if (!txc->osr->deferred_pending &&
       !txc->osr->deferred_running) {
     deferred_queue.push_back(*txc->osr);
@@ -8820,9 +10344,11 @@ void BlueStore::_deferred_queue(TransContext *txc)
   }
   if (deferred_aggressive &&
       !txc->osr->deferred_running) {
-    _deferred_submit_unlock(txc->osr.get());
-  } else {
-    deferred_lock.unlock();
+    if (cct->_conf->bluestore_deferred_global_batch) {
+      _deferred_submit_global_unlock(l);
+    } else {
+      _deferred_submit_unlock(l, txc->osr.get());
+    }
   }
 }
 
@@ -8830,7 +10356,11 @@ void BlueStore::deferred_try_submit()
 {
   dout(20) << __func__ << " " << deferred_queue.size() << " osrs, "
 	   << deferred_queue_size << " txcs" << dendl;
-  std::lock_guard<std::mutex> l(deferred_lock);
+  std::unique_lock<std::mutex> l(deferred_lock);
+  if (cct->_conf->bluestore_deferred_global_batch) {
+    _deferred_submit_global_unlock(l);
+    return;
+  }
   vector<OpSequencerRef> osrs;
   osrs.reserve(deferred_queue.size());
   for (auto& osr : deferred_queue) {
@@ -8839,8 +10369,8 @@ void BlueStore::deferred_try_submit()
   for (auto& osr : osrs) {
     if (osr->deferred_pending) {
       if (!osr->deferred_running) {
-	_deferred_submit_unlock(osr.get());
-	deferred_lock.lock();
+	_deferred_submit_unlock(l, osr.get());
+	l.lock();
       } else {
 	dout(20) << __func__ << "  osr " << osr << " already has running"
 		 << dendl;
@@ -8851,7 +10381,8 @@ void BlueStore::deferred_try_submit()
   }
 }
 
-void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
+void BlueStore::_deferred_submit_unlock(std::unique_lock<std::mutex>& l,
+				       OpSequencer *osr)
 {
   dout(10) << __func__ << " osr " << osr
 	   << " " << osr->deferred_pending->iomap.size() << " ios pending "
@@ -8866,7 +10397,7 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
   osr->deferred_running = osr->deferred_pending;
   osr->deferred_pending = nullptr;
 
-  deferred_lock.unlock();
+  l.unlock();
 
   for (auto& txc : b->txcs) {
     txc.log_state_latency(logger, l_bluestore_state_deferred_queued_lat);
@@ -8908,6 +10439,100 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
   bdev->aio_submit(&b->ioc);
 }
 
+void BlueStore::deferred_elevator_runs(
+  map<uint64_t,bufferlist*>& ios,
+  uint64_t head,
+  vector<pair<uint64_t,bufferlist>> *runs)
+{
+  // coalesce adjacent ios into runs
+  for (auto& i : ios) {
+    if (runs->empty() ||
+	runs->back().first + runs->back().second.length() != i.first) {
+      runs->emplace_back(i.first, bufferlist());
+    }
+    runs->back().second.claim_append(*i.second);
+  }
+
+  // elevator: carry on upward from where the last submit stopped, then
+  // wrap around to the lowest offset
+  auto first = std::lower_bound(
+    runs->begin(), runs->end(), head,
+    [](const pair<uint64_t,bufferlist>& r, uint64_t off) {
+      return r.first < off;
+    });
+  std::rotate(runs->begin(), first, runs->end());
+}
+
+void BlueStore::_deferred_submit_global_unlock(std::unique_lock<std::mutex>& l)
+{
+  // take every idle osr's pending batch whose ios don't overlap one we
+  // already have (overlapping ones stay pending and go next time)
+  DeferredBatchGroup *g = new DeferredBatchGroup(cct);
+  map<uint64_t,bufferlist*> ios;   // offset -> data, across all batches
+  vector<DeferredBatch*> batches;
+  for (auto& osr : deferred_queue) {
+    if (!osr.deferred_pending || osr.deferred_running) {
+      continue;
+    }
+    DeferredBatch *b = osr.deferred_pending;
+    bool overlap = false;
+    for (auto& i : b->iomap) {
+      uint64_t end = i.first + i.second.bl.length();
+      auto p = ios.lower_bound(i.first);
+      if ((p != ios.end() && p->first < end) ||
+	  (p != ios.begin() &&
+	   std::prev(p)->first + std::prev(p)->second->length() > i.first)) {
+	overlap = true;
+	break;
+      }
+    }
+    if (overlap) {
+      dout(20) << __func__ << " osr " << &osr << " overlaps, deferring"
+	       << dendl;
+      continue;
+    }
+    for (auto& i : b->iomap) {
+      ios[i.first] = &i.second.bl;
+    }
+    deferred_queue_size -= b->seq_bytes.size();
+    osr.deferred_running = b;
+    osr.deferred_pending = nullptr;
+    g->osrs.push_back(&osr);
+    batches.push_back(b);
+  }
+  assert(deferred_queue_size >= 0);
+  l.unlock();
+
+  if (batches.empty()) {
+    delete g;
+    return;
+  }
+  dout(10) << __func__ << " " << batches.size() << " osrs, " << ios.size()
+	   << " ios pending" << dendl;
+  for (auto b : batches) {
+    for (auto& txc : b->txcs) {
+      txc.log_state_latency(logger, l_bluestore_state_deferred_queued_lat);
+    }
+  }
+
+  vector<pair<uint64_t,bufferlist>> runs;
+  deferred_elevator_runs(ios, deferred_last_lba, &runs);
+  logger->inc(l_bluestore_deferred_write_coalesced, ios.size() - runs.size());
+  for (auto& r : runs) {
+    dout(20) << __func__ << " write 0x" << std::hex
+	     << r.first << "~" << r.second.length() << std::dec << dendl;
+    if (!g_conf->bluestore_debug_omit_block_device_write) {
+      logger->inc(l_bluestore_deferred_write_ops);
+      logger->inc(l_bluestore_deferred_write_bytes, r.second.length());
+      int r2 = bdev->aio_write(r.first, r.second, &g->ioc, false);
+      assert(r2 == 0);
+    }
+  }
+  deferred_last_lba = runs.back().first + runs.back().second.length();
+
+  bdev->aio_submit(&g->ioc);
+}
+
 struct C_DeferredTrySubmit : public Context {
   BlueStore *store;
   C_DeferredTrySubmit(BlueStore *s) : store(s) {}
@@ -8916,6 +10541,19 @@ struct C_DeferredTrySubmit : public Context {
   }
 };
 
+void BlueStore::DeferredBatchGroup::aio_finish(BlueStore *store)
+{
+  for (auto& osr : osrs) {
+    store->_deferred_aio_finish(osr.get());
+  }
+  if (store->deferred_aggressive) {
+    // osrs that overlapped this group were left pending; nothing else
+    // will kick them
+    store->deferred_finisher.queue(new C_DeferredTrySubmit(store));
+  }
+  delete this;
+}
+
 void BlueStore::_deferred_aio_finish(OpSequencer *osr)
 {
   dout(10) << __func__ << " osr " << osr << dendl;
@@ -9031,6 +10669,7 @@ int BlueStore::queue_transactions(
   } else {
     osr = new OpSequencer(cct, this);
     osr->parent = posr;
+    osr->name = posr->get_name();
     posr->p = osr;
     dout(10) << __func__ << " new " << osr << " " << *osr << dendl;
   }
@@ -9040,6 +10679,9 @@ int BlueStore::queue_transactions(
   txc->onreadable = onreadable;
   txc->onreadable_sync = onreadable_sync;
   txc->oncommit = ondisk;
+  if (txc->trace.enabled) {
+    txc->trace.op = op;
+  }
 
   for (vector<Transaction>::iterator p = tls.begin(); p != tls.end(); ++p) {
     (*p).set_osr(osr);
@@ -9064,8 +10706,10 @@ int BlueStore::queue_transactions(
   if (handle)
     handle->suspend_tp_timeout();
 
+  txc->trace_event("build", "bluestore:build");
   utime_t tstart = ceph_clock_now();
   throttle_bytes.get(txc->cost);
+  txc->trace_event("throttle", "bluestore:throttle");
   if (txc->deferred_txn) {
     // ensure we do not block here because of deferred writes
     if (!throttle_deferred_bytes.get_or_fail(txc->cost)) {
@@ -9080,6 +10724,7 @@ int BlueStore::queue_transactions(
       }
       throttle_deferred_bytes.get(txc->cost);
       --deferred_aggressive;
+      txc->trace_event("deferred_throttle", "bluestore:deferred_throttle");
    }
   }
   utime_t tend = ceph_clock_now();
@@ -9224,6 +10869,8 @@ void BlueStore::_txc_add_transaction(TransContext *txc, Transaction *t)
       r = -ENOENT;
       goto endop;
     }
+    // a read may have decoded part of a shard since the last op
+    o->extent_map.fault_partial(db);
 
     switch (op->op) {
     case Transaction::OP_TOUCH:
@@ -9305,6 +10952,7 @@ void BlueStore::_txc_add_transaction(TransContext *txc, Transaction *t)
           const ghobject_t& noid = i.get_oid(op->dest_oid);
 	  no = c->get_onode(noid, true);
 	}
+	no->extent_map.fault_partial(db);
 	r = _clone(txc, c, o, no);
       }
       break;
@@ -9320,6 +10968,7 @@ void BlueStore::_txc_add_transaction(TransContext *txc, Transaction *t)
 	  const ghobject_t& noid = i.get_oid(op->dest_oid);
 	  no = c->get_onode(noid, true);
 	}
+	no->extent_map.fault_partial(db);
         uint64_t srcoff = op->off;
         uint64_t len = op->len;
         uint64_t dstoff = op->dest_off;
@@ -9348,6 +10997,9 @@ void BlueStore::_txc_add_transaction(TransContext *txc, Transaction *t)
 	if (!no) {
 	  no = c->get_onode(noid, false);
 	}
+	if (no) {
+	  no->extent_map.fault_partial(db);
+	}
 	r = _rename(txc, c, o, no, noid);
       }
       break;
@@ -9995,6 +11647,57 @@ void BlueStore::_do_write_big(
   }
 }
 
+void BlueStore::_note_compress_cost(uint64_t len, utime_t lat)
+{
+  if (!len) {
+    return;
+  }
+  uint64_t sample = lat.to_nsec() * 1024 / len;
+  uint64_t avg = comp_ns_per_kb.load(std::memory_order_relaxed);
+  // racy, but this is only an estimate
+  comp_ns_per_kb.store(avg ? avg - avg / 8 + sample / 8 : sample,
+		       std::memory_order_relaxed);
+}
+
+void BlueStore::_note_compress_skipped(uint64_t len)
+{
+  logger->inc(l_bluestore_compress_skipped_count);
+  logger->inc(l_bluestore_compress_skipped_bytes, len);
+  uint64_t ns = comp_ns_per_kb.load(std::memory_order_relaxed) * len / 1024;
+  if (ns) {
+    logger->tinc(l_bluestore_compress_saved_time, make_timespan(ns / 1e9));
+  }
+}
+
+void BlueStore::_update_compress_history(
+  OnodeRef& o,
+  unsigned success,
+  unsigned fail)
+{
+  if (success) {
+    o->comp_rejects = 0;
+    o->comp_skip = 0;
+    return;
+  }
+  if (!fail) {
+    return;
+  }
+  uint64_t backoff =
+    cct->_conf->get_val<uint64_t>("bluestore_compression_reject_backoff");
+  if (!backoff) {
+    return;
+  }
+  // skip 1, 3, 7, ... writes after each run of rejects
+  if (o->comp_rejects < 8) {
+    ++o->comp_rejects;
+  }
+  o->comp_skip = std::min<uint64_t>((1u << o->comp_rejects) - 1,
+				    std::min<uint64_t>(backoff, 255));
+  dout(20) << __func__ << " " << o->oid << " rejects "
+	   << (int)o->comp_rejects << ", skipping compression for next "
+	   << (int)o->comp_skip << " writes" << dendl;
+}
+
 int BlueStore::_do_alloc_write(
   TransContext *txc,
   CollectionRef coll,
@@ -10057,7 +11760,32 @@ int BlueStore::_do_alloc_write(
   // compress (as needed) and calc needed space
   uint64_t need = 0;
   auto max_bsize = MAX(wctx->target_blob_size, min_alloc_size);
+  double entropy_threshold =
+    cct->_conf->get_val<double>("bluestore_compression_entropy_threshold");
+  uint64_t sample_size =
+    cct->_conf->get_val<uint64_t>("bluestore_compression_sample_size");
+  unsigned comp_success = 0, comp_fail = 0;
   for (auto& wi : wctx->writes) {
+    if (c && wi.blob_length > min_alloc_size && wctx->compress_backoff) {
+      // only count the blobs we would have tried to compress
+      _note_compress_skipped(wi.blob_length);
+      need += wi.blob_length;
+      continue;
+    }
+    if (c && wi.blob_length > min_alloc_size && !wctx->compress_force &&
+	entropy_threshold > 0) {
+      double entropy = Compressor::estimate_entropy(wi.bl, sample_size);
+      if (entropy >= entropy_threshold) {
+	dout(20) << __func__ << std::hex << "  0x" << wi.blob_length
+		 << std::dec << " entropy " << entropy
+		 << " >= " << entropy_threshold
+		 << ", leaving uncompressed" << dendl;
+	_note_compress_skipped(wi.blob_length);
+	++comp_fail;
+	need += wi.blob_length;
+	continue;
+      }
+    }
     if (c && wi.blob_length > min_alloc_size) {
       utime_t start = ceph_clock_now();
 
@@ -10094,6 +11822,7 @@ int BlueStore::_do_alloc_write(
 	txc->statfs_delta.compressed_allocated() += newlen;
 	logger->inc(l_bluestore_compress_success_count);
 	wi.compressed = true;
+	++comp_success;
 	need += newlen;
       } else {
 	dout(20) << __func__ << std::hex << "  0x" << wi.blob_length
@@ -10104,14 +11833,19 @@ int BlueStore::_do_alloc_write(
 		 << ", leaving uncompressed"
 		 << std::dec << dendl;
 	logger->inc(l_bluestore_compress_rejected_count);
+	++comp_fail;
 	need += wi.blob_length;
       }
-      logger->tinc(l_bluestore_compress_lat,
-		   ceph_clock_now() - start);
+      utime_t lat = ceph_clock_now() - start;
+      logger->tinc(l_bluestore_compress_lat, lat);
+      _note_compress_cost(wi.blob_length, lat);
     } else {
       need += wi.blob_length;
     }
   }
+  if (!wctx->compress_force) {
+    _update_compress_history(o, comp_success, comp_fail);
+  }
   int r = alloc->reserve(need);
   if (r < 0) {
     derr << __func__ << " failed to reserve 0x" << std::hex << need << std::dec
@@ -10396,6 +12130,7 @@ void BlueStore::_choose_write_options(
     }
   );
 
+  wctx->compress_force = (cm == Compressor::COMP_FORCE);
   wctx->compress = (cm != Compressor::COMP_NONE) &&
     ((cm == Compressor::COMP_FORCE) ||
      (cm == Compressor::COMP_AGGRESSIVE &&
@@ -10545,6 +12280,13 @@ int BlueStore::_do_write(
 
   WriteContext wctx;
   _choose_write_options(c, o, fadvise_flags, &wctx);
+  if (wctx.compress && !wctx.compress_force && o->comp_skip) {
+    // recent writes to this object did not compress; give it a rest
+    --o->comp_skip;
+    wctx.compress_backoff = true;
+    dout(20) << __func__ << " skipping compression, " << (int)o->comp_skip
+	     << " more writes to go" << dendl;
+  }
   o->extent_map.fault_range(db, offset, length);
   _do_write_data(txc, c, o, offset, length, bl, &wctx);
   r = _do_alloc_write(txc, c, o, &wctx);
@@ -11395,6 +13137,9 @@ int BlueStore::_rename(TransContext *txc,
   {
     oldo->extent_map.fault_range(db, 0, oldo->onode.size);
     get_object_key(cct, new_oid, &new_okey);
+    if (onode_filter) {
+      c->onode_filter_insert(new_okey.c_str(), new_okey.size());
+    }
     string key;
     for (auto &s : oldo->extent_map.shards) {
       generate_extent_shard_key_and_apply(oldo->key, s.shard_info->offset, &key,
@@ -11444,6 +13189,8 @@ int BlueStore::_create_collection(
 	cache_shards[cid.hash_to_shard(cache_shards.size())],
 	cid));
     (*c)->cnode.bits = bits;
+    // a new collection has no onodes yet
+    (*c)->onode_filter_complete = true;
     coll_map[cid] = *c;
   }
   ::encode((*c)->cnode, bl);
@@ -11557,6 +13304,11 @@ int BlueStore::_split_collection(TransContext *txc,
 
   c->split_cache(d.get());
 
+  // the child's onodes are (a subset of) those of the parent
+  d->onode_filter = c->onode_filter;
+  d->onode_filter_complete = c->onode_filter_complete;
+  d->onode_filter_failed = c->onode_filter_failed;
+
   // adjust bits.  note that this will be redundant for all but the first
   // split call for this parent (first child).
   c->cnode.bits = bits;
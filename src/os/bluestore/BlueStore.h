@@ -33,8 +33,10 @@
 #include "include/unordered_map.h"
 #include "include/memory.h"
 #include "include/mempool.h"
+#include "common/bloom_filter.hpp"
 #include "common/Finisher.h"
 #include "common/perf_counters.h"
+#include "common/Readahead.h"
 #include "compressor/Compressor.h"
 #include "os/ObjectStore.h"
 
@@ -60,6 +62,10 @@ enum {
   l_bluestore_kv_flush_lat,
   l_bluestore_kv_commit_lat,
   l_bluestore_kv_lat,
+  l_bluestore_kv_submit_lat,
+  l_bluestore_kv_sync_batch,
+  l_bluestore_kv_submit_batch,
+  l_bluestore_kv_submit_lanes,
   l_bluestore_state_prepare_lat,
   l_bluestore_state_aio_wait_lat,
   l_bluestore_state_io_done_lat,
@@ -82,9 +88,13 @@ enum {
   l_bluestore_csum_lat,
   l_bluestore_compress_success_count,
   l_bluestore_compress_rejected_count,
+  l_bluestore_compress_skipped_count,
+  l_bluestore_compress_skipped_bytes,
+  l_bluestore_compress_saved_time,
   l_bluestore_write_pad_bytes,
   l_bluestore_deferred_write_ops,
   l_bluestore_deferred_write_bytes,
+  l_bluestore_deferred_write_coalesced,
   l_bluestore_write_penalty_read_ops,
   l_bluestore_allocated,
   l_bluestore_stored,
@@ -96,12 +106,25 @@ enum {
   l_bluestore_onode_misses,
   l_bluestore_onode_shard_hits,
   l_bluestore_onode_shard_misses,
+  l_bluestore_onode_shard_partial,
+  l_bluestore_onode_shard_skipped_extents,
+  l_bluestore_onode_filter_skipped,
+  l_bluestore_onode_filter_false_positive,
   l_bluestore_extents,
   l_bluestore_blobs,
   l_bluestore_buffers,
   l_bluestore_buffer_bytes,
   l_bluestore_buffer_hit_bytes,
   l_bluestore_buffer_miss_bytes,
+  l_bluestore_readahead,
+  l_bluestore_readahead_bytes,
+  l_bluestore_readahead_hit_bytes,
+  l_bluestore_readahead_dropped,
+  l_bluestore_cache_target_bytes,
+  l_bluestore_cache_meta_target_bytes,
+  l_bluestore_cache_kv_target_bytes,
+  l_bluestore_cache_data_target_bytes,
+  l_bluestore_cache_autotune_shifts,
   l_bluestore_write_big,
   l_bluestore_write_big_bytes,
   l_bluestore_write_big_blobs,
@@ -112,11 +135,14 @@ enum {
   l_bluestore_write_small_pre_read,
   l_bluestore_write_small_new,
   l_bluestore_txc,
+  l_bluestore_txc_slow_traced,
   l_bluestore_onode_reshard,
   l_bluestore_blob_split,
   l_bluestore_extent_compress,
   l_bluestore_gc_merged,
   l_bluestore_read_eio,
+  l_bluestore_read_bytes,
+  l_bluestore_read_zerocopy_bytes,
   l_bluestore_last
 };
 
@@ -132,6 +158,8 @@ public:
 
   void _set_csum();
   void _set_compression();
+  void _set_txc_trace();
+  void _set_extent_map_lazy_decode();
   void _set_throttle_params();
   int _set_cache_sizes();
 
@@ -166,12 +194,13 @@ public:
       }
     }
     enum {
-      FLAG_NOCACHE = 1,  ///< trim when done WRITING (do not become CLEAN)
-      // NOTE: fix operator<< when you define a second flag
+      FLAG_NOCACHE = 1,    ///< trim when done WRITING (do not become CLEAN)
+      FLAG_READAHEAD = 2,  ///< CLEAN data prefetched by readahead
     };
     static const char *get_flag_name(int s) {
       switch (s) {
       case FLAG_NOCACHE: return "nocache";
+      case FLAG_READAHEAD: return "readahead";
       default: return "???";
       }
     }
@@ -329,9 +358,10 @@ public:
       _add_buffer(cache, b, (flags & Buffer::FLAG_NOCACHE) ? 0 : 1, nullptr);
     }
     void finish_write(Cache* cache, uint64_t seq);
-    void did_read(Cache* cache, uint32_t offset, bufferlist& bl) {
+    void did_read(Cache* cache, uint32_t offset, bufferlist& bl,
+		  unsigned flags = 0) {
       std::lock_guard<std::recursive_mutex> l(cache->lock);
-      Buffer *b = new Buffer(this, Buffer::STATE_CLEAN, 0, offset, bl);
+      Buffer *b = new Buffer(this, Buffer::STATE_CLEAN, 0, offset, bl, flags);
       b->cache_private = _discard(cache, offset, bl.length());
       _add_buffer(cache, b, 1, nullptr);
     }
@@ -340,6 +370,10 @@ public:
 	      BlueStore::ready_regions_t& res,
 	      interval_set<uint32_t>& res_intervals);
 
+    /// cached parts of offset~length, without counting or touching them
+    void get_cached(Cache* cache, uint32_t offset, uint32_t length,
+		    interval_set<uint32_t>& res_intervals);
+
     void truncate(Cache* cache, uint32_t offset) {
       discard(cache, offset, (uint32_t)-1 - offset);
     }
@@ -737,8 +771,19 @@ public:
       unsigned extents = 0;  ///< count extents in this shard
       bool loaded = false;   ///< true if shard is loaded
       bool dirty = false;    ///< true if shard is dirty and needs reencoding
+
+      /// encoded shard, kept while it is only partially decoded
+      bufferlist encoded;
+      uint32_t decoded_begin = 0; ///< range materialized from encoded
+      uint32_t decoded_end = 0;
+
+      /// true if some extents were decoded for read, but not all of them
+      bool is_partial() const {
+	return !loaded && encoded.length();
+      }
     };
     mempool::bluestore_cache_other::vector<Shard> shards;    ///< shards
+    bool has_partial = false;  ///< some shard may be partially decoded
 
     bufferlist inline_bl;    ///< cached encoded map, if unsharded; empty=>dirty
 
@@ -779,6 +824,11 @@ public:
     bool encode_some(uint32_t offset, uint32_t length, bufferlist& bl,
 		     unsigned *pn);
     unsigned decode_some(bufferlist& bl);
+    /// decode only extents overlapping [begin, end) that are not in the
+    /// map yet; the rest are parsed and skipped.  returns the shard's
+    /// total extent count.
+    unsigned decode_some(bufferlist& bl, uint64_t begin, uint64_t end,
+			 unsigned *skipped);
 
     void bound_encode_spanning_blobs(size_t& p);
     void encode_spanning_blobs(bufferlist::contiguous_appender& p);
@@ -843,6 +893,24 @@ public:
     void fault_range(KeyValueDB *db,
 		     uint32_t offset, uint32_t length);
 
+    /// ensure that the extents overlapping a range are present; shards
+    /// may be left partially decoded, so the result must not be modified
+    void fault_range_for_read(KeyValueDB *db,
+			      uint32_t offset, uint32_t length);
+
+    /// fully decode any partially decoded shards; must be called before
+    /// anything but a read looks at the map
+    void fault_partial(KeyValueDB *db) {
+      if (has_partial) {
+	_fault_partial(db);
+      }
+    }
+    void _fault_partial(KeyValueDB *db);
+
+    void _read_shard(KeyValueDB *db, Shard *p, bufferlist *v);
+    void _load_shard(KeyValueDB *db, int i);
+    uint64_t _shard_end(int i) const;
+
     /// ensure a range of the map is marked dirty
     void dirty_range(uint32_t offset, uint32_t length);
 
@@ -1007,6 +1075,9 @@ public:
     mempool::bluestore_cache_other::string key;
 
     boost::intrusive::list_member_hook<> lru_item;
+    /// set by lookup hits (which skip the cache lock); trim gives a
+    /// referenced onode a second chance instead of evicting it
+    std::atomic<bool> lru_referenced = {false};
 
     bluestore_onode_t onode;  ///< metadata stored as value in kv store
     bool exists;              ///< true if object logically exists
@@ -1019,6 +1090,19 @@ public:
     std::mutex flush_lock;  ///< protect flush_txns
     std::condition_variable flush_cond;   ///< wait here for uncommitted txns
 
+    /// bumped by every op that modifies us (under c->lock); readahead
+    /// uses it to tell whether prefetched data is still current
+    uint64_t write_seq = 0;
+    /// end of the last read, to spot the start of a sequential stream
+    std::atomic<uint64_t> last_read_end = {0};
+    /// allocated once reads look sequential; see _readahead()
+    std::atomic<Readahead*> readahead = {nullptr};
+
+    /// compression history (under c->lock): blobs rejected in a row, and
+    /// how many more writes to leave uncompressed; see _do_alloc_write()
+    uint8_t comp_rejects = 0;
+    uint8_t comp_skip = 0;
+
     Onode(Collection *c, const ghobject_t& o,
 	  const mempool::bluestore_cache_other::string& k)
       : nref(0),
@@ -1028,6 +1112,9 @@ public:
 	exists(false),
 	extent_map(this) {
     }
+    ~Onode() {
+      delete readahead.load();
+    }
 
     void flush();
     void get() {
@@ -1299,13 +1386,20 @@ public:
   private:
     Cache *cache;
 
+    /// protects onode_map.  lookups only take it for read, so cache hits
+    /// do not serialize on the (shared) cache shard lock.  writers take
+    /// cache->lock first.
+    RWLock lock;
+
     /// forward lookups
     mempool::bluestore_cache_other::unordered_map<ghobject_t,OnodeRef> onode_map;
 
     friend class Collection; // for split_cache()
 
   public:
-    OnodeSpace(Cache *c) : cache(c) {}
+    OnodeSpace(Cache *c)
+      : cache(c),
+	lock("BlueStore::OnodeSpace::lock", true, false) {}
     ~OnodeSpace() {
       clear();
     }
@@ -1313,8 +1407,12 @@ public:
     OnodeRef add(const ghobject_t& oid, OnodeRef o);
     OnodeRef lookup(const ghobject_t& o);
     void remove(const ghobject_t& oid) {
+      RWLock::WLocker l(lock);
       onode_map.erase(oid);
     }
+    /// remove o unless someone besides the map and the caller holds a
+    /// ref; called by cache trim with cache->lock held
+    bool evict(Onode *o);
     void rename(OnodeRef& o, const ghobject_t& old_oid,
 		const ghobject_t& new_oid,
 		const mempool::bluestore_cache_other::string& new_okey);
@@ -1342,6 +1440,21 @@ public:
     // contention.
     OnodeSpace onode_map;
 
+    /// keys of every onode in the collection (bluestore_onode_filter),
+    /// as a chain of bloom filters that double in size as they fill up.
+    /// once complete, a miss means an onode does not exist and the kv
+    /// lookup can be skipped.  protected by lock; updated when wlocked.
+    std::list<bloom_filter> onode_filter;
+    bool onode_filter_complete = false;
+    bool onode_filter_failed = false;  ///< too many onodes to bother
+    bool onode_filter_loading = false; ///< queued on onode_filter_finisher
+
+    static void onode_filter_add(std::list<bloom_filter>& filter,
+				 const char *key, size_t len);
+    void onode_filter_insert(const char *key, size_t len);
+    bool onode_filter_contains(const char *key, size_t len) const;
+    void onode_filter_load();
+
     //pool options
     pool_opts_t pool_opts;
 
@@ -1468,6 +1581,47 @@ public:
     }
   };
 
+  /// where one txc spent its time, recorded when bluestore_txc_trace is
+  /// on; slow ones are kept by _txc_trace_finish().  Lives inside the
+  /// TransContext, so tracing allocates nothing per txc.
+  struct TxcTrace {
+    static const unsigned MAX_EVENTS = 16;
+    struct event_t {
+      const char *name;  ///< static string
+      uint32_t usec;     ///< since txc start
+    };
+    bool enabled = false;
+    uint8_t num_events = 0;
+    TrackedOpRef op;     ///< the op this txc is part of, if any
+    event_t events[MAX_EVENTS];
+
+    /// record an event; op_name, if any, is marked on the op as well
+    void add(const char *name, const char *op_name,
+	     utime_t now, utime_t start) {
+      if (num_events < MAX_EVENTS) {
+	events[num_events].name = name;
+	events[num_events].usec = (now - start).to_nsec() / 1000;
+	++num_events;
+      }
+      if (op && op_name) {
+	op->mark_event(op_name, now);
+      }
+    }
+  };
+
+  /// a finished txc that took longer than bluestore_txc_trace_slow_threshold
+  struct SlowTxc {
+    utime_t start;
+    utime_t lat;
+    uint64_t seq;
+    uint64_t bytes;
+    bool deferred;
+    std::string osr;
+    vector<TxcTrace::event_t> events;
+
+    void dump(Formatter *f) const;
+  };
+
   struct TransContext : public AioContext {
     MEMPOOL_CLASS_HELPERS();
 
@@ -1504,8 +1658,7 @@ public:
       return "???";
     }
 
-#if defined(WITH_LTTNG) && defined(WITH_EVENTTRACE)
-    const char *get_state_latency_name(int state) {
+    static const char *get_state_latency_name(int state) {
       switch (state) {
       case l_bluestore_state_prepare_lat: return "prepare";
       case l_bluestore_state_aio_wait_lat: return "aio_wait";
@@ -1514,18 +1667,35 @@ public:
       case l_bluestore_state_kv_committing_lat: return "kv_committing";
       case l_bluestore_state_kv_done_lat: return "kv_done";
       case l_bluestore_state_deferred_queued_lat: return "deferred_queued";
+      case l_bluestore_state_deferred_aio_wait_lat: return "deferred_aio_wait";
       case l_bluestore_state_deferred_cleanup_lat: return "deferred_cleanup";
       case l_bluestore_state_finishing_lat: return "finishing";
       case l_bluestore_state_done_lat: return "done";
       }
       return "???";
     }
-#endif
+
+    /// op event for the states a txc passes before its commit callback;
+    /// nullptr for the rest, which may come after the op is done
+    static const char *get_state_op_event_name(int state) {
+      switch (state) {
+      case l_bluestore_state_prepare_lat: return "bluestore:prepare";
+      case l_bluestore_state_aio_wait_lat: return "bluestore:aio_wait";
+      case l_bluestore_state_io_done_lat: return "bluestore:io_done";
+      case l_bluestore_state_kv_queued_lat: return "bluestore:kv_queued";
+      case l_bluestore_state_kv_committing_lat: return "bluestore:kv_committing";
+      }
+      return nullptr;
+    }
 
     void log_state_latency(PerfCounters *logger, int state) {
       utime_t lat, now = ceph_clock_now();
       lat = now - last_stamp;
       logger->tinc(state, lat);
+      if (trace.enabled) {
+	trace.add(get_state_latency_name(state),
+		  get_state_op_event_name(state), now, start);
+      }
 #if defined(WITH_LTTNG) && defined(WITH_EVENTTRACE)
       if (state >= l_bluestore_state_prepare_lat && state <= l_bluestore_state_done_lat) {
         double usecs = (now.to_nsec()-last_stamp.to_nsec())/1000;
@@ -1568,6 +1738,15 @@ public:
     uint64_t last_nid = 0;     ///< if non-zero, highest new nid we allocated
     uint64_t last_blobid = 0;  ///< if non-zero, highest new blobid we allocated
 
+    TxcTrace trace;  ///< if bluestore_txc_trace
+
+    /// note a point in time that is not a state change
+    void trace_event(const char *name, const char *op_name) {
+      if (trace.enabled) {
+	trace.add(name, op_name, ceph_clock_now(), start);
+      }
+    }
+
     explicit TransContext(CephContext* cct, OpSequencer *o)
       : osr(o),
 	ioc(cct, this),
@@ -1580,6 +1759,7 @@ public:
 
     void write_onode(OnodeRef &o) {
       onodes.insert(o);
+      ++o->write_seq;
     }
     void write_shared_blob(SharedBlobRef &sb) {
       shared_blobs.insert(sb);
@@ -1638,6 +1818,18 @@ public:
     }
   };
 
+  /// pending batches of several OpSequencers, submitted together as one
+  /// LBA-sorted, coalesced set of writes (bluestore_deferred_global_batch)
+  struct DeferredBatchGroup : public AioContext {
+    vector<OpSequencerRef> osrs;  ///< osrs whose running batch is ours
+    IOContext ioc;
+
+    DeferredBatchGroup(CephContext *cct)
+      : ioc(cct, this) {}
+
+    void aio_finish(BlueStore *store) override;
+  };
+
   class OpSequencer : public Sequencer_impl {
   public:
     std::mutex qlock;
@@ -1657,6 +1849,7 @@ public:
 
     Sequencer *parent;
     BlueStore *store;
+    string name;  ///< parent's, which may go away before our txcs
 
     uint64_t last_seq = 0;
 
@@ -1786,6 +1979,18 @@ public:
     }
   };
 
+  /// helper thread submitting kv transactions on behalf of kv_sync_thread
+  struct KVSubmitLane : public Thread {
+    BlueStore *store;
+    unsigned id;
+    deque<TransContext*> q;  ///< txcs to submit (protected by kv_submit_lock)
+    explicit KVSubmitLane(BlueStore *s, unsigned i) : store(s), id(i) {}
+    void *entry() override {
+      store->_kv_submit_lane_thread(this);
+      return NULL;
+    }
+  };
+
   struct DBHistogram {
     struct value_dist {
       uint64_t count;
@@ -1851,7 +2056,11 @@ private:
   deferred_osr_queue_t deferred_queue; ///< osr's with deferred io pending
   int deferred_queue_size = 0;         ///< num txc's queued across all osrs
   atomic_int deferred_aggressive = {0}; ///< aggressive wakeup of kv thread
+  /// where the last global deferred submit left the disk head
+  std::atomic<uint64_t> deferred_last_lba = {0};
   Finisher deferred_finisher;
+  Finisher onode_filter_finisher;  ///< builds collections' onode filters
+  std::atomic<bool> onode_filter_stop = {false};
 
   int m_finisher_num = 1;
   vector<Finisher*> finishers;
@@ -1876,11 +2085,22 @@ private:
   deque<TransContext*> kv_committing_to_finalize;   ///< pending finalization
   deque<DeferredBatch*> deferred_stable_to_finalize; ///< pending finalization
 
+  vector<KVSubmitLane*> kv_submit_lanes;  ///< empty: kv_sync_thread submits
+  std::mutex kv_submit_lock;
+  std::condition_variable kv_submit_cond;
+  unsigned kv_submit_pending = 0;  ///< lanes still busy with current batch
+  bool kv_submit_stop = false;
+
   PerfCounters *logger = nullptr;
 
   std::mutex reap_lock;
   list<CollectionRef> removed_collections;
 
+  struct ReadaheadContext;
+  std::mutex readahead_lock;
+  std::condition_variable readahead_cond;
+  int readahead_inflight = 0;  ///< prefetches not yet completed
+
   RWLock debug_read_error_lock = {"BlueStore::debug_read_error_lock"};
   set<ghobject_t> debug_data_error_objects;
   set<ghobject_t> debug_mdata_error_objects;
@@ -1915,6 +2135,18 @@ private:
   CompressorRef compressor;
   std::atomic<uint64_t> comp_min_blob_size = {0};
   std::atomic<uint64_t> comp_max_blob_size = {0};
+  ///< moving average of compressor cost, to estimate what skipping saves
+  std::atomic<uint64_t> comp_ns_per_kb = {0};
+
+  bool onode_filter = false;  ///< bluestore_onode_filter, fixed at mount
+
+  std::atomic<bool> extent_map_lazy_decode = {false};
+  std::atomic<uint64_t> extent_map_lazy_decode_min_bytes = {0};
+
+  std::atomic<bool> txc_trace = {false};        ///< bluestore_txc_trace
+  std::atomic<uint64_t> txc_trace_slow_usec = {0};
+  std::mutex txc_trace_lock;                    ///< protects slow_txcs
+  deque<SlowTxc> slow_txcs;                     ///< most recent last
 
   std::atomic<uint64_t> max_blob_size = {0};  ///< maximum blob size
 
@@ -1927,6 +2159,17 @@ private:
   float cache_kv_ratio = 0;     ///< cache ratio dedicated to kv (e.g., rocksdb)
   float cache_data_ratio = 0;   ///< cache ratio dedicated to object data
 
+  // cache autotuning (bluestore_cache_autotune), driven by MempoolThread
+  enum {
+    CACHE_POOL_META = 0,
+    CACHE_POOL_KV,
+    CACHE_POOL_DATA,
+    CACHE_POOL_MAX
+  };
+  utime_t cache_autotune_stamp;  ///< time of last decision
+  uint64_t cache_autotune_hits[CACHE_POOL_MAX] = {0};    ///< at last decision
+  uint64_t cache_autotune_misses[CACHE_POOL_MAX] = {0};  ///< at last decision
+
   std::mutex vstatfs_lock;
   volatile_statfs vstatfs;
 
@@ -1976,12 +2219,20 @@ private:
    * @warning to_repair_db means that we open this db to repair it, will not
    * hold the rocksdb's file lock.
    */
+  void _get_rocksdb_cfs(std::vector<KeyValueDB::ColumnFamily> *cfs);
   int _open_db(bool create, bool to_repair_db=false);
   void _close_db();
   int _open_fm(bool create);
   void _close_fm();
-  int _open_alloc();
+  int _open_alloc(bool use_checkpoint = false);
   void _close_alloc();
+  int _read_alloc_checkpoint_meta(bluestore_alloc_checkpoint_t *ckpt);
+  int _read_alloc_checkpoint_extents(const bluestore_alloc_checkpoint_t& ckpt,
+				     interval_set<uint64_t> *free);
+  int _load_alloc_checkpoint();
+  int _drop_alloc_checkpoint();
+  int _write_alloc_checkpoint();
+  int _fsck_alloc_checkpoint();
   int _open_collections(int *errors=0);
   void _close_collections();
 
@@ -2009,6 +2260,7 @@ private:
   void _queue_reap_collection(CollectionRef& c);
   void _reap_collections();
   void _update_cache_logger();
+  void _autotune_cache();
 
   void _assign_nid(TransContext *txc, OnodeRef o);
   uint64_t _assign_blobid(TransContext *txc);
@@ -2035,6 +2287,7 @@ private:
   void _txc_committed_kv(TransContext *txc);
   void _txc_finish(TransContext *txc);
   void _txc_release_alloc(TransContext *txc);
+  void _txc_trace_finish(TransContext *txc);
 
   void _osr_drain_preceding(TransContext *txc);
   void _osr_drain_all();
@@ -2044,15 +2297,28 @@ private:
   void _kv_stop();
   void _kv_sync_thread();
   void _kv_finalize_thread();
+  void _kv_submit_txc(TransContext *txc);
+  unsigned _kv_submit_lanes_queue(const deque<TransContext*>& txcs);
+  void _kv_submit_lane_thread(KVSubmitLane *lane);
 
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc, OnodeRef o);
   void _deferred_queue(TransContext *txc);
 public:
   void deferred_try_submit();
 private:
-  void _deferred_submit_unlock(OpSequencer *osr);
+  void _deferred_submit_unlock(std::unique_lock<std::mutex>& l,
+			       OpSequencer *osr);
+  void _deferred_submit_global_unlock(std::unique_lock<std::mutex>& l);
   void _deferred_aio_finish(OpSequencer *osr);
   int _deferred_replay();
+public:
+  /// coalesce adjacent @ios into runs, ordered for submission upward
+  /// from @head and then wrapping around to the lowest offset
+  static void deferred_elevator_runs(
+    map<uint64_t,bufferlist*>& ios,
+    uint64_t head,
+    vector<pair<uint64_t,bufferlist>> *runs);
+private:
 
 public:
   using mempool_dynamic_bitset =
@@ -2098,9 +2364,11 @@ private:
 
   // -- ondisk version ---
 public:
-  const int32_t latest_ondisk_format = 2;        ///< our version
+  const int32_t latest_ondisk_format = 3;        ///< our version
   const int32_t min_readable_ondisk_format = 1;  ///< what we can read
   const int32_t min_compat_ondisk_format = 2;    ///< who can read us
+  /// who can read us while an allocator checkpoint is present
+  const int32_t alloc_checkpoint_compat_ondisk_format = 3;
 
 private:
   int32_t ondisk_format = 0;  ///< value detected on mount
@@ -2169,6 +2437,23 @@ public:
   }
   int _fsck(bool deep, bool repair);
 
+  /// summary of the most recent fsck/repair, for benchmarking
+  struct fsck_stats_t {
+    uint64_t num_objects = 0;
+    uint64_t bytes = 0;       ///< logical bytes covered (read, if deep)
+    utime_t duration;
+  };
+  const fsck_stats_t& get_last_fsck_stats() const {
+    return last_fsck_stats;
+  }
+private:
+  fsck_stats_t last_fsck_stats;
+public:
+
+  /// offline: move metadata between the default rocksdb key space and
+  /// per-prefix column families, as bluestore_rocksdb_cf[s] ask for
+  int migrate_column_families(ostream& out);
+
   void set_cache_shards(unsigned num) override;
 
   int validate_hobject_key(const hobject_t &obj) const override {
@@ -2184,6 +2469,7 @@ public:
   }
 
   void get_db_statistics(Formatter *f) override;
+  void dump_slow_transactions(Formatter *f) override;
   void generate_db_histogram(Formatter *f) override;
   void _flush_cache();
   void flush_cache() override;
@@ -2242,9 +2528,17 @@ public:
     uint64_t offset,
     size_t len,
     bufferlist& bl,
-    uint32_t op_flags = 0);
+    uint32_t op_flags = 0,
+    uint64_t *zerocopy_bytes = nullptr);
 
 private:
+  void _readahead(Collection *c, OnodeRef& o, uint64_t offset,
+		  uint64_t length);
+  void _readahead_issue(Collection *c, OnodeRef& o, uint64_t offset,
+			uint64_t length);
+  void _readahead_finish(ReadaheadContext *rc, bool locked);
+  void _readahead_drain();
+
   int _fiemap(CollectionHandle &c_, const ghobject_t& oid,
  	     uint64_t offset, size_t len, interval_set<uint64_t>& destset);
 public:
@@ -2461,6 +2755,8 @@ private:
   struct WriteContext {
     bool buffered = false;          ///< buffered write
     bool compress = false;          ///< compressed write
+    bool compress_force = false;    ///< compression mode is force
+    bool compress_backoff = false;  ///< skip compressing, see _do_write()
     uint64_t target_blob_size = 0;  ///< target (max) blob size
     unsigned csum_order = 0;        ///< target checksum chunk order
 
@@ -2509,6 +2805,8 @@ private:
     void fork(const WriteContext& other) {
       buffered = other.buffered;
       compress = other.compress;
+      compress_force = other.compress_force;
+      compress_backoff = other.compress_backoff;
       target_blob_size = other.target_blob_size;
       csum_order = other.csum_order;
     }
@@ -2554,6 +2852,9 @@ private:
     uint64_t offset, uint64_t length,
     bufferlist::iterator& blp,
     WriteContext *wctx);
+  void _note_compress_cost(uint64_t len, utime_t lat);
+  void _note_compress_skipped(uint64_t len);
+  void _update_compress_history(OnodeRef& o, unsigned success, unsigned fail);
   int _do_alloc_write(
     TransContext *txc,
     CollectionRef c,
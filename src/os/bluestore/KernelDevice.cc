@@ -19,6 +19,7 @@
 #include <fcntl.h>
 
 #include "KernelDevice.h"
+#include "ioring.h"
 #include "include/types.h"
 #include "include/compat.h"
 #include "include/stringify.h"
@@ -27,23 +28,85 @@
 #include "common/blkdev.h"
 #include "common/align.h"
 #include "common/blkdev.h"
+#include "common/perf_counters.h"
 
 #define dout_context cct
 #define dout_subsys ceph_subsys_bdev
 #undef dout_prefix
 #define dout_prefix *_dout << "bdev(" << this << " " << path << ") "
 
+enum {
+  l_bluestore_kerneldevice_first = 632530,
+  l_bluestore_kerneldevice_aio_submit,
+  l_bluestore_kerneldevice_aio_submit_ios,
+  l_bluestore_kerneldevice_aio_submit_retries,
+  l_bluestore_kerneldevice_aio_submit_lat,
+  l_bluestore_kerneldevice_aio_reap,
+  l_bluestore_kerneldevice_aio_reap_empty,
+  l_bluestore_kerneldevice_last
+};
+
 KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv)
   : BlockDevice(cct, cb, cbpriv),
     fd_direct(-1),
     fd_buffered(-1),
     fs(NULL), aio(false), dio(false),
     debug_lock("KernelDevice::debug_lock"),
-    aio_queue(cct->_conf->bdev_aio_max_queue_depth),
     aio_stop(false),
     aio_thread(this),
     injecting_crash(0)
 {
+  if (cct->_conf->bdev_ioring) {
+    if (ioring_queue_t::supported()) {
+      io_queue.reset(new ioring_queue_t(
+		       cct->_conf->bdev_aio_max_queue_depth,
+		       cct->_conf->bdev_ioring_hipri,
+		       cct->_conf->bdev_ioring_sqthread_poll));
+    } else {
+      derr << __func__ << " bdev_ioring is set but io_uring is not supported"
+	   << " by this build or kernel; falling back to libaio" << dendl;
+    }
+  }
+  if (!io_queue) {
+    io_queue.reset(new aio_queue_t(cct->_conf->bdev_aio_max_queue_depth));
+  }
+}
+
+void KernelDevice::_init_logger()
+{
+  string name = path;
+  size_t pos = name.rfind('/');
+  if (pos != string::npos) {
+    name = name.substr(pos + 1);
+  }
+  PerfCountersBuilder b(cct, string("bdev-") + name,
+			l_bluestore_kerneldevice_first,
+			l_bluestore_kerneldevice_last);
+  b.add_u64_counter(l_bluestore_kerneldevice_aio_submit, "aio_submit",
+		    "Batches of aios submitted");
+  b.add_u64_counter(l_bluestore_kerneldevice_aio_submit_ios,
+		    "aio_submit_ios", "Aios submitted");
+  b.add_u64_counter(l_bluestore_kerneldevice_aio_submit_retries,
+		    "aio_submit_retries",
+		    "Aio submissions retried because the queue was full");
+  b.add_time_avg(l_bluestore_kerneldevice_aio_submit_lat, "aio_submit_lat",
+		 "Average time spent submitting a batch of aios");
+  b.add_u64_avg(l_bluestore_kerneldevice_aio_reap, "aio_reap",
+		"Aios reaped per completion poll");
+  b.add_u64_counter(l_bluestore_kerneldevice_aio_reap_empty,
+		    "aio_reap_empty",
+		    "Completion polls that timed out without reaping an aio");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
+}
+
+void KernelDevice::_shutdown_logger()
+{
+  if (!logger)
+    return;
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
+  logger = nullptr;
 }
 
 int KernelDevice::_lock()
@@ -141,6 +204,7 @@ int KernelDevice::open(const string& p)
     }
   }
 
+  _init_logger();
   r = _aio_start();
   if (r < 0) {
     goto out_fail;
@@ -159,10 +223,12 @@ int KernelDevice::open(const string& p)
 	  << " block_size " << block_size
 	  << " (" << pretty_si_t(block_size) << "B)"
 	  << " " << (rotational ? "rotational" : "non-rotational")
+	  << " " << io_queue->get_type()
 	  << dendl;
   return 0;
 
  out_fail:
+  _shutdown_logger();
   VOID_TEMP_FAILURE_RETRY(::close(fd_buffered));
   fd_buffered = -1;
  out_direct:
@@ -175,6 +241,7 @@ void KernelDevice::close()
 {
   dout(1) << __func__ << dendl;
   _aio_stop();
+  _shutdown_logger();
 
   assert(fs);
   delete fs;
@@ -204,6 +271,7 @@ int KernelDevice::collect_metadata(const string& prefix, map<string,string> *pm)
   (*pm)[prefix + "size"] = stringify(get_size());
   (*pm)[prefix + "block_size"] = stringify(get_block_size());
   (*pm)[prefix + "driver"] = "KernelDevice";
+  (*pm)[prefix + "io_backend"] = io_queue->get_type();
   if (rotational) {
     (*pm)[prefix + "type"] = "hdd";
   } else {
@@ -303,14 +371,17 @@ int KernelDevice::flush()
 int KernelDevice::_aio_start()
 {
   if (aio) {
-    dout(10) << __func__ << dendl;
-    int r = aio_queue.init();
+    dout(10) << __func__ << " " << io_queue->get_type() << dendl;
+    std::vector<int> fds = { fd_direct };
+    int r = io_queue->init(fds);
     if (r < 0) {
       if (r == -EAGAIN) {
-	derr << __func__ << " io_setup(2) failed with EAGAIN; "
+	derr << __func__ << " " << io_queue->get_type()
+	     << " setup failed with EAGAIN; "
 	     << "try increasing /proc/sys/fs/aio-max-nr" << dendl;
       } else {
-	derr << __func__ << " io_setup(2) failed: " << cpp_strerror(r) << dendl;
+	derr << __func__ << " " << io_queue->get_type()
+	     << " setup failed: " << cpp_strerror(r) << dendl;
       }
       return r;
     }
@@ -326,7 +397,7 @@ void KernelDevice::_aio_stop()
     aio_stop = true;
     aio_thread.join();
     aio_stop = false;
-    aio_queue.shutdown();
+    io_queue->shutdown();
   }
 }
 
@@ -338,14 +409,18 @@ void KernelDevice::_aio_thread()
     dout(40) << __func__ << " polling" << dendl;
     int max = cct->_conf->bdev_aio_reap_max;
     aio_t *aio[max];
-    int r = aio_queue.get_next_completed(cct->_conf->bdev_aio_poll_ms,
+    int r = io_queue->get_next_completed(cct->_conf->bdev_aio_poll_ms,
 					 aio, max);
     if (r < 0) {
       derr << __func__ << " got " << cpp_strerror(r) << dendl;
       assert(0 == "got unexpected error from io_getevents");
     }
+    if (r == 0) {
+      logger->inc(l_bluestore_kerneldevice_aio_reap_empty);
+    }
     if (r > 0) {
       dout(30) << __func__ << " got " << r << " completed aios" << dendl;
+      logger->inc(l_bluestore_kerneldevice_aio_reap, r);
       for (int i = 0; i < r; ++i) {
 	IOContext *ioc = static_cast<IOContext*>(aio[i]->priv);
 	_aio_log_finish(ioc, aio[i]->offset, aio[i]->length);
@@ -521,11 +596,18 @@ void KernelDevice::aio_submit(IOContext *ioc)
 
   void *priv = static_cast<void*>(ioc);
   int r, retries = 0;
-  r = aio_queue.submit_batch(ioc->running_aios.begin(), e, 
+  utime_t start = ceph_clock_now();
+  r = io_queue->submit_batch(ioc->running_aios.begin(), e,
 			     pending, priv, &retries);
-  
-  if (retries)
+  logger->tinc(l_bluestore_kerneldevice_aio_submit_lat,
+	       ceph_clock_now() - start);
+  logger->inc(l_bluestore_kerneldevice_aio_submit);
+  logger->inc(l_bluestore_kerneldevice_aio_submit_ios, pending);
+
+  if (retries) {
     derr << __func__ << " retries " << retries << dendl;
+    logger->inc(l_bluestore_kerneldevice_aio_submit_retries, retries);
+  }
   if (r < 0) {
     derr << " aio submit got " << cpp_strerror(r) << dendl;
     assert(r == 0);
@@ -23,6 +23,8 @@
 #include "aio.h"
 #include "BlockDevice.h"
 
+class PerfCounters;
+
 class KernelDevice : public BlockDevice {
   int fd_direct, fd_buffered;
   std::string path;
@@ -35,9 +37,11 @@ class KernelDevice : public BlockDevice {
   std::atomic<bool> io_since_flush = {false};
   std::mutex flush_mutex;
 
-  aio_queue_t aio_queue;
+  std::unique_ptr<io_queue_t> io_queue;
   bool aio_stop;
 
+  PerfCounters *logger = nullptr;
+
   struct AioCompletionThread : public Thread {
     KernelDevice *bdev;
     explicit AioCompletionThread(KernelDevice *b) : bdev(b) {}
@@ -53,6 +57,9 @@ class KernelDevice : public BlockDevice {
   int _aio_start();
   void _aio_stop();
 
+  void _init_logger();
+  void _shutdown_logger();
+
   void _aio_log_start(IOContext *ioc, uint64_t offset, uint64_t length);
   void _aio_log_finish(IOContext *ioc, uint64_t offset, uint64_t length);
 
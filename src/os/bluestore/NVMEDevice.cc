@@ -88,6 +88,10 @@ class SharedDriverData {
   uint32_t sector_size = 0;
   uint64_t size = 0;
 
+  std::mutex queue_lock;
+  std::vector<SharedDriverQueueData*> queues;  ///< protected by queue_lock
+  unsigned next_shared_queue = 0;
+
   public:
   std::vector<NVMEDevice*> registered_devices;
   friend class SharedDriverQueueData;
@@ -103,8 +107,7 @@ class SharedDriverData {
   }
 
   bool is_equal(const string &tag) const { return sn == tag; }
-  ~SharedDriverData() {
-  }
+  ~SharedDriverData();
 
   void register_device(NVMEDevice *device) {
     registered_devices.push_back(device);
@@ -125,6 +128,8 @@ class SharedDriverData {
   uint64_t get_size() {
     return size;
   }
+
+  SharedDriverQueueData *get_queue(NVMEDevice *bdev);
 };
 
 class SharedDriverQueueData {
@@ -141,6 +146,11 @@ class SharedDriverQueueData {
   int alloc_buf_from_pool(Task *t, bool write);
 
   public:
+    /// uncontended unless the controller ran out of qpairs (or
+    /// bluestore_spdk_io_qpairs was reached) and threads share queues
+    std::mutex lock;
+    bool valid() const { return qpair != nullptr; }
+
     uint32_t current_queue_depth = 0;
     std::atomic_ulong completed_op_seq, queue_op_seq;
     std::vector<void*> data_buf_mempool;
@@ -161,7 +171,9 @@ class SharedDriverQueueData {
     // usable queue depth should minus 1 to aovid overflow.
     max_queue_depth = opts.io_queue_size - 1;
     qpair = spdk_nvme_ctrlr_alloc_io_qpair(ctrlr, &opts, sizeof(opts));
-    assert(qpair != NULL);
+    if (!qpair) {
+      return;
+    }
 
     // allocate spdk dma memory
     for (uint16_t i = 0; i < data_buffer_default_num; i++) {
@@ -192,11 +204,12 @@ class SharedDriverQueueData {
   }
 
   ~SharedDriverQueueData() {
-    g_ceph_context->get_perfcounters_collection()->remove(logger);
     if (!qpair) {
-      spdk_nvme_ctrlr_free_io_qpair(qpair);
-      bdev->queue_number--;
+      return;
     }
+    g_ceph_context->get_perfcounters_collection()->remove(logger);
+    spdk_nvme_ctrlr_free_io_qpair(qpair);
+    bdev->queue_number--;
 
     // free all spdk dma memory;
     if (!data_buf_mempool.empty()) {
@@ -212,6 +225,15 @@ class SharedDriverQueueData {
   }
 };
 
+SharedDriverData::~SharedDriverData()
+{
+  std::lock_guard<std::mutex> l(queue_lock);
+  for (auto q : queues) {
+    delete q;
+  }
+  queues.clear();
+}
+
 struct Task {
   NVMEDevice *device;
   IOContext *ctx = nullptr;
@@ -363,6 +385,9 @@ void SharedDriverQueueData::_aio_handle(Task *t, IOContext *ioc)
     = ceph::coarse_real_clock::now();
   while (ioc->num_running) {
  again:
+    // hold the queue only for one round of polling and submitting, so
+    // that threads sharing it can get their ios in while we wait for ours
+    std::unique_lock<std::mutex> l(lock);
     dout(40) << __func__ << " polling" << dendl;
     if (current_queue_depth) {
       spdk_nvme_qpair_process_completions(qpair, g_conf->bluestore_spdk_max_io_completion);
@@ -445,6 +470,7 @@ void SharedDriverQueueData::_aio_handle(Task *t, IOContext *ioc)
       }
       current_queue_depth++;
     }
+    l.unlock();
     cur = ceph::coarse_real_clock::now();
     auto dur = std::chrono::duration_cast<std::chrono::nanoseconds>(cur - start);
     logger->tinc(l_bluestore_nvmedevice_polling_lat, dur);
@@ -456,6 +482,26 @@ void SharedDriverQueueData::_aio_handle(Task *t, IOContext *ioc)
   dout(20) << __func__ << " end" << dendl;
 }
 
+SharedDriverQueueData *SharedDriverData::get_queue(NVMEDevice *bdev)
+{
+  std::lock_guard<std::mutex> l(queue_lock);
+  uint64_t max = g_conf->get_val<uint64_t>("bluestore_spdk_io_qpairs");
+  if (!max || queues.size() < max) {
+    SharedDriverQueueData *q = new SharedDriverQueueData(bdev, this);
+    if (q->valid()) {
+      dout(10) << __func__ << " new io qpair " << queues.size() << dendl;
+      queues.push_back(q);
+      return q;
+    }
+    delete q;
+    dout(1) << __func__ << " controller has no more io qpairs, sharing "
+	    << queues.size() << " among threads" << dendl;
+    assert(!queues.empty());
+  }
+  // share, round robin
+  return queues[next_shared_queue++ % queues.size()];
+}
+
 #define dout_subsys ceph_subsys_bdev
 #undef dout_prefix
 #define dout_prefix *_dout << "bdev "
@@ -467,6 +513,10 @@ class NVMEManager {
     NVMEManager *manager;
     SharedDriverData *driver;
     bool done;
+    /// sn_tag is a transport id (e.g. an nvmf target backed by a malloc
+    /// bdev, for testing without nvme hardware) rather than a serial
+    bool by_trid;
+    struct spdk_nvme_transport_id trid;
   };
 
  private:
@@ -482,7 +532,8 @@ class NVMEManager {
   NVMEManager()
       : lock("NVMEDevice::NVMEManager::lock") {}
   int try_get(const string &sn_tag, SharedDriverData **driver);
-  void register_ctrlr(const string &sn_tag, spdk_nvme_ctrlr *c, struct spdk_pci_device *pci_dev,
+  void register_ctrlr(const string &sn_tag, spdk_nvme_ctrlr *c,
+                      const struct spdk_nvme_transport_id *trid,
                       SharedDriverData **driver) {
     assert(lock.is_locked());
     spdk_nvme_ns *ns;
@@ -496,8 +547,8 @@ class NVMEManager {
       derr << __func__ << " failed to get namespace at 1" << dendl;
       ceph_abort();
     }
-    dout(1) << __func__ << " successfully attach nvme device at" << spdk_pci_device_get_bus(pci_dev)
-            << ":" << spdk_pci_device_get_dev(pci_dev) << ":" << spdk_pci_device_get_func(pci_dev) << dendl;
+    dout(1) << __func__ << " successfully attach nvme device at "
+            << trid->traddr << dendl;
 
     // only support one device per osd now!
     assert(shared_driver_datas.empty());
@@ -517,6 +568,11 @@ static bool probe_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid, st
   struct spdk_pci_device *pci_dev = NULL;
   int result = 0;
 
+  if (ctx->by_trid) {
+    // spdk_nvme_probe() was given the transport id; nothing else is probed
+    return true;
+  }
+
   if (trid->trtype != SPDK_NVME_TRANSPORT_PCIE) {
     dout(0) << __func__ << " only probe local nvme device" << dendl;
     return false;
@@ -555,19 +611,8 @@ static bool probe_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid, st
 static void attach_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
                       struct spdk_nvme_ctrlr *ctrlr, const struct spdk_nvme_ctrlr_opts *opts)
 {
-  struct spdk_pci_addr pci_addr;
-  struct spdk_pci_device *pci_dev = NULL;
-
-  spdk_pci_addr_parse(&pci_addr, trid->traddr);
-
-  pci_dev = spdk_pci_get_device(&pci_addr);
-  if (!pci_dev) {
-    dout(0) << __func__ << " failed to get pci device" << dendl; 
-    assert(pci_dev);
-  }
-
   NVMEManager::ProbeContext *ctx = static_cast<NVMEManager::ProbeContext*>(cb_ctx);
-  ctx->manager->register_ctrlr(ctx->sn_tag, ctrlr, pci_dev, &ctx->driver);
+  ctx->manager->register_ctrlr(ctx->sn_tag, ctrlr, trid, &ctx->driver);
 }
 
 int NVMEManager::try_get(const string &sn_tag, SharedDriverData **driver)
@@ -636,7 +681,8 @@ int NVMEManager::try_get(const string &sn_tag, SharedDriverData **driver)
           if (!probe_queue.empty()) {
             ProbeContext* ctxt = probe_queue.front();
             probe_queue.pop_front();
-            r = spdk_nvme_probe(NULL, ctxt, probe_cb, attach_cb, NULL);
+            r = spdk_nvme_probe(ctxt->by_trid ? &ctxt->trid : NULL, ctxt,
+                                probe_cb, attach_cb, NULL);
             if (r < 0) {
               assert(!ctxt->driver);
               derr << __func__ << " device probe nvme failed" << dendl;
@@ -652,7 +698,14 @@ int NVMEManager::try_get(const string &sn_tag, SharedDriverData **driver)
     dpdk_thread.detach();
   }
 
-  ProbeContext ctx = {sn_tag, this, nullptr, false};
+  ProbeContext ctx = {sn_tag, this, nullptr, false, false};
+  if (sn_tag.compare(0, 7, "trtype:") == 0) {
+    ctx.by_trid = true;
+    if (spdk_nvme_transport_id_parse(&ctx.trid, sn_tag.c_str()) != 0) {
+      derr << __func__ << " invalid transport id " << sn_tag << dendl;
+      return -EINVAL;
+    }
+  }
   {
     std::unique_lock<std::mutex> l(probe_queue_lock);
     probe_queue.push_back(&ctx);
@@ -745,7 +798,7 @@ int NVMEDevice::open(const string& p)
 	 << dendl;
     return r;
   }
-  char buf[100];
+  char buf[512];
   r = ::read(fd, buf, sizeof(buf));
   VOID_TEMP_FAILURE_RETRY(::close(fd));
   fd = -1; // defensive
@@ -758,10 +811,17 @@ int NVMEDevice::open(const string& p)
     derr << __func__ << " unable to read " << p << ": " << cpp_strerror(r) << dendl;
     return r;
   }
-  /* scan buf from the beginning with isxdigit. */
   int i = 0;
-  while (i < r && isxdigit(buf[i])) {
-    i++;
+  if (r > 7 && strncmp(buf, "trtype:", 7) == 0) {
+    /* a transport id, e.g. "trtype:RDMA adrfam:IPv4 traddr:... subnqn:..." */
+    while (i < r && buf[i] != '\n' && buf[i] != '\0') {
+      i++;
+    }
+  } else {
+    /* scan buf from the beginning with isxdigit. */
+    while (i < r && isxdigit(buf[i])) {
+      i++;
+    }
   }
   serial_number = string(buf, i);
   r = manager.try_get(serial_number, &driver);
@@ -830,8 +890,10 @@ void NVMEDevice::aio_submit(IOContext *ioc)
     assert(ioc->num_pending.load() == 0);  // we should be only thread doing this
     // Only need to push the first entry
     ioc->nvme_task_first = ioc->nvme_task_last = nullptr;
+    // each submitting thread (osd op shard, kv sync thread, ...) gets its
+    // own qpair and polls its own completions inline
     if(!queue_t)
-	queue_t = new SharedDriverQueueData(this, driver);
+	queue_t = driver->get_queue(this);
     queue_t->_aio_handle(t, ioc);
   }
 }
@@ -37,6 +37,7 @@ struct aio_t {
     length = len;
     bufferptr p = buffer::create_page_aligned(length);
     io_prep_pread(&iocb, fd, p.c_str(), length, offset);
+    iov.push_back(iovec{p.c_str(), length});  // for io_queue_t's not using iocb
     bl.append(std::move(p));
   }
 
@@ -52,21 +53,40 @@ typedef boost::intrusive::list<
     boost::intrusive::list_member_hook<>,
     &aio_t::queue_item> > aio_list_t;
 
-struct aio_queue_t {
+/// interface to a kernel async io submission/completion queue
+struct io_queue_t {
+  typedef list<aio_t>::iterator aio_iter;
+
+  virtual ~io_queue_t() {}
+
+  /// name of the backend, for metadata and logging
+  virtual const char *get_type() const = 0;
+  /// set up the queue; fds are all the files we will submit io against
+  virtual int init(const std::vector<int>& fds) = 0;
+  virtual void shutdown() = 0;
+  virtual int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+			   void *priv, int *retries) = 0;
+  virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+};
+
+/// libaio (io_submit/io_getevents) based queue
+struct aio_queue_t final : public io_queue_t {
   int max_iodepth;
   io_context_t ctx;
 
-  typedef list<aio_t>::iterator aio_iter;
-
   explicit aio_queue_t(unsigned max_iodepth)
     : max_iodepth(max_iodepth),
       ctx(0) {
   }
-  ~aio_queue_t() {
+  ~aio_queue_t() override {
     assert(ctx == 0);
   }
 
-  int init() {
+  const char *get_type() const override {
+    return "libaio";
+  }
+
+  int init(const std::vector<int>& fds) override {
     assert(ctx == 0);
     int r = io_setup(max_iodepth, &ctx);
     if (r < 0) {
@@ -77,7 +97,7 @@ struct aio_queue_t {
     }
     return r;
   }
-  void shutdown() {
+  void shutdown() override {
     if (ctx) {
       int r = io_destroy(ctx);
       assert(r == 0);
@@ -85,9 +105,9 @@ struct aio_queue_t {
     }
   }
 
-  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size, 
-		   void *priv, int *retries);
-  int get_next_completed(int timeout_ms, aio_t **paio, int max);
+  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+		   void *priv, int *retries) override;
+  int get_next_completed(int timeout_ms, aio_t **paio, int max) override;
 };
 
 #endif
@@ -133,6 +133,7 @@ int main(int argc, char **argv)
   string key, value;
   int log_level = 30;
   bool fsck_deep = false;
+  int fsck_max_threads = 8;
   po::options_description po_options("Options");
   po_options.add_options()
     ("help,h", "produce help message")
@@ -142,12 +143,13 @@ int main(int argc, char **argv)
     ("log-level", po::value<int>(&log_level), "log level (30=most, 20=lots, 10=some, 1=little)")
     ("dev", po::value<vector<string>>(&devs), "device(s)")
     ("deep", po::value<bool>(&fsck_deep), "deep fsck (read all data)")
+    ("max-threads", po::value<int>(&fsck_max_threads), "largest fsck thread count to try for bench-fsck")
     ("key,k", po::value<string>(&key), "label metadata key name")
     ("value,v", po::value<string>(&value), "label metadata value")
     ;
   po::options_description po_positional("Positional options");
   po_positional.add_options()
-    ("command", po::value<string>(&action), "fsck, repair, bluefs-export, bluefs-bdev-sizes, bluefs-bdev-expand, show-label, set-label-key, rm-label-key, prime-osd-dir")
+    ("command", po::value<string>(&action), "fsck, repair, bench-fsck, migrate-cfs, bluefs-export, bluefs-bdev-sizes, bluefs-bdev-expand, show-label, set-label-key, rm-label-key, prime-osd-dir")
     ;
   po::options_description po_all("All options");
   po_all.add(po_options).add(po_positional);
@@ -177,7 +179,8 @@ int main(int argc, char **argv)
     exit(EXIT_FAILURE);
   }
 
-  if (action == "fsck" || action == "repair") {
+  if (action == "fsck" || action == "repair" || action == "bench-fsck" ||
+      action == "migrate-cfs") {
     if (path.empty()) {
       cerr << "must specify bluestore path" << std::endl;
       exit(EXIT_FAILURE);
@@ -296,6 +299,40 @@ int main(int argc, char **argv)
     }
     cout << action << " success" << std::endl;
   }
+  else if (action == "bench-fsck") {
+    validate_path(cct.get(), path, false);
+    cout << "threads\tobjects\tseconds\tobjects/sec\tMB/sec" << std::endl;
+    for (int threads = 1; threads <= fsck_max_threads; threads *= 2) {
+      cct->_conf->set_val_or_die("bluestore_fsck_threads", stringify(threads));
+      cct->_conf->apply_changes(NULL);
+      BlueStore bluestore(cct.get(), path);
+      int r = bluestore.fsck(fsck_deep);
+      if (r < 0) {
+	cerr << "error from fsck: " << cpp_strerror(r) << std::endl;
+	exit(EXIT_FAILURE);
+      }
+      if (r > 0) {
+	cerr << "fsck found " << r << " errors" << std::endl;
+	exit(EXIT_FAILURE);
+      }
+      const auto& stats = bluestore.get_last_fsck_stats();
+      double secs = MAX((double)stats.duration, 0.000001);
+      cout << threads << "\t" << stats.num_objects << "\t" << secs << "\t"
+	   << (uint64_t)(stats.num_objects / secs) << "\t"
+	   << (stats.bytes / secs / 1048576.0) << std::endl;
+    }
+  }
+  else if (action == "migrate-cfs") {
+    validate_path(cct.get(), path, false);
+    BlueStore bluestore(cct.get(), path);
+    int r = bluestore.migrate_column_families(cerr);
+    if (r < 0) {
+      cerr << "error migrating column families: " << cpp_strerror(r)
+	   << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    cout << action << " success" << std::endl;
+  }
   else if (action == "prime-osd-dir") {
     bluestore_bdev_label_t label;
     int r = BlueStore::_read_bdev_label(cct.get(), devs.front(), &label);
@@ -1145,3 +1145,48 @@ void bluestore_compression_header_t::generate_test_instances(
   o.push_back(new bluestore_compression_header_t(1));
   o.back()->length = 1234;
 }
+
+// bluestore_alloc_checkpoint_t
+
+void bluestore_alloc_checkpoint_t::dump(Formatter *f) const
+{
+  f->dump_unsigned("size", size);
+  f->dump_unsigned("min_alloc_size", min_alloc_size);
+  f->dump_unsigned("num_extents", num_extents);
+  f->dump_unsigned("free_bytes", free_bytes);
+  f->dump_unsigned("num_chunks", num_chunks);
+  f->dump_unsigned("crc", crc);
+  f->open_array_section("bluefs_extents");
+  for (auto p = bluefs_extents.begin(); p != bluefs_extents.end(); ++p) {
+    f->open_object_section("extent");
+    f->dump_unsigned("offset", p.get_start());
+    f->dump_unsigned("length", p.get_len());
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void bluestore_alloc_checkpoint_t::generate_test_instances(
+  list<bluestore_alloc_checkpoint_t*>& o)
+{
+  o.push_back(new bluestore_alloc_checkpoint_t);
+  o.push_back(new bluestore_alloc_checkpoint_t);
+  o.back()->size = 1ull << 30;
+  o.back()->min_alloc_size = 4096;
+  o.back()->num_extents = 2;
+  o.back()->free_bytes = 1ull << 20;
+  o.back()->num_chunks = 1;
+  o.back()->crc = 0x12345678;
+  o.back()->bluefs_extents.insert(0x2000, 0x10000);
+}
+
+ostream& operator<<(ostream& out, const bluestore_alloc_checkpoint_t& c)
+{
+  return out << "alloc_checkpoint(size 0x" << std::hex << c.size
+	     << " min_alloc 0x" << c.min_alloc_size
+	     << " free 0x" << c.free_bytes << std::dec
+	     << " extents " << c.num_extents
+	     << " chunks " << c.num_chunks
+	     << " crc 0x" << std::hex << c.crc << std::dec
+	     << " bluefs_extents " << c.bluefs_extents << ")";
+}
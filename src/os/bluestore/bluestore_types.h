@@ -1076,5 +1076,33 @@ struct bluestore_compression_header_t {
 };
 WRITE_CLASS_DENC(bluestore_compression_header_t)
 
+/// allocator free-space checkpoint written on clean umount
+struct bluestore_alloc_checkpoint_t {
+  uint64_t size = 0;            ///< device size covered
+  uint64_t min_alloc_size = 0;  ///< min_alloc_size at time of checkpoint
+  uint64_t num_extents = 0;     ///< total free extents over all chunks
+  uint64_t free_bytes = 0;      ///< sum of free extent lengths
+  uint32_t num_chunks = 0;      ///< number of extent chunk keys
+  uint32_t crc = -1;            ///< crc32c over all encoded chunks
+  interval_set<uint64_t> bluefs_extents;  ///< bluefs_extents at checkpoint
+
+  DENC(bluestore_alloc_checkpoint_t, v, p) {
+    DENC_START(1, 1, p);
+    denc(v.size, p);
+    denc(v.min_alloc_size, p);
+    denc(v.num_extents, p);
+    denc(v.free_bytes, p);
+    denc(v.num_chunks, p);
+    denc(v.crc, p);
+    denc(v.bluefs_extents, p);
+    DENC_FINISH(p);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<bluestore_alloc_checkpoint_t*>& o);
+};
+WRITE_CLASS_DENC(bluestore_alloc_checkpoint_t)
+
+ostream& operator<<(ostream& out, const bluestore_alloc_checkpoint_t& c);
+
 
 #endif
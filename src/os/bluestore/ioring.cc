@@ -0,0 +1,268 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "ioring.h"
+
+#if defined(HAVE_LIBAIO)
+
+#if defined(HAVE_LIBURING)
+
+#include <liburing.h>
+#include <sys/epoll.h>
+
+#include <mutex>
+
+#include "common/Clock.h"
+#include "include/compat.h"
+
+struct ioring_data {
+  struct io_uring io_uring;
+  std::mutex sq_lock;  ///< serialize sqe preparation and submission
+  std::mutex cq_lock;  ///< serialize cqe reaping
+  int epoll_fd = -1;
+  std::map<int, int> fixed_fds;  ///< fd -> index in the registered file table
+};
+
+static int ioring_get_cqe(ioring_data *d, unsigned max, aio_t **paio)
+{
+  struct io_uring *ring = &d->io_uring;
+  struct io_uring_cqe *cqe;
+  unsigned head;
+  unsigned nr = 0;
+
+  io_uring_for_each_cqe(ring, head, cqe) {
+    aio_t *io = static_cast<aio_t*>(io_uring_cqe_get_data(cqe));
+    io->rval = cqe->res;
+    paio[nr++] = io;
+    if (nr == max)
+      break;
+  }
+  io_uring_cq_advance(ring, nr);
+  return nr;
+}
+
+static int find_fixed_fd(ioring_data *d, int real_fd)
+{
+  auto it = d->fixed_fds.find(real_fd);
+  if (it == d->fixed_fds.end())
+    return -1;
+  return it->second;
+}
+
+static void init_sqe(ioring_data *d, struct io_uring_sqe *sqe, aio_t *io)
+{
+  int fixed_fd = find_fixed_fd(d, io->fd);
+  assert(fixed_fd != -1);
+
+  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV) {
+    io_uring_prep_writev(sqe, fixed_fd, &io->iov[0], io->iov.size(),
+			 io->offset);
+  } else if (io->iocb.aio_lio_opcode == IO_CMD_PREAD ||
+	     io->iocb.aio_lio_opcode == IO_CMD_PREADV) {
+    io_uring_prep_readv(sqe, fixed_fd, &io->iov[0], io->iov.size(),
+			io->offset);
+  } else {
+    assert(0 == "unexpected aio opcode");
+  }
+  io_uring_sqe_set_data(sqe, io);
+  io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+}
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
+  : d(new ioring_data),
+    iodepth(iodepth_),
+    hipri(hipri_),
+    sq_thread(sq_thread_)
+{
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+  assert(d->epoll_fd < 0);
+}
+
+bool ioring_queue_t::supported()
+{
+  struct io_uring ring;
+  int r = io_uring_queue_init(16, &ring, 0);
+  if (r < 0)
+    return false;
+  io_uring_queue_exit(&ring);
+  return true;
+}
+
+int ioring_queue_t::init(const std::vector<int>& fds)
+{
+  unsigned flags = 0;
+  if (hipri)
+    flags |= IORING_SETUP_IOPOLL;
+  if (sq_thread)
+    flags |= IORING_SETUP_SQPOLL;
+
+  int r = io_uring_queue_init(iodepth, &d->io_uring, flags);
+  if (r < 0)
+    return r;
+
+  r = io_uring_register_files(&d->io_uring, &fds[0], fds.size());
+  if (r < 0)
+    goto out_ring;
+  for (unsigned i = 0; i < fds.size(); ++i) {
+    d->fixed_fds[fds[i]] = i;
+  }
+
+  d->epoll_fd = epoll_create1(0);
+  if (d->epoll_fd < 0) {
+    r = -errno;
+    goto out_files;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;
+  r = epoll_ctl(d->epoll_fd, EPOLL_CTL_ADD, d->io_uring.ring_fd, &ev);
+  if (r < 0) {
+    r = -errno;
+    goto out_epoll;
+  }
+  return 0;
+
+ out_epoll:
+  VOID_TEMP_FAILURE_RETRY(::close(d->epoll_fd));
+  d->epoll_fd = -1;
+ out_files:
+  io_uring_unregister_files(&d->io_uring);
+  d->fixed_fds.clear();
+ out_ring:
+  io_uring_queue_exit(&d->io_uring);
+  return r;
+}
+
+void ioring_queue_t::shutdown()
+{
+  if (d->epoll_fd < 0)
+    return;
+  d->fixed_fds.clear();
+  VOID_TEMP_FAILURE_RETRY(::close(d->epoll_fd));
+  d->epoll_fd = -1;
+  io_uring_queue_exit(&d->io_uring);
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  // same backoff policy as aio_queue_t::submit_batch
+  int attempts = 16;
+  int delay = 125;
+  int done = 0;
+
+  std::lock_guard<std::mutex> l(d->sq_lock);
+  aio_iter cur = beg;
+  while (cur != end) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&d->io_uring);
+    if (!sqe) {
+      // the sq ring is full; push what we have to the kernel and retry
+      int r = io_uring_submit(&d->io_uring);
+      if (r < 0)
+	return r;
+      if (r == 0) {
+	if (attempts-- <= 0)
+	  return -EAGAIN;
+	usleep(delay);
+	delay *= 2;
+	(*retries)++;
+      }
+      continue;
+    }
+    cur->priv = priv;
+    init_sqe(d.get(), sqe, &*cur);
+    ++done;
+    ++cur;
+  }
+  assert(aios_size >= done);
+
+  int r = io_uring_submit(&d->io_uring);
+  if (r < 0)
+    return r;
+  return done;
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  std::lock_guard<std::mutex> l(d->cq_lock);
+  int events = ioring_get_cqe(d.get(), max, paio);
+  if (events)
+    return events;
+
+  if (hipri && !sq_thread) {
+    // polled io only completes when someone reaps the device queue: that
+    // is us.  spin until something shows up or we time out.
+    utime_t deadline = ceph_clock_now();
+    deadline += (double)timeout_ms / 1000.0;
+    do {
+      {
+	std::lock_guard<std::mutex> sl(d->sq_lock);
+	int r = io_uring_submit(&d->io_uring);
+	if (r < 0)
+	  return r;
+      }
+      events = ioring_get_cqe(d.get(), max, paio);
+    } while (events == 0 && ceph_clock_now() < deadline);
+    return events;
+  }
+
+  struct epoll_event ev;
+  int r = epoll_wait(d->epoll_fd, &ev, 1, timeout_ms);
+  if (r < 0)
+    return errno == EINTR ? 0 : -errno;
+  if (r == 0)
+    return 0;
+  return ioring_get_cqe(d.get(), max, paio);
+}
+
+#else // HAVE_LIBURING
+
+struct ioring_data {};
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
+{
+  assert(0);
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+}
+
+bool ioring_queue_t::supported()
+{
+  return false;
+}
+
+int ioring_queue_t::init(const std::vector<int>& fds)
+{
+  assert(0);
+  return -EOPNOTSUPP;
+}
+
+void ioring_queue_t::shutdown()
+{
+  assert(0);
+}
+
+int ioring_queue_t::submit_batch(aio_iter begin, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  assert(0);
+  return -EOPNOTSUPP;
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  assert(0);
+  return -EOPNOTSUPP;
+}
+
+#endif // HAVE_LIBURING
+
+#endif // HAVE_LIBAIO
@@ -0,0 +1,48 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include "acconfig.h"
+
+#include <memory>
+
+#include "aio.h"
+
+#if defined(HAVE_LIBAIO)
+
+struct ioring_data;
+
+/// io_uring based queue
+///
+/// Submission and completion go through the shared SQ/CQ rings, so a
+/// batch costs at most one io_uring_enter(2) (none at all with
+/// sq_thread_poll) and completions are reaped from the CQ ring without
+/// a syscall when they are already available.  The files passed to
+/// init() are registered with the ring so that the kernel does not
+/// have to look up the fd on every io.
+struct ioring_queue_t final : public io_queue_t {
+  std::unique_ptr<ioring_data> d;
+  unsigned iodepth = 0;
+  bool hipri = false;
+  bool sq_thread = false;
+
+  ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_);
+  ~ioring_queue_t() override;
+
+  /// true if this build and the running kernel can use io_uring
+  static bool supported();
+
+  const char *get_type() const override {
+    return "io_uring";
+  }
+
+  int init(const std::vector<int>& fds) override;
+  void shutdown() override;
+
+  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+		   void *priv, int *retries) override;
+  int get_next_completed(int timeout_ms, aio_t **paio, int max) override;
+};
+
+#endif
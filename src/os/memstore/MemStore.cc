@@ -722,6 +722,13 @@ int MemStore::queue_transactions(Sequencer *osr,
 					     &on_apply_sync);
   if (on_apply_sync)
     on_apply_sync->complete(0);
+  if (osr && osr->commit_queue) {
+    if (on_apply)
+      osr->commit_queue->queue(on_apply);
+    if (on_commit)
+      osr->commit_queue->queue(on_commit);
+    return 0;
+  }
   if (on_apply)
     finisher.queue(on_apply);
   if (on_commit)
@@ -115,6 +115,8 @@ ostream &operator<<(ostream &lhs, const ECBackend::ReadOp &rhs)
   return lhs << ", to_read=" << rhs.to_read
 	     << ", complete=" << rhs.complete
 	     << ", priority=" << rhs.priority
+	     << ", mode=" << rhs.mode
+	     << ", hedged=" << rhs.hedged
 	     << ", obj_to_source=" << rhs.obj_to_source
 	     << ", source_to_obj=" << rhs.source_to_obj
 	     << ", in_progress=" << rhs.in_progress << ")";
@@ -129,6 +131,8 @@ void ECBackend::ReadOp::dump(Formatter *f) const
   f->dump_stream("to_read") << to_read;
   f->dump_stream("complete") << complete;
   f->dump_int("priority", priority);
+  f->dump_int("mode", mode);
+  f->dump_stream("hedged") << hedged;
   f->dump_stream("obj_to_source") << obj_to_source;
   f->dump_stream("source_to_obj") << source_to_obj;
   f->dump_stream("in_progress") << in_progress;
@@ -1127,6 +1131,12 @@ void ECBackend::handle_sub_read_reply(
   if (iter == tid_to_read_map.end()) {
     //canceled
     dout(20) << __func__ << ": dropped " << op << dendl;
+    // a slow shard is still slow if the read completed without it
+    auto late = late_reads.find(make_pair(op.tid, from));
+    if (late != late_reads.end()) {
+      shard_read_latency[from].add((double)(ceph_clock_now() - late->second));
+      late_reads.erase(late);
+    }
     return;
   }
   ReadOp &rop = iter->second;
@@ -1151,6 +1161,9 @@ void ECBackend::handle_sub_read_reply(
       assert(req_iter != rop.to_read.find(i->first)->second.to_read.end());
       assert(riter != rop.complete[i->first].returned.end());
       pair<uint64_t, uint64_t> adjusted =
+	rop.mode == ReadOp::DIRECT ?
+	sinfo.offset_len_to_chunk_extent(
+	  make_pair(req_iter->get<0>(), req_iter->get<1>())) :
 	sinfo.aligned_offset_len_to_chunk(
 	  make_pair(req_iter->get<0>(), req_iter->get<1>()));
       assert(adjusted.first == j->first);
@@ -1187,6 +1200,23 @@ void ECBackend::handle_sub_read_reply(
 
   assert(rop.in_progress.count(from));
   rop.in_progress.erase(from);
+  if (!rop.for_recovery) {
+    shard_read_latency[from].add((double)(ceph_clock_now() - rop.sent[from]));
+  }
+  rop.sent.erase(from);
+  auto hiter = rop.hedge_events.find(from);
+  if (hiter != rop.hedge_events.end()) {
+    get_parent()->cancel_timer_event(hiter->second);
+    rop.hedge_events.erase(hiter);
+  }
+  if (rop.mode != ReadOp::DECODE) {
+    // nothing to decode, the callback checks every chunk came back
+    if (rop.in_progress.empty()) {
+      dout(20) << __func__ << " Complete: " << rop << dendl;
+      complete_read_op(rop, m);
+    }
+    return;
+  }
   unsigned is_complete = 0;
   // For redundant reads check for completion as each shard comes in,
   // or in a non-recovery read check for completion once all the shards read.
@@ -1257,6 +1287,41 @@ void ECBackend::handle_sub_read_reply(
 
 void ECBackend::complete_read_op(ReadOp &rop, RecoveryMessages *m)
 {
+  cancel_read_hedge(rop);
+  if (rop.hedge) {
+    bool first_pending = false;
+    for (auto &&i: rop.in_progress) {
+      if (!rop.hedged.count(i)) {
+	first_pending = true;
+	break;
+      }
+    }
+    if (!rop.hedged.empty() && first_pending) {
+      get_parent()->get_logger()->inc(l_osd_ec_read_hedge_win);
+    }
+    // compared to fast_read, which always reads every shard
+    uint64_t saved = 0;
+    for (auto &&i: rop.to_read) {
+      uint64_t unread = ec_impl->get_chunk_count() -
+	rop.obj_to_source[i.first].size();
+      for (auto &&extent: i.second.to_read) {
+	saved += unread * sinfo.aligned_offset_len_to_chunk(
+	  make_pair(extent.get<0>(), extent.get<1>())).second;
+      }
+    }
+    get_parent()->get_logger()->inc(l_osd_ec_read_bytes_saved, saved);
+  }
+  // replies still outstanding are dropped, @see handle_sub_read_reply
+  for (auto &&i: rop.in_progress) {
+    if (!rop.for_recovery)
+      late_reads[make_pair(rop.tid, i)] = rop.sent[i];
+    auto siter = shard_to_read_map.find(i);
+    if (siter != shard_to_read_map.end()) {
+      siter->second.erase(rop.tid);
+      if (siter->second.empty())
+	shard_to_read_map.erase(siter);
+    }
+  }
   map<hobject_t, read_request_t>::iterator reqiter =
     rop.to_read.begin();
   map<hobject_t, read_result_t>::iterator resiter =
@@ -1391,6 +1456,7 @@ void ECBackend::on_change()
        i != tid_to_read_map.end();
        ++i) {
     dout(10) << __func__ << ": cancelling " << i->second << dendl;
+    cancel_read_hedge(i->second);
     for (map<hobject_t, read_request_t>::iterator j =
 	   i->second.to_read.begin();
 	 j != i->second.to_read.end();
@@ -1402,6 +1468,8 @@ void ECBackend::on_change()
   tid_to_read_map.clear();
   in_progress_client_reads.clear();
   shard_to_read_map.clear();
+  shard_read_latency.clear();
+  late_reads.clear();
   clear_recovery_state();
 }
 
@@ -1604,12 +1672,13 @@ int ECBackend::get_remaining_shards(
   return 0;
 }
 
-void ECBackend::start_read_op(
+ceph_tid_t ECBackend::start_read_op(
   int priority,
   map<hobject_t, read_request_t> &to_read,
   OpRequestRef _op,
   bool do_redundant_reads,
-  bool for_recovery)
+  bool for_recovery,
+  ReadOp::read_mode_t mode)
 {
   ceph_tid_t tid = get_parent()->get_tid();
   assert(!tid_to_read_map.count(tid));
@@ -1622,12 +1691,14 @@ void ECBackend::start_read_op(
       for_recovery,
       _op,
       std::move(to_read))).first->second;
+  op.mode = mode;
   dout(10) << __func__ << ": starting " << op << dendl;
   if (_op) {
     op.trace = _op->pg_trace;
     op.trace.event("start ec read");
   }
   do_read_op(op);
+  return tid;
 }
 
 void ECBackend::do_read_op(ReadOp &op)
@@ -1657,6 +1728,8 @@ void ECBackend::do_read_op(ReadOp &op)
 	 j != i->second.to_read.end();
 	 ++j) {
       pair<uint64_t, uint64_t> chunk_off_len =
+	op.mode == ReadOp::DIRECT ?
+	sinfo.offset_len_to_chunk_extent(make_pair(j->get<0>(), j->get<1>())) :
 	sinfo.aligned_offset_len_to_chunk(make_pair(j->get<0>(), j->get<1>()));
       for (set<pg_shard_t>::const_iterator k = i->second.need.begin();
 	   k != i->second.need.end();
@@ -1671,10 +1744,12 @@ void ECBackend::do_read_op(ReadOp &op)
     }
   }
 
+  utime_t now = ceph_clock_now();
   for (map<pg_shard_t, ECSubRead>::iterator i = messages.begin();
        i != messages.end();
        ++i) {
     op.in_progress.insert(i->first);
+    op.sent[i->first] = now;
     shard_to_read_map[i->first].insert(op.tid);
     i->second.tid = tid;
     MOSDECSubOpRead *msg = new MOSDECSubOpRead;
@@ -1771,6 +1846,10 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
       return ref;
     },
     get_parent()->get_dpp());
+  if (cct->_conf->get_val<bool>("osd_ec_parity_delta_writes")) {
+    ECTransaction::plan_parity_delta(
+      op->plan, sinfo, ec_impl, get_parent()->get_dpp());
+  }
 
   dout(10) << __func__ << ": " << *op << dendl;
 
@@ -1793,6 +1872,23 @@ bool ECBackend::try_state_to_reads()
     return false;
   }
 
+  if (blocked_by_parity_delta(*op)) {
+    dout(20) << __func__ << ": blocking " << *op
+	     << " because it writes an object with a parity delta"
+	     << " read in progress" << dendl;
+    return false;
+  }
+
+  if (!op->plan.parity_delta.empty()) {
+    if (start_parity_delta_read(op)) {
+      waiting_state.pop_front();
+      waiting_reads.push_back(*op);
+      dout(10) << __func__ << ": " << *op << dendl;
+      return true;
+    }
+    op->plan.parity_delta.clear();
+  }
+
   if (op->invalidates_cache()) {
     dout(20) << __func__ << ": invalidating cache after this op"
 	     << dendl;
@@ -1901,6 +1997,7 @@ bool ECBackend::try_reads_to_commit()
       get_parent()->get_info().pgid.pgid,
       sinfo,
       op->remote_read_result,
+      op->parity_delta_read_result,
       op->log_entries,
       &written,
       &trans,
@@ -1927,6 +2024,10 @@ bool ECBackend::try_reads_to_commit()
   for (auto &&i: written) {
     written_set[i.first] = i.second.get_interval_set();
   }
+  for (auto &&i: op->plan.parity_delta) {
+    // written around the cache, see blocked_by_parity_delta
+    written_set[i.first] = op->plan.will_write[i.first];
+  }
   dout(20) << __func__ << ": written_set: " << written_set << dendl;
   assert(written_set == op->plan.will_write);
 
@@ -1938,6 +2039,7 @@ bool ECBackend::try_reads_to_commit()
   }
   op->remote_read.clear();
   op->remote_read_result.clear();
+  op->parity_delta_read_result.clear();
 
   dout(10) << "onreadable_sync: " << op->on_local_applied_sync << dendl;
   ObjectStore::Transaction empty;
@@ -2068,6 +2170,138 @@ void ECBackend::check_ops()
 	 try_finish_rmw());
 }
 
+bool ECBackend::blocked_by_parity_delta(const Op &op) const
+{
+  /* A parity delta write neither reads from nor updates the cache, so
+   * later writes to the same object must not start their reads before
+   * it commits. */
+  for (auto ops : {&waiting_reads, &waiting_commit}) {
+    for (auto &&i: *ops) {
+      if (!i.parity_delta)
+	continue;
+      for (auto &&hpair: i.plan.will_write) {
+	if (op.plan.will_write.count(hpair.first))
+	  return true;
+      }
+    }
+  }
+  return false;
+}
+
+struct FinishParityDeltaRead :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  ECBackend *ec;
+  ceph_tid_t tid;
+  FinishParityDeltaRead(ECBackend *ec, ceph_tid_t tid) : ec(ec), tid(tid) {}
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ec->finish_parity_delta_read(tid, in.second);
+  }
+};
+
+bool ECBackend::start_parity_delta_read(Op *op)
+{
+  assert(op->plan.parity_delta.size() == 1);
+  const hobject_t &hoid = op->plan.parity_delta.begin()->first;
+  if (cache.has_extents(hoid)) {
+    dout(20) << __func__ << ": " << hoid << " has writes in progress"
+	     << " through the cache" << dendl;
+    return false;
+  }
+
+  set<int> want = op->plan.parity_delta.begin()->second;
+  for (unsigned i = ec_impl->get_data_chunk_count();
+       i < ec_impl->get_chunk_count();
+       ++i) {
+    want.insert(i);
+  }
+  set<int> have;
+  map<shard_id_t, pg_shard_t> shards;
+  get_all_avail_shards(hoid, have, shards, false);
+  set<pg_shard_t> need;
+  for (auto &&i: want) {
+    auto siter = shards.find(shard_id_t(i));
+    if (siter == shards.end()) {
+      dout(20) << __func__ << ": " << hoid << " shard " << i
+	       << " is not available" << dendl;
+      return false;
+    }
+    need.insert(siter->second);
+  }
+
+  const extent_set &stripe = op->plan.to_read.begin()->second;
+  list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+  to_read.push_back(
+    boost::make_tuple(stripe.range_start(), stripe.size(), 0));
+  map<hobject_t, read_request_t> for_read_op;
+  for_read_op.insert(
+    make_pair(
+      hoid,
+      read_request_t(
+	to_read,
+	need,
+	false,
+	new FinishParityDeltaRead(this, op->tid))));
+
+  op->parity_delta = true;
+  op->parity_delta_read_pending = true;
+  op->using_cache = false;
+  dout(10) << __func__ << ": reading shards " << need
+	   << " of " << hoid << dendl;
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    for_read_op,
+    OpRequestRef(),
+    false, false, ReadOp::PARITY_DELTA);
+  return true;
+}
+
+void ECBackend::finish_parity_delta_read(ceph_tid_t tid, read_result_t &res)
+{
+  auto opiter = tid_to_op_map.find(tid);
+  assert(opiter != tid_to_op_map.end());
+  Op *op = &(opiter->second);
+  assert(op->parity_delta_read_pending);
+  assert(op->plan.parity_delta.size() == 1);
+  const hobject_t &hoid = op->plan.parity_delta.begin()->first;
+
+  bool complete = res.r == 0 && res.errors.empty() &&
+    res.returned.size() == 1;
+  if (complete) {
+    auto &result = op->parity_delta_read_result[hoid];
+    for (auto &&i: res.returned.front().get<2>()) {
+      if (i.second.length() != sinfo.get_chunk_size()) {
+	complete = false;
+	break;
+      }
+      result[i.first.shard].claim(i.second);
+    }
+    if (result.size() != op->plan.parity_delta.begin()->second.size() +
+	ec_impl->get_coding_chunk_count())
+      complete = false;
+  }
+  if (!complete) {
+    /* Fall back to reading and decoding the whole stripe, op stays
+     * flagged as a parity delta write to keep ordering later writes
+     * after it. */
+    dout(10) << __func__ << ": " << hoid << " read failed " << res.r
+	     << " errors " << res.errors
+	     << ", reading the whole stripe" << dendl;
+    op->plan.parity_delta.clear();
+    op->parity_delta_read_result.clear();
+    op->remote_read = op->plan.to_read;
+    objects_read_async_no_cache(
+      op->remote_read,
+      [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
+	for (auto &&i: results) {
+	  op->remote_read_result.emplace(i.first, i.second.second);
+	}
+	check_ops();
+      });
+  }
+  op->parity_delta_read_pending = false;
+  check_ops();
+}
+
 int ECBackend::objects_read_sync(
   const hobject_t &hoid,
   uint64_t off,
@@ -2184,15 +2418,37 @@ void ECBackend::objects_read_async(
       to_read.clear();
     }
   };
+  auto func = make_gen_lambda_context<
+    map<hobject_t,pair<int, extent_map> > &&, cb>(
+      cb(this,
+	 hoid,
+	 to_read,
+	 on_complete));
+
+  if (!fast_read && to_read.size() == 1 &&
+      cct->_conf->get_val<bool>("osd_ec_direct_reads")) {
+    const boost::tuple<uint64_t, uint64_t, uint32_t> &extent =
+      to_read.front().first;
+    pair<uint64_t, uint64_t> off_len(extent.get<0>(), extent.get<1>());
+    if (sinfo.offset_len_within_chunk(off_len)) {
+      set<int> have;
+      map<shard_id_t, pg_shard_t> shards;
+      get_all_avail_shards(hoid, have, shards, false);
+      const vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+      int i = sinfo.logical_offset_to_chunk_index(off_len.first);
+      int chunk = (int)chunk_mapping.size() > i ? chunk_mapping[i] : i;
+      auto shard = shards.find(shard_id_t(chunk));
+      if (shard != shards.end()) {
+	objects_read_direct(hoid, extent, shard->second, std::move(func));
+	return;
+      }
+    }
+  }
+
   objects_read_and_reconstruct(
     reads,
     fast_read,
-    make_gen_lambda_context<
-      map<hobject_t,pair<int, extent_map> > &&, cb>(
-	cb(this,
-	   hoid,
-	   to_read,
-	   on_complete)));
+    std::move(func));
 }
 
 struct CallClientContexts :
@@ -2254,6 +2510,80 @@ out:
   }
 };
 
+struct CallClientDirectRead :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  hobject_t hoid;
+  ECBackend *ec;
+  ECBackend::ClientAsyncReadStatus *status;
+  boost::tuple<uint64_t, uint64_t, uint32_t> extent;
+  CallClientDirectRead(
+    hobject_t hoid,
+    ECBackend *ec,
+    ECBackend::ClientAsyncReadStatus *status,
+    const boost::tuple<uint64_t, uint64_t, uint32_t> &extent)
+    : hoid(hoid), ec(ec), status(status), extent(extent) {}
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ECBackend::read_result_t &res = in.second;
+    uint64_t off = extent.get<0>();
+    uint64_t len = extent.get<1>();
+    pair<uint64_t, uint64_t> bounds =
+      ec->sinfo.offset_len_to_stripe_bounds(make_pair(off, len));
+    if (res.r == 0 && res.errors.empty() &&
+	res.returned.size() == 1 &&
+	res.returned.front().get<2>().size() == 1 &&
+	res.returned.front().get<2>().begin()->second.length() == len) {
+      extent_map result;
+      result.insert(
+	off, len,
+	std::move(res.returned.front().get<2>().begin()->second));
+      PerfCounters *logger = ec->get_parent()->get_logger();
+      logger->inc(l_osd_ec_read_direct);
+      logger->inc(
+	l_osd_ec_read_bytes_saved,
+	ec->ec_impl->get_chunk_count() *
+	ec->sinfo.aligned_logical_offset_to_chunk_offset(bounds.second) - len);
+      status->complete_object(hoid, 0, std::move(result));
+      ec->kick_reads();
+      return;
+    }
+    // error or short read, decode the stripe from the other shards
+    map<hobject_t, std::list<boost::tuple<uint64_t, uint64_t, uint32_t> > >
+      reads;
+    reads[hoid].push_back(
+      boost::make_tuple(bounds.first, bounds.second, extent.get<2>()));
+    ec->start_client_read_op(reads, status, false);
+  }
+};
+
+void ECBackend::objects_read_direct(
+  const hobject_t &hoid,
+  const boost::tuple<uint64_t, uint64_t, uint32_t> &extent,
+  pg_shard_t shard,
+  GenContextURef<map<hobject_t,pair<int, extent_map> > &&> &&func)
+{
+  dout(10) << __func__ << ": " << hoid << " " << extent
+	   << " from " << shard << dendl;
+  in_progress_client_reads.emplace_back(1, std::move(func));
+  map<hobject_t, read_request_t> for_read_op;
+  for_read_op.insert(
+    make_pair(
+      hoid,
+      read_request_t(
+	list<boost::tuple<uint64_t, uint64_t, uint32_t> >(1, extent),
+	set<pg_shard_t>{shard},
+	false,
+	new CallClientDirectRead(
+	  hoid,
+	  this,
+	  &(in_progress_client_reads.back()),
+	  extent))));
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    for_read_op,
+    OpRequestRef(),
+    false, false, ReadOp::DIRECT);
+}
+
 void ECBackend::objects_read_and_reconstruct(
   const map<hobject_t,
     std::list<boost::tuple<uint64_t, uint64_t, uint32_t> >
@@ -2267,7 +2597,19 @@ void ECBackend::objects_read_and_reconstruct(
     kick_reads();
     return;
   }
+  start_client_read_op(
+    reads,
+    &(in_progress_client_reads.back()),
+    fast_read);
+}
 
+void ECBackend::start_client_read_op(
+  const map<hobject_t,
+    std::list<boost::tuple<uint64_t, uint64_t, uint32_t> >
+  > &reads,
+  ClientAsyncReadStatus *status,
+  bool fast_read)
+{
   set<int> want_to_read;
   get_want_to_read_shards(&want_to_read);
     
@@ -2285,7 +2627,7 @@ void ECBackend::objects_read_and_reconstruct(
     CallClientContexts *c = new CallClientContexts(
       to_read.first,
       this,
-      &(in_progress_client_reads.back()),
+      status,
       to_read.second);
     for_read_op.insert(
       make_pair(
@@ -2297,12 +2639,105 @@ void ECBackend::objects_read_and_reconstruct(
 	  c)));
   }
 
-  start_read_op(
+  ceph_tid_t tid = start_read_op(
     CEPH_MSG_PRIO_DEFAULT,
     for_read_op,
     OpRequestRef(),
     fast_read, false);
-  return;
+  if (!fast_read && cct->_conf->get_val<bool>("osd_ec_hedged_reads")) {
+    auto rop = tid_to_read_map.find(tid);
+    if (rop != tid_to_read_map.end()) {
+      rop->second.hedge = true;
+      schedule_read_hedge(rop->second);
+    }
+  }
+}
+
+void ECBackend::schedule_read_hedge(ReadOp &rop)
+{
+  double percentile =
+    cct->_conf->get_val<double>("osd_ec_hedged_read_percentile");
+  double min_delay =
+    cct->_conf->get_val<double>("osd_ec_hedged_read_min_delay");
+  utime_t now = ceph_clock_now();
+  ceph_tid_t tid = rop.tid;
+  // each shard is timed against its own latencies, a shard which is
+  // usually slow must not get the read hedged because another is fast
+  for (auto &&i: rop.in_progress) {
+    auto lat = shard_read_latency.find(i);
+    if (lat == shard_read_latency.end() || !lat->second.ready()) {
+      dout(20) << __func__ << ": no read latencies for " << i
+	       << " yet, not hedging tid " << tid << " on it" << dendl;
+      continue;
+    }
+    double delay = std::max(min_delay, lat->second.percentile(percentile)) -
+      (double)(now - rop.sent[i]);
+    dout(20) << __func__ << ": tid " << tid << " on " << i
+	     << " in " << delay << dendl;
+    pg_shard_t shard = i;
+    rop.hedge_events[shard] = get_parent()->schedule_timer_event(
+      new FunctionContext([this, tid, shard](int r) {
+	  hedge_read_op(tid, shard);
+	}),
+      std::max(0.0, delay));
+  }
+}
+
+void ECBackend::cancel_read_hedge(ReadOp &rop)
+{
+  for (auto &&i: rop.hedge_events)
+    get_parent()->cancel_timer_event(i.second);
+  rop.hedge_events.clear();
+}
+
+void ECBackend::hedge_read_op(ceph_tid_t tid, pg_shard_t shard)
+{
+  auto iter = tid_to_read_map.find(tid);
+  if (iter == tid_to_read_map.end())
+    return;
+  ReadOp &rop = iter->second;
+  rop.hedge_events.erase(shard);
+  if (!rop.in_progress.count(shard))
+    return;
+
+  set<pg_shard_t> extra;
+  map<hobject_t, read_request_t> for_read_op;
+  for (auto &&i: rop.to_read) {
+    set<int> already_read;
+    for (auto &&j: rop.obj_to_source[i.first])
+      already_read.insert(j.shard);
+    set<pg_shard_t> shards;
+    get_remaining_shards(i.first, already_read, &shards, false);
+    // a shard gets a single sub read per read op at a time
+    for (auto j = shards.begin(); j != shards.end(); ) {
+      if (rop.in_progress.count(*j))
+	shards.erase(j++);
+      else
+	++j;
+    }
+    extra.insert(shards.begin(), shards.end());
+    for_read_op.insert(
+      make_pair(
+	i.first,
+	read_request_t(
+	  i.second.to_read,
+	  shards,
+	  false,
+	  i.second.cb)));
+  }
+  if (extra.empty()) {
+    dout(20) << __func__ << ": no other shards for " << rop << dendl;
+    return;
+  }
+
+  dout(10) << __func__ << ": " << shard << " slow, reading "
+	   << extra << " for " << rop << dendl;
+  get_parent()->get_logger()->inc(l_osd_ec_read_hedged);
+  cancel_read_hedge(rop);
+  rop.to_read.swap(for_read_op);
+  rop.do_redundant_reads = true;
+  rop.hedged.insert(extra.begin(), extra.end());
+  do_read_op(rop);
 }
 
 
@@ -152,6 +152,7 @@ public:
     GenContextURef<map<hobject_t,pair<int, extent_map> > &&> &&func);
 
   friend struct CallClientContexts;
+  friend struct CallClientDirectRead;
   struct ClientAsyncReadStatus {
     unsigned objects_to_read;
     GenContextURef<map<hobject_t,pair<int, extent_map> > &&> func;
@@ -177,6 +178,18 @@ public:
     }
   };
   list<ClientAsyncReadStatus> in_progress_client_reads;
+  void start_client_read_op(
+    const map<hobject_t, std::list<boost::tuple<uint64_t, uint64_t, uint32_t> >
+    > &reads,
+    ClientAsyncReadStatus *status,
+    bool fast_read);
+
+  /// Reads an extent within a single chunk from the shard holding it
+  void objects_read_direct(
+    const hobject_t &hoid,
+    const boost::tuple<uint64_t, uint64_t, uint32_t> &extent,
+    pg_shard_t shard,
+    GenContextURef<map<hobject_t,pair<int, extent_map> > &&> &&func);
   void objects_read_async(
     const hobject_t &hoid,
     const list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
@@ -383,6 +396,23 @@ public:
     // True if reading for recovery which could possibly reading only a subset
     // of the available shards.
     bool for_recovery;
+    // DECODE reads enough shards to decode the requested stripes,
+    // PARITY_DELTA reads the chunks needed by a parity delta write and
+    // DIRECT reads a client extent from the single shard holding it.
+    // Only DECODE results may be rebuilt from other shards.
+    enum read_mode_t {
+      DECODE,
+      PARITY_DELTA,
+      DIRECT
+    } mode = DECODE;
+
+    // True if extra shards are read once the first ones are slower
+    // than they usually are, @see schedule_read_hedge
+    bool hedge = false;
+    map<pg_shard_t, utime_t> sent;
+    set<pg_shard_t> hedged;
+    // hedges the read if the shard is still pending when it fires
+    map<pg_shard_t, Context*> hedge_events;
 
     ZTracer::Trace trace;
 
@@ -428,17 +458,59 @@ public:
   friend ostream &operator<<(ostream &lhs, const ReadOp &rhs);
   map<ceph_tid_t, ReadOp> tid_to_read_map;
   map<pg_shard_t, set<ceph_tid_t> > shard_to_read_map;
-  void start_read_op(
+  ceph_tid_t start_read_op(
     int priority,
     map<hobject_t, read_request_t> &to_read,
     OpRequestRef op,
-    bool do_redundant_reads, bool for_recovery);
+    bool do_redundant_reads, bool for_recovery,
+    ReadOp::read_mode_t mode = ReadOp::DECODE);
 
   void do_read_op(ReadOp &rop);
   int send_all_remaining_reads(
     const hobject_t &hoid,
     ReadOp &rop);
 
+  /**
+   * Hedged reads
+   *
+   * Client reads go to the minimum set of shards.  Each shard keeps a
+   * window of its recent read latencies; once a pending shard of a read
+   * is slower than osd_ec_hedged_read_percentile of its own window, the
+   * read is sent to the remaining shards as well and completes as soon
+   * as any of them suffice to decode.  Replies still outstanding at
+   * that point are dropped, but their latency is still recorded.
+   */
+  struct shard_read_latency_t {
+    static const unsigned MAX_SAMPLES = 64;
+    static const unsigned MIN_SAMPLES = 16;
+    vector<double> samples;
+    unsigned next = 0;
+    void add(double lat) {
+      if (samples.size() < MAX_SAMPLES) {
+	samples.push_back(lat);
+      } else {
+	samples[next] = lat;
+	next = (next + 1) % MAX_SAMPLES;
+      }
+    }
+    bool ready() const {
+      return samples.size() >= MIN_SAMPLES;
+    }
+    double percentile(double p) const {
+      assert(!samples.empty());
+      vector<double> sorted(samples);
+      auto nth = sorted.begin() + (unsigned)(p * (sorted.size() - 1));
+      std::nth_element(sorted.begin(), nth, sorted.end());
+      return *nth;
+    }
+  };
+  map<pg_shard_t, shard_read_latency_t> shard_read_latency;
+  /// send time of sub reads a client read op completed without
+  map<pair<ceph_tid_t, pg_shard_t>, utime_t> late_reads;
+  void schedule_read_hedge(ReadOp &rop);
+  void cancel_read_hedge(ReadOp &rop);
+  void hedge_read_op(ceph_tid_t tid, pg_shard_t shard);
+
 
   /**
    * Client writes
@@ -481,15 +553,23 @@ public:
     bool requires_rmw() const { return !plan.to_read.empty(); }
     bool invalidates_cache() const { return plan.invalidates_cache; }
 
-    // must be true if requires_rmw(), must be false if invalidates_cache()
+    // must be true if requires_rmw() (unless parity_delta), must be false
+    // if invalidates_cache()
     bool using_cache = false;
 
     /// In progress read state;
     map<hobject_t,extent_set> pending_read; // subset already being read
     map<hobject_t,extent_set> remote_read;  // subset we must read
     map<hobject_t,extent_map> remote_read_result;
+
+    /// parity delta read state, see ECTransaction::plan_parity_delta
+    bool parity_delta = false;
+    bool parity_delta_read_pending = false;
+    map<hobject_t,map<int,bufferlist>> parity_delta_read_result;
+
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return parity_delta_read_pending ||
+	(!remote_read.empty() && remote_read_result.empty());
     }
 
     /// In progress write state
@@ -574,6 +654,11 @@ public:
   bool try_finish_rmw();
   void check_ops();
 
+  bool blocked_by_parity_delta(const Op &op) const;
+  bool start_parity_delta_read(Op *op);
+  friend struct FinishParityDeltaRead;
+  void finish_parity_delta_read(ceph_tid_t tid, read_result_t &res);
+
   ErasureCodeInterfaceRef ec_impl;
 
 
@@ -95,12 +95,70 @@ bool ECTransaction::requires_overwrite(
       (op.truncate->first < prev_size)));
 }
 
+void ECTransaction::plan_parity_delta(
+  WritePlan &plan,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  DoutPrefixProvider *dpp)
+{
+  plan.parity_delta.clear();
+  if (!ecimpl->supports_parity_delta() ||
+      !ecimpl->get_chunk_mapping().empty())
+    return;
+
+  if (plan.to_read.size() != 1 || plan.will_write.size() != 1)
+    return;
+  const hobject_t &oid = plan.to_read.begin()->first;
+  const extent_set &to_read = plan.to_read.begin()->second;
+  auto wwiter = plan.will_write.find(oid);
+  if (wwiter == plan.will_write.end() ||
+      !(wwiter->second == to_read) ||
+      to_read.num_intervals() != 1 ||
+      to_read.size() != (int64_t)sinfo.get_stripe_width())
+    return;
+
+  auto opiter = plan.t->op_map.find(oid);
+  if (opiter == plan.t->op_map.end())
+    return;
+  const auto &op = opiter->second;
+  if (!op.is_none() || op.truncate || op.has_source() ||
+      op.buffer_updates.empty())
+    return;
+
+  const uint64_t stripe_off = to_read.range_start();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  set<int> data_chunks;
+  for (auto &&extent: op.buffer_updates) {
+    assert(extent.get_off() >= stripe_off);
+    assert(extent.get_off() + extent.get_len() <=
+	   stripe_off + sinfo.get_stripe_width());
+    uint64_t first = (extent.get_off() - stripe_off) / chunk_size;
+    uint64_t last =
+      (extent.get_off() + extent.get_len() - 1 - stripe_off) / chunk_size;
+    for (uint64_t i = first; i <= last; ++i) {
+      data_chunks.insert(i);
+    }
+  }
+
+  // read data_chunks and the coding chunks instead of the whole stripe
+  unsigned coding_chunks =
+    ecimpl->get_chunk_count() - ecimpl->get_data_chunk_count();
+  if (data_chunks.size() + coding_chunks >= ecimpl->get_data_chunk_count())
+    return;
+
+  ldpp_dout(dpp, 20) << __func__ << ": " << oid
+		     << " updating parity with the delta of chunks "
+		     << data_chunks << dendl;
+  plan.parity_delta[oid] = std::move(data_chunks);
+}
+
 void ECTransaction::generate_transactions(
   WritePlan &plan,
   ErasureCodeInterfaceRef &ecimpl,
   pg_t pgid,
   const ECUtil::stripe_info_t &sinfo,
   const map<hobject_t,extent_map> &partial_extents,
+  const map<hobject_t,map<int,bufferlist>> &parity_delta_reads,
   vector<pg_log_entry_t> &entries,
   map<hobject_t,extent_map> *written_map,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -536,6 +594,93 @@ void ECTransaction::generate_transactions(
 			   << dendl;
       }
 
+      auto pditer = plan.parity_delta.find(oid);
+      if (pditer != plan.parity_delta.end()) {
+	assert(!op.truncate);
+	assert(new_size == orig_size);
+	auto rditer = parity_delta_reads.find(oid);
+	assert(rditer != parity_delta_reads.end());
+	const map<int,bufferlist> &old_chunks = rditer->second;
+
+	const uint64_t stripe_off = plan.will_write[oid].range_start();
+	const uint64_t chunk_size = sinfo.get_chunk_size();
+	const uint64_t chunk_off =
+	  sinfo.aligned_logical_offset_to_chunk_offset(stripe_off);
+	auto read_chunk = [&](int i) {
+	  auto iter = old_chunks.find(i);
+	  assert(iter != old_chunks.end());
+	  assert(iter->second.length() == chunk_size);
+	  bufferptr p = buffer::create_aligned(
+	    chunk_size, ECUtil::CHUNK_ALIGNMENT);
+	  iter->second.copy(0, chunk_size, p.c_str());
+	  return p;
+	};
+
+	map<int,bufferlist> buffers;
+	map<int,bufferptr> deltas;
+	for (auto &&i: pditer->second) {
+	  bufferptr old_data = read_chunk(i);
+	  bufferptr new_data = read_chunk(i);
+	  uint64_t start = stripe_off + i * chunk_size;
+	  for (auto &&extent: to_write.intersect(start, chunk_size)) {
+	    extent.get_val().copy(
+	      0, extent.get_len(),
+	      new_data.c_str() + (extent.get_off() - start));
+	  }
+	  bufferptr delta = buffer::create_aligned(
+	    chunk_size, ECUtil::CHUNK_ALIGNMENT);
+	  ecimpl->encode_delta(old_data, new_data, &delta);
+	  deltas[i] = delta;
+	  buffers[i].append(new_data);
+	}
+	map<int,bufferptr> parity;
+	for (unsigned i = ecimpl->get_data_chunk_count();
+	     i < ecimpl->get_chunk_count();
+	     ++i) {
+	  parity[i] = read_chunk(i);
+	}
+	int r = ecimpl->apply_delta(deltas, parity);
+	assert(r == 0);
+	for (auto &&i: parity) {
+	  buffers[i.first].append(i.second);
+	}
+
+	ldpp_dout(dpp, 20) << __func__ << ": parity delta on "
+			   << oid << " chunks " << pditer->second
+			   << " at " << chunk_off << "~" << chunk_size
+			   << dendl;
+	if (entry) {
+	  // the untouched chunks are saved too, rollback is per shard
+	  assert(rollback_extents.empty());
+	  rollback_extents.emplace_back(make_pair(chunk_off, chunk_size));
+	  for (auto &&st : *transactions) {
+	    st.second.touch(
+	      coll_t(spg_t(pgid, st.first)),
+	      ghobject_t(oid, entry->version.version, st.first));
+	    st.second.clone_range(
+	      coll_t(spg_t(pgid, st.first)),
+	      ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	      ghobject_t(oid, entry->version.version, st.first),
+	      chunk_off,
+	      chunk_size,
+	      chunk_off);
+	  }
+	}
+	for (auto &&i : buffers) {
+	  auto titer = transactions->find(shard_id_t(i.first));
+	  if (titer == transactions->end())
+	    continue;
+	  titer->second.write(
+	    coll_t(spg_t(pgid, titer->first)),
+	    ghobject_t(oid, ghobject_t::NO_GEN, titer->first),
+	    chunk_off,
+	    chunk_size,
+	    i.second,
+	    fadvise_flags);
+	}
+	to_write.clear();
+      }
+
       set<int> want;
       for (unsigned i = 0; i < ecimpl->get_chunk_count(); ++i) {
 	want.insert(i);
@@ -29,6 +29,11 @@ namespace ECTransaction {
     map<hobject_t,extent_set> to_read;
     map<hobject_t,extent_set> will_write; // superset of to_read
 
+    // objects whose coding chunks are updated with
+    // ErasureCodeInterface::apply_delta, mapped to the data chunks
+    // modified, see plan_parity_delta
+    map<hobject_t,set<int>> parity_delta;
+
     map<hobject_t,ECUtil::HashInfoRef> hash_infos;
   };
 
@@ -182,12 +187,28 @@ namespace ECTransaction {
     return plan;
   }
 
+  /**
+   * Fill plan.parity_delta if the plan overwrites part of a single
+   * stripe of a single object and reading only the data chunks it
+   * modifies plus the coding chunks is cheaper than reading the whole
+   * stripe.  The caller is free to clear plan.parity_delta and read
+   * plan.to_read instead.
+   */
+  void plan_parity_delta(
+    WritePlan &plan,
+    const ECUtil::stripe_info_t &sinfo,
+    ErasureCodeInterfaceRef &ecimpl,
+    DoutPrefixProvider *dpp);
+
+  /// parity_delta_reads maps the objects in plan.parity_delta to
+  /// the current content of the chunks read, indexed by chunk
   void generate_transactions(
     WritePlan &plan,
     ErasureCodeInterfaceRef &ecimpl,
     pg_t pgid,
     const ECUtil::stripe_info_t &sinfo,
     const map<hobject_t,extent_map> &partial_extents,
+    const map<hobject_t,map<int,bufferlist>> &parity_delta_reads,
     vector<pg_log_entry_t> &entries,
     map<hobject_t,extent_map> *written,
     map<shard_id_t, ObjectStore::Transaction> *transactions,
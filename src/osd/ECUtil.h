@@ -81,6 +81,23 @@ public:
       (in.first - off) + in.second);
     return std::make_pair(off, len);
   }
+  /// index of the data chunk holding logical offset
+  unsigned logical_offset_to_chunk_index(uint64_t offset) const {
+    return (offset % stripe_width) / chunk_size;
+  }
+  bool offset_len_within_chunk(std::pair<uint64_t, uint64_t> in) const {
+    return in.second > 0 &&
+      ((in.first % stripe_width) % chunk_size) + in.second <= chunk_size;
+  }
+  /// extent of the shard holding a logical extent within one chunk
+  std::pair<uint64_t, uint64_t> offset_len_to_chunk_extent(
+    std::pair<uint64_t, uint64_t> in) const {
+    assert(offset_len_within_chunk(in));
+    return std::make_pair(
+      logical_to_prev_chunk_offset(in.first) +
+      (in.first % stripe_width) % chunk_size,
+      in.second);
+  }
 };
 
 int decode(
@@ -407,6 +407,11 @@ public:
     pin.open(next_write_tid++);
   }
 
+  /// true if a write in progress holds extents of oid
+  bool has_extents(const hobject_t &oid) {
+    return get_if_exists(oid) != nullptr;
+  }
+
   /**
    * Reserves extents required for rmw, and learn
    * which need to be read
@@ -257,6 +257,9 @@ OSDService::OSDService(OSD *osd) :
   scrub_sleep_lock("OSDService::scrub_sleep_lock"),
   scrub_sleep_timer(
     osd->client_messenger->cct, scrub_sleep_lock, false /* relax locking */),
+  backend_timer_lock("OSDService::backend_timer_lock"),
+  backend_timer(
+    osd->client_messenger->cct, backend_timer_lock, false /* relax locking */),
   snap_reserver(cct, &reserver_finisher,
 		cct->_conf->osd_max_trimming_pgs),
   recovery_lock("OSDService::recovery_lock"),
@@ -548,8 +551,15 @@ void OSDService::shutdown()
     scrub_sleep_timer.shutdown();
   }
 
-  osdmap = OSDMapRef();
+  {
+    Mutex::Locker l(backend_timer_lock);
+    backend_timer.shutdown();
+  }
+
+  osdmap.reset();
   next_osdmap = OSDMapRef();
+  for (auto &map : recent_maps)
+    map.reset();
 }
 
 void OSDService::init()
@@ -567,6 +577,7 @@ void OSDService::init()
   agent_timer.init();
   snap_sleep_timer.init();
   scrub_sleep_timer.init();
+  backend_timer.init();
 
   agent_thread.create("osd_srv_agent");
 
@@ -576,7 +587,7 @@ void OSDService::init()
 
 void OSDService::final_init()
 {
-  objecter->start(osdmap.get());
+  objecter->start(get_osdmap().get());
 }
 
 void OSDService::activate_map()
@@ -584,7 +595,7 @@ void OSDService::activate_map()
   // wake/unwake the tiering agent
   agent_lock.Lock();
   agent_active =
-    !osdmap->test_flag(CEPH_OSDMAP_NOTIERAGENT) &&
+    !get_osdmap()->test_flag(CEPH_OSDMAP_NOTIERAGENT) &&
     osd->is_active();
   agent_cond.Signal();
   agent_lock.Unlock();
@@ -1082,7 +1093,7 @@ void OSDService::send_pg_temp()
   if (pg_temp_wanted.empty())
     return;
   dout(10) << "send_pg_temp " << pg_temp_wanted << dendl;
-  MOSDPGTemp *m = new MOSDPGTemp(osdmap->get_epoch());
+  MOSDPGTemp *m = new MOSDPGTemp(get_osdmap_epoch());
   m->pg_temp = pg_temp_wanted;
   monc->send_mon_message(m);
   _sent_pg_temp();
@@ -1091,7 +1102,7 @@ void OSDService::send_pg_temp()
 void OSDService::send_pg_created(pg_t pgid)
 {
   dout(20) << __func__ << dendl;
-  if (osdmap->require_osd_release >= CEPH_RELEASE_LUMINOUS) {
+  if (get_osdmap()->require_osd_release >= CEPH_RELEASE_LUMINOUS) {
     monc->send_mon_message(new MOSDPGCreated(pgid));
   }
 }
@@ -1556,13 +1567,28 @@ OSDMapRef OSDService::_add_map(OSDMap *o)
   if (existed) {
     delete o;
   }
+  // maps loaded for old epochs don't replace newer recent ones
+  rcu_ptr<const OSDMap> &recent = recent_maps[e % RECENT_MAPS];
+  OSDMapRef prev = recent.get();
+  if (!prev || prev->get_epoch() < e) {
+    recent.set(l);
+  }
   return l;
 }
 
 OSDMapRef OSDService::try_get_map(epoch_t epoch)
 {
+  OSDMapRef retval = recent_maps[epoch % RECENT_MAPS].get();
+  if (retval && retval->get_epoch() == epoch) {
+    dout(30) << "get_map " << epoch << " -recent" << dendl;
+    if (logger) {
+      logger->inc(l_osd_map_cache_hit);
+    }
+    return retval;
+  }
+
   Mutex::Locker l(map_cache_lock);
-  OSDMapRef retval = map_cache.lookup(epoch);
+  retval = map_cache.lookup(epoch);
   if (retval) {
     dout(30) << "get_map " << epoch << " -cached" << dendl;
     if (logger) {
@@ -1612,7 +1638,7 @@ void OSDService::reply_op_error(OpRequestRef op, int err, eversion_t v,
   int flags;
   flags = m->get_flags() & (CEPH_OSD_FLAG_ACK|CEPH_OSD_FLAG_ONDISK);
 
-  MOSDOpReply *reply = new MOSDOpReply(m, err, osdmap->get_epoch(), flags,
+  MOSDOpReply *reply = new MOSDOpReply(m, err, get_osdmap_epoch(), flags,
 				       true);
   reply->set_reply_versions(v, uv);
   m->get_connection()->send_message(reply);
@@ -1670,7 +1696,7 @@ void OSDService::handle_misdirected_op(PG *pg, OpRequestRef op)
 	       << " pg " << m->get_raw_pg()
 	       << " to osd." << whoami
 	       << " not " << pg->get_acting()
-	       << " in e" << m->get_map_epoch() << "/" << osdmap->get_epoch();
+	       << " in e" << m->get_map_epoch() << "/" << get_osdmap_epoch();
 }
 
 void OSDService::enqueue_back(OpQueueItem&& qi)
@@ -1977,6 +2003,7 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
   test_ops_hook(NULL),
   op_queue(get_io_queue()),
   op_prio_cutoff(get_io_prio_cut()),
+  op_run_to_completion(cct->_conf->get_val<bool>("osd_op_run_to_completion")),
   op_shardedwq(
     get_num_op_shards(),
     this,
@@ -2262,6 +2289,8 @@ will start to track new ops received afterwards.";
     f->close_section();
   } else if (admin_command == "dump_objectstore_kv_stats") {
     store->get_db_statistics(f);
+  } else if (admin_command == "dump_objectstore_slow_transactions") {
+    store->dump_slow_transactions(f);
   } else if (admin_command == "dump_scrubs") {
     service.dumps_scrub(f);
   } else if (admin_command == "calc_objectstore_db_histogram") {
@@ -2389,6 +2418,8 @@ int OSD::get_num_op_shards()
 
 int OSD::get_num_op_threads()
 {
+  if (cct->_conf->get_val<bool>("osd_op_run_to_completion"))
+    return get_num_op_shards();
   if (cct->_conf->osd_op_num_threads_per_shard)
     return get_num_op_shards() * cct->_conf->osd_op_num_threads_per_shard;
   if (store_is_rotational)
@@ -2636,6 +2667,13 @@ int OSD::init()
   update_log_config();
 
   peering_tp.start();
+  {
+    int64_t cpu = cct->_conf->get_val<int64_t>("osd_op_thread_first_cpu");
+    if (cpu >= 0) {
+      dout(10) << "pinning op threads to cpus starting at " << cpu << dendl;
+      osd_op_tp.set_cpu_affinity(cpu);
+    }
+  }
   osd_op_tp.start();
   disk_tp.start();
   command_tp.start();
@@ -2827,6 +2865,12 @@ void OSD::final_init()
 				     "print statistics of kvdb which used by bluestore");
   assert(r == 0);
 
+  r = admin_socket->register_command("dump_objectstore_slow_transactions",
+				     "dump_objectstore_slow_transactions",
+				     asok_hook,
+				     "show where recent slow objectstore transactions spent their time (bluestore_txc_trace)");
+  assert(r == 0);
+
   r = admin_socket->register_command("dump_scrubs",
 				     "dump_scrubs",
 				     asok_hook,
@@ -3219,6 +3263,19 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_hedged, "ec_read_hedged",
+    "EC reads which read the remaining shards because of a slow shard");
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_hedge_win, "ec_read_hedge_win",
+    "Hedged EC reads completed before the slow shard replied");
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_direct, "ec_read_direct",
+    "EC reads served by a single data shard without decoding");
+  osd_plb.add_u64_counter(
+    l_osd_ec_read_bytes_saved, "ec_read_bytes_saved",
+    "Shard bytes EC reads did not read compared to reading all shards");
+
   logger = osd_plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -3305,6 +3362,18 @@ int OSD::shutdown()
     }
   }
 
+  if (op_run_to_completion) {
+    // pg store completions are run by the op shards; wait for any in
+    // flight to be queued there before the final drain
+    RWLock::RLocker l(pg_map_lock);
+    for (auto& p : pg_map) {
+      C_SaferCond waiter;
+      if (!p.second->osr->flush_commit(&waiter)) {
+	waiter.wait();
+      }
+    }
+  }
+
   // drain op queue again (in case PGs requeued something)
   op_shardedwq.drain();
   {
@@ -3331,6 +3400,7 @@ int OSD::shutdown()
   cct->get_admin_socket()->unregister_command("set_heap_property");
   cct->get_admin_socket()->unregister_command("get_heap_property");
   cct->get_admin_socket()->unregister_command("dump_objectstore_kv_stats");
+  cct->get_admin_socket()->unregister_command("dump_objectstore_slow_transactions");
   cct->get_admin_socket()->unregister_command("dump_scrubs");
   cct->get_admin_socket()->unregister_command("calc_objectstore_db_histogram");
   cct->get_admin_socket()->unregister_command("flush_store_cache");
@@ -3760,6 +3830,11 @@ PG* OSD::_make_pg(
   else
     ceph_abort();
 
+  if (op_run_to_completion) {
+    // run the pg's store completions on the shard thread that runs its ops
+    pg->osr->commit_queue = op_shardedwq.get_commit_queue(pgid);
+  }
+
   return pg;
 }
 
@@ -9741,7 +9816,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   assert(sdata);
   // peek at spg_t
   sdata->sdata_op_ordering_lock.Lock();
-  if (sdata->pqueue->empty()) {
+  if (sdata->pqueue->empty() && sdata->context_queue.empty()) {
     dout(20) << __func__ << " empty q, waiting" << dendl;
     // optimistically sleep a moment; maybe another work item will come along.
     osd->cct->get_heartbeat_map()->reset_timeout(hb,
@@ -9752,11 +9827,22 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       utime_t(osd->cct->_conf->threadpool_empty_queue_max_wait, 0));
     sdata->sdata_lock.Unlock();
     sdata->sdata_op_ordering_lock.Lock();
-    if (sdata->pqueue->empty()) {
+    if (sdata->pqueue->empty() && sdata->context_queue.empty()) {
       sdata->sdata_op_ordering_lock.Unlock();
       return;
     }
   }
+  if (!sdata->context_queue.empty()) {
+    // store completions for our pgs (osd_op_run_to_completion); finish
+    // them before starting new work, with no locks held
+    list<Context*> oncommits;
+    oncommits.swap(sdata->context_queue);
+    sdata->sdata_op_ordering_lock.Unlock();
+    dout(20) << __func__ << " finishing " << oncommits.size()
+	     << " store completions" << dendl;
+    finish_contexts(osd->cct, oncommits, 0);
+    return;
+  }
   OpQueueItem item = sdata->pqueue->dequeue();
   if (osd->is_stopping()) {
     sdata->sdata_op_ordering_lock.Unlock();
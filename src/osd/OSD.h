@@ -53,6 +53,7 @@ using namespace std;
 
 #include "common/shared_cache.hpp"
 #include "common/simple_cache.hpp"
+#include "common/rcu_ptr.h"
 #include "common/sharedptr_registry.hpp"
 #include "common/WeightedPriorityQueue.h"
 #include "common/PrioritizedQueue.h"
@@ -178,6 +179,11 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_ec_read_hedged,
+  l_osd_ec_read_hedge_win,
+  l_osd_ec_read_direct,
+  l_osd_ec_read_bytes_saved,
+
   l_osd_last,
 };
 
@@ -439,20 +445,19 @@ public:
 
   std::atomic<epoch_t> max_oldest_map;
 private:
-  OSDMapRef osdmap;
+  // read by every op and dispatch, so published without publish_lock
+  rcu_ptr<const OSDMap> osdmap;
 
 public:
   OSDMapRef get_osdmap() {
-    Mutex::Locker l(publish_lock);
-    return osdmap;
+    return osdmap.get();
   }
   epoch_t get_osdmap_epoch() {
-    Mutex::Locker l(publish_lock);
-    return osdmap ? osdmap->get_epoch() : 0;
+    OSDMapRef map = osdmap.get();
+    return map ? map->get_epoch() : 0;
   }
   void publish_map(OSDMapRef map) {
-    Mutex::Locker l(publish_lock);
-    osdmap = map;
+    osdmap.set(std::move(map));
   }
 
   /*
@@ -858,6 +863,10 @@ public:
   Mutex scrub_sleep_lock;
   SafeTimer scrub_sleep_timer;
 
+  // -- PGBackend delayed work, e.g. EC read hedging --
+  Mutex backend_timer_lock;
+  SafeTimer backend_timer;
+
   AsyncReserver<spg_t> snap_reserver;
   void queue_for_snap_trim(PG *pg);
   void queue_for_scrub(PG *pg, bool with_high_priority);
@@ -937,6 +946,9 @@ public:
   // osd map cache (past osd maps)
   Mutex map_cache_lock;
   SharedLRU<epoch_t, const OSDMap> map_cache;
+  /// most recently added maps by epoch, looked up without map_cache_lock
+  static const unsigned RECENT_MAPS = 16;
+  rcu_ptr<const OSDMap> recent_maps[RECENT_MAPS];
   SimpleLRU<epoch_t, bufferlist> map_bl_cache;
   SimpleLRU<epoch_t, bufferlist> map_bl_inc_cache;
 
@@ -1572,6 +1584,8 @@ private:
 
   const io_queue op_queue;
   const unsigned int op_prio_cutoff;
+  /// one pinned thread per op shard, which also runs its pgs' commits
+  const bool op_run_to_completion;
 
   /*
    * The ordered op delivery chain is:
@@ -1599,12 +1613,15 @@ private:
   class ShardedOpWQ
     : public ShardedThreadPool::ShardedWQ<OpQueueItem>
   {
-    struct ShardData {
+    struct ShardData : public ObjectStore::CommitQueue {
       Mutex sdata_lock;
       Cond sdata_cond;
 
       Mutex sdata_op_ordering_lock;   ///< protects all members below
 
+      /// store completions for this shard's pgs (osd_op_run_to_completion)
+      list<Context*> context_queue;
+
       OSDMapRef waiting_for_pg_osdmap;
       struct pg_slot {
 	PGRef pg;                     ///< cached pg reference [optional]
@@ -1662,6 +1679,15 @@ private:
 	  pqueue = ceph::make_unique<ceph::mClockClientQueue>(cct);
 	}
       }
+
+      void queue(Context *c) override {
+	sdata_op_ordering_lock.Lock();
+	context_queue.push_back(c);
+	sdata_op_ordering_lock.Unlock();
+	sdata_lock.Lock();
+	sdata_cond.SignalOne();
+	sdata_lock.Unlock();
+      }
     }; // struct ShardData
 
     vector<ShardData*> shard_list;
@@ -1709,6 +1735,11 @@ private:
     /// clear pg_slots on shutdown
     void clear_pg_slots();
 
+    /// queue that runs store completions for pgid on its shard's thread
+    ObjectStore::CommitQueue *get_commit_queue(spg_t pgid) {
+      return shard_list[pgid.hash_to_shard(shard_list.size())];
+    }
+
     /// try to do some work
     void _process(uint32_t thread_index, heartbeat_handle_d *hb) override;
 
@@ -1777,7 +1808,7 @@ private:
       auto &&sdata = shard_list[shard_index];
       assert(sdata);
       Mutex::Locker l(sdata->sdata_op_ordering_lock);
-      return sdata->pqueue->empty();
+      return sdata->pqueue->empty() && sdata->context_queue.empty();
     }
   } op_shardedwq;
 
@@ -254,6 +254,14 @@ typedef ceph::shared_ptr<const OSDMap> OSDMapRef;
      virtual void schedule_recovery_work(
        GenContext<ThreadPool::TPHandle&> *c) = 0;
 
+     /**
+      * Call c with the pg locked after delay seconds, unless the pg
+      * resets first.  Returns a handle for cancel_timer_event, which
+      * must not be used once c was called.
+      */
+     virtual Context *schedule_timer_event(Context *c, double delay) = 0;
+     virtual void cancel_timer_event(Context *handle) = 0;
+
      virtual pg_shard_t whoami_shard() const = 0;
      int whoami() const {
        return whoami_shard().osd;
@@ -82,10 +82,66 @@ public:
    * plus some methods to manipulate it all.
    */
   struct IndexedLog : public pg_log_t {
-    mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
-    mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
+    /**
+     * Key of the objects index.  It points at the soid of the entry it
+     * maps to instead of holding another copy of the object name, so
+     * it must be repointed whenever the entry changes, @see index_object
+     */
+    struct object_key_t {
+      mutable const hobject_t *soid;
+      explicit object_key_t(const hobject_t &soid) : soid(&soid) {}
+    };
+    struct object_key_hash_t {
+      size_t operator()(const object_key_t &k) const {
+	return std::hash<hobject_t>()(*k.soid);
+      }
+    };
+    struct object_key_equal_t {
+      bool operator()(const object_key_t &l, const object_key_t &r) const {
+	return *l.soid == *r.soid;
+      }
+    };
+    /**
+     * The objects index, looked up by hobject_t.  Only index_object()
+     * adds to it, so a key never points at anything but its entry.
+     */
+    class object_index_t {
+      typedef mempool::osd_pglog::unordered_map<
+	object_key_t, pg_log_entry_t*,
+	object_key_hash_t, object_key_equal_t> map_t;
+      map_t m;
+      friend struct IndexedLog;
+    public:
+      typedef map_t::iterator iterator;
+      typedef map_t::const_iterator const_iterator;
+      iterator find(const hobject_t &oid) {
+	return m.find(object_key_t(oid));
+      }
+      const_iterator find(const hobject_t &oid) const {
+	return m.find(object_key_t(oid));
+      }
+      size_t count(const hobject_t &oid) const {
+	return m.count(object_key_t(oid));
+      }
+      iterator begin() { return m.begin(); }
+      iterator end() { return m.end(); }
+      const_iterator begin() const { return m.begin(); }
+      const_iterator end() const { return m.end(); }
+      size_t size() const { return m.size(); }
+      bool empty() const { return m.empty(); }
+      void erase(iterator p) { m.erase(p); }
+      void clear() { m.clear(); }
+    };
+    typedef std::unordered_multimap<
+      osd_reqid_t, pg_log_entry_t*,
+      std::hash<osd_reqid_t>, std::equal_to<osd_reqid_t>,
+      mempool::osd_pglog::pool_allocator<
+	pair<const osd_reqid_t, pg_log_entry_t*>>> extra_caller_index_t;
+
+    mutable object_index_t objects;  // ptrs into log.  be careful!
+    mutable mempool::osd_pglog::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
+    mutable extra_caller_index_t extra_caller_ops;
+    mutable mempool::osd_pglog::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
 
     // recovery pointers
     list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -273,11 +329,10 @@ public:
       assert(version);
       assert(user_version);
       assert(return_code);
-      ceph::unordered_map<osd_reqid_t,pg_log_entry_t*>::const_iterator p;
       if (!(indexed_data & PGLOG_INDEXED_CALLER_OPS)) {
         index_caller_ops();
       }
-      p = caller_ops.find(r);
+      auto p = caller_ops.find(r);
       if (p != caller_ops.end()) {
 	*version = p->second->version;
 	*user_version = p->second->user_version;
@@ -290,15 +345,15 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_EXTRA_CALLER_OPS)) {
         index_extra_caller_ops();
       }
-      p = extra_caller_ops.find(r);
-      if (p != extra_caller_ops.end()) {
-	for (auto i = p->second->extra_reqids.begin();
-	     i != p->second->extra_reqids.end();
+      auto e = extra_caller_ops.find(r);
+      if (e != extra_caller_ops.end()) {
+	for (auto i = e->second->extra_reqids.begin();
+	     i != e->second->extra_reqids.end();
 	     ++i) {
 	  if (i->first == r) {
-	    *version = p->second->version;
+	    *version = e->second->version;
 	    *user_version = i->second;
-	    *return_code = p->second->return_code;
+	    *return_code = e->second->return_code;
 	    return true;
 	  }
 	}
@@ -376,7 +431,7 @@ public:
 	     ++i) {
 	  if (to_index & PGLOG_INDEXED_OBJECTS) {
 	    if (i->object_is_indexed()) {
-	      objects[i->soid] = const_cast<pg_log_entry_t*>(&(*i));
+	      index_object(const_cast<pg_log_entry_t*>(&(*i)));
 	    }
 	  }
 
@@ -416,11 +471,22 @@ public:
       index(PGLOG_INDEXED_DUPS);
     }
 
+    /// point the objects index entry for e->soid at e
+    void index_object(pg_log_entry_t *e) const {
+      auto p = objects.find(e->soid);
+      if (p == objects.end()) {
+	objects.m.emplace(object_key_t(e->soid), e);
+      } else {
+	p->first.soid = &e->soid;
+	p->second = e;
+      }
+    }
+
     void index(pg_log_entry_t& e) {
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        if (objects.count(e.soid) == 0 ||
-            objects[e.soid]->version < e.version)
-          objects[e.soid] = &e;
+	auto p = objects.find(e.soid);
+	if (p == objects.end() || p->second->version < e.version)
+	  index_object(&e);
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
 	// divergent merge_log indexes new before unindexing old
@@ -448,8 +514,9 @@ public:
     void unindex(const pg_log_entry_t& e) {
       // NOTE: this only works if we remove from the _tail_ of the log!
       if (indexed_data & PGLOG_INDEXED_OBJECTS) {
-        if (objects.count(e.soid) && objects[e.soid]->version == e.version)
-          objects.erase(e.soid);
+	auto p = objects.find(e.soid);
+	if (p != objects.end() && p->second->version == e.version)
+	  objects.erase(p);
       }
       if (e.reqid_is_indexed()) {
         if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
@@ -462,7 +529,7 @@ public:
         for (auto j = e.extra_reqids.begin();
              j != e.extra_reqids.end();
              ++j) {
-          for (ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*>::iterator k =
+          for (extra_caller_index_t::iterator k =
 		 extra_caller_ops.find(j->first);
                k != extra_caller_ops.end() && k->first == j->first;
                ++k) {
@@ -501,6 +568,11 @@ public:
 
       // add to log
       log.push_back(e);
+      if (log.back().snaps.length()) {
+	// likewise for clone entries decoded from a message
+	log.back().snaps.rebuild();
+	log.back().snaps.reassign_to_mempool(mempool::mempool_osd_pglog);
+      }
 
       // riter previously pointed to the previous entry
       if (rollback_info_trimmed_to_riter == log.rbegin())
@@ -512,7 +584,7 @@ public:
 
       // to our index
       if ((indexed_data & PGLOG_INDEXED_OBJECTS) && e.object_is_indexed()) {
-        objects[e.soid] = &(log.back());
+        index_object(&(log.back()));
       }
       if (indexed_data & PGLOG_INDEXED_CALLER_OPS) {
         if (e.reqid_is_indexed()) {
@@ -912,8 +984,7 @@ protected:
 		       << " last_divergent_update: " << last_divergent_update
 		       << dendl;
 
-    ceph::unordered_map<hobject_t, pg_log_entry_t*>::const_iterator objiter =
-      log.objects.find(hoid);
+    auto objiter = log.objects.find(hoid);
     if (objiter != log.objects.end() &&
 	objiter->second->version >= first_divergent_update) {
       /// Case 1)
@@ -500,6 +500,18 @@ void PrimaryLogPG::schedule_recovery_work(
   osd->recovery_gen_wq.queue(c);
 }
 
+Context *PrimaryLogPG::schedule_timer_event(Context *c, double delay)
+{
+  Mutex::Locker l(osd->backend_timer_lock);
+  return osd->backend_timer.add_event_after(delay, bless_context(c));
+}
+
+void PrimaryLogPG::cancel_timer_event(Context *handle)
+{
+  Mutex::Locker l(osd->backend_timer_lock);
+  osd->backend_timer.cancel_event(handle);
+}
+
 void PrimaryLogPG::send_message_osd_cluster(
   int peer, Message *m, epoch_t from_epoch)
 {
@@ -439,6 +439,8 @@ public:
 
   void schedule_recovery_work(
     GenContext<ThreadPool::TPHandle&> *c) override;
+  Context *schedule_timer_event(Context *c, double delay) override;
+  void cancel_timer_event(Context *handle) override;
 
   pg_shard_t whoami_shard() const override {
     return pg_whoami;
@@ -359,3 +359,65 @@ TEST(Crc32c, zeros_performance) {
 
 }
 
+
+TEST(Crc32c, Multi) {
+  const unsigned max_blocks = 13;
+  const unsigned max_len = 4099;
+  unsigned char *a = (unsigned char *)malloc(max_blocks * max_len);
+  for (unsigned i = 0; i < max_blocks * max_len; i++)
+    a[i] = rand();
+  uint32_t out[max_blocks];
+  for (unsigned len : {1u, 7u, 8u, 15u, 64u, 512u, 4096u, 4099u}) {
+    for (unsigned n = 0; n <= max_blocks; n++) {
+      for (uint32_t crc : {0u, 0xffffffffu}) {
+	ceph_crc32c_multi(crc, a, len, n, out);
+	for (unsigned i = 0; i < n; i++) {
+	  ASSERT_EQ(ceph_crc32c(crc, a + i * len, len), out[i])
+	    << "len " << len << " nblocks " << n << " block " << i;
+	}
+	ceph_crc32c_multi_generic(crc, a, len, n, out);
+	for (unsigned i = 0; i < n; i++) {
+	  ASSERT_EQ(ceph_crc32c(crc, a + i * len, len), out[i]);
+	}
+	ceph_crc32c_multi(crc, nullptr, len, n, out);
+	for (unsigned i = 0; i < n; i++) {
+	  ASSERT_EQ(ceph_crc32c(crc, nullptr, len), out[i]);
+	}
+      }
+    }
+  }
+  free(a);
+}
+
+TEST(Crc32c, MultiPerformance) {
+  int len = 256 * 1024 * 1024;
+  char *a = (char *)malloc(len);
+  for (int i=0; i<len; i++)
+    a[i] = i & 0xff;
+  for (unsigned block_len : {512u, 4096u, 65536u}) {
+    unsigned nblocks = len / block_len;
+    uint32_t *out = (uint32_t *)malloc(nblocks * sizeof(uint32_t));
+    uint32_t *ref = (uint32_t *)malloc(nblocks * sizeof(uint32_t));
+    {
+      utime_t start = ceph_clock_now();
+      for (unsigned i = 0; i < nblocks; i++)
+	ref[i] = ceph_crc32c(-1, (unsigned char *)a + i * block_len, block_len);
+      utime_t end = ceph_clock_now();
+      float rate = (float)len / (float)(1024*1024) / (float)(end - start);
+      std::cout << "block_len " << block_len << " per block = " << rate
+		<< " MB/sec" << std::endl;
+    }
+    {
+      utime_t start = ceph_clock_now();
+      ceph_crc32c_multi(-1, (unsigned char *)a, block_len, nblocks, out);
+      utime_t end = ceph_clock_now();
+      float rate = (float)len / (float)(1024*1024) / (float)(end - start);
+      std::cout << "block_len " << block_len << " multi = " << rate
+		<< " MB/sec" << std::endl;
+    }
+    ASSERT_EQ(0, memcmp(ref, out, nblocks * sizeof(uint32_t)));
+    free(out);
+    free(ref);
+  }
+  free(a);
+}
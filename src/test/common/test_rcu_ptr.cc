@@ -0,0 +1,65 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "common/rcu_ptr.h"
+
+TEST(RcuPtr, get_set)
+{
+  rcu_ptr<int> p;
+  ASSERT_FALSE(p.get());
+
+  std::shared_ptr<int> one = std::make_shared<int>(1);
+  p.set(one);
+  ASSERT_EQ(1, *p.get());
+  ASSERT_EQ(2, one.use_count());
+
+  p.set(std::make_shared<int>(2));
+  ASSERT_EQ(2, *p.get());
+  // the old value is dropped once replaced
+  ASSERT_EQ(1, one.use_count());
+
+  p.reset();
+  ASSERT_FALSE(p.get());
+}
+
+TEST(RcuPtr, concurrent)
+{
+  rcu_ptr<const int> p(std::make_shared<const int>(0));
+  const int last = 10000;
+  std::atomic<bool> failed = {false};
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+	int prev = 0;
+	while (prev < last) {
+	  std::shared_ptr<const int> v = p.get();
+	  if (!v || *v < prev) {
+	    failed = true;
+	    return;
+	  }
+	  prev = *v;
+	}
+      });
+  }
+  for (int i = 1; i <= last; ++i) {
+    p.set(std::make_shared<const int>(i));
+  }
+  for (auto &t : readers) {
+    t.join();
+  }
+  ASSERT_FALSE(failed);
+  ASSERT_EQ(2, p.get().use_count()); // the slot and the copy
+}
@@ -376,6 +376,36 @@ TEST(ZlibCompressor, zlib_isal_compatibility)
 }
 #endif
 
+TEST(Compressor, estimate_entropy)
+{
+  bufferlist empty;
+  EXPECT_EQ(0, Compressor::estimate_entropy(empty, 4096));
+
+  bufferlist same;
+  same.append(string(1 << 20, 'a'));
+  EXPECT_EQ(0, Compressor::estimate_entropy(same, 4096));
+
+  // ten letters: log2(10) bits
+  bufferlist letters;
+  for (unsigned i = 0; i < 1 << 20; ++i) {
+    letters.append((char)('a' + rand() % 10));
+  }
+  EXPECT_NEAR(3.32, Compressor::estimate_entropy(letters, 0), .05);
+  EXPECT_NEAR(3.32, Compressor::estimate_entropy(letters, 4096), .2);
+
+  // random, and spread over many small buffers
+  bufferlist random;
+  for (unsigned i = 0; i < 1024; ++i) {
+    bufferptr bp(1000);
+    for (unsigned j = 0; j < bp.length(); ++j) {
+      bp.c_str()[j] = rand();
+    }
+    random.append(bp);
+  }
+  EXPECT_GT(Compressor::estimate_entropy(random, 4096), 7.9);
+  EXPECT_GT(Compressor::estimate_entropy(random, 0), 7.99);
+}
+
 TEST(CompressionPlugin, all)
 {
   const char* env = getenv("CEPH_LIB");
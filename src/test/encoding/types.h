@@ -132,6 +132,7 @@ TYPE(bluestore_pextent_t)
 TYPE(bluestore_onode_t)
 TYPE(bluestore_deferred_op_t)
 TYPE(bluestore_deferred_transaction_t)
+TYPE(bluestore_alloc_checkpoint_t)
 #endif
 
 #include "common/hobject.h"
@@ -874,6 +874,64 @@ TEST_F(IsaErasureCodeTest, isa_xor_codec)
   EXPECT_EQ(5, cnt_cf);
 }
 
+TEST_F(IsaErasureCodeTest, apply_delta)
+{
+  // xor (m=1) and vandermonde/cauchy (m>1) coding chunks updated with
+  // the delta of two data chunks must match a full encode
+  const char *ms[] = { "1", "3" };
+  int matrices[] = { ErasureCodeIsaDefault::kVandermonde,
+                     ErasureCodeIsaDefault::kCauchy };
+  for (auto m : ms) {
+    for (auto matrix : matrices) {
+      ErasureCodeIsaDefault Isa(tcache, matrix);
+      ErasureCodeProfile profile;
+      profile["k"] = "5";
+      profile["m"] = m;
+      Isa.init(profile, &cerr);
+      EXPECT_TRUE(Isa.supports_parity_delta());
+
+      const unsigned k = Isa.get_data_chunk_count();
+      const unsigned n = Isa.get_chunk_count();
+      set<int> want_to_encode;
+      for (unsigned i = 0; i < n; ++i)
+        want_to_encode.insert(i);
+
+      bufferlist in;
+      for (unsigned i = 0; i < 5 * 4096; ++i)
+        in.append((char) (i * 13 + 1));
+      map<int, bufferlist> encoded;
+      EXPECT_EQ(0, Isa.encode(want_to_encode, in, &encoded));
+      unsigned length = encoded[0].length();
+
+      bufferlist out;
+      out.append(string(length, 'A'));
+      out.append(in.c_str() + length, 2 * length);
+      out.append(string(length, 'B'));
+      out.append(in.c_str() + 4 * length, in.length() - 4 * length);
+      map<int, bufferlist> reencoded;
+      EXPECT_EQ(0, Isa.encode(want_to_encode, out, &reencoded));
+
+      map<int, bufferptr> deltas;
+      int modified[] = { 0, 3 };
+      for (auto i : modified) {
+        bufferptr old_data(encoded[i].c_str(), length);
+        bufferptr new_data(reencoded[i].c_str(), length);
+        deltas[i] = buffer::create_aligned(length, EC_ISA_ADDRESS_ALIGNMENT);
+        Isa.encode_delta(old_data, new_data, &deltas[i]);
+      }
+      map<int, bufferptr> parity;
+      for (unsigned i = k; i < n; ++i) {
+        parity[i] = buffer::create_aligned(length, EC_ISA_ADDRESS_ALIGNMENT);
+        memcpy(parity[i].c_str(), encoded[i].c_str(), length);
+      }
+      EXPECT_EQ(0, Isa.apply_delta(deltas, parity));
+      for (unsigned i = k; i < n; ++i) {
+        EXPECT_EQ(0, memcmp(parity[i].c_str(), reencoded[i].c_str(), length));
+      }
+    }
+  }
+}
+
 TEST_F(IsaErasureCodeTest, create_rule)
 {
   CrushWrapper *c = new CrushWrapper;
@@ -277,6 +277,76 @@ TEST(ErasureCodeTest, encode)
   }
 }
 
+template <typename T>
+void check_apply_delta(const char *w, const char *m)
+{
+  T jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = m;
+  profile["w"] = w;
+  EXPECT_EQ(0, jerasure.init(profile, &cerr));
+  EXPECT_TRUE(jerasure.supports_parity_delta());
+
+  const unsigned k = jerasure.get_data_chunk_count();
+  const unsigned n = jerasure.get_chunk_count();
+  unsigned object_size = jerasure.get_alignment() * 4;
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < n; ++i)
+    want_to_encode.insert(i);
+
+  bufferlist in;
+  for (unsigned i = 0; i < object_size; ++i)
+    in.append((char)(i * 7 + 3));
+  map<int, bufferlist> encoded;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+  unsigned length = encoded[0].length();
+
+  // overwrite the second data chunk
+  bufferlist out;
+  out.append(in.c_str(), length);
+  out.append(string(length, 'D'));
+  out.append(in.c_str() + 2 * length, in.length() - 2 * length);
+  map<int, bufferlist> reencoded;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, out, &reencoded));
+
+  bufferptr old_data(encoded[1].c_str(), length);
+  bufferptr new_data(reencoded[1].c_str(), length);
+  map<int, bufferptr> deltas;
+  deltas[1] = buffer::create_aligned(length, 64);
+  jerasure.encode_delta(old_data, new_data, &deltas[1]);
+
+  map<int, bufferptr> parity;
+  for (unsigned i = k; i < n; ++i) {
+    parity[i] = buffer::create_aligned(length, 64);
+    memcpy(parity[i].c_str(), encoded[i].c_str(), length);
+  }
+  EXPECT_EQ(0, jerasure.apply_delta(deltas, parity));
+  for (unsigned i = k; i < n; ++i) {
+    EXPECT_EQ(0, memcmp(parity[i].c_str(), reencoded[i].c_str(), length));
+  }
+}
+
+TEST(ErasureCodeTest, apply_delta)
+{
+  const char *ws[] = { "8", "16", "32" };
+  for (auto w : ws) {
+    check_apply_delta<ErasureCodeJerasureReedSolomonVandermonde>(w, "2");
+    check_apply_delta<ErasureCodeJerasureReedSolomonVandermonde>(w, "3");
+    check_apply_delta<ErasureCodeJerasureReedSolomonRAID6>(w, "2");
+  }
+
+  ErasureCodeJerasureCauchyGood cauchy;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  EXPECT_EQ(0, cauchy.init(profile, &cerr));
+  EXPECT_FALSE(cauchy.supports_parity_delta());
+  map<int, bufferptr> deltas, parity;
+  EXPECT_EQ(-ENOTSUP, cauchy.apply_delta(deltas, parity));
+}
+
 TEST(ErasureCodeTest, create_rule)
 {
   CrushWrapper *c = new CrushWrapper;
@@ -5,6 +5,8 @@
  * Author: Ramesh Chander, Ramesh.Chander@sandisk.com
  */
 #include <iostream>
+#include <chrono>
+#include <random>
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
 
@@ -290,11 +292,143 @@ TEST_P(AllocTest, test_alloc_non_aligned_len)
   EXPECT_EQ(want_size, alloc->allocate(want_size, alloc_unit, 0, &extents));
 }
 
+TEST_P(AllocTest, test_alloc_dump)
+{
+  int64_t block_size = 4096;
+  int64_t blocks = BitMapZone::get_total_blocks() * 4;
+
+  init_alloc(blocks * block_size, block_size);
+  interval_set<uint64_t> expected;
+  // cross bitmap word and zone boundaries
+  expected.insert(0, block_size * 3);
+  expected.insert(block_size * 60, block_size * 10);
+  expected.insert(block_size * (BitMapZone::get_total_blocks() - 2),
+		  block_size * 70);
+  expected.insert(block_size * (blocks - 1), block_size);
+  for (auto p = expected.begin(); p != expected.end(); ++p) {
+    alloc->init_add_free(p.get_start(), p.get_len());
+  }
+
+  interval_set<uint64_t> dumped;
+  alloc->dump([&](uint64_t offset, uint64_t length) {
+      dumped.insert(offset, length);
+    });
+  EXPECT_EQ(expected, dumped);
+
+  EXPECT_EQ(0, alloc->reserve(block_size * 2));
+  AllocExtentVector extents;
+  EXPECT_EQ(block_size * 2,
+	    alloc->allocate(block_size * 2, block_size, 0, &extents));
+  for (auto& e : extents) {
+    expected.erase(e.offset, e.length);
+  }
+  dumped.clear();
+  alloc->dump([&](uint64_t offset, uint64_t length) {
+      dumped.insert(offset, length);
+    });
+  EXPECT_EQ(expected, dumped);
+  EXPECT_EQ(expected.size(), alloc->get_free());
+}
+
+/*
+ * Fragmentation/throughput benchmark: fill the device to a target
+ * utilization with random sized allocations, then churn (free a random
+ * allocation, allocate a new one) and report allocation rate, extents
+ * per allocation and the resulting free space layout.  Too slow for
+ * the unit suite; run with
+ *   --gtest_also_run_disabled_tests --gtest_filter=*fragmentation*
+ * to compare allocators.
+ */
+TEST_P(AllocTest, DISABLED_test_alloc_fragmentation_bench)
+{
+  const uint64_t block_size = 4096;
+  const uint64_t capacity = 16ull << 30;
+  const uint64_t max_alloc = 256 << 10;
+  const unsigned churn_ops = 20000;
+
+  init_alloc(capacity, block_size);
+  alloc->init_add_free(0, capacity);
+
+  std::mt19937_64 rng(0x5eed);
+  std::uniform_int_distribution<uint64_t> size_dist(1, max_alloc / block_size);
+  std::vector<AllocExtentVector> live;
+  uint64_t used = 0;
+
+  auto do_alloc = [&](uint64_t *extents) {
+    uint64_t want = size_dist(rng) * block_size;
+    if (alloc->reserve(want) < 0) {
+      return false;
+    }
+    AllocExtentVector ev;
+    int64_t got = alloc->allocate(want, block_size, 0, &ev);
+    EXPECT_EQ((int64_t)want, got);
+    if (got <= 0) {
+      alloc->unreserve(want);
+      return false;
+    }
+    used += got;
+    *extents += ev.size();
+    live.push_back(std::move(ev));
+    return true;
+  };
+  auto do_release = [&]() {
+    std::uniform_int_distribution<size_t> pick(0, live.size() - 1);
+    size_t i = pick(rng);
+    interval_set<uint64_t> release_set;
+    for (auto& e : live[i]) {
+      release_set.insert(e.offset, e.length);
+      used -= e.length;
+    }
+    alloc->release(release_set);
+    std::swap(live[i], live.back());
+    live.pop_back();
+  };
+  auto report = [&](const char *phase, unsigned ops, uint64_t extents,
+		    std::chrono::duration<double> elapsed) {
+    uint64_t free_extents = 0, largest = 0;
+    alloc->dump([&](uint64_t offset, uint64_t length) {
+	++free_extents;
+	largest = MAX(largest, length);
+      });
+    std::cout << GetParam() << " " << phase
+	      << ": utilization " << (100 * used / capacity) << "%"
+	      << ", " << ops << " allocs in " << elapsed.count() << "s ("
+	      << (uint64_t)(ops / elapsed.count()) << " allocs/s)"
+	      << ", " << (ops ? (double)extents / ops : 0) << " extents/alloc"
+	      << ", " << free_extents << " free extents"
+	      << ", largest free " << prettybyte_t(largest) << std::endl;
+  };
+
+  for (unsigned pct : {70, 90}) {
+    using namespace std::chrono;
+    uint64_t extents = 0;
+    unsigned ops = 0;
+    auto start = steady_clock::now();
+    while (used < capacity / 100 * pct) {
+      ASSERT_TRUE(do_alloc(&extents));
+      ++ops;
+    }
+    report("fill", ops, extents, steady_clock::now() - start);
+
+    extents = 0;
+    ops = 0;
+    start = steady_clock::now();
+    for (unsigned i = 0; i < churn_ops; ++i) {
+      do_release();
+      if (do_alloc(&extents)) {
+	++ops;
+      }
+    }
+    report("churn", ops, extents, steady_clock::now() - start);
+    ASSERT_EQ(capacity - used, alloc->get_free());
+  }
+}
+
 
 INSTANTIATE_TEST_CASE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap"));
+  ::testing::Values("stupid", "bitmap", "avl"));
 
 #else
 
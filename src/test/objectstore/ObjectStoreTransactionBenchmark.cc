@@ -24,6 +24,8 @@ using namespace std;
 #include "common/ceph_argparse.h"
 #include "common/debug.h"
 #include "common/Cycles.h"
+#include "common/errno.h"
+#include "common/perf_counters.h"
 #include "global/global_init.h"
 #include "os/ObjectStore.h"
 
@@ -42,7 +44,7 @@ class Transaction {
     }
   };
   static Tick write_ticks, setattr_ticks, omap_setkeys_ticks, omap_rmkeys_ticks;
-  static Tick encode_ticks, decode_ticks, iterate_ticks;
+  static Tick encode_ticks, decode_ticks, iterate_ticks, apply_ticks;
 
   void write(coll_t cid, const ghobject_t& oid, uint64_t off, uint64_t len,
              const bufferlist& data) {
@@ -126,6 +128,13 @@ class Transaction {
     iterate_ticks.add(Cycles::rdtsc() - start_time);
   }
 
+  void apply(ObjectStore *store, ObjectStore::Sequencer *osr) {
+    uint64_t start_time = Cycles::rdtsc();
+    int r = store->apply_transaction(osr, std::move(t));
+    assert(r == 0);
+    apply_ticks.add(Cycles::rdtsc() - start_time);
+  }
+
   static void dump_stat() {
     cerr << " write op: " << Cycles::to_microseconds(write_ticks.ticks) << "us count: " << write_ticks.count << std::endl;
     cerr << " setattr op: " << Cycles::to_microseconds(setattr_ticks.ticks) << "us count: " << setattr_ticks.count << std::endl;
@@ -134,6 +143,9 @@ class Transaction {
     cerr << " encode op: " << Cycles::to_microseconds(Transaction::encode_ticks.ticks) << "us count: " << Transaction::encode_ticks.count << std::endl;
     cerr << " decode op: " << Cycles::to_microseconds(Transaction::decode_ticks.ticks) << "us count: " << Transaction::decode_ticks.count << std::endl;
     cerr << " iterate op: " << Cycles::to_microseconds(Transaction::iterate_ticks.ticks) << "us count: " << Transaction::iterate_ticks.count << std::endl;
+    if (apply_ticks.count) {
+      cerr << " apply op: " << Cycles::to_microseconds(Transaction::apply_ticks.ticks) << "us count: " << Transaction::apply_ticks.count << std::endl;
+    }
   }
 };
 
@@ -187,7 +199,8 @@ class PerfCase {
     data[info_info_attr] = generate_random(560, 1);
   }
 
-  uint64_t rados_write_4k(int times) {
+  uint64_t rados_write_4k(int times, ObjectStore *store = nullptr,
+                          ObjectStore::Sequencer *osr = nullptr) {
     uint64_t ticks = 0;
     uint64_t len = Kib *4;
     for (int i = 0; i < times; i++) {
@@ -202,6 +215,9 @@ class PerfCase {
         t.apply_encode_decode();
         t.apply_iterate();
         ticks += Cycles::rdtsc() - start_time;
+        if (store) {
+          t.apply(store, osr);
+        }
       }
       {
         Transaction t;
@@ -219,6 +235,9 @@ class PerfCase {
         t.apply_encode_decode();
         t.apply_iterate();
         ticks += Cycles::rdtsc() - start_time;
+        if (store) {
+          t.apply(store, osr);
+        }
       }
     }
     return ticks;
@@ -234,13 +253,29 @@ const coll_t PerfCase::cid;
 const ghobject_t PerfCase::pglog_oid(hobject_t(sobject_t(object_t("cid_pglog"), 0)));
 const ghobject_t PerfCase::info_oid(hobject_t(sobject_t(object_t("infos"), 0)));
 Transaction::Tick Transaction::write_ticks, Transaction::setattr_ticks, Transaction::omap_setkeys_ticks, Transaction::omap_rmkeys_ticks;
-Transaction::Tick Transaction::encode_ticks, Transaction::decode_ticks, Transaction::iterate_ticks;
+Transaction::Tick Transaction::encode_ticks, Transaction::decode_ticks, Transaction::iterate_ticks, Transaction::apply_ticks;
 
 void usage(const string &name) {
-  cerr << "Usage: " << name << " [times] "
+  cerr << "Usage: " << name << " [times] [objectstore type] [objectstore path]"
+       << std::endl;
+  cerr << "  with a store, transactions are also applied to it and the kv\n"
+       << "  write amplification (bluefs sst bytes per wal byte) is reported"
        << std::endl;
 }
 
+static uint64_t get_counter(const string& path)
+{
+  uint64_t v = 0;
+  g_ceph_context->get_perfcounters_collection()->with_counters(
+    [&](const PerfCountersCollection::CounterMap& m) {
+      auto p = m.find(path);
+      if (p != m.end()) {
+        v = p->second.data->u64;
+      }
+    });
+  return v;
+}
+
 int main(int argc, char **argv)
 {
   vector<const char*> args;
@@ -259,10 +294,48 @@ int main(int argc, char **argv)
   }
 
   uint64_t times = atoi(args[0]);
+  std::unique_ptr<ObjectStore> store;
+  ObjectStore::Sequencer osr("bench");
+  if (args.size() >= 3) {
+    store.reset(ObjectStore::create(g_ceph_context, args[1], args[2],
+                                    string(), 0));
+    if (!store) {
+      cerr << "unknown objectstore type " << args[1] << std::endl;
+      return 1;
+    }
+    int r = store->mkfs();
+    if (r < 0) {
+      cerr << "mkfs failed: " << cpp_strerror(r) << std::endl;
+      return 1;
+    }
+    r = store->mount();
+    if (r < 0) {
+      cerr << "mount failed: " << cpp_strerror(r) << std::endl;
+      return 1;
+    }
+    ObjectStore::Transaction t;
+    t.create_collection(coll_t(), 0);
+    r = store->apply_transaction(&osr, std::move(t));
+    assert(r == 0);
+  }
+
+  uint64_t wal_bytes = get_counter("bluefs.bytes_written_wal");
+  uint64_t sst_bytes = get_counter("bluefs.bytes_written_sst");
   PerfCase c;
-  uint64_t ticks = c.rados_write_4k(times);
+  uint64_t ticks = c.rados_write_4k(times, store.get(), &osr);
   Transaction::dump_stat();
   cerr << " Total rados op " << times << " run time " << Cycles::to_microseconds(ticks) << "us." << std::endl;
 
+  if (store) {
+    wal_bytes = get_counter("bluefs.bytes_written_wal") - wal_bytes;
+    sst_bytes = get_counter("bluefs.bytes_written_sst") - sst_bytes;
+    if (wal_bytes) {
+      cerr << " kv wal bytes " << wal_bytes << " sst bytes " << sst_bytes
+           << " write amplification " << (double)sst_bytes / wal_bytes
+           << std::endl;
+    }
+    store->umount();
+  }
+
   return 0;
 }
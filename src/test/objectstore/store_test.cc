@@ -36,6 +36,7 @@
 #include "common/Cond.h"
 #include "common/errno.h"
 #include "include/stringify.h"
+#include "common/ceph_json.h"
 #include "include/coredumpctl.h"
 
 #include "include/unordered_map.h"
@@ -4486,6 +4487,820 @@ TEST_P(StoreTestSpecificAUSize, SyntheticMatrixPreferDeferred) {
   do_matrix(m, store, doSyntheticTest);
 }
 
+TEST_P(StoreTestSpecificAUSize, SyntheticMatrixAllocCheckpoint) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  // doSyntheticTest remounts for fsck; each cycle writes, verifies and
+  // loads a checkpoint
+  const char *m[][10] = {
+    { "bluestore_min_alloc_size", "4096", "65536", 0 }, // to be the first!
+    { "max_write", "65536", 0 },
+    { "max_size", "1048576", 0 },
+    { "alignment", "512", 0 },
+    { "bluestore_allocator", "stupid", "bitmap", 0 },
+    { "bluestore_alloc_checkpoint", "true", 0 },
+    { 0 },
+  };
+  do_matrix(m, store, doSyntheticTest);
+}
+
+TEST_P(StoreTestSpecificAUSize, SyntheticKVSubmitLanes) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  g_conf->set_val("bluestore_kv_submit_lanes", "4");
+  g_conf->apply_changes(NULL);
+  StartDeferred(4096);
+  doSyntheticTest(store, 10000, 400*1024, 40*1024, 0);
+  g_conf->set_val("bluestore_kv_submit_lanes", "0");
+  g_conf->apply_changes(NULL);
+}
+
+#if defined(WITH_BLUESTORE)
+TEST_P(StoreTestSpecificAUSize, CacheAutotune) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  g_conf->set_val("bluestore_cache_autotune", "true");
+  g_conf->set_val("bluestore_cache_autotune_interval", "0");
+  g_conf->set_val("osd_memory_target", stringify(512 << 20));
+  g_conf->set_val("osd_memory_cache_min", stringify(64 << 20));
+  g_conf->apply_changes(NULL);
+  StartDeferred(4096);
+  doSyntheticTest(store, 2000, 400*1024, 40*1024, 0);
+  // let the mempool thread make a few decisions
+  sleep(1);
+
+  const PerfCounters* logger = store->get_perf_counters();
+  uint64_t target = logger->get(l_bluestore_cache_target_bytes);
+  ASSERT_GE(target, 64u << 20);
+  ASSERT_LE(target, 512u << 20);
+  // per-cache targets split the total (modulo float rounding)
+  uint64_t split = logger->get(l_bluestore_cache_meta_target_bytes) +
+    logger->get(l_bluestore_cache_kv_target_bytes) +
+    logger->get(l_bluestore_cache_data_target_bytes);
+  ASSERT_LE(split, target + target / 1000);
+  ASSERT_GE(split, target - target / 1000);
+
+  // start over with no data cache, then read the same object over and
+  // over: only the data cache misses, so memory has to move toward it
+  store->umount();
+  g_conf->set_val("bluestore_cache_meta_ratio", ".5");
+  g_conf->set_val("bluestore_cache_kv_ratio", ".5");
+  g_conf->set_val("bluestore_cache_kv_max", stringify(1ull << 30));
+  g_conf->set_val("bluestore_cache_autotune_chunk_size", stringify(4 << 20));
+  g_conf->apply_changes(NULL);
+  store->mount();
+  auto data_share = [&]() {
+    return (double)logger->get(l_bluestore_cache_data_target_bytes) /
+      (double)logger->get(l_bluestore_cache_target_bytes);
+  };
+  ObjectStore::Sequencer osr("test");
+  coll_t cid(spg_t(pg_t(0, 555), shard_id_t::NO_SHARD));
+  ghobject_t hoid(hobject_t(sobject_t("autotune", CEPH_NOSNAP)));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    bufferlist bl;
+    bl.append(string(32 << 20, 'a'));
+    t.write(cid, hoid, 0, bl.length(), bl);
+    int r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  sleep(1);
+  double before = data_share();
+  utime_t end = ceph_clock_now();
+  end += 3.0;
+  while (ceph_clock_now() < end) {
+    for (uint64_t off = 0; off < (32 << 20); off += (1 << 20)) {
+      bufferlist bl;
+      ASSERT_EQ((int)(1 << 20), store->read(cid, hoid, off, 1 << 20, bl));
+    }
+  }
+  sleep(1);
+  double after = data_share();
+  ASSERT_GT(after, before);
+  ASSERT_GT(logger->get(l_bluestore_cache_autotune_shifts), 0u);
+
+  g_conf->set_val("bluestore_cache_meta_ratio", ".01");
+  g_conf->set_val("bluestore_cache_kv_ratio", ".99");
+  g_conf->set_val("bluestore_cache_kv_max", stringify(512 << 20));
+  g_conf->set_val("bluestore_cache_autotune_chunk_size", stringify(32 << 20));
+  g_conf->set_val("bluestore_cache_autotune", "false");
+  g_conf->set_val("bluestore_cache_autotune_interval", "5");
+  g_conf->set_val("osd_memory_target", stringify(4ull << 30));
+  g_conf->set_val("osd_memory_cache_min", stringify(128 << 20));
+  g_conf->apply_changes(NULL);
+}
+
+TEST_P(StoreTestSpecificAUSize, ParallelFsck) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  StartDeferred(4096);
+  ObjectStore::Sequencer osr("test");
+  int r;
+  // several collections so the object keyspace splits into several ranges
+  for (int64_t pool = 1; pool <= 8; ++pool) {
+    coll_t cid(spg_t(pg_t(0, pool), shard_id_t::NO_SHARD));
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    for (unsigned i = 0; i < 16; ++i) {
+      ghobject_t hoid(hobject_t("obj" + stringify(i), "", CEPH_NOSNAP,
+				i * 0x10000001u, pool, ""));
+      bufferlist bl;
+      bl.append(string(16384 * (i % 4 + 1), 'a' + i));
+      t.write(cid, hoid, 0, bl.length(), bl);
+      t.omap_setheader(cid, hoid, bl);
+    }
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  BlueStore *bstore = dynamic_cast<BlueStore*>(store.get());
+  ASSERT_TRUE(bstore);
+  store->umount();
+  map<int, BlueStore::fsck_stats_t> stats;
+  for (int threads : {1, 4}) {
+    g_conf->set_val("bluestore_fsck_threads", stringify(threads));
+    g_conf->apply_changes(NULL);
+    ASSERT_EQ(store->fsck(true), 0);
+    stats[threads] = bstore->get_last_fsck_stats();
+  }
+  ASSERT_EQ(stats[1].num_objects, 8u * 16u);
+  ASSERT_EQ(stats[1].num_objects, stats[4].num_objects);
+  ASSERT_EQ(stats[1].bytes, stats[4].bytes);
+  store->mount();
+
+  g_conf->set_val("bluestore_fsck_threads", "1");
+  g_conf->apply_changes(NULL);
+}
+
+TEST_P(StoreTestSpecificAUSize, SequentialReadahead) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  g_conf->set_val("bluestore_readahead_trigger_requests", "1");
+  g_conf->set_val("bluestore_readahead_min_bytes", stringify(64 << 10));
+  g_conf->set_val("bluestore_readahead_max_bytes", stringify(1 << 20));
+  g_conf->apply_changes(NULL);
+  StartDeferred(4096);
+
+  ObjectStore::Sequencer osr("test");
+  coll_t cid;
+  ghobject_t hoid(hobject_t("readahead", "", CEPH_NOSNAP, 0, -1, ""));
+  const unsigned obj_size = 4 << 20, chunk = 64 << 10;
+  bufferlist orig;
+  for (unsigned i = 0; i < obj_size / chunk; ++i) {
+    orig.append(string(chunk, 'a' + i % 26));
+  }
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, hoid, 0, orig.length(), orig,
+	    CEPH_OSD_OP_FLAG_FADVISE_DONTNEED);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // drop cached data
+  store->umount();
+  store->mount();
+
+  const PerfCounters* logger = store->get_perf_counters();
+  uint64_t miss_bytes = logger->get(l_bluestore_buffer_miss_bytes);
+  uint64_t ra_hit_bytes = logger->get(l_bluestore_readahead_hit_bytes);
+  for (unsigned off = 0; off < obj_size; off += chunk) {
+    if (off == obj_size / 2) {
+      // data prefetched before an overwrite must not be served after it
+      bufferlist bl;
+      bl.append(string(chunk * 4, 'z'));
+      orig.copy_in(off, bl.length(), bl);
+      ObjectStore::Transaction t;
+      t.write(cid, hoid, off, bl.length(), bl);
+      r = apply_transaction(store, &osr, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+    bufferlist in, exp;
+    r = store->read(cid, hoid, off, chunk, in);
+    ASSERT_EQ((int)chunk, r);
+    exp.substr_of(orig, off, chunk);
+    ASSERT_TRUE(bl_eq(exp, in));
+  }
+  ASSERT_GT(logger->get(l_bluestore_readahead), 0u);
+  ASSERT_GT(logger->get(l_bluestore_readahead_hit_bytes), ra_hit_bytes);
+  // the readahead probes are not client misses, and prefetched data is
+  // a hit once
+  ASSERT_LE(logger->get(l_bluestore_buffer_miss_bytes) - miss_bytes,
+	    (uint64_t)obj_size);
+  ASSERT_LE(logger->get(l_bluestore_readahead_hit_bytes) - ra_hit_bytes,
+	    (uint64_t)obj_size);
+
+  // reading the cached first half again is no readahead hit
+  ra_hit_bytes = logger->get(l_bluestore_readahead_hit_bytes);
+  for (unsigned off = 0; off < obj_size / 2; off += chunk) {
+    bufferlist in, exp;
+    r = store->read(cid, hoid, off, chunk, in);
+    ASSERT_EQ((int)chunk, r);
+    exp.substr_of(orig, off, chunk);
+    ASSERT_TRUE(bl_eq(exp, in));
+  }
+  ASSERT_EQ(ra_hit_bytes, logger->get(l_bluestore_readahead_hit_bytes));
+
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  g_conf->set_val("bluestore_readahead_trigger_requests", "2");
+  g_conf->set_val("bluestore_readahead_min_bytes", stringify(64 << 10));
+  g_conf->set_val("bluestore_readahead_max_bytes", "0");
+  g_conf->apply_changes(NULL);
+}
+
+TEST_P(StoreTestSpecificAUSize, DeferredGlobalBatch) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  g_conf->set_val("bluestore_deferred_global_batch", "true");
+  g_conf->set_val("bluestore_deferred_batch_ops", "16");
+  g_conf->apply_changes(NULL);
+  StartDeferred(65536);
+
+  // small overwrites from several sequencers, so that pending deferred
+  // batches from different osrs get merged
+  const unsigned num_colls = 4, obj_size = 256 << 10, wsize = 4096;
+  vector<std::unique_ptr<ObjectStore::Sequencer>> osrs;
+  vector<coll_t> cids;
+  vector<bufferlist> expected(num_colls);
+  ghobject_t hoid(hobject_t("deferred", "", CEPH_NOSNAP, 0, -1, ""));
+  int r;
+  for (unsigned i = 0; i < num_colls; ++i) {
+    osrs.emplace_back(new ObjectStore::Sequencer("test"));
+    cids.push_back(coll_t(spg_t(pg_t(i, 1), shard_id_t::NO_SHARD)));
+    expected[i].append(string(obj_size, 'a' + i));
+    ObjectStore::Transaction t;
+    t.create_collection(cids[i], 0);
+    t.write(cids[i], hoid, 0, obj_size, expected[i]);
+    r = apply_transaction(store, osrs[i].get(), std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  const PerfCounters* logger = store->get_perf_counters();
+  uint64_t ops = logger->get(l_bluestore_deferred_write_ops);
+  for (unsigned round = 0; round < 32; ++round) {
+    for (unsigned i = 0; i < num_colls; ++i) {
+      uint64_t off = ((round * 7 + i * 3) % (obj_size / wsize)) * wsize;
+      bufferlist bl;
+      bl.append(string(wsize, 'A' + (round + i) % 26));
+      expected[i].copy_in(off, wsize, bl);
+      ObjectStore::Transaction t;
+      t.write(cids[i], hoid, off, wsize, bl);
+      r = apply_transaction(store, osrs[i].get(), std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  // adjacent overwrites queued from separate txcs go out as one io
+  uint64_t coalesced = logger->get(l_bluestore_deferred_write_coalesced);
+  for (unsigned blk = 0; blk < 16; ++blk) {
+    uint64_t off = blk * wsize;
+    bufferlist bl;
+    bl.append(string(wsize, 'z'));
+    expected[0].copy_in(off, wsize, bl);
+    ObjectStore::Transaction t;
+    t.write(cids[0], hoid, off, wsize, bl);
+    r = apply_transaction(store, osrs[0].get(), std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  store->umount();
+  store->mount();
+  ASSERT_GT(logger->get(l_bluestore_deferred_write_ops), ops);
+  ASSERT_GT(logger->get(l_bluestore_deferred_write_coalesced), coalesced);
+  for (unsigned i = 0; i < num_colls; ++i) {
+    bufferlist in;
+    r = store->read(cids[i], hoid, 0, obj_size, in);
+    ASSERT_EQ((int)obj_size, r);
+    ASSERT_TRUE(bl_eq(expected[i], in));
+  }
+
+  // submit order: adjacent ios merged, upward from the head, then wrap
+  {
+    bufferlist a, b, c, d, e;
+    a.append(string(0x1000, 'a'));
+    b.append(string(0x1000, 'b'));
+    c.append(string(0x1000, 'c'));
+    d.append(string(0x1000, 'd'));
+    e.append(string(0x1000, 'e'));
+    map<uint64_t,bufferlist*> ios = {
+      {0x1000, &a}, {0x2000, &b}, {0x8000, &c}, {0x9000, &d}, {0x20000, &e}
+    };
+    vector<pair<uint64_t,bufferlist>> runs;
+    BlueStore::deferred_elevator_runs(ios, 0x5000, &runs);
+    ASSERT_EQ(3u, runs.size());
+    ASSERT_EQ(0x8000u, runs[0].first);
+    ASSERT_EQ(0x2000u, runs[0].second.length());
+    ASSERT_EQ(string(0x1000, 'c') + string(0x1000, 'd'),
+	      runs[0].second.to_str());
+    ASSERT_EQ(0x20000u, runs[1].first);
+    ASSERT_EQ(0x1000u, runs[1].second.length());
+    ASSERT_EQ(0x1000u, runs[2].first);
+    ASSERT_EQ(0x2000u, runs[2].second.length());
+    ASSERT_EQ(string(0x1000, 'a') + string(0x1000, 'b'),
+	      runs[2].second.to_str());
+  }
+
+  g_conf->set_val("bluestore_deferred_global_batch", "false");
+  g_conf->set_val("bluestore_deferred_batch_ops", "0");
+  g_conf->apply_changes(NULL);
+}
+
+TEST_P(StoreTestSpecificAUSize, CompressionSkipsIncompressible) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  g_conf->set_val("bluestore_compression_mode", "aggressive");
+  g_conf->set_val("bluestore_compression_max_blob_size", "524288");
+  g_conf->apply_changes(NULL);
+  StartDeferred(65536);
+
+  ObjectStore::Sequencer osr("test");
+  coll_t cid;
+  ghobject_t hoid(hobject_t("incompressible", "", CEPH_NOSNAP, 0, -1, ""));
+  const unsigned len = 0x80000;
+  bufferlist random_bl, text_bl;
+  {
+    bufferptr bp(len);
+    for (unsigned i = 0; i < len; ++i) {
+      bp.c_str()[i] = rand();
+    }
+    random_bl.append(bp);
+    text_bl.append(string(len, 'x'));
+  }
+  const PerfCounters* logger = store->get_perf_counters();
+  uint64_t skipped = logger->get(l_bluestore_compress_skipped_bytes);
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, hoid, 0, len, random_bl);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // predicted incompressible, never handed to the compressor
+  ASSERT_EQ(logger->get(l_bluestore_compress_skipped_bytes), skipped + len);
+  skipped = logger->get(l_bluestore_compress_skipped_bytes);
+  {
+    struct store_statfs_t statfs;
+    ASSERT_EQ(0, store->statfs(&statfs));
+    ASSERT_EQ(0, statfs.compressed_original);
+  }
+  {
+    // the object is in back-off now, so this is left alone, too...
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, len, text_bl);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_EQ(logger->get(l_bluestore_compress_skipped_bytes), skipped + len);
+  {
+    // ...but not forever
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, len, text_bl);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  {
+    struct store_statfs_t statfs;
+    ASSERT_EQ(0, store->statfs(&statfs));
+    ASSERT_EQ((int64_t)len, statfs.compressed_original);
+  }
+  {
+    bufferlist in;
+    r = store->read(cid, hoid, 0, len, in);
+    ASSERT_EQ((int)len, r);
+    ASSERT_TRUE(bl_eq(text_bl, in));
+  }
+  {
+    // force means force: the compressor sees every blob
+    g_conf->set_val("bluestore_compression_mode", "force");
+    g_conf->apply_changes(NULL);
+    skipped = logger->get(l_bluestore_compress_skipped_bytes);
+    uint64_t rejected = logger->get(l_bluestore_compress_rejected_count);
+    for (unsigned i = 0; i < 2; ++i) {
+      ObjectStore::Transaction t;
+      t.write(cid, hoid, 0, len, random_bl);
+      r = apply_transaction(store, &osr, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+    ASSERT_EQ(logger->get(l_bluestore_compress_skipped_bytes), skipped);
+    ASSERT_GT(logger->get(l_bluestore_compress_rejected_count), rejected + 1);
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  g_conf->set_val("bluestore_compression_mode", "none");
+  g_conf->set_val("bluestore_compression_max_blob_size", "0");
+  g_conf->apply_changes(NULL);
+}
+
+TEST_P(StoreTest, TxcTrace) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  // threshold 0: every transaction counts as slow
+  g_conf->set_val("bluestore_txc_trace", "true");
+  g_conf->set_val("bluestore_txc_trace_slow_threshold", "0");
+  g_conf->set_val("bluestore_txc_trace_history", "4");
+  g_conf->apply_changes(NULL);
+
+  ObjectStore::Sequencer osr("txc_trace");
+  coll_t cid;
+  ghobject_t hoid(hobject_t("txc_trace", "", CEPH_NOSNAP, 0, -1, ""));
+  const PerfCounters* logger = store->get_perf_counters();
+  uint64_t traced = logger->get(l_bluestore_txc_slow_traced);
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (unsigned i = 0; i < 8; ++i) {
+    ObjectStore::Transaction t;
+    bufferlist bl;
+    bl.append(string(4096, 'a' + i));
+    t.write(cid, hoid, i * 4096, bl.length(), bl);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // txcs are recorded once they reach STATE_DONE, after the commit
+  // callbacks we wait for above
+  for (unsigned i = 0; i < 100; ++i) {
+    if (logger->get(l_bluestore_txc_slow_traced) >= traced + 9) {
+      break;
+    }
+    usleep(10000);
+  }
+  ASSERT_GE(logger->get(l_bluestore_txc_slow_traced), traced + 9);
+
+  {
+    JSONFormatter f;
+    store->dump_slow_transactions(&f);
+    stringstream ss;
+    f.flush(ss);
+    JSONParser parser;
+    ASSERT_TRUE(parser.parse(ss.str().c_str(), ss.str().length()));
+    JSONObj *txcs = parser.find_obj("transactions");
+    ASSERT_TRUE(txcs);
+    ASSERT_TRUE(txcs->is_array());
+    vector<string> v = txcs->get_array_elements();
+    ASSERT_EQ(4u, v.size());  // bluestore_txc_trace_history
+    string last = v.back();
+    ASSERT_NE(string::npos, last.find("\"osr\":\"txc_trace\""));
+    ASSERT_NE(string::npos, last.find("\"throttle\""));
+    ASSERT_NE(string::npos, last.find("\"kv_committing\""));
+    ASSERT_NE(string::npos, last.find("\"done\""));
+  }
+
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  g_conf->set_val("bluestore_txc_trace", "false");
+  g_conf->set_val("bluestore_txc_trace_slow_threshold", ".1");
+  g_conf->set_val("bluestore_txc_trace_history", "100");
+  g_conf->apply_changes(NULL);
+}
+
+// not a functional test: reports what bluestore_txc_trace costs per
+// txc.  run with --gtest_also_run_disabled_tests.
+TEST_P(StoreTest, DISABLED_TxcTraceOverhead) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  ObjectStore::Sequencer osr("txc_trace_overhead");
+  coll_t cid;
+  ghobject_t hoid(hobject_t("txc_trace_overhead", "", CEPH_NOSNAP, 0, -1, ""));
+  const unsigned num = 20000;
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.touch(cid, hoid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  bufferlist bl;
+  bl.append(string(4096, 'a'));
+  double took[2];
+  // off, on, off, on: the first pass warms up the onode and allocator
+  for (unsigned pass = 0; pass < 4; ++pass) {
+    g_conf->set_val("bluestore_txc_trace", (pass & 1) ? "true" : "false");
+    g_conf->apply_changes(NULL);
+    utime_t start = ceph_clock_now();
+    for (unsigned i = 0; i < num; ++i) {
+      ObjectStore::Transaction t;
+      t.write(cid, hoid, (i % 1024) * 4096, bl.length(), bl);
+      r = store->queue_transaction(&osr, std::move(t), nullptr);
+      ASSERT_EQ(r, 0);
+    }
+    osr.flush();
+    took[pass & 1] = (double)(ceph_clock_now() - start);
+  }
+  cout << "txc trace off " << took[0] * 1000000.0 / num << " us/txc, on "
+       << took[1] * 1000000.0 / num << " us/txc ("
+       << (took[1] / took[0] - 1.0) * 100.0 << "%)" << std::endl;
+
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  g_conf->set_val("bluestore_txc_trace", "false");
+  g_conf->apply_changes(NULL);
+}
+
+TEST_P(StoreTest, ExtentMapLazyDecode) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  g_conf->set_val("bluestore_extent_map_lazy_decode", "true");
+  g_conf->set_val("bluestore_extent_map_lazy_decode_min_bytes", "0");
+  g_conf->apply_changes(NULL);
+
+  ObjectStore::Sequencer osr("test");
+  coll_t cid;
+  ghobject_t hoid(hobject_t("lazy_decode", "", CEPH_NOSNAP, 0, -1, ""));
+  ghobject_t hoid2(hobject_t("lazy_decode_clone", "", CEPH_NOSNAP, 0, -1, ""));
+  const unsigned chunk = 4096;
+  const unsigned num = 256;
+  bufferlist expected;
+  int r;
+  {
+    // every other chunk, so that each gets its own extent and blob
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    for (unsigned i = 0; i < num; ++i) {
+      bufferlist bl;
+      bl.append(string(chunk, 'a' + i % 26));
+      t.write(cid, hoid, i * chunk * 2, chunk, bl);
+      expected.append(bl);
+      if (i + 1 < num) {
+	expected.append_zero(chunk);
+      }
+    }
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  store->umount();
+  store->mount();
+
+  const PerfCounters* logger = store->get_perf_counters();
+  uint64_t partial = logger->get(l_bluestore_onode_shard_partial);
+  uint64_t skipped = logger->get(l_bluestore_onode_shard_skipped_extents);
+  {
+    bufferlist in, exp;
+    r = store->read(cid, hoid, 100 * chunk * 2, chunk, in);
+    ASSERT_EQ((int)chunk, r);
+    exp.substr_of(expected, 100 * chunk * 2, chunk);
+    ASSERT_TRUE(bl_eq(exp, in));
+  }
+  ASSERT_LT(partial, logger->get(l_bluestore_onode_shard_partial));
+  ASSERT_LT(skipped, logger->get(l_bluestore_onode_shard_skipped_extents));
+  {
+    // fill in the rest of the partially decoded shards
+    bufferlist in;
+    r = store->read(cid, hoid, 0, expected.length(), in);
+    ASSERT_EQ((int)expected.length(), r);
+    ASSERT_TRUE(bl_eq(expected, in));
+  }
+  store->umount();
+  store->mount();
+  {
+    // a write must see the whole shard, not just what a read decoded
+    bufferlist in;
+    r = store->read(cid, hoid, 100 * chunk * 2, chunk, in);
+    ASSERT_EQ((int)chunk, r);
+    ObjectStore::Transaction t;
+    bufferlist bl;
+    bl.append(string(chunk * 3, 'z'));
+    t.write(cid, hoid, 99 * chunk * 2, bl.length(), bl);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+    bufferlist exp;
+    exp.substr_of(expected, 0, 99 * chunk * 2);
+    exp.append(bl);
+    bufferlist tail;
+    tail.substr_of(expected, exp.length(), expected.length() - exp.length());
+    exp.append(tail);
+    expected.swap(exp);
+  }
+  store->umount();
+  store->mount();
+  {
+    // ...and so must one whose range lies in another shard: small writes
+    // look at neighbouring blobs for reuse
+    bufferlist in;
+    r = store->read(cid, hoid, 200 * chunk * 2, chunk, in);
+    ASSERT_EQ((int)chunk, r);
+    ObjectStore::Transaction t;
+    bufferlist bl;
+    bl.append(string(chunk, 'y'));
+    t.write(cid, hoid, 10 * chunk * 2 + chunk, bl.length(), bl);
+    t.clone(cid, hoid, hoid2);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+    bufferlist exp;
+    exp.substr_of(expected, 0, 10 * chunk * 2 + chunk);
+    exp.append(bl);
+    bufferlist tail;
+    tail.substr_of(expected, exp.length(), expected.length() - exp.length());
+    exp.append(tail);
+    expected.swap(exp);
+  }
+  store->umount();
+  ASSERT_EQ(store->fsck(false), 0);
+  store->mount();
+  {
+    bufferlist in;
+    r = store->read(cid, hoid, 0, expected.length(), in);
+    ASSERT_EQ((int)expected.length(), r);
+    ASSERT_TRUE(bl_eq(expected, in));
+    in.clear();
+    r = store->read(cid, hoid2, 0, expected.length(), in);
+    ASSERT_EQ((int)expected.length(), r);
+    ASSERT_TRUE(bl_eq(expected, in));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove(cid, hoid2);
+    t.remove_collection(cid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  g_conf->set_val("bluestore_extent_map_lazy_decode_min_bytes", "256");
+  g_conf->apply_changes(NULL);
+}
+
+TEST_P(StoreTest, OnodeFilter) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  // only takes effect on mount
+  g_conf->set_val("bluestore_onode_filter", "true");
+  g_conf->apply_changes(NULL);
+  store->umount();
+  store->mount();
+
+  ObjectStore::Sequencer osr("test");
+  coll_t cid;
+  auto make_oid = [](unsigned i) {
+    return ghobject_t(hobject_t(sobject_t("onode_filter_" + stringify(i),
+					  CEPH_NOSNAP)));
+  };
+  const unsigned num = 100;
+  const PerfCounters* logger = store->get_perf_counters();
+  int r;
+  {
+    // a new collection is known to be empty
+    uint64_t skipped = logger->get(l_bluestore_onode_filter_skipped);
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    for (unsigned i = 0; i < num; ++i) {
+      bufferlist bl;
+      bl.append(stringify(i));
+      t.write(cid, make_oid(i), 0, bl.length(), bl);
+    }
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ(skipped + num, logger->get(l_bluestore_onode_filter_skipped));
+  }
+  store->umount();
+  store->mount();
+  logger = store->get_perf_counters();
+  {
+    // the first create after mount starts rebuilding the filter from the
+    // kv store in the background; it is not used until that is done
+    ObjectStore::Transaction t;
+    t.touch(cid, make_oid(num * 3));
+    t.remove(cid, make_oid(num * 3));
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+    uint64_t skipped = logger->get(l_bluestore_onode_filter_skipped);
+    for (unsigned i = 0; i < 100; ++i) {
+      ASSERT_FALSE(store->exists(cid, make_oid(num * 3 + 1)));
+      if (logger->get(l_bluestore_onode_filter_skipped) > skipped) {
+	break;
+      }
+      usleep(10000);
+    }
+    ASSERT_LT(skipped, logger->get(l_bluestore_onode_filter_skipped));
+  }
+  {
+    // existing objects must be found, new ones not looked up
+    uint64_t skipped = logger->get(l_bluestore_onode_filter_skipped);
+    ObjectStore::Transaction t;
+    for (unsigned i = 0; i < num * 2; ++i) {
+      bufferlist bl;
+      bl.append("x");
+      t.write(cid, make_oid(i), 10, bl.length(), bl);
+    }
+    t.collection_move_rename(cid, make_oid(0), cid, make_oid(num * 2));
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+    ASSERT_LE(skipped + num / 2, logger->get(l_bluestore_onode_filter_skipped));
+  }
+  store->umount();
+  store->mount();
+  for (unsigned i = 1; i <= num * 2; ++i) {
+    bufferlist in, exp;
+    if (i < num) {
+      exp.append(stringify(i));
+    } else if (i == num * 2) {
+      exp.append(stringify(0));
+    }
+    exp.append_zero(10 - exp.length());
+    exp.append("x");
+    r = store->read(cid, make_oid(i), 0, exp.length(), in);
+    ASSERT_EQ((int)exp.length(), r);
+    ASSERT_TRUE(bl_eq(exp, in));
+  }
+  {
+    ObjectStore::Transaction t;
+    for (unsigned i = 1; i <= num * 2; ++i) {
+      t.remove(cid, make_oid(i));
+    }
+    t.remove_collection(cid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  g_conf->set_val("bluestore_onode_filter", "false");
+  g_conf->apply_changes(NULL);
+  store->umount();
+  store->mount();
+}
+
+TEST_P(StoreTest, ZeroCopyRead) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  ObjectStore::Sequencer osr("test");
+  coll_t cid;
+  ghobject_t hoid(hobject_t("zerocopy", "", CEPH_NOSNAP, 0, -1, ""));
+  const unsigned len = 128 << 10;
+  bufferlist data, expected;
+  data.append(string(len, 'z'));
+  expected.append(data);
+  expected.append_zero(len);
+  expected.append(data);
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, hoid, 0, len, data);
+    t.write(cid, hoid, len * 2, len, data);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  store->umount();
+  store->mount();
+
+  const PerfCounters* logger = store->get_perf_counters();
+  uint64_t read_bytes = logger->get(l_bluestore_read_bytes);
+  uint64_t zerocopy_bytes = logger->get(l_bluestore_read_zerocopy_bytes);
+  bufferlist in;
+  r = store->read(cid, hoid, 0, len * 3, in);
+  ASSERT_EQ((int)len * 3, r);
+  ASSERT_TRUE(bl_eq(expected, in));
+  // the hole is zero filled, everything else comes from the device buffers
+  ASSERT_EQ(read_bytes + len * 3, logger->get(l_bluestore_read_bytes));
+  ASSERT_EQ(zerocopy_bytes + len * 2,
+	    logger->get(l_bluestore_read_zerocopy_bytes));
+  ASSERT_TRUE(in.buffers().front().is_page_aligned());
+
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+#endif //#if defined(WITH_BLUESTORE)
+
 TEST_P(StoreTest, AttrSynthetic) {
   ObjectStore::Sequencer osr("test");
   MixedGenerator gen(447);
@@ -6464,6 +7279,105 @@ TEST_P(StoreTestSpecificAUSize, SmallWriteOnShardedExtents) {
   g_conf->set_val("bluestore_csum_type", "crc32c");
 }
 
+TEST_P(StoreTestSpecificAUSize, AllocCheckpointCompat) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  g_conf->set_val("bluestore_alloc_checkpoint", "true");
+  g_conf->apply_changes(NULL);
+  StartDeferred(65536);
+  ObjectStore::Sequencer osr("test");
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  bufferlist data;
+  data.append(string(1048576, 'a'));
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, hoid, 0, data.length(), data);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  BlueStore *bstore = dynamic_cast<BlueStore*>(store.get());
+  ASSERT_TRUE(bstore);
+  store->umount();
+
+  // kv-only access may modify the freelist, so opening the store that way
+  // drops the checkpoint and lets older code mount it again
+  KeyValueDB *db = nullptr;
+  ASSERT_EQ(0, bstore->start_kv_only(&db));
+  {
+    KeyValueDB::Iterator it = db->get_iterator("A");
+    it->seek_to_first();
+    ASSERT_FALSE(it->valid());
+    bufferlist bl;
+    ASSERT_EQ(0, db->get("S", "min_compat_ondisk_format", &bl));
+    int32_t compat;
+    auto p = bl.begin();
+    ::decode(compat, p);
+    ASSERT_EQ(bstore->min_compat_ondisk_format, compat);
+  }
+
+  // leave a checkpoint the way code that does not raise the compat
+  // version would; it claims the whole device is free, so trusting it
+  // would hand out space that is in use
+  {
+    bluestore_alloc_checkpoint_t ckpt;
+    bufferlist bl;
+    ASSERT_EQ(0, db->get("S", "min_alloc_size", &bl));
+    auto p = bl.begin();
+    ::decode(ckpt.min_alloc_size, p);
+    bl.clear();
+    ASSERT_EQ(0, db->get("S", "bluefs_extents", &bl));
+    p = bl.begin();
+    ::decode(ckpt.bluefs_extents, p);
+    ckpt.size = g_conf->bluestore_block_size;
+
+    interval_set<uint64_t> chunk;
+    chunk.insert(0, ckpt.size);
+    chunk.subtract(ckpt.bluefs_extents);
+    bufferlist cbl;
+    ::encode(chunk, cbl);
+    ckpt.crc = cbl.crc32c(-1);
+    ckpt.num_chunks = 1;
+    ckpt.num_extents = chunk.num_intervals();
+    ckpt.free_bytes = chunk.size();
+
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->set("A", string(8, 0), cbl);
+    bufferlist mbl;
+    ::encode(ckpt, mbl);
+    t->set("A", "meta", mbl);
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  store->umount();
+
+  // mount must fall back to the freelist
+  ASSERT_EQ(0, store->mount());
+  {
+    ObjectStore::Transaction t;
+    ghobject_t hoid2(hobject_t(sobject_t("Object 2", CEPH_NOSNAP)));
+    bufferlist bl;
+    bl.append(string(1048576, 'b'));
+    t.write(cid, hoid2, 0, bl.length(), bl);
+    r = apply_transaction(store, &osr, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  {
+    bufferlist bl;
+    r = store->read(cid, hoid, 0, data.length(), bl);
+    ASSERT_EQ(r, (int)data.length());
+    ASSERT_TRUE(bl_eq(data, bl));
+  }
+  store->umount();
+  g_conf->set_val("bluestore_alloc_checkpoint", "false");
+  g_conf->apply_changes(NULL);
+  ASSERT_EQ(store->fsck(false), 0);
+  store->mount();
+}
+
 #endif //#if defined(WITH_BLUESTORE)
 
 TEST_P(StoreTest, KVDBHistogramTest) {
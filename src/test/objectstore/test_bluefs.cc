@@ -526,6 +526,153 @@ TEST(BlueFS, test_compaction_async) {
   rm_temp_bdev(fn);
 }
 
+void write_small_files(BlueFS &fs, string dir, int count)
+{
+  for (int i = 0; i < count; i++) {
+    string file = "file." + to_string(i);
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write(dir, file, &h, false));
+    ASSERT_NE(nullptr, h);
+    auto sg = make_scope_guard([&fs, h] { fs.close_writer(h); });
+    bufferlist bl;
+    char *buf = gen_buffer(4096);
+    bufferptr bp = buffer::claim_char(4096, buf);
+    bl.push_back(bp);
+    h->append(bl.c_str(), bl.length());
+    ASSERT_EQ(0, fs.fsync(h));
+  }
+}
+
+TEST(BlueFS, test_compaction_async_concurrent_writes) {
+  uint64_t size = 1048576 * 128;
+  string fn = get_temp_bdev(size);
+  g_ceph_context->_conf->set_val(
+    "bluefs_alloc_size",
+    "65536");
+  g_ceph_context->_conf->set_val(
+    "bluefs_compact_log_sync",
+    "false");
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, fn));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid));
+  ASSERT_EQ(0, fs.mount());
+  const int num_files = 200;
+  {
+    std::vector<std::thread> write_threads;
+    for (int i=0; i<NUM_WRITERS; i++) {
+      string dir = "dir." + to_string(i);
+      ASSERT_EQ(0, fs.mkdir(dir));
+      write_threads.push_back(
+	std::thread(write_small_files, std::ref(fs), dir, num_files));
+    }
+
+    // keep compacting while the writers log new files; each compaction
+    // must not lose the metadata appended to the old log meanwhile.
+    std::atomic<bool> done = { false };
+    std::thread compact_thread([&fs, &done] {
+	while (!done) {
+	  fs.compact_log();
+	}
+      });
+
+    join_all(write_threads);
+    done = true;
+    compact_thread.join();
+  }
+  fs.umount();
+
+  ASSERT_EQ(0, fs.mount());
+  for (int i=0; i<NUM_WRITERS; i++) {
+    string dir = "dir." + to_string(i);
+    for (int j=0; j<num_files; j++) {
+      uint64_t fsize = 0;
+      utime_t mtime;
+      ASSERT_EQ(0, fs.stat(dir, "file." + to_string(j), &fsize, &mtime));
+      ASSERT_EQ(4096u, fsize);
+    }
+  }
+  fs.umount();
+  rm_temp_bdev(fn);
+}
+
+TEST(BlueFS, test_level_placement) {
+  uint64_t size = 1048576 * 128;
+  string fn_db = get_temp_bdev(size);
+  string fn_slow = get_temp_bdev(size);
+  g_ceph_context->_conf->set_val("bluefs_placement_slow_level", "2");
+  // keep the background pass out of the way; we drive it by hand
+  g_ceph_context->_conf->set_val("bluefs_placement_interval", "1000");
+  g_ceph_context->_conf->apply_changes(NULL);
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, fn_db));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_SLOW, fn_slow));
+  fs.add_block_extent(BlueFS::BDEV_SLOW, 0, size);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid));
+  ASSERT_EQ(0, fs.mount());
+
+  const uint64_t len = 1048576;
+  bufferlist data;
+  data.push_back(buffer::claim_char(len, gen_buffer(len)));
+  ASSERT_EQ(0, fs.mkdir("db"));
+  for (auto name : { "hot.sst", "cold.sst" }) {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write("db", name, &h, false));
+    h->append(data.c_str(), data.length());
+    ASSERT_EQ(0, fs.fsync(h));
+    fs.close_writer(h);
+  }
+  fs.set_file_level("db", "hot.sst", 1);
+  fs.set_file_level("db", "cold.sst", 3);
+
+  // a reader opened before the move keeps working after it
+  BlueFS::FileReader *reader;
+  ASSERT_EQ(0, fs.open_for_read("db", "cold.sst", &reader));
+
+  ASSERT_EQ(len, fs.migrate_files(1ull << 30));
+  ASSERT_EQ(0u, fs.migrate_files(1ull << 30));
+
+  map<int,vector<uint64_t>> usage;
+  fs.get_level_usage(&usage);
+  ASSERT_EQ(len, usage[3][BlueFS::BDEV_SLOW]);
+  ASSERT_EQ(0u, usage[3][BlueFS::BDEV_DB]);
+  ASSERT_EQ(0u, usage[1][BlueFS::BDEV_SLOW]);
+  ASSERT_EQ(len, usage[1][BlueFS::BDEV_DB]);
+
+  {
+    bufferlist bl;
+    BlueFS::FileReaderBuffer buf(len);
+    ASSERT_EQ((int)len, fs.read(reader, &buf, 0, len, &bl, NULL));
+    ASSERT_TRUE(bl.contents_equal(data));
+    delete reader;
+  }
+
+  // the new location survives a remount
+  fs.umount();
+  ASSERT_EQ(0, fs.mount());
+  {
+    BlueFS::FileReader *h;
+    ASSERT_EQ(0, fs.open_for_read("db", "cold.sst", &h));
+    bufferlist bl;
+    BlueFS::FileReaderBuffer buf(len);
+    ASSERT_EQ((int)len, fs.read(h, &buf, 0, len, &bl, NULL));
+    ASSERT_TRUE(bl.contents_equal(data));
+    delete h;
+  }
+  fs.umount();
+
+  g_ceph_context->_conf->set_val("bluefs_placement_slow_level", "0");
+  g_ceph_context->_conf->set_val("bluefs_placement_interval", "5");
+  g_ceph_context->_conf->apply_changes(NULL);
+  rm_temp_bdev(fn_db);
+  rm_temp_bdev(fn_slow);
+}
+
 TEST(BlueFS, test_replay) {
   uint64_t size = 1048576 * 128;
   string fn = get_temp_bdev(size);
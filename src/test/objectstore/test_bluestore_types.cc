@@ -332,6 +332,120 @@ TEST(bluestore_blob_t, csum_bench)
   }
 }
 
+template<class Alg>
+static void check_checksummer_multi(const bufferlist& bl, size_t csum_block_size)
+{
+  typedef typename Alg::value_t value_t;
+  size_t blocks = bl.length() / csum_block_size;
+  size_t length = blocks * csum_block_size;
+
+  // reference: one Alg::calc per block
+  bufferptr expected(blocks * sizeof(value_t));
+  {
+    typename Alg::state_t state;
+    Alg::init(&state);
+    bufferlist::const_iterator p = bl.begin();
+    value_t *pv = reinterpret_cast<value_t*>(expected.c_str());
+    for (size_t i = 0; i < blocks; ++i) {
+      pv[i] = Alg::calc(state, -1, csum_block_size, p);
+    }
+    Alg::fini(&state);
+  }
+
+  bufferptr csum(blocks * sizeof(value_t));
+  Checksummer::calculate<Alg>(csum_block_size, 0, length, bl, &csum);
+  ASSERT_EQ(0, memcmp(expected.c_str(), csum.c_str(), csum.length()));
+  ASSERT_EQ(-1, Checksummer::verify<Alg>(csum_block_size, 0, length, bl, csum));
+
+  // a bad csum deep into the run is still reported at the right offset
+  size_t bad = blocks * 2 / 3;
+  value_t *pv = reinterpret_cast<value_t*>(csum.c_str());
+  value_t good = pv[bad];
+  pv[bad] = ~(uint64_t)good;
+  uint64_t bad_csum = 0;
+  ASSERT_EQ((int)(bad * csum_block_size),
+	    Checksummer::verify<Alg>(csum_block_size, 0, length, bl, csum,
+				     &bad_csum));
+  ASSERT_EQ((uint64_t)good, bad_csum);
+}
+
+TEST(Checksummer, multi)
+{
+  // a mix of block aligned and misaligned segments, so that runs of
+  // contiguous blocks alternate with blocks straddling segments.
+  bufferlist bl;
+  unsigned sizes[] = { 4096 * 70, 100, 4096 * 3 - 100, 4096 * 2 + 17,
+		       4096 * 5 - 17, 1, 4095, 4096 * 9 };
+  for (unsigned s : sizes) {
+    bufferptr bp(s);
+    for (unsigned i = 0; i < s; ++i) {
+      bp.c_str()[i] = rand();
+    }
+    bl.append(bp);
+  }
+  ASSERT_EQ(0u, bl.length() % 4096);
+
+  for (size_t csum_block_size : {4096u, 512u, 8u}) {
+    check_checksummer_multi<Checksummer::crc32c>(bl, csum_block_size);
+    check_checksummer_multi<Checksummer::crc32c_16>(bl, csum_block_size);
+    check_checksummer_multi<Checksummer::crc32c_8>(bl, csum_block_size);
+    check_checksummer_multi<Checksummer::xxhash32>(bl, csum_block_size);
+    check_checksummer_multi<Checksummer::xxhash64>(bl, csum_block_size);
+  }
+}
+
+template<class Alg>
+static void bench_checksummer_multi(const bufferlist& bl, size_t csum_block_size,
+				    int count)
+{
+  size_t blocks = bl.length() / csum_block_size;
+  bufferptr csum(blocks * sizeof(typename Alg::value_t));
+  typename Alg::value_t *pv =
+    reinterpret_cast<typename Alg::value_t*>(csum.c_str());
+
+  ceph::mono_clock::time_point start = ceph::mono_clock::now();
+  for (int i = 0; i < count; ++i) {
+    typename Alg::state_t state;
+    Alg::init(&state);
+    bufferlist::const_iterator p = bl.begin();
+    for (size_t b = 0; b < blocks; ++b) {
+      pv[b] = Alg::calc(state, -1, csum_block_size, p);
+    }
+    Alg::fini(&state);
+  }
+  ceph::mono_clock::time_point mid = ceph::mono_clock::now();
+  for (int i = 0; i < count; ++i) {
+    Checksummer::calculate<Alg>(csum_block_size, 0, bl.length(), bl, &csum);
+  }
+  ceph::mono_clock::time_point end = ceph::mono_clock::now();
+
+  double bytes = (double)count * (double)bl.length();
+  auto per_block = std::chrono::duration_cast<std::chrono::nanoseconds>(mid - start);
+  auto multi = std::chrono::duration_cast<std::chrono::nanoseconds>(end - mid);
+  cout << "  block " << csum_block_size
+       << ": per block " << bytes / 1000.0 / (double)per_block.count() * 1000000.0
+       << " MB/sec, multi " << bytes / 1000.0 / (double)multi.count() * 1000000.0
+       << " MB/sec" << std::endl;
+}
+
+TEST(Checksummer, multi_bench)
+{
+  bufferlist bl;
+  bufferptr bp(4194304);
+  for (char *a = bp.c_str(); a < bp.c_str() + bp.length(); ++a)
+    *a = (unsigned long)a & 0xff;
+  bl.append(bp);
+  int count = 64;
+  for (size_t csum_block_size : {512u, 4096u, 65536u}) {
+    cout << "crc32c" << std::endl;
+    bench_checksummer_multi<Checksummer::crc32c>(bl, csum_block_size, count);
+    cout << "xxhash32" << std::endl;
+    bench_checksummer_multi<Checksummer::xxhash32>(bl, csum_block_size, count);
+    cout << "xxhash64" << std::endl;
+    bench_checksummer_multi<Checksummer::xxhash64>(bl, csum_block_size, count);
+  }
+}
+
 TEST(Blob, put_ref)
 {
   {
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <iostream>
+#include <thread>
 #include <time.h>
 #include <sys/mount.h>
 #include "kv/KeyValueDB.h"
@@ -312,6 +313,121 @@ TEST_P(KVTest, RMRange) {
   fini();
 }
 
+TEST_P(KVTest, IteratorSnapshot) {
+  ASSERT_EQ(0, db->create_and_open(cout));
+  bufferlist value;
+  value.append("old");
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->set("prefix", "key1", value);
+    t->set("prefix", "key2", value);
+    t->set("prefix", "key3", value);
+    db->submit_transaction_sync(t);
+  }
+  KeyValueDB::Iterator it = db->get_iterator("prefix");
+  {
+    bufferlist nv;
+    nv.append("new");
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->set("prefix", "key1", nv);
+    t->rmkey("prefix", "key2");
+    t->set("prefix", "key4", nv);
+    db->submit_transaction_sync(t);
+  }
+  // the iterator sees the db as it was when it was created
+  it->seek_to_first();
+  for (auto k : { "key1", "key2", "key3" }) {
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ(k, it->key());
+    ASSERT_EQ("old", _bl_to_str(it->value()));
+    it->next();
+  }
+  ASSERT_FALSE(it->valid());
+  it.reset();
+
+  it = db->get_iterator("prefix");
+  it->seek_to_first();
+  for (auto k : { "key1", "key3", "key4" }) {
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ(k, it->key());
+    it->next();
+  }
+  ASSERT_FALSE(it->valid());
+  it->seek_to_last();
+  ASSERT_TRUE(it->valid());
+  ASSERT_EQ("key4", it->key());
+  it->prev();
+  ASSERT_TRUE(it->valid());
+  ASSERT_EQ("key3", it->key());
+  it.reset();
+  fini();
+}
+
+TEST_P(KVTest, BenchConcurrentReaders) {
+  const int keys = 10000;
+  const int readers = 4;
+  const int reads = 50000;
+  ASSERT_EQ(0, db->create_and_open(cout));
+  bufferlist data;
+  bufferptr bp(256);
+  bp.zero();
+  data.append(bp);
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (int i = 0; i < keys; ++i) {
+      t->set("prefix", "key" + stringify(i), data);
+    }
+    db->submit_transaction_sync(t);
+  }
+
+  // one writer, as the bluestore kv thread would be, against a few
+  // threads doing point reads and short scans
+  std::atomic<bool> stop = { false };
+  std::atomic<uint64_t> writes = { 0 };
+  std::thread writer([&]() {
+    unsigned i = 0;
+    while (!stop) {
+      KeyValueDB::Transaction t = db->get_transaction();
+      for (int j = 0; j < 16; ++j, ++i) {
+	t->set("prefix", "key" + stringify(i % keys), data);
+      }
+      db->submit_transaction(t);
+      ++writes;
+    }
+  });
+  utime_t start = ceph_clock_now();
+  std::vector<std::thread> threads;
+  for (int r = 0; r < readers; ++r) {
+    threads.emplace_back([&, r]() {
+      unsigned seed = r;
+      for (int i = 0; i < reads; ++i) {
+	string k = "key" + stringify(rand_r(&seed) % keys);
+	if (i % 16) {
+	  bufferlist v;
+	  ASSERT_EQ(0, db->get("prefix", k, &v));
+	} else {
+	  KeyValueDB::Iterator it = db->get_iterator("prefix");
+	  it->lower_bound(k);
+	  for (int j = 0; j < 16 && it->valid(); ++j) {
+	    it->next();
+	  }
+	}
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  utime_t dur = ceph_clock_now() - start;
+  uint64_t w = writes;
+  stop = true;
+  writer.join();
+  cout << GetParam() << ": " << readers << " readers did " << readers * reads
+       << " reads in " << dur << " (" << (readers * reads / (double)dur)
+       << "/s) alongside " << w << " write transactions" << std::endl;
+  fini();
+}
+
 TEST_P(KVTest, RocksDBColumnFamilyTest) {
   if(string(GetParam()) != "rocksdb")
     return;
@@ -467,6 +583,201 @@ TEST_P(KVTest, RocksDBCFMerge) {
   fini();
 }
 
+TEST_P(KVTest, RocksDBWholeSpaceIteratorTest) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+
+  std::vector<KeyValueDB::ColumnFamily> cfs;
+  cfs.push_back(KeyValueDB::ColumnFamily("b", ""));
+  cfs.push_back(KeyValueDB::ColumnFamily("d", ""));
+  ASSERT_EQ(0, db->init(g_conf->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->create_and_open(cout, cfs));
+  // prefixes a, c, e stay in the default CF, b and d get their own
+  vector<pair<string,string>> expected;
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (auto prefix : { "a", "b", "c", "d", "e" }) {
+      for (auto key : { "k1", "k2" }) {
+	bufferlist bl;
+	bl.append(string(prefix) + key);
+	t->set(prefix, key, bl);
+	expected.push_back(make_pair(string(prefix), string(key)));
+      }
+    }
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  {
+    cout << "forward" << std::endl;
+    KeyValueDB::WholeSpaceIterator iter = db->get_wholespace_iterator();
+    iter->seek_to_first();
+    for (auto& e : expected) {
+      ASSERT_TRUE(iter->valid());
+      ASSERT_EQ(e, iter->raw_key());
+      ASSERT_TRUE(iter->raw_key_is_prefixed(e.first));
+      ASSERT_EQ(e.first + e.second, _bl_to_str(iter->value()));
+      iter->next();
+    }
+    ASSERT_FALSE(iter->valid());
+  }
+  {
+    cout << "backward" << std::endl;
+    KeyValueDB::WholeSpaceIterator iter = db->get_wholespace_iterator();
+    iter->seek_to_last();
+    for (auto e = expected.rbegin(); e != expected.rend(); ++e) {
+      ASSERT_TRUE(iter->valid());
+      ASSERT_EQ(*e, iter->raw_key());
+      iter->prev();
+    }
+    ASSERT_FALSE(iter->valid());
+  }
+  {
+    cout << "seeks and direction changes" << std::endl;
+    KeyValueDB::WholeSpaceIterator iter = db->get_wholespace_iterator();
+    iter->lower_bound("c", "k2");
+    ASSERT_EQ(make_pair(string("c"), string("k2")), iter->raw_key());
+    iter->next();
+    ASSERT_EQ(make_pair(string("d"), string("k1")), iter->raw_key());
+    iter->prev();
+    ASSERT_EQ(make_pair(string("c"), string("k2")), iter->raw_key());
+    iter->prev();
+    iter->prev();
+    ASSERT_EQ(make_pair(string("b"), string("k2")), iter->raw_key());
+    iter->next();
+    ASSERT_EQ(make_pair(string("c"), string("k1")), iter->raw_key());
+    iter->upper_bound("d", "k2");
+    ASSERT_EQ(make_pair(string("e"), string("k1")), iter->raw_key());
+    iter->seek_to_last("b");
+    ASSERT_EQ(make_pair(string("b"), string("k2")), iter->raw_key());
+    iter->seek_to_first("d");
+    ASSERT_EQ(make_pair(string("d"), string("k1")), iter->raw_key());
+  }
+  fini();
+}
+
+TEST_P(KVTest, RocksDBMigrateColumnFamilies) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+
+  ASSERT_EQ(0, db->init(g_conf->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->create_and_open(cout));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (unsigned i = 0; i < 1000; ++i) {
+      bufferlist bl;
+      bl.append(stringify(i));
+      t->set("O", stringify(i), bl);
+      t->set("M", stringify(i), bl);
+      t->set("S", stringify(i), bl);
+    }
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  auto check = [&]() {
+    for (auto prefix : { "O", "M", "S" }) {
+      KeyValueDB::Iterator iter = db->get_iterator(prefix);
+      unsigned n = 0;
+      for (iter->seek_to_first(); iter->valid(); iter->next()) {
+	ASSERT_EQ(iter->key(), _bl_to_str(iter->value()));
+	++n;
+      }
+      ASSERT_EQ(1000u, n);
+      bufferlist bl;
+      ASSERT_EQ(0, db->get(prefix, "42", &bl));
+      ASSERT_EQ("42", _bl_to_str(bl));
+    }
+  };
+
+  std::vector<KeyValueDB::ColumnFamily> cfs;
+  cfs.push_back(KeyValueDB::ColumnFamily("O", ""));
+  cfs.push_back(KeyValueDB::ColumnFamily("M", ""));
+  cout << "moving O and M into their own column families" << std::endl;
+  ASSERT_EQ(0, db->migrate_column_families(cout, cfs));
+  ASSERT_TRUE(db->is_column_family("O"));
+  ASSERT_TRUE(db->is_column_family("M"));
+  check();
+
+  cout << "reopen" << std::endl;
+  fini();
+  init();
+  ASSERT_EQ(0, db->init(g_conf->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->open(cout, cfs));
+  ASSERT_TRUE(db->is_column_family("O"));
+  check();
+
+  cout << "merging M back into the default column family" << std::endl;
+  cfs.pop_back();
+  ASSERT_EQ(0, db->migrate_column_families(cout, cfs));
+  ASSERT_TRUE(db->is_column_family("O"));
+  ASSERT_FALSE(db->is_column_family("M"));
+  check();
+  fini();
+}
+
+TEST_P(KVTest, RocksDBMigrateColumnFamiliesInterrupted) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+
+  ASSERT_EQ(0, db->init(g_conf->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->create_and_open(cout));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (unsigned i = 0; i < 1000; ++i) {
+      bufferlist bl;
+      bl.append(stringify(i));
+      t->set("O", stringify(i), bl);
+      t->set("M", stringify(i), bl);
+    }
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  auto check = [&]() {
+    for (auto prefix : { "O", "M" }) {
+      KeyValueDB::Iterator iter = db->get_iterator(prefix);
+      unsigned n = 0;
+      for (iter->seek_to_first(); iter->valid(); iter->next()) {
+	ASSERT_EQ(iter->key(), _bl_to_str(iter->value()));
+	++n;
+      }
+      ASSERT_EQ(1000u, n);
+    }
+  };
+
+  // stop halfway through O: the O column family exists but most of its
+  // keys are still in the default key space
+  std::vector<KeyValueDB::ColumnFamily> cfs;
+  cfs.push_back(KeyValueDB::ColumnFamily("O", ""));
+  cfs.push_back(KeyValueDB::ColumnFamily("M", ""));
+  g_conf->set_val("rocksdb_debug_cf_migration_stop_after", "500");
+  g_conf->apply_changes(NULL);
+  ASSERT_EQ(-EINTR, db->migrate_column_families(cout, cfs));
+  ASSERT_TRUE(db->is_column_family("O"));
+  g_conf->set_val("rocksdb_debug_cf_migration_stop_after", "0");
+  g_conf->apply_changes(NULL);
+
+  // a normal open finishes the migration before anything reads
+  cout << "reopen" << std::endl;
+  fini();
+  init();
+  ASSERT_EQ(0, db->init(g_conf->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->open(cout));
+  ASSERT_TRUE(db->is_column_family("O"));
+  ASSERT_TRUE(db->is_column_family("M"));
+  check();
+
+  // and it is done: nothing left to resume on the next open
+  fini();
+  init();
+  ASSERT_EQ(0, db->init(g_conf->bluestore_rocksdb_options));
+  ASSERT_EQ(0, db->open(cout, cfs));
+  check();
+  {
+    KeyValueDB::WholeSpaceIterator iter = db->get_wholespace_iterator();
+    for (iter->seek_to_first(); iter->valid(); iter->next()) {
+      string prefix = iter->raw_key().first;
+      ASSERT_TRUE(prefix == "O" || prefix == "M");
+    }
+  }
+  fini();
+}
+
 INSTANTIATE_TEST_CASE_P(
   KeyValueDB,
   KVTest,
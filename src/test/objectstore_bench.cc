@@ -9,6 +9,9 @@
 #include <thread>
 
 #include "os/ObjectStore.h"
+#if defined(WITH_BLUESTORE)
+#include "os/bluestore/BlueStore.h"
+#endif
 
 #include "global/global_init.h"
 
@@ -30,7 +33,12 @@ static void usage()
       "	 --threads\n"
       "	       number of threads to carry out this workload\n"
       "	 --multi-object\n"
-      "	       have each thread write to a separate object\n" << dendl;
+      "	       have each thread write to a separate object\n"
+      "	 --remounts\n"
+      "	       number of umount/mount cycles to time after writing\n"
+      "	 --create-objects\n"
+      "	       instead of writing, have each thread create this many\n"
+      "	       objects of one block each and report the creation rate\n" << dendl;
   generic_server_usage();
 }
 
@@ -74,10 +82,12 @@ struct Config {
   int repeats;
   int threads;
   bool multi_object;
+  int remounts;
+  int create_objects;
   Config()
     : size(1048576), block_size(4096),
       repeats(1), threads(1),
-      multi_object(false) {}
+      multi_object(false), remounts(0), create_objects(0) {}
 };
 
 class C_NotifyCond : public Context {
@@ -147,6 +157,44 @@ void osbench_worker(ObjectStore *os, const Config &cfg,
   sequencer.flush();
 }
 
+ghobject_t osbench_create_oid(int thread, int i)
+{
+  std::stringstream oss;
+  oss << "osbench-create-" << thread << "-" << i;
+  return ghobject_t(hobject_t(sobject_t(oss.str(), CEPH_NOSNAP)));
+}
+
+void osbench_create_worker(ObjectStore *os, const Config &cfg,
+                           const coll_t cid, int thread)
+{
+  bufferlist data;
+  data.append(buffer::create(cfg.block_size));
+
+  ObjectStore::Sequencer sequencer("osbench");
+
+  vector<ObjectStore::Transaction> tls;
+  tls.reserve(cfg.create_objects);
+  for (int i = 0; i < cfg.create_objects; ++i) {
+    // one transaction per object, as the osd would submit them
+    ObjectStore::Transaction t;
+    t.write(cid, osbench_create_oid(thread, i), 0, cfg.block_size, data);
+    tls.push_back(std::move(t));
+  }
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool done = false;
+
+  os->queue_transactions(&sequencer, tls, nullptr,
+                         new C_NotifyCond(&mutex, &cond, &done));
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [&done](){ return done; });
+  lock.unlock();
+
+  sequencer.flush();
+}
+
 int main(int argc, const char *argv[])
 {
   Config cfg;
@@ -183,6 +231,10 @@ int main(int argc, const char *argv[])
       cfg.threads = atoi(val.c_str());
     } else if (ceph_argparse_flag(args, i, "--multi-object", (char*)nullptr)) {
       cfg.multi_object = true;
+    } else if (ceph_argparse_witharg(args, i, &val, "--remounts", (char*)nullptr)) {
+      cfg.remounts = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--create-objects", (char*)nullptr)) {
+      cfg.create_objects = atoi(val.c_str());
     } else {
       derr << "Error: can't understand argument: " << *i << "\n" << dendl;
       usage();
@@ -199,6 +251,8 @@ int main(int argc, const char *argv[])
   dout(0) << "block-size " << cfg.block_size << dendl;
   dout(0) << "repeats " << cfg.repeats << dendl;
   dout(0) << "threads " << cfg.threads << dendl;
+  dout(0) << "remounts " << cfg.remounts << dendl;
+  dout(0) << "create-objects " << cfg.create_objects << dendl;
 
   auto os = std::unique_ptr<ObjectStore>(
       ObjectStore::create(g_ceph_context,
@@ -264,6 +318,53 @@ int main(int argc, const char *argv[])
     os->apply_transaction(&osr, std::move(t));
   }
 
+  if (cfg.create_objects > 0) {
+#if defined(WITH_BLUESTORE)
+    uint64_t skipped = 0;
+    const PerfCounters *logger = nullptr;
+    if (g_conf->osd_objectstore == "bluestore") {
+      logger = os->get_perf_counters();
+      skipped = logger->get(l_bluestore_onode_filter_skipped);
+    }
+#endif
+    std::vector<std::thread> workers;
+    workers.reserve(cfg.threads);
+
+    using namespace std::chrono;
+    auto t1 = high_resolution_clock::now();
+    for (int i = 0; i < cfg.threads; i++) {
+      workers.emplace_back(osbench_create_worker, os.get(), std::ref(cfg),
+                           cid, i);
+    }
+    for (auto &worker : workers)
+      worker.join();
+    auto t2 = high_resolution_clock::now();
+
+    auto duration = duration_cast<microseconds>(t2 - t1);
+    uint64_t total = (uint64_t)cfg.create_objects * cfg.threads;
+    dout(0) << "Created " << total << " objects of " << cfg.block_size
+        << " in " << duration.count() << "us, at a rate of "
+        << (1000000LL * total) / duration.count() << " objects/s" << dendl;
+#if defined(WITH_BLUESTORE)
+    if (logger) {
+      dout(0) << "Skipped " << logger->get(l_bluestore_onode_filter_skipped) -
+          skipped << " onode lookups" << dendl;
+    }
+#endif
+
+    ObjectStore::Sequencer osr(__func__);
+    for (int i = 0; i < cfg.threads; i++) {
+      for (int j = 0; j < cfg.create_objects; j += 1000) {
+        ObjectStore::Transaction t;
+        for (int k = j; k < std::min(j + 1000, cfg.create_objects); k++)
+          t.remove(cid, osbench_create_oid(i, k));
+        os->apply_transaction(&osr, std::move(t));
+      }
+    }
+    os->umount();
+    return 0;
+  }
+
   // create the objects
   std::vector<ghobject_t> oids;
   if (cfg.multi_object) {
@@ -289,6 +390,17 @@ int main(int argc, const char *argv[])
     assert(r == 0);
   }
 
+#if defined(WITH_BLUESTORE)
+  // snapshot the deferred write counters so setup io is not counted
+  uint64_t deferred_ops = 0, deferred_bytes = 0;
+  const PerfCounters *logger = nullptr;
+  if (g_conf->osd_objectstore == "bluestore") {
+    logger = os->get_perf_counters();
+    deferred_ops = logger->get(l_bluestore_deferred_write_ops);
+    deferred_bytes = logger->get(l_bluestore_deferred_write_bytes);
+  }
+#endif
+
   // run the worker threads
   std::vector<std::thread> workers;
   workers.reserve(cfg.threads);
@@ -313,6 +425,46 @@ int main(int argc, const char *argv[])
       << duration.count() << "us, at a rate of " << rate << "/s and "
       << iops << " iops" << dendl;
 
+#if defined(WITH_BLUESTORE)
+  if (logger) {
+    // flush deferred writes so they are all accounted for
+    os->umount();
+    if (os->mount() < 0) {
+      derr << "remount failed" << dendl;
+      return 1;
+    }
+    logger = os->get_perf_counters();
+    deferred_ops = logger->get(l_bluestore_deferred_write_ops) - deferred_ops;
+    deferred_bytes =
+      logger->get(l_bluestore_deferred_write_bytes) - deferred_bytes;
+    uint64_t client_ops = total / cfg.block_size;
+    dout(0) << "Deferred " << deferred_ops << " device writes ("
+        << (double)deferred_ops / client_ops << " per client op), "
+        << byte_units(deferred_bytes) << " ("
+        << (double)deferred_bytes / total << "x client bytes)" << dendl;
+  }
+#endif
+
+  // time umount/mount cycles, e.g. to measure allocator startup cost
+  if (cfg.remounts > 0) {
+    microseconds umount_total(0), mount_total(0);
+    for (int i = 0; i < cfg.remounts; i++) {
+      auto t3 = high_resolution_clock::now();
+      os->umount();
+      auto t4 = high_resolution_clock::now();
+      if (os->mount() < 0) {
+        derr << "remount failed" << dendl;
+        return 1;
+      }
+      auto t5 = high_resolution_clock::now();
+      umount_total += duration_cast<microseconds>(t4 - t3);
+      mount_total += duration_cast<microseconds>(t5 - t4);
+    }
+    dout(0) << "Remounted " << cfg.remounts << " times, average umount "
+        << umount_total.count() / cfg.remounts << "us, mount "
+        << mount_total.count() / cfg.remounts << "us" << dendl;
+  }
+
   // remove the objects
   ObjectStore::Sequencer osr(__func__);
   ObjectStore::Transaction t;
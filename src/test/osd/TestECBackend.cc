@@ -56,5 +56,15 @@ TEST(ECUtil, stripe_info_t)
 
   ASSERT_EQ(s.offset_len_to_stripe_bounds(make_pair(swidth-10, (uint64_t)20)),
             make_pair((uint64_t)0, 2*swidth));
+
+  const uint64_t csize = s.get_chunk_size();
+  ASSERT_EQ(s.logical_offset_to_chunk_index(0), 0u);
+  ASSERT_EQ(s.logical_offset_to_chunk_index(swidth + 2*csize + 1), 2u);
+  ASSERT_TRUE(s.offset_len_within_chunk(make_pair(csize + 10, csize - 10)));
+  ASSERT_FALSE(s.offset_len_within_chunk(make_pair(csize + 10, csize)));
+  ASSERT_FALSE(s.offset_len_within_chunk(make_pair(csize, (uint64_t)0)));
+  ASSERT_EQ(s.offset_len_to_chunk_extent(
+	      make_pair(2*swidth + 3*csize + 10, (uint64_t)20)),
+	    make_pair(2*csize + 10, (uint64_t)20));
 }
 
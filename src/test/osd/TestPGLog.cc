@@ -2253,7 +2253,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(modify);
 
   EXPECT_TRUE(log.logged_object(oid));
-  pg_log_entry_t *entry = log.objects[oid];
+  pg_log_entry_t *entry = log.objects.find(oid)->second;
   EXPECT_EQ(modify.op, entry->op);
   EXPECT_EQ(modify.version, entry->version);
   EXPECT_EQ(modify.prior_version, entry->prior_version);
@@ -2267,7 +2267,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
   log.add(del);
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid)->second;
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2280,7 +2280,7 @@ TEST_F(PGLogTest, ErrorNotIndexedByObject) {
 		   utime_t(20,1), -ENOENT));
 
   EXPECT_TRUE(log.logged_object(oid));
-  entry = log.objects[oid];
+  entry = log.objects.find(oid)->second;
   EXPECT_EQ(del.op, entry->op);
   EXPECT_EQ(del.version, entry->version);
   EXPECT_EQ(del.prior_version, entry->prior_version);
@@ -2933,6 +2933,161 @@ TEST_F(PGLogTrimTest, TestGetRequest) {
   EXPECT_FALSE(result);
 }
 
+TEST_F(PGLogTrimTest, TestObjectIndex) {
+  SetUp(1, 2, 20);
+  PGLog::IndexedLog log;
+  log.head = mk_evt(20, 0);
+  log.skip_can_rollback_to_to_head();
+  log.head = mk_evt(9, 0);
+
+  log.add(mk_ple_mod(mk_obj(1), mk_evt(10, 100), mk_evt(8, 70)));
+  log.add(mk_ple_mod(mk_obj(2), mk_evt(15, 150), mk_evt(10, 100)));
+  log.index();
+  log.add(mk_ple_mod(mk_obj(1), mk_evt(20, 160), mk_evt(10, 100)));
+
+  // the index refers to the latest entry of each object, key included
+  for (auto &&i : log.objects) {
+    EXPECT_EQ(&i.second->soid, i.first.soid);
+  }
+  auto p = log.objects.find(mk_obj(1));
+  ASSERT_NE(log.objects.end(), p);
+  EXPECT_EQ(mk_evt(20, 160), p->second->version);
+
+  eversion_t write_from_dups = eversion_t::max();
+  log.trim(cct, mk_evt(15, 150), nullptr, nullptr, &write_from_dups);
+
+  EXPECT_EQ(1u, log.objects.size());
+  EXPECT_FALSE(log.logged_object(mk_obj(2)));
+  p = log.objects.find(mk_obj(1));
+  ASSERT_NE(log.objects.end(), p);
+  EXPECT_EQ(&log.log.back(), p->second);
+  EXPECT_EQ(&log.log.back().soid, p->first.soid);
+}
+
+TEST_F(PGLogTrimTest, TestIndexMemory) {
+  SetUp(1, 2, 20);
+  const unsigned num_objects = 1000;
+  PGLog::IndexedLog log;
+  log.head = mk_evt(9, 0);
+  log.skip_can_rollback_to_to_head();
+
+  entity_name_t client = entity_name_t::CLIENT(777);
+  for (unsigned i = 1; i <= num_objects; ++i) {
+    hobject_t hoid = mk_obj(i);
+    hoid.oid.name = "rbd_data.1234567890ab." + std::to_string(i);
+    log.add(mk_ple_mod(hoid, mk_evt(10, 100 + i), mk_evt(8, 0),
+		       osd_reqid_t(client, 8, i)));
+  }
+
+  // indexes are accounted in the pglog mempool, and the objects
+  // index doesn't hold a copy of every object name
+  size_t before = mempool::osd_pglog::allocated_bytes();
+  log.index(PGLOG_INDEXED_OBJECTS);
+  size_t objects_bytes = mempool::osd_pglog::allocated_bytes() - before;
+  EXPECT_EQ(num_objects, log.objects.size());
+  EXPECT_LT(0u, objects_bytes);
+  EXPECT_LT(objects_bytes / num_objects, sizeof(hobject_t));
+
+  before = mempool::osd_pglog::allocated_bytes();
+  log.index(PGLOG_INDEXED_CALLER_OPS);
+  EXPECT_EQ(num_objects, log.caller_ops.size());
+  EXPECT_LT(before, mempool::osd_pglog::allocated_bytes());
+}
+
+// bytes a string keeps on the heap, beyond its own footprint
+static size_t heap_bytes(const string &s)
+{
+  const char *p = s.data();
+  if (p >= (const char *)&s && p < (const char *)(&s + 1))
+    return 0;  // short string, stored inline
+  return s.capacity() + 1;
+}
+
+static size_t heap_bytes(const hobject_t &h)
+{
+  return heap_bytes(h.oid.name) + heap_bytes(h.get_key()) +
+    heap_bytes(h.nspace);
+}
+
+// Memory of the in-memory pg logs of an OSD per log entry, with the
+// objects index keyed by a copy of each object name as it used to be
+// and by a pointer into the entry as it is now.  Every entry is for a
+// different object, the worst case for that index.
+// Run with --gtest_also_run_disabled_tests.
+TEST_F(PGLogTrimTest, DISABLED_IndexMemoryBenchmark) {
+  SetUp(1, 2, 20);
+  const unsigned num_pgs = 300;
+  const unsigned num_entries = 3000;
+  entity_name_t client = entity_name_t::CLIENT(777);
+
+  size_t start = mempool::osd_pglog::allocated_bytes();
+  size_t name_bytes = 0;
+  vector<PGLog::IndexedLog> logs(num_pgs);
+  for (unsigned pg = 0; pg < num_pgs; ++pg) {
+    PGLog::IndexedLog &log = logs[pg];
+    log.head = mk_evt(9, 0);
+    log.skip_can_rollback_to_to_head();
+    for (unsigned i = 0; i < num_entries; ++i) {
+      unsigned id = pg * num_entries + i;
+      char name[64];
+      snprintf(name, sizeof(name), "rbd_data.1234567890ab.%016x", id);
+      hobject_t hoid = mk_obj(id);
+      hoid.oid.name = name;
+      log.add(mk_ple_mod(hoid, mk_evt(10, i + 1), mk_evt(8, 0),
+			 osd_reqid_t(client, 8, id)));
+      name_bytes += heap_bytes(log.log.back().soid);
+    }
+  }
+  size_t entry_bytes = mempool::osd_pglog::allocated_bytes() - start +
+    name_bytes;
+
+  size_t before_bytes;
+  {
+    typedef mempool::osd_pglog::unordered_map<
+      hobject_t, pg_log_entry_t*> old_object_index_t;
+    start = mempool::osd_pglog::allocated_bytes();
+    size_t key_bytes = 0;
+    vector<old_object_index_t> old(num_pgs);
+    for (unsigned pg = 0; pg < num_pgs; ++pg) {
+      for (auto &&e : logs[pg].log) {
+	old[pg][e.soid] = &e;
+      }
+      for (auto &&i : old[pg]) {
+	key_bytes += heap_bytes(i.first);
+      }
+    }
+    before_bytes = mempool::osd_pglog::allocated_bytes() - start + key_bytes;
+  }
+
+  start = mempool::osd_pglog::allocated_bytes();
+  for (auto &&log : logs) {
+    log.index(PGLOG_INDEXED_OBJECTS);
+  }
+  size_t after_bytes = mempool::osd_pglog::allocated_bytes() - start;
+
+  start = mempool::osd_pglog::allocated_bytes();
+  for (auto &&log : logs) {
+    log.index(PGLOG_INDEXED_CALLER_OPS);
+  }
+  size_t caller_bytes = mempool::osd_pglog::allocated_bytes() - start;
+
+  const double n = num_pgs * num_entries;
+  const double mb = 1024 * 1024;
+  cout << num_pgs << " pgs x " << num_entries << " entries, bytes/entry:"
+       << std::endl
+       << "  entries        " << entry_bytes / n << std::endl
+       << "  caller_ops     " << caller_bytes / n << std::endl
+       << "  objects before " << before_bytes / n << std::endl
+       << "  objects after  " << after_bytes / n << std::endl
+       << "  total before   " << (entry_bytes + caller_bytes + before_bytes) / n
+       << " (" << (entry_bytes + caller_bytes + before_bytes) / mb << " MB)"
+       << std::endl
+       << "  total after    " << (entry_bytes + caller_bytes + after_bytes) / n
+       << " (" << (entry_bytes + caller_bytes + after_bytes) / mb << " MB)"
+       << std::endl;
+  EXPECT_LT(after_bytes, before_bytes);
+}
+
 TEST_F(PGLogTest, _merge_object_divergent_entries) {
   {
     // Test for issue 20843
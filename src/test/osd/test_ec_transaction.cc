@@ -15,6 +15,7 @@
 #include <gtest/gtest.h>
 #include "osd/PGTransaction.h"
 #include "osd/ECTransaction.h"
+#include "erasure-code/ErasureCode.h"
 
 #include "test/unit.cc"
 
@@ -122,3 +123,324 @@ TEST(ectransaction, many_writes)
   ASSERT_EQ(0u, plan.to_read.size());
   ASSERT_EQ(1u, plan.will_write.size());
 }
+
+class DeltaErasureCode : public ErasureCode {
+public:
+  bool delta;
+  explicit DeltaErasureCode(bool delta) : delta(delta) {}
+  int create_rule(const string &name,
+		  CrushWrapper &crush,
+		  ostream *ss) const override {
+    return 0;
+  }
+  unsigned int get_chunk_count() const override {
+    return 6;
+  }
+  unsigned int get_data_chunk_count() const override {
+    return 4;
+  }
+  unsigned int get_chunk_size(unsigned int object_size) const override {
+    return object_size / 4;
+  }
+  bool supports_parity_delta() const override {
+    return delta;
+  }
+  // both coding chunks are the xor of the data chunks: a poor code, but
+  // a linear one, which is all a parity delta needs
+  int encode_chunks(const set<int> &want_to_encode,
+		    map<int, bufferlist> *encoded) override {
+    unsigned k = get_data_chunk_count();
+    unsigned blocksize = (*encoded)[0].length();
+    for (unsigned j = k; j < get_chunk_count(); ++j) {
+      char *p = (*encoded)[j].c_str();
+      memset(p, 0, blocksize);
+      for (unsigned i = 0; i < k; ++i) {
+	const char *d = (*encoded)[i].c_str();
+	for (unsigned n = 0; n < blocksize; ++n) {
+	  p[n] ^= d[n];
+	}
+      }
+    }
+    return 0;
+  }
+  int apply_delta(const map<int, bufferptr> &in,
+		  map<int, bufferptr> &out) override {
+    if (!delta)
+      return -ENOTSUP;
+    for (auto &&o : out) {
+      for (auto &&i : in) {
+	for (unsigned n = 0; n < o.second.length(); ++n) {
+	  o.second.c_str()[n] ^= i.second.c_str()[n];
+	}
+      }
+    }
+    return 0;
+  }
+};
+
+ECTransaction::WritePlan parity_delta_plan(
+  ErasureCodeInterfaceRef ecimpl,
+  uint64_t off, uint64_t len)
+{
+  hobject_t h;
+  PGTransactionUPtr t(new PGTransaction);
+  bufferlist a;
+  a.append_zero(len);
+  t->write(h, off, a.length(), a, 0);
+
+  ECUtil::stripe_info_t sinfo(4, 4 * 4096);
+  auto plan = ECTransaction::get_write_plan(
+    sinfo,
+    std::move(t),
+    [&](const hobject_t &i) {
+      ECUtil::HashInfoRef ref(new ECUtil::HashInfo(6));
+      ref->set_projected_total_logical_size(sinfo, 4 * 4 * 4096);
+      return ref;
+    },
+    &dpp);
+  ECTransaction::plan_parity_delta(plan, sinfo, ecimpl, &dpp);
+  generic_derr << "to_read " << plan.to_read << dendl;
+  generic_derr << "parity_delta " << plan.parity_delta << dendl;
+  return plan;
+}
+
+TEST(ectransaction, parity_delta)
+{
+  ErasureCodeInterfaceRef ecimpl(new DeltaErasureCode(true));
+  hobject_t h;
+  {
+    // one data chunk of the second stripe
+    auto plan = parity_delta_plan(ecimpl, 16384 + 4096 + 100, 512);
+    ASSERT_EQ(1u, plan.to_read.size());
+    ASSERT_EQ(1u, plan.parity_delta.size());
+    ASSERT_EQ(set<int>({1}), plan.parity_delta[h]);
+  }
+  {
+    // two data chunks plus two coding chunks are as many as a stripe
+    auto plan = parity_delta_plan(ecimpl, 16384 + 4000, 512);
+    ASSERT_EQ(1u, plan.to_read.size());
+    ASSERT_EQ(0u, plan.parity_delta.size());
+  }
+  {
+    // two stripes
+    auto plan = parity_delta_plan(ecimpl, 16384 - 100, 512);
+    ASSERT_EQ(0u, plan.parity_delta.size());
+  }
+  {
+    // full stripe overwrite does not read
+    auto plan = parity_delta_plan(ecimpl, 16384, 16384);
+    ASSERT_EQ(0u, plan.to_read.size());
+    ASSERT_EQ(0u, plan.parity_delta.size());
+  }
+  {
+    ErasureCodeInterfaceRef nodelta(new DeltaErasureCode(false));
+    auto plan = parity_delta_plan(nodelta, 16384 + 4096 + 100, 512);
+    ASSERT_EQ(1u, plan.to_read.size());
+    ASSERT_EQ(0u, plan.parity_delta.size());
+  }
+}
+
+struct RollbackVisitor : public ObjectModDesc::Visitor {
+  map<string, boost::optional<bufferlist> > attrs;
+  vector<pair<uint64_t, uint64_t> > extents;
+  void setattrs(map<string, boost::optional<bufferlist> > &a) override {
+    attrs = a;
+  }
+  void rollback_extents(
+    version_t gen,
+    const vector<pair<uint64_t, uint64_t> > &e) override {
+    extents.insert(extents.end(), e.begin(), e.end());
+  }
+};
+
+TEST(ectransaction, parity_delta_generate)
+{
+  ErasureCodeInterfaceRef ecimpl(new DeltaErasureCode(true));
+  const unsigned k = 4, m = 2;
+  const uint64_t chunk_size = 4096;
+  const uint64_t stripe_width = k * chunk_size;
+  const unsigned stripes = 4;
+  ECUtil::stripe_info_t sinfo(k, stripe_width);
+  hobject_t h(object_t("parity_delta"), "", CEPH_NOSNAP, 0, 1, "");
+  set<int> all;
+  for (unsigned i = 0; i < k + m; ++i) {
+    all.insert(i);
+  }
+
+  // current content of the object and its shards
+  bufferlist old_data;
+  map<int, bufferlist> old_shards;
+  map<int, bufferlist> old_stripe1;
+  for (unsigned s = 0; s < stripes; ++s) {
+    bufferptr bp(stripe_width);
+    for (unsigned i = 0; i < stripe_width; ++i) {
+      bp.c_str()[i] = rand();
+    }
+    bufferlist stripe;
+    stripe.append(bp);
+    old_data.append(stripe);
+    map<int, bufferlist> chunks;
+    ASSERT_EQ(0, ecimpl->encode(all, stripe, &chunks));
+    for (auto &&i : chunks) {
+      old_shards[i.first].append(i.second);
+    }
+    if (s == 1) {
+      old_stripe1 = chunks;
+    }
+  }
+  ECUtil::HashInfoRef hinfo(new ECUtil::HashInfo(k + m));
+  hinfo->append(0, old_shards);
+  hinfo->set_projected_total_logical_size(sinfo, stripes * stripe_width);
+  ASSERT_TRUE(hinfo->has_chunk_hash());
+
+  // 512 bytes in the second data chunk of the second stripe
+  const uint64_t off = stripe_width + chunk_size + 100;
+  bufferlist a;
+  a.append(string(512, 'x'));
+  PGTransactionUPtr t(new PGTransaction);
+  t->write(h, off, a.length(), a, 0);
+  t->obc_map[h] = ObjectContextRef(new ObjectContext);
+
+  auto plan = ECTransaction::get_write_plan(
+    sinfo,
+    std::move(t),
+    [&](const hobject_t &i) {
+      return hinfo;
+    },
+    &dpp);
+  ECTransaction::plan_parity_delta(plan, sinfo, ecimpl, &dpp);
+  ASSERT_EQ(set<int>({1}), plan.parity_delta[h]);
+
+  // what ECBackend reads: the modified data chunk and the coding chunks
+  map<hobject_t, map<int, bufferlist> > parity_delta_reads;
+  for (int i : {1, 4, 5}) {
+    parity_delta_reads[h][i] = old_stripe1[i];
+  }
+
+  vector<pg_log_entry_t> entries;
+  entries.push_back(pg_log_entry_t());
+  entries.back().op = pg_log_entry_t::MODIFY;
+  entries.back().soid = h;
+  entries.back().version = eversion_t(1, 2);
+  map<hobject_t, extent_map> written;
+  map<shard_id_t, ObjectStore::Transaction> transactions;
+  for (unsigned i = 0; i < k + m; ++i) {
+    transactions[shard_id_t(i)];
+  }
+  set<hobject_t> temp_added, temp_removed;
+  ECTransaction::generate_transactions(
+    plan,
+    ecimpl,
+    pg_t(0, 1),
+    sinfo,
+    map<hobject_t, extent_map>(),
+    parity_delta_reads,
+    entries,
+    &written,
+    &transactions,
+    &temp_added,
+    &temp_removed,
+    &dpp);
+
+  // the parity must be what a full re-encode of the new stripe gives
+  bufferlist new_stripe;
+  new_stripe.substr_of(old_data, stripe_width, chunk_size + 100);
+  new_stripe.append(a);
+  {
+    bufferlist tail;
+    tail.substr_of(old_data, off + a.length(),
+		   2 * stripe_width - off - a.length());
+    new_stripe.append(tail);
+  }
+  map<int, bufferlist> new_chunks;
+  ASSERT_EQ(0, ecimpl->encode(all, new_stripe, &new_chunks));
+
+  const uint64_t chunk_off = chunk_size;  // of the second stripe
+  for (auto &&st : transactions) {
+    int shard = st.first.id;
+    map<uint64_t, bufferlist> writes;
+    vector<pair<uint64_t, uint64_t> > saved;
+    bufferlist hinfo_bl;
+    auto i = st.second.begin();
+    while (i.have_op()) {
+      auto op = i.decode_op();
+      switch (op->op) {
+      case ObjectStore::Transaction::OP_WRITE:
+	{
+	  bufferlist bl;
+	  i.decode_bl(bl);
+	  ASSERT_EQ((uint64_t)op->len, bl.length());
+	  ASSERT_EQ(ghobject_t::NO_GEN, i.get_oid(op->oid).generation);
+	  writes[(uint64_t)op->off] = bl;
+	}
+	break;
+      case ObjectStore::Transaction::OP_CLONERANGE2:
+	ASSERT_EQ(2u, i.get_oid(op->dest_oid).generation);
+	ASSERT_EQ((uint64_t)op->off, (uint64_t)op->dest_off);
+	saved.push_back(make_pair((uint64_t)op->off, (uint64_t)op->len));
+	break;
+      case ObjectStore::Transaction::OP_SETATTR:
+	{
+	  string name = i.decode_string();
+	  bufferlist bl;
+	  i.decode_bl(bl);
+	  if (name == ECUtil::get_hinfo_key()) {
+	    hinfo_bl = bl;
+	  }
+	}
+	break;
+      case ObjectStore::Transaction::OP_SETATTRS:
+	{
+	  map<string, bufferptr> aset;
+	  i.decode_attrset(aset);
+	}
+	break;
+      case ObjectStore::Transaction::OP_RMATTR:
+	i.decode_string();
+	break;
+      case ObjectStore::Transaction::OP_TOUCH:
+	break;
+      default:
+	FAIL() << "unexpected op " << op->op << " on shard " << shard;
+      }
+    }
+
+    if (shard == 1 || shard >= (int)k) {
+      ASSERT_EQ(1u, writes.size()) << "shard " << shard;
+      ASSERT_EQ(chunk_off, writes.begin()->first);
+      ASSERT_TRUE(writes.begin()->second.contents_equal(new_chunks[shard]))
+	<< "shard " << shard;
+    } else {
+      ASSERT_EQ(0u, writes.size()) << "shard " << shard;
+    }
+    // every shard saves the chunk for rollback, written or not
+    ASSERT_EQ(1u, saved.size()) << "shard " << shard;
+    ASSERT_EQ(make_pair(chunk_off, chunk_size), saved[0]);
+
+    // the chunk hashes no longer match and are dropped; size is unchanged
+    ASSERT_LT(0u, hinfo_bl.length());
+    ECUtil::HashInfo written_hinfo;
+    auto p = hinfo_bl.begin();
+    ::decode(written_hinfo, p);
+    ASSERT_EQ(stripes * chunk_size, written_hinfo.get_total_chunk_size());
+    ASSERT_FALSE(written_hinfo.has_chunk_hash());
+  }
+
+  RollbackVisitor rollback;
+  entries.back().mod_desc.visit(&rollback);
+  ASSERT_EQ(1u, rollback.extents.size());
+  ASSERT_EQ(make_pair(chunk_off, chunk_size), rollback.extents[0]);
+  // and the old hinfo, hashes included, is kept to restore it
+  ASSERT_EQ(1u, rollback.attrs.count(ECUtil::get_hinfo_key()));
+  ASSERT_TRUE(rollback.attrs[ECUtil::get_hinfo_key()]);
+  ECUtil::HashInfo old_hinfo;
+  auto p = rollback.attrs[ECUtil::get_hinfo_key()]->begin();
+  ::decode(old_hinfo, p);
+  ASSERT_EQ(stripes * chunk_size, old_hinfo.get_total_chunk_size());
+  ASSERT_TRUE(old_hinfo.has_chunk_hash());
+  for (unsigned i = 0; i < k + m; ++i) {
+    ASSERT_EQ(ceph_crc32c(-1, (const unsigned char*)old_shards[i].c_str(),
+			  old_shards[i].length()),
+	      old_hinfo.get_chunk_hash(i));
+  }
+}